@@ -0,0 +1,664 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+
+
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#ifdef __linux__
+#	include <sys/epoll.h>
+#else
+#	include <poll.h>
+#endif
+
+#include <stdlib.h> /* malloc, exit */
+#include <stdio.h> /* snprintf */
+#include <unistd.h> /* close, write, sysconf */
+#include <fcntl.h> /* For O_* constants */
+#include <pthread.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <string.h> /* bcopy, bzero, memcpy, memmove, memset, strerror... */
+#include <time.h>
+#include <errno.h>
+
+#include "bench_gen.h"
+#include "bench_cli.h"
+#include "bench_util.h"
+
+
+#define BENCH_CLI_RCV_BUF_SIZE	(256 * 1024)
+#define BENCH_CLI_HDR_MAX	1024
+#define BENCH_CLI_RECV_MAX	4	/* recv() per client per wakeup: fairness. */
+#define BENCH_CLI_EV_MAX	256
+#define BENCH_CLI_WAIT		10	/* ms. */
+#define BENCH_CLI_LAG_SAMPLES	65536	/* Per thread, power of 2. */
+
+#define BENCH_CLI_ST_IDLE	0
+#define BENCH_CLI_ST_CONN	1
+#define BENCH_CLI_ST_HDRS	2
+#define BENCH_CLI_ST_DATA	3
+#define BENCH_CLI_ST_DEAD	4
+
+typedef struct bench_cli_conn_s {
+	int		fd;
+	uint32_t	state;		/* BENCH_CLI_ST_*. */
+	size_t		chan;
+	uint64_t	start_time;	/* ns, connect(). */
+	uint64_t	join_time;	/* ns, first body byte - start. */
+	uint8_t		cc_data;	/* 0xff = unknown. */
+	uint8_t		cc_time;
+	size_t		buf_size;	/* Headers or TS packet tail. */
+	uint8_t		buf[BENCH_CLI_HDR_MAX];
+} bench_cli_conn_t, *bench_cli_conn_p;
+
+typedef struct bench_cli_thr_s {
+	bench_cli_p	cli;
+	pthread_t	pt_id;
+	int		pt_created;
+	bench_cli_conn_p conn;
+	size_t		conn_count;
+	size_t		conn_next;	/* Next to connect. */
+	uint32_t	connect_rate;
+#ifdef __linux__
+	int		efd;
+#else
+	struct pollfd	*pfd;
+#endif
+	uint8_t		*rcv_buf;
+	uint64_t	*lag;		/* Ring. */
+	size_t		lag_count;	/* Total writes. */
+	uint32_t	lag_gen;
+	/* Stat. */
+	atomic_uint_fast64_t rcvd_size;
+	atomic_uint_fast64_t recv_calls;
+	atomic_uint_fast64_t cc_errors;
+	atomic_uint_fast64_t sync_errors;
+	atomic_uint_fast64_t connected;
+	atomic_uint_fast64_t conn_fail;
+	atomic_uint_fast64_t dropped;
+} bench_cli_thr_t, *bench_cli_thr_p;
+
+typedef struct bench_cli_s {
+	bench_cli_params_t p;
+	atomic_int	running;
+	atomic_uint	lag_gen;
+	int		stopped;
+	bench_cli_thr_p	thr;
+	bench_cli_conn_p conn;		/* All clients. */
+} bench_cli_t;
+
+
+static void	*bench_cli_proc(void *arg);
+static void	bench_cli_conn_start(bench_cli_thr_p thr, size_t idx);
+static void	bench_cli_conn_close(bench_cli_thr_p thr, bench_cli_conn_p conn,
+		    uint32_t state);
+static void	bench_cli_conn_io(bench_cli_thr_p thr, size_t idx,
+		    int writable);
+static int	bench_cli_hdrs_parse(bench_cli_thr_p thr, bench_cli_conn_p conn,
+		    uint8_t *buf, size_t buf_size);
+static void	bench_cli_ts_parse(bench_cli_thr_p thr, bench_cli_conn_p conn,
+		    const uint8_t *buf, size_t buf_size, uint64_t now);
+static void	bench_cli_ts_pkt(bench_cli_thr_p thr, bench_cli_conn_p conn,
+		    const uint8_t *pkt, uint64_t now);
+static int	bench_cli_ev_set(bench_cli_thr_p thr, size_t idx, int add,
+		    int want_write);
+
+
+void
+bench_cli_def(bench_cli_params_p params) {
+
+	if (NULL == params)
+		return;
+	memset(params, 0x00, sizeof(bench_cli_params_t));
+	params->channels = 1;
+	params->clients = 1;
+	params->threads = 1;
+	params->connect_rate = BENCH_CLI_DEF_CONNECT_RATE;
+}
+
+int
+bench_cli_create(bench_cli_params_p params, bench_cli_p *cli_ret) {
+	int error;
+	bench_cli_p cli;
+	bench_cli_thr_p thr;
+	size_t i, off = 0;
+
+	if (NULL == params || NULL == cli_ret || 0 == params->channels ||
+	    0 == params->clients || 0 == params->threads)
+		return (EINVAL);
+	cli = calloc(1, sizeof(bench_cli_t));
+	if (NULL == cli)
+		return (ENOMEM);
+	memcpy(&cli->p, params, sizeof(bench_cli_params_t));
+	cli->p.threads = MIN(cli->p.threads, cli->p.clients);
+	atomic_init(&cli->running, 1);
+	atomic_init(&cli->lag_gen, 0);
+	cli->thr = calloc(cli->p.threads, sizeof(bench_cli_thr_t));
+	cli->conn = calloc(cli->p.clients, sizeof(bench_cli_conn_t));
+	if (NULL == cli->thr || NULL == cli->conn) {
+		error = ENOMEM;
+		goto err_out;
+	}
+	for (i = 0; i < cli->p.clients; i ++) {
+		cli->conn[i].fd = -1;
+		cli->conn[i].chan = (i % cli->p.channels);
+	}
+	for (i = 0; i < cli->p.threads; i ++) {
+		thr = &cli->thr[i];
+		thr->cli = cli;
+#ifdef __linux__
+		thr->efd = -1;
+#endif
+		thr->conn = &cli->conn[off];
+		thr->conn_count = (((i + 1) * cli->p.clients / cli->p.threads) - off);
+		off += thr->conn_count;
+		thr->connect_rate = (uint32_t)MAX(1,
+		    (cli->p.connect_rate / cli->p.threads));
+		atomic_init(&thr->rcvd_size, 0);
+		atomic_init(&thr->recv_calls, 0);
+		atomic_init(&thr->cc_errors, 0);
+		atomic_init(&thr->sync_errors, 0);
+		atomic_init(&thr->connected, 0);
+		atomic_init(&thr->conn_fail, 0);
+		atomic_init(&thr->dropped, 0);
+		thr->rcv_buf = malloc(BENCH_CLI_RCV_BUF_SIZE);
+		thr->lag = malloc((BENCH_CLI_LAG_SAMPLES * sizeof(uint64_t)));
+#ifdef __linux__
+		thr->efd = epoll_create1(EPOLL_CLOEXEC);
+		if (-1 == thr->efd) {
+			error = errno;
+			goto err_out;
+		}
+#else
+		thr->pfd = calloc(thr->conn_count, sizeof(struct pollfd));
+		if (NULL == thr->pfd) {
+			error = ENOMEM;
+			goto err_out;
+		}
+		for (size_t j = 0; j < thr->conn_count; j ++) {
+			thr->pfd[j].fd = -1;
+		}
+#endif
+		if (NULL == thr->rcv_buf || NULL == thr->lag) {
+			error = ENOMEM;
+			goto err_out;
+		}
+	}
+	for (i = 0; i < cli->p.threads; i ++) {
+		thr = &cli->thr[i];
+		error = pthread_create(&thr->pt_id, NULL, bench_cli_proc, thr);
+		if (0 != error)
+			goto err_out;
+		thr->pt_created = 1;
+	}
+
+	(*cli_ret) = cli;
+	return (0);
+
+err_out:
+	bench_cli_destroy(cli);
+	return (error);
+}
+
+void
+bench_cli_stop(bench_cli_p cli) {
+
+	if (NULL == cli || 0 != cli->stopped)
+		return;
+	atomic_store_explicit(&cli->running, 0, memory_order_release);
+	for (size_t i = 0; i < cli->p.threads; i ++) {
+		if (0 == cli->thr[i].pt_created)
+			continue;
+		pthread_join(cli->thr[i].pt_id, NULL);
+	}
+	cli->stopped = 1;
+}
+
+void
+bench_cli_destroy(bench_cli_p cli) {
+	bench_cli_thr_p thr;
+
+	if (NULL == cli)
+		return;
+	bench_cli_stop(cli);
+	if (NULL != cli->conn) {
+		for (size_t i = 0; i < cli->p.clients; i ++) {
+			if (-1 == cli->conn[i].fd)
+				continue;
+			close(cli->conn[i].fd);
+		}
+	}
+	if (NULL != cli->thr) {
+		for (size_t i = 0; i < cli->p.threads; i ++) {
+			thr = &cli->thr[i];
+#ifdef __linux__
+			if (-1 != thr->efd) {
+				close(thr->efd);
+			}
+#else
+			free(thr->pfd);
+#endif
+			free(thr->rcv_buf);
+			free(thr->lag);
+		}
+	}
+	free(cli->thr);
+	free(cli->conn);
+	free(cli);
+}
+
+void
+bench_cli_stat_get(bench_cli_p cli, bench_cli_stat_p stat) {
+	bench_cli_thr_p thr;
+	uint64_t *vals;
+	size_t i, j, count;
+
+	if (NULL == cli || NULL == stat)
+		return;
+	memset(stat, 0x00, sizeof(bench_cli_stat_t));
+	for (i = 0; i < cli->p.threads; i ++) {
+		thr = &cli->thr[i];
+		stat->rcvd_size += atomic_load_explicit(&thr->rcvd_size,
+		    memory_order_relaxed);
+		stat->recv_calls += atomic_load_explicit(&thr->recv_calls,
+		    memory_order_relaxed);
+		stat->cc_errors += atomic_load_explicit(&thr->cc_errors,
+		    memory_order_relaxed);
+		stat->sync_errors += atomic_load_explicit(&thr->sync_errors,
+		    memory_order_relaxed);
+		stat->connected += atomic_load_explicit(&thr->connected,
+		    memory_order_relaxed);
+		stat->conn_fail += atomic_load_explicit(&thr->conn_fail,
+		    memory_order_relaxed);
+		stat->dropped += atomic_load_explicit(&thr->dropped,
+		    memory_order_relaxed);
+	}
+	if (0 == cli->stopped)
+		return;
+	/* Percentiles: threads stopped, no races. */
+	count = MAX(cli->p.clients, (cli->p.threads * BENCH_CLI_LAG_SAMPLES));
+	vals = malloc((count * sizeof(uint64_t)));
+	if (NULL == vals)
+		return;
+	for (i = 0, count = 0; i < cli->p.clients; i ++) {
+		if (2 > cli->conn[i].join_time) /* 1: headers only. */
+			continue;
+		vals[count ++] = cli->conn[i].join_time;
+	}
+	stat->join_max = bench_percentile(vals, count, 100);
+	stat->join_p99 = bench_percentile(vals, count, 99);
+	stat->join_p50 = bench_percentile(vals, count, 50);
+	for (i = 0, count = 0; i < cli->p.threads; i ++) {
+		thr = &cli->thr[i];
+		j = MIN(thr->lag_count, BENCH_CLI_LAG_SAMPLES);
+		memcpy(&vals[count], thr->lag, (j * sizeof(uint64_t)));
+		count += j;
+	}
+	stat->lag_max = bench_percentile(vals, count, 100);
+	stat->lag_p99 = bench_percentile(vals, count, 99);
+	stat->lag_p50 = bench_percentile(vals, count, 50);
+	free(vals);
+}
+
+void
+bench_cli_lag_reset(bench_cli_p cli) {
+
+	if (NULL == cli)
+		return;
+	atomic_fetch_add_explicit(&cli->lag_gen, 1, memory_order_release);
+}
+
+
+static void *
+bench_cli_proc(void *arg) {
+	bench_cli_thr_p thr = arg;
+	bench_cli_p cli = thr->cli;
+	uint64_t start, due;
+	size_t i;
+	uint32_t lag_gen;
+#ifdef __linux__
+	struct epoll_event ev[BENCH_CLI_EV_MAX];
+	int ev_count;
+#endif
+
+	start = bench_time_ns();
+	while (0 != atomic_load_explicit(&cli->running,
+	    memory_order_acquire)) {
+		lag_gen = atomic_load_explicit(&cli->lag_gen,
+		    memory_order_acquire);
+		if (lag_gen != thr->lag_gen) {
+			thr->lag_gen = lag_gen;
+			thr->lag_count = 0;
+		}
+		/* Connect ramp. */
+		due = (((bench_time_ns() - start) / 1000000) *
+		    thr->connect_rate / 1000);
+		due = MIN(due + 1, thr->conn_count);
+		if (0 == cli->p.connect_rate) {
+			due = thr->conn_count;
+		}
+		for (; thr->conn_next < due; thr->conn_next ++) {
+			bench_cli_conn_start(thr, thr->conn_next);
+		}
+#ifdef __linux__
+		ev_count = epoll_wait(thr->efd, ev, BENCH_CLI_EV_MAX,
+		    BENCH_CLI_WAIT);
+		for (int j = 0; j < ev_count; j ++) {
+			bench_cli_conn_io(thr, ev[j].data.u32,
+			    (0 != (EPOLLOUT & ev[j].events)));
+		}
+#else
+		if (0 >= poll(thr->pfd, thr->conn_next, BENCH_CLI_WAIT))
+			continue;
+		for (i = 0; i < thr->conn_next; i ++) {
+			if (0 == thr->pfd[i].revents)
+				continue;
+			bench_cli_conn_io(thr, i,
+			    (0 != (POLLOUT & thr->pfd[i].revents)));
+		}
+#endif
+	}
+	/* Clients stay connected until destroy: no drop on stop. */
+	for (i = 0; i < thr->conn_count; i ++) {
+		if (-1 == thr->conn[i].fd)
+			continue;
+		bench_cli_ev_set(thr, i, -1, 0);
+	}
+
+	return (NULL);
+}
+
+static void
+bench_cli_conn_start(bench_cli_thr_p thr, size_t idx) {
+	bench_cli_conn_p conn = &thr->conn[idx];
+	int val;
+
+	conn->start_time = bench_time_ns();
+	conn->cc_data = 0xff;
+	conn->cc_time = 0xff;
+	conn->fd = socket(thr->cli->p.server.ss_family, SOCK_STREAM, IPPROTO_TCP);
+	if (-1 == conn->fd)
+		goto err_out;
+	fcntl(conn->fd, F_SETFL, (fcntl(conn->fd, F_GETFL, 0) | O_NONBLOCK));
+	if (0 != thr->cli->p.rcv_buf) {
+		val = (int)(thr->cli->p.rcv_buf * 1024);
+		setsockopt(conn->fd, SOL_SOCKET, SO_RCVBUF, &val, sizeof(val));
+	}
+	if (0 != connect(conn->fd, (struct sockaddr*)&thr->cli->p.server,
+	    bench_sa_size(&thr->cli->p.server)) &&
+	    EINPROGRESS != errno)
+		goto err_out;
+	conn->state = BENCH_CLI_ST_CONN;
+	if (0 != bench_cli_ev_set(thr, idx, 1, 1))
+		goto err_out;
+	return;
+
+err_out:
+	atomic_fetch_add_explicit(&thr->conn_fail, 1, memory_order_relaxed);
+	if (-1 != conn->fd) {
+		close(conn->fd);
+		conn->fd = -1;
+	}
+	conn->state = BENCH_CLI_ST_DEAD;
+}
+
+static void
+bench_cli_conn_close(bench_cli_thr_p thr, bench_cli_conn_p conn,
+    uint32_t state) {
+
+	if (BENCH_CLI_ST_DATA == conn->state) {
+		atomic_fetch_sub_explicit(&thr->connected, 1,
+		    memory_order_relaxed);
+		atomic_fetch_add_explicit(&thr->dropped, 1,
+		    memory_order_relaxed);
+	} else {
+		atomic_fetch_add_explicit(&thr->conn_fail, 1,
+		    memory_order_relaxed);
+	}
+	bench_cli_ev_set(thr, (size_t)(conn - thr->conn), -1, 0);
+	close(conn->fd);
+	conn->fd = -1;
+	conn->state = state;
+}
+
+static void
+bench_cli_conn_io(bench_cli_thr_p thr, size_t idx, int writable) {
+	bench_cli_conn_p conn = &thr->conn[idx];
+	char req[256], straddr[INET6_ADDRSTRLEN];
+	struct sockaddr_storage addr;
+	int error, ret;
+	socklen_t optlen;
+	ssize_t ios;
+	size_t i;
+	uint64_t now;
+
+	if (-1 == conn->fd)
+		return;
+	if (BENCH_CLI_ST_CONN == conn->state) {
+		if (0 == writable)
+			return;
+		optlen = sizeof(error);
+		if (0 != getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &error,
+		    &optlen) || 0 != error)
+			goto err_out;
+		bench_sa_add(&thr->cli->p.group, (uint32_t)conn->chan, &addr);
+		if (AF_INET == addr.ss_family) {
+			inet_ntop(AF_INET,
+			    &((struct sockaddr_in*)(void*)&addr)->sin_addr,
+			    straddr, sizeof(straddr));
+			ret = snprintf(req, sizeof(req),
+			    "GET /udp/%s:%u HTTP/1.1\r\n", straddr,
+			    ntohs(((struct sockaddr_in*)(void*)&addr)->sin_port));
+		} else {
+			inet_ntop(AF_INET6,
+			    &((struct sockaddr_in6*)(void*)&addr)->sin6_addr,
+			    straddr, sizeof(straddr));
+			ret = snprintf(req, sizeof(req),
+			    "GET /udp/[%s]:%u HTTP/1.1\r\n", straddr,
+			    ntohs(((struct sockaddr_in6*)(void*)&addr)->sin6_port));
+		}
+		ret += snprintf((req + ret), (sizeof(req) - (size_t)ret),
+		    "Host: bench\r\n"
+		    "User-Agent: msd_bench\r\n"
+		    "Connection: close\r\n"
+		    "\r\n");
+		/* Small request: fits in empty send buffer. */
+		if (ret != send(conn->fd, req, (size_t)ret, MSG_NOSIGNAL))
+			goto err_out;
+		conn->state = BENCH_CLI_ST_HDRS;
+		conn->buf_size = 0;
+		if (0 != bench_cli_ev_set(thr, idx, 0, 0))
+			goto err_out;
+		return;
+	}
+	for (i = 0; i < BENCH_CLI_RECV_MAX; i ++) {
+		ios = recv(conn->fd, thr->rcv_buf, BENCH_CLI_RCV_BUF_SIZE,
+		    MSG_DONTWAIT);
+		atomic_fetch_add_explicit(&thr->recv_calls, 1,
+		    memory_order_relaxed);
+		if (0 > ios) {
+			if (EAGAIN == errno || EWOULDBLOCK == errno ||
+			    EINTR == errno)
+				return;
+			goto err_out;
+		}
+		if (0 == ios)
+			goto err_out;
+		now = bench_time_ns();
+		if (BENCH_CLI_ST_HDRS == conn->state) {
+			if (0 != bench_cli_hdrs_parse(thr, conn,
+			    thr->rcv_buf, (size_t)ios))
+				goto err_out;
+			continue;
+		}
+		atomic_fetch_add_explicit(&thr->rcvd_size, (uint64_t)ios,
+		    memory_order_relaxed);
+		bench_cli_ts_parse(thr, conn, thr->rcv_buf, (size_t)ios, now);
+	}
+	return;
+
+err_out:
+	bench_cli_conn_close(thr, conn, BENCH_CLI_ST_DEAD);
+}
+
+/* Accumulate headers, on end switch to data and parse body part. */
+static int
+bench_cli_hdrs_parse(bench_cli_thr_p thr, bench_cli_conn_p conn,
+    uint8_t *buf, size_t buf_size) {
+	uint8_t *end;
+	size_t tm, body_off;
+
+	tm = MIN(buf_size, (sizeof(conn->buf) - conn->buf_size));
+	memcpy((conn->buf + conn->buf_size), buf, tm);
+	conn->buf_size += tm;
+	end = memmem(conn->buf, conn->buf_size, "\r\n\r\n", 4);
+	if (NULL == end) {
+		if (sizeof(conn->buf) == conn->buf_size)
+			return (EBADMSG);
+		return (0);
+	}
+	if (12 > conn->buf_size ||
+	    0 != memcmp(conn->buf, "HTTP/1.", 7) ||
+	    0 != memcmp((conn->buf + 8), " 200", 4))
+		return (EBADMSG);
+	/* Body start in buf: headers tail not in conn->buf before copy. */
+	body_off = ((size_t)((end + 4) - conn->buf) - (conn->buf_size - tm));
+	conn->state = BENCH_CLI_ST_DATA;
+	conn->buf_size = 0;
+	conn->join_time = 1; /* Set on first body byte. */
+	atomic_fetch_add_explicit(&thr->connected, 1, memory_order_relaxed);
+	if (body_off < buf_size) {
+		atomic_fetch_add_explicit(&thr->rcvd_size,
+		    (uint64_t)(buf_size - body_off), memory_order_relaxed);
+		bench_cli_ts_parse(thr, conn, (buf + body_off),
+		    (buf_size - body_off), bench_time_ns());
+	}
+	return (0);
+}
+
+static void
+bench_cli_ts_parse(bench_cli_thr_p thr, bench_cli_conn_p conn,
+    const uint8_t *buf, size_t buf_size, uint64_t now) {
+	size_t tm, skipped = 0;
+
+	if (1 == conn->join_time) {
+		conn->join_time = MAX(1, (now - conn->start_time));
+	}
+	/* Packet tail from previous recv(). */
+	if (0 != conn->buf_size) {
+		tm = MIN(buf_size, (BENCH_TS_SIZE - conn->buf_size));
+		memcpy((conn->buf + conn->buf_size), buf, tm);
+		conn->buf_size += tm;
+		buf += tm;
+		buf_size -= tm;
+		if (BENCH_TS_SIZE != conn->buf_size)
+			return;
+		conn->buf_size = 0;
+		bench_cli_ts_pkt(thr, conn, conn->buf, now);
+	}
+	while (BENCH_TS_SIZE <= buf_size) {
+		if (0x47 != buf[0]) { /* Resync. */
+			buf ++;
+			buf_size --;
+			skipped ++;
+			continue;
+		}
+		bench_cli_ts_pkt(thr, conn, buf, now);
+		buf += BENCH_TS_SIZE;
+		buf_size -= BENCH_TS_SIZE;
+	}
+	if (0 != buf_size) {
+		memcpy(conn->buf, buf, buf_size);
+		conn->buf_size = buf_size;
+	}
+	if (0 != skipped) {
+		atomic_fetch_add_explicit(&thr->sync_errors, skipped,
+		    memory_order_relaxed);
+	}
+}
+
+static void
+bench_cli_ts_pkt(bench_cli_thr_p thr, bench_cli_conn_p conn,
+    const uint8_t *pkt, uint64_t now) {
+	uint16_t pid;
+	uint8_t cc, *cc_last;
+	uint64_t time;
+
+	pid = (uint16_t)(((pkt[1] & 0x1f) << 8) | pkt[2]);
+	switch (pid) {
+	case BENCH_TS_PID_DATA:
+		cc_last = &conn->cc_data;
+		break;
+	case BENCH_TS_PID_TIME:
+		cc_last = &conn->cc_time;
+		break;
+	default:
+		return;
+	}
+	cc = (pkt[3] & 0x0f);
+	if (0xff != (*cc_last) && cc != (((*cc_last) + 1) & 0x0f)) {
+		atomic_fetch_add_explicit(&thr->cc_errors, 1,
+		    memory_order_relaxed);
+	}
+	(*cc_last) = cc;
+	if (BENCH_TS_PID_TIME != pid ||
+	    BENCH_TS_TIME_MAGIC != bench_u64_get((pkt + 4)))
+		return;
+	time = bench_u64_get((pkt + 12));
+	thr->lag[(thr->lag_count & (BENCH_CLI_LAG_SAMPLES - 1))] =
+	    ((now > time) ? (now - time) : 0);
+	thr->lag_count ++;
+}
+
+/* add: 1 = add, 0 = modify, -1 = delete. */
+static int
+bench_cli_ev_set(bench_cli_thr_p thr, size_t idx, int add, int want_write) {
+#ifdef __linux__
+	struct epoll_event ev;
+
+	memset(&ev, 0x00, sizeof(ev));
+	ev.events = ((0 != want_write) ? EPOLLOUT : EPOLLIN);
+	ev.data.u32 = (uint32_t)idx;
+	if (0 != epoll_ctl(thr->efd, ((0 < add) ? EPOLL_CTL_ADD :
+	    ((0 == add) ? EPOLL_CTL_MOD : EPOLL_CTL_DEL)),
+	    thr->conn[idx].fd, &ev))
+		return (errno);
+#else
+	thr->pfd[idx].fd = ((0 > add) ? -1 : thr->conn[idx].fd);
+	thr->pfd[idx].events = ((0 != want_write) ? POLLOUT : POLLIN);
+	thr->pfd[idx].revents = 0;
+#endif
+	return (0);
+}
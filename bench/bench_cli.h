@@ -0,0 +1,89 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+
+
+#ifndef __MSD_BENCH_CLI_H__
+#define __MSD_BENCH_CLI_H__
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <inttypes.h>
+
+
+/*
+ * Many HTTP stream clients, spread over threads and channels:
+ * client N play /udp/GROUP + (N % channels):PORT.
+ * Check TS sync and continuity, measure join time (connect to first
+ * body byte) and lag (generator time PID to receive time).
+ */
+
+typedef struct bench_cli_s *bench_cli_p;
+
+typedef struct bench_cli_params_s {
+	struct sockaddr_storage	server;	/* msd_lite HTTP. */
+	struct sockaddr_storage	group;	/* First group:port, same as generator. */
+	size_t		channels;
+	size_t		clients;
+	size_t		threads;
+	uint32_t	connect_rate;	/* New connections per second, 0 = no limit. */
+	uint32_t	rcv_buf;	/* kb, 0 = OS default. */
+} bench_cli_params_t, *bench_cli_params_p;
+
+#define BENCH_CLI_DEF_CONNECT_RATE	1000
+
+typedef struct bench_cli_stat_s {
+	uint64_t	rcvd_size;	/* Body bytes. */
+	uint64_t	recv_calls;
+	uint64_t	cc_errors;	/* TS continuity counter errors. */
+	uint64_t	sync_errors;	/* Bytes skipped to find sync byte. */
+	uint64_t	connected;	/* Now receiving body. */
+	uint64_t	conn_fail;	/* Connect fail or not 200 responce. */
+	uint64_t	dropped;	/* Closed by server after join. */
+	/* Set only after bench_cli_stop(), ns. */
+	uint64_t	join_p50;
+	uint64_t	join_p99;
+	uint64_t	join_max;
+	uint64_t	lag_p50;
+	uint64_t	lag_p99;
+	uint64_t	lag_max;
+} bench_cli_stat_t, *bench_cli_stat_p;
+
+
+void	bench_cli_def(bench_cli_params_p params);
+int	bench_cli_create(bench_cli_params_p params, bench_cli_p *cli_ret);
+/* Stop threads, sockets closed by destroy. */
+void	bench_cli_stop(bench_cli_p cli);
+void	bench_cli_destroy(bench_cli_p cli);
+void	bench_cli_stat_get(bench_cli_p cli, bench_cli_stat_p stat);
+/* Drop lag samples: start of measure interval. */
+void	bench_cli_lag_reset(bench_cli_p cli);
+
+
+#endif /* __MSD_BENCH_CLI_H__ */
@@ -0,0 +1,304 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+
+
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+
+#include <stdlib.h> /* malloc, exit */
+#include <stdio.h>
+#include <unistd.h> /* close, write, sysconf */
+#include <pthread.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <string.h> /* bcopy, bzero, memcpy, memmove, memset, strerror... */
+#include <time.h>
+#include <errno.h>
+
+#include "bench_gen.h"
+#include "bench_util.h"
+
+
+#define BENCH_GEN_TICK		1000000ull	/* ns, pacing tick. */
+#define BENCH_GEN_LATE_MAX	100000000ull	/* ns, behind: skip, not burst. */
+#define BENCH_RTP_HDR_SIZE	12
+
+typedef struct bench_gen_chan_s {
+	struct sockaddr_storage	addr;
+	uint8_t		cc_data;
+	uint8_t		cc_time;
+	uint16_t	rtp_seq;
+	uint64_t	next_time;	/* ns, time PID packet. */
+} bench_gen_chan_t, *bench_gen_chan_p;
+
+typedef struct bench_gen_s {
+	bench_gen_params_t p;
+	int		skt;
+	pthread_t	pt_id;
+	atomic_int	running;
+	bench_gen_chan_p chan;
+	uint8_t		buf[(BENCH_RTP_HDR_SIZE + BENCH_TS_DGRAM_SIZE)];
+	/* Stat. */
+	atomic_uint_fast64_t dgram_count;
+	atomic_uint_fast64_t sended_size;
+	atomic_uint_fast64_t send_errors;
+	atomic_uint_fast64_t late_count;
+} bench_gen_t;
+
+
+static void	*bench_gen_proc(void *arg);
+static size_t	bench_gen_dgram_make(bench_gen_p gen, bench_gen_chan_p chan,
+		    uint64_t now);
+
+
+void
+bench_gen_def(bench_gen_params_p params) {
+
+	if (NULL == params)
+		return;
+	memset(params, 0x00, sizeof(bench_gen_params_t));
+	params->channels = 1;
+	params->rate = BENCH_GEN_DEF_RATE;
+	params->time_interval = BENCH_GEN_DEF_TIME_INTERVAL;
+	params->ttl = 1;
+}
+
+int
+bench_gen_create(bench_gen_params_p params, bench_gen_p *gen_ret) {
+	int error, on = 1;
+	bench_gen_p gen;
+	size_t i;
+	struct in_addr if_addr4;
+	unsigned int if_index6;
+
+	if (NULL == params || NULL == gen_ret || 0 == params->channels ||
+	    0 == params->rate ||
+	    (AF_INET != params->group.ss_family &&
+	    AF_INET6 != params->group.ss_family))
+		return (EINVAL);
+	gen = calloc(1, sizeof(bench_gen_t));
+	if (NULL == gen)
+		return (ENOMEM);
+	memcpy(&gen->p, params, sizeof(bench_gen_params_t));
+	gen->skt = -1;
+	gen->chan = calloc(params->channels, sizeof(bench_gen_chan_t));
+	if (NULL == gen->chan) {
+		error = ENOMEM;
+		goto err_out;
+	}
+	for (i = 0; i < params->channels; i ++) {
+		bench_sa_add(&params->group, (uint32_t)i, &gen->chan[i].addr);
+		gen->chan[i].rtp_seq = (uint16_t)random();
+	}
+	gen->skt = socket(params->group.ss_family, SOCK_DGRAM, IPPROTO_UDP);
+	if (-1 == gen->skt) {
+		error = errno;
+		goto err_out;
+	}
+	/* Out interface: loopback unless set. */
+	if (AF_INET == params->group.ss_family) {
+		if (AF_INET == params->if_addr.ss_family) {
+			if_addr4 = ((struct sockaddr_in*)(void*)&params->if_addr)->sin_addr;
+		} else {
+			if_addr4.s_addr = htonl(INADDR_LOOPBACK);
+		}
+		if (0 != setsockopt(gen->skt, IPPROTO_IP, IP_MULTICAST_IF,
+		    &if_addr4, sizeof(if_addr4)) ||
+		    0 != setsockopt(gen->skt, IPPROTO_IP, IP_MULTICAST_LOOP,
+		    &on, sizeof(on)) ||
+		    0 != setsockopt(gen->skt, IPPROTO_IP, IP_MULTICAST_TTL,
+		    &params->ttl, sizeof(params->ttl))) {
+			error = errno;
+			goto err_out;
+		}
+	} else {
+		if_index6 = if_nametoindex("lo");
+		if (0 == if_index6) {
+			if_index6 = if_nametoindex("lo0");
+		}
+		if (0 != setsockopt(gen->skt, IPPROTO_IPV6, IPV6_MULTICAST_IF,
+		    &if_index6, sizeof(if_index6)) ||
+		    0 != setsockopt(gen->skt, IPPROTO_IPV6, IPV6_MULTICAST_LOOP,
+		    &on, sizeof(on)) ||
+		    0 != setsockopt(gen->skt, IPPROTO_IPV6, IPV6_MULTICAST_HOPS,
+		    &params->ttl, sizeof(params->ttl))) {
+			error = errno;
+			goto err_out;
+		}
+	}
+	/* Payload filler, headers set per datagram. */
+	memset(gen->buf, 0xff, sizeof(gen->buf));
+	atomic_init(&gen->running, 1);
+	atomic_init(&gen->dgram_count, 0);
+	atomic_init(&gen->sended_size, 0);
+	atomic_init(&gen->send_errors, 0);
+	atomic_init(&gen->late_count, 0);
+	error = pthread_create(&gen->pt_id, NULL, bench_gen_proc, gen);
+	if (0 != error)
+		goto err_out;
+
+	(*gen_ret) = gen;
+	return (0);
+
+err_out:
+	if (-1 != gen->skt) {
+		close(gen->skt);
+	}
+	free(gen->chan);
+	free(gen);
+	return (error);
+}
+
+void
+bench_gen_destroy(bench_gen_p gen) {
+
+	if (NULL == gen)
+		return;
+	atomic_store_explicit(&gen->running, 0, memory_order_release);
+	pthread_join(gen->pt_id, NULL);
+	close(gen->skt);
+	free(gen->chan);
+	free(gen);
+}
+
+void
+bench_gen_stat_get(bench_gen_p gen, bench_gen_stat_p stat) {
+
+	if (NULL == gen || NULL == stat)
+		return;
+	stat->dgram_count = atomic_load_explicit(&gen->dgram_count,
+	    memory_order_relaxed);
+	stat->sended_size = atomic_load_explicit(&gen->sended_size,
+	    memory_order_relaxed);
+	stat->send_errors = atomic_load_explicit(&gen->send_errors,
+	    memory_order_relaxed);
+	stat->late_count = atomic_load_explicit(&gen->late_count,
+	    memory_order_relaxed);
+}
+
+
+/* All channels have same rate: one schedule, same datagrams count each. */
+static void *
+bench_gen_proc(void *arg) {
+	bench_gen_p gen = arg;
+	uint64_t start, now, due, sended = 0;
+	size_t i, size;
+	struct timespec tp;
+
+	start = bench_time_ns();
+	while (0 != atomic_load_explicit(&gen->running,
+	    memory_order_acquire)) {
+		now = bench_time_ns();
+		/* kbit/s -> datagrams since start. */
+		due = (((now - start) / 1000) * gen->p.rate /
+		    (8000ull * BENCH_TS_DGRAM_SIZE));
+		if ((due - sended) > ((BENCH_GEN_LATE_MAX / 1000) *
+		    gen->p.rate / (8000ull * BENCH_TS_DGRAM_SIZE))) {
+			atomic_fetch_add_explicit(&gen->late_count, 1,
+			    memory_order_relaxed);
+			sended = due;
+		}
+		for (; sended < due; sended ++) {
+			for (i = 0; i < gen->p.channels; i ++) {
+				size = bench_gen_dgram_make(gen, &gen->chan[i],
+				    now);
+				if ((ssize_t)size != sendto(gen->skt, gen->buf,
+				    size, 0,
+				    (struct sockaddr*)&gen->chan[i].addr,
+				    bench_sa_size(&gen->chan[i].addr))) {
+					atomic_fetch_add_explicit(&gen->send_errors,
+					    1, memory_order_relaxed);
+					continue;
+				}
+				atomic_fetch_add_explicit(&gen->dgram_count, 1,
+				    memory_order_relaxed);
+				atomic_fetch_add_explicit(&gen->sended_size,
+				    size, memory_order_relaxed);
+			}
+		}
+		tp.tv_sec = 0;
+		tp.tv_nsec = (long)BENCH_GEN_TICK;
+		nanosleep(&tp, NULL);
+	}
+
+	return (NULL);
+}
+
+static size_t
+bench_gen_dgram_make(bench_gen_p gen, bench_gen_chan_p chan, uint64_t now) {
+	uint8_t *pkt;
+	size_t i, off = 0;
+	uint32_t ts, ssrc;
+
+	if (0 != gen->p.rtp) {
+		ts = (uint32_t)((now / 1000) * 90 / 1000); /* 90 kHz. */
+		gen->buf[0] = 0x80;
+		gen->buf[1] = 33; /* MP2T. */
+		gen->buf[2] = (uint8_t)(chan->rtp_seq >> 8);
+		gen->buf[3] = (uint8_t)chan->rtp_seq;
+		gen->buf[4] = (uint8_t)(ts >> 24);
+		gen->buf[5] = (uint8_t)(ts >> 16);
+		gen->buf[6] = (uint8_t)(ts >> 8);
+		gen->buf[7] = (uint8_t)ts;
+		ssrc = (uint32_t)((chan - gen->chan) + 1);
+		gen->buf[8] = (uint8_t)(ssrc >> 24);
+		gen->buf[9] = (uint8_t)(ssrc >> 16);
+		gen->buf[10] = (uint8_t)(ssrc >> 8);
+		gen->buf[11] = (uint8_t)ssrc;
+		chan->rtp_seq ++;
+		off = BENCH_RTP_HDR_SIZE;
+	}
+	for (i = 0; i < 7; i ++) {
+		pkt = (gen->buf + off + (i * BENCH_TS_SIZE));
+		pkt[0] = 0x47;
+		if (0 == i && chan->next_time <= now) {
+			chan->next_time = (now +
+			    ((uint64_t)gen->p.time_interval * 1000000ull));
+			pkt[1] = (BENCH_TS_PID_TIME >> 8);
+			pkt[2] = (BENCH_TS_PID_TIME & 0xff);
+			pkt[3] = (0x10 | chan->cc_time);
+			chan->cc_time = ((chan->cc_time + 1) & 0x0f);
+			bench_u64_put((pkt + 4), BENCH_TS_TIME_MAGIC);
+			bench_u64_put((pkt + 12), now);
+			continue;
+		}
+		pkt[1] = (BENCH_TS_PID_DATA >> 8);
+		pkt[2] = (BENCH_TS_PID_DATA & 0xff);
+		pkt[3] = (0x10 | chan->cc_data);
+		chan->cc_data = ((chan->cc_data + 1) & 0x0f);
+	}
+
+	return (off + BENCH_TS_DGRAM_SIZE);
+}
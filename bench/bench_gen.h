@@ -0,0 +1,82 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+
+
+#ifndef __MSD_BENCH_GEN_H__
+#define __MSD_BENCH_GEN_H__
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <inttypes.h>
+
+
+/*
+ * Paced MPEG2-TS generator: one datagram of 7 TS packets (RTP optional)
+ * per channel slot, groups GROUP, GROUP + 1... same port.
+ * Data PID carry continuity counter, time PID carry send time
+ * (CLOCK_MONOTONIC, ns) for client lag measure on same host.
+ */
+
+typedef struct bench_gen_s *bench_gen_p;
+
+#define BENCH_TS_SIZE		188
+#define BENCH_TS_DGRAM_SIZE	(7 * BENCH_TS_SIZE)
+#define BENCH_TS_PID_DATA	0x0100
+#define BENCH_TS_PID_TIME	0x1ffe
+#define BENCH_TS_TIME_MAGIC	0x6d73646c6974655full /* "msdlite_". */
+
+typedef struct bench_gen_params_s {
+	struct sockaddr_storage	group;	/* First group:port. */
+	struct sockaddr_storage	if_addr; /* Out interface address, AF_UNSPEC = loopback. */
+	size_t		channels;
+	uint32_t	rate;		/* kbit/s per channel. */
+	uint32_t	time_interval;	/* ms, time PID packet. */
+	int		rtp;
+	int		ttl;
+} bench_gen_params_t, *bench_gen_params_p;
+
+#define BENCH_GEN_DEF_RATE		8000
+#define BENCH_GEN_DEF_TIME_INTERVAL	10
+
+typedef struct bench_gen_stat_s {
+	uint64_t	dgram_count;
+	uint64_t	sended_size;
+	uint64_t	send_errors;
+	uint64_t	late_count;	/* Ticks behind schedule: generator overloaded. */
+} bench_gen_stat_t, *bench_gen_stat_p;
+
+
+void	bench_gen_def(bench_gen_params_p params);
+int	bench_gen_create(bench_gen_params_p params, bench_gen_p *gen_ret);
+void	bench_gen_destroy(bench_gen_p gen);
+void	bench_gen_stat_get(bench_gen_p gen, bench_gen_stat_p stat);
+
+
+#endif /* __MSD_BENCH_GEN_H__ */
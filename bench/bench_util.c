@@ -0,0 +1,170 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+
+
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <stdlib.h> /* malloc, exit */
+#include <string.h> /* bcopy, bzero, memcpy, memmove, memset, strerror... */
+#include <inttypes.h>
+#include <errno.h>
+
+#include "bench_util.h"
+
+
+socklen_t
+bench_sa_size(const struct sockaddr_storage *addr) {
+
+	switch (addr->ss_family) {
+	case AF_INET:
+		return (sizeof(struct sockaddr_in));
+	case AF_INET6:
+		return (sizeof(struct sockaddr_in6));
+	}
+	return (sizeof(struct sockaddr_storage));
+}
+
+int
+bench_sa_from_str(const char *buf, struct sockaddr_storage *addr) {
+	char straddr[64];
+	const char *port, *end;
+	size_t addr_size;
+	unsigned long port_val;
+	char *ptm;
+	struct sockaddr_in *addr4 = (struct sockaddr_in*)(void*)addr;
+	struct sockaddr_in6 *addr6 = (struct sockaddr_in6*)(void*)addr;
+
+	if (NULL == buf || NULL == addr)
+		return (EINVAL);
+	memset(addr, 0x00, sizeof(struct sockaddr_storage));
+	if ('[' == buf[0]) {
+		end = strchr(buf, ']');
+		if (NULL == end)
+			return (EINVAL);
+		buf ++;
+		port = ((':' == end[1]) ? (end + 2) : NULL);
+	} else {
+		end = strrchr(buf, ':');
+		port = ((NULL != end) ? (end + 1) : NULL);
+		if (NULL == end) {
+			end = (buf + strlen(buf));
+		}
+	}
+	addr_size = (size_t)(end - buf);
+	if (0 == addr_size || sizeof(straddr) <= addr_size || NULL == port)
+		return (EINVAL);
+	memcpy(straddr, buf, addr_size);
+	straddr[addr_size] = 0;
+	port_val = strtoul(port, &ptm, 10);
+	if (0 == port_val || 65535 < port_val || 0 != (*ptm))
+		return (EINVAL);
+	if (1 == inet_pton(AF_INET, straddr, &addr4->sin_addr)) {
+		addr4->sin_family = AF_INET;
+		addr4->sin_port = htons((uint16_t)port_val);
+		return (0);
+	}
+	if (1 == inet_pton(AF_INET6, straddr, &addr6->sin6_addr)) {
+		addr6->sin6_family = AF_INET6;
+		addr6->sin6_port = htons((uint16_t)port_val);
+		return (0);
+	}
+	return (EINVAL);
+}
+
+void
+bench_sa_add(const struct sockaddr_storage *base, uint32_t num,
+    struct sockaddr_storage *addr) {
+	struct sockaddr_in *addr4 = (struct sockaddr_in*)(void*)addr;
+	struct sockaddr_in6 *addr6 = (struct sockaddr_in6*)(void*)addr;
+	uint32_t val;
+
+	memcpy(addr, base, sizeof(struct sockaddr_storage));
+	switch (addr->ss_family) {
+	case AF_INET:
+		addr4->sin_addr.s_addr = htonl((ntohl(addr4->sin_addr.s_addr) + num));
+		break;
+	case AF_INET6: /* Low 32 bits. */
+		memcpy(&val, &addr6->sin6_addr.s6_addr[12], sizeof(val));
+		val = htonl((ntohl(val) + num));
+		memcpy(&addr6->sin6_addr.s6_addr[12], &val, sizeof(val));
+		break;
+	}
+}
+
+int
+bench_list_parse(const char *buf, uint32_t *vals, size_t vals_max,
+    size_t *count_ret) {
+	size_t count = 0;
+	unsigned long val;
+	char *ptm;
+
+	if (NULL == buf || NULL == vals || NULL == count_ret)
+		return (EINVAL);
+	for (;;) {
+		val = strtoul(buf, &ptm, 10);
+		if (ptm == buf || UINT32_MAX < val || vals_max == count)
+			return (EINVAL);
+		vals[count ++] = (uint32_t)val;
+		if (0 == (*ptm))
+			break;
+		if (',' != (*ptm))
+			return (EINVAL);
+		buf = (ptm + 1);
+	}
+	(*count_ret) = count;
+
+	return (0);
+}
+
+static int
+bench_u64_cmp(const void *a, const void *b) {
+	uint64_t v1 = (*(const uint64_t*)a), v2 = (*(const uint64_t*)b);
+
+	return ((v1 > v2) - (v1 < v2));
+}
+
+uint64_t
+bench_percentile(uint64_t *vals, size_t count, uint32_t pct) {
+	size_t idx;
+
+	if (NULL == vals || 0 == count)
+		return (0);
+	qsort(vals, count, sizeof(uint64_t), bench_u64_cmp);
+	idx = (((count * pct) + 99) / 100);
+	if (0 != idx) {
+		idx --;
+	}
+	return (vals[MIN(idx, (count - 1))]);
+}
@@ -0,0 +1,81 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+
+
+#ifndef __MSD_BENCH_UTIL_H__
+#define __MSD_BENCH_UTIL_H__
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <inttypes.h>
+#include <time.h>
+
+
+static inline uint64_t
+bench_time_ns(void) {
+	struct timespec tp;
+
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return (((uint64_t)tp.tv_sec * 1000000000ull) + (uint64_t)tp.tv_nsec);
+}
+
+static inline void
+bench_u64_put(uint8_t *buf, uint64_t val) {
+
+	for (size_t i = 0; i < 8; i ++) {
+		buf[i] = (uint8_t)(val >> (56 - (i * 8)));
+	}
+}
+
+static inline uint64_t
+bench_u64_get(const uint8_t *buf) {
+	uint64_t val = 0;
+
+	for (size_t i = 0; i < 8; i ++) {
+		val = ((val << 8) | buf[i]);
+	}
+	return (val);
+}
+
+
+socklen_t bench_sa_size(const struct sockaddr_storage *addr);
+/* ADDR:PORT, [ADDR6]:PORT. */
+int	bench_sa_from_str(const char *buf, struct sockaddr_storage *addr);
+/* Address + num, same port: GROUP, GROUP + 1... */
+void	bench_sa_add(const struct sockaddr_storage *base, uint32_t num,
+	    struct sockaddr_storage *addr);
+/* "1,10,100" -> values. */
+int	bench_list_parse(const char *buf, uint32_t *vals, size_t vals_max,
+	    size_t *count_ret);
+/* Sort vals and return pct percentile, 0 if empty. */
+uint64_t bench_percentile(uint64_t *vals, size_t count, uint32_t pct);
+
+
+#endif /* __MSD_BENCH_UTIL_H__ */
@@ -0,0 +1,742 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+
+
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#ifdef __linux__
+#	include <sys/syscall.h>
+#	include <linux/perf_event.h>
+#endif
+
+#include <stdlib.h> /* malloc, exit */
+#include <stdio.h> /* snprintf, fprintf */
+#include <unistd.h> /* close, write, sysconf */
+#include <fcntl.h> /* For O_* constants */
+#include <signal.h>
+#include <inttypes.h>
+#include <string.h> /* bcopy, bzero, memcpy, memmove, memset, strerror... */
+#include <time.h>
+#include <errno.h>
+
+#include "bench_gen.h"
+#include "bench_cli.h"
+#include "bench_util.h"
+
+
+/*
+ * msd_bench: end to end fan-out benchmark.
+ *  gen - paced multicast/RTP generator on loopback.
+ *  cli - many HTTP clients against running msd_lite.
+ *  run - start msd_lite for each point of channels x clients x threads x
+ *        sndBlockSize x ringBufSize matrix, feed it with gen, load it
+ *        with cli and print one JSON line per point.
+ */
+
+#define BENCH_LIST_MAX		32
+#define BENCH_DEF_GROUP		"239.255.0.1:1234"
+#define BENCH_DEF_HTTP_PORT	17088
+#define BENCH_DEF_DURATION	20
+#define BENCH_DEF_WARMUP	5
+#define BENCH_DEF_CLI_THREADS	2
+#define BENCH_START_TIMEOUT	10	/* s, msd_lite HTTP ready. */
+#define BENCH_STOP_TIMEOUT	5	/* s, SIGTERM -> SIGKILL. */
+
+typedef struct bench_run_params_s {
+	const char	*msd_bin;
+	const char	*if_name;
+	const char	*label;		/* Build name for compare. */
+	bench_gen_params_t gen;
+	bench_cli_params_t cli;
+	uint16_t	http_port;
+	uint32_t	duration;	/* s, measure interval. */
+	uint32_t	warmup;		/* s, before measure. */
+	uint32_t	channels[BENCH_LIST_MAX];
+	size_t		channels_count;
+	uint32_t	clients[BENCH_LIST_MAX];
+	size_t		clients_count;
+	uint32_t	threads[BENCH_LIST_MAX];
+	size_t		threads_count;
+	uint32_t	snd_block[BENCH_LIST_MAX]; /* kb, sndLoWatermark. */
+	size_t		snd_block_count;
+	uint32_t	ring_buf[BENCH_LIST_MAX]; /* kb. */
+	size_t		ring_buf_count;
+} bench_run_params_t, *bench_run_params_p;
+
+/* msd_lite process counters. */
+typedef struct bench_proc_stat_s {
+	uint64_t	cpu_ns;		/* user + system. */
+	uint64_t	syscalls;
+	const char	*syscalls_src;	/* "perf", "proc_io" or "none". */
+} bench_proc_stat_t, *bench_proc_stat_p;
+
+typedef struct bench_proc_s {
+	pid_t		pid;
+	int		perf_fd;	/* raw_syscalls:sys_enter counter, -1 = none. */
+	char		dir[64];	/* Config and log. */
+} bench_proc_t, *bench_proc_p;
+
+
+static volatile sig_atomic_t g_stop = 0;
+
+
+static void
+bench_sig_handler(int sig __attribute__((unused))) {
+
+	g_stop = 1;
+}
+
+/* Sleep, return non zero if interrupted by signal. */
+static int
+bench_sleep(uint32_t sec) {
+	struct timespec tp;
+
+	for (uint64_t i = 0; i < ((uint64_t)sec * 10); i ++) {
+		if (0 != g_stop)
+			return (1);
+		tp.tv_sec = 0;
+		tp.tv_nsec = 100000000;
+		nanosleep(&tp, NULL);
+	}
+	return (g_stop);
+}
+
+static void
+usage(void) {
+
+	fprintf(stderr,
+	    "usage: msd_bench gen [-g GROUP:PORT] [-c channels] [-R kbit/s] [-P]\n"
+	    "       msd_bench cli [-s ADDR:PORT] [-g GROUP:PORT] [-c channels] [-n clients]\n"
+	    "                     [-T threads] [-D duration] [-W warmup] [-a connect/s]\n"
+	    "       msd_bench run -m msd_lite [-l label] [-g GROUP:PORT] [-i ifname]\n"
+	    "                     [-p http_port] [-R kbit/s] [-P] [-T cli_threads]\n"
+	    "                     [-D duration] [-W warmup] [-a connect/s]\n"
+	    "                     [-C channels,...] [-N clients,...] [-t threads,...]\n"
+	    "                     [-b sndBlockSize_kb,...] [-r ringBufSize_kb,...]\n"
+	    " Defaults: group %s, http port %i, rate %i kbit/s, duration %i s, warmup %i s.\n"
+	    " Loopback multicast on Linux: ip link set lo multicast on;\n"
+	    "  ip route add 239.255.0.0/16 dev lo\n",
+	    BENCH_DEF_GROUP, BENCH_DEF_HTTP_PORT, BENCH_GEN_DEF_RATE,
+	    BENCH_DEF_DURATION, BENCH_DEF_WARMUP);
+	exit(1);
+}
+
+
+static int
+bench_proc_stat_get(bench_proc_p proc, bench_proc_stat_p stat) {
+	char path[64], buf[1024], *ptm;
+	FILE *fp;
+	size_t i;
+	unsigned long long utime, stime, val;
+
+	memset(stat, 0x00, sizeof(bench_proc_stat_t));
+	stat->syscalls_src = "none";
+	/* CPU: /proc/PID/stat fields 14 and 15, after comm. */
+	snprintf(path, sizeof(path), "/proc/%i/stat", (int)proc->pid);
+	fp = fopen(path, "r");
+	if (NULL == fp)
+		return (errno);
+	ptm = fgets(buf, sizeof(buf), fp);
+	fclose(fp);
+	if (NULL == ptm)
+		return (EIO);
+	ptm = strrchr(buf, ')');
+	if (NULL == ptm)
+		return (EIO);
+	for (i = 0; i < 12 && NULL != ptm; i ++) { /* To field 14. */
+		ptm = strchr((ptm + 1), ' ');
+	}
+	if (NULL == ptm ||
+	    2 != sscanf(ptm, " %llu %llu", &utime, &stime))
+		return (EIO);
+	stat->cpu_ns = ((utime + stime) * 1000000000ull /
+	    (uint64_t)sysconf(_SC_CLK_TCK));
+#ifdef __linux__
+	if (-1 != proc->perf_fd &&
+	    sizeof(val) == read(proc->perf_fd, &val, sizeof(val))) {
+		stat->syscalls = val;
+		stat->syscalls_src = "perf";
+		return (0);
+	}
+#endif
+	/* Fallback: read/write class calls only, no send/recv. */
+	snprintf(path, sizeof(path), "/proc/%i/io", (int)proc->pid);
+	fp = fopen(path, "r");
+	if (NULL == fp)
+		return (0);
+	while (NULL != fgets(buf, sizeof(buf), fp)) {
+		if (1 == sscanf(buf, "syscr: %llu", &val) ||
+		    1 == sscanf(buf, "syscw: %llu", &val)) {
+			stat->syscalls += val;
+			stat->syscalls_src = "proc_io";
+		}
+	}
+	fclose(fp);
+
+	return (0);
+}
+
+#ifdef __linux__
+/* Count all syscalls of process and its threads, need perf access. */
+static int
+bench_proc_perf_open(pid_t pid) {
+	struct perf_event_attr attr;
+	const char *id_files[] = {
+		"/sys/kernel/tracing/events/raw_syscalls/sys_enter/id",
+		"/sys/kernel/debug/tracing/events/raw_syscalls/sys_enter/id",
+		NULL
+	};
+	unsigned long long id = 0;
+	FILE *fp;
+
+	for (size_t i = 0; NULL != id_files[i] && 0 == id; i ++) {
+		fp = fopen(id_files[i], "r");
+		if (NULL == fp)
+			continue;
+		if (1 != fscanf(fp, "%llu", &id)) {
+			id = 0;
+		}
+		fclose(fp);
+	}
+	if (0 == id)
+		return (-1);
+	memset(&attr, 0x00, sizeof(attr));
+	attr.type = PERF_TYPE_TRACEPOINT;
+	attr.size = sizeof(attr);
+	attr.config = id;
+	attr.inherit = 1; /* Threads created later. */
+	attr.disabled = 0;
+	return ((int)syscall(SYS_perf_event_open, &attr, pid, -1, -1,
+	    PERF_FLAG_FD_CLOEXEC));
+}
+#endif
+
+static int
+bench_proc_start(bench_run_params_p rp, uint32_t threads, uint32_t snd_block,
+    uint32_t ring_buf, bench_proc_p proc) {
+	char cfg[128], log[128];
+	int pipe_fd[2], fd, error;
+	FILE *fp;
+	uint8_t ok = 0;
+	pid_t pid;
+
+	memset(proc, 0x00, sizeof(bench_proc_t));
+	proc->perf_fd = -1;
+	snprintf(proc->dir, sizeof(proc->dir), "/tmp/msd_bench.XXXXXX");
+	if (NULL == mkdtemp(proc->dir))
+		return (errno);
+	snprintf(cfg, sizeof(cfg), "%s/msd_lite.conf", proc->dir);
+	snprintf(log, sizeof(log), "%s/msd_lite.log", proc->dir);
+	fp = fopen(cfg, "w");
+	if (NULL == fp)
+		return (errno);
+	fprintf(fp,
+	    "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+	    "<msd>\n"
+	    "	<log><level>4</level></log>\n"
+	    "	<threadPool>\n"
+	    "		<threadsCountMax>%"PRIu32"</threadsCountMax>\n"
+	    "		<fBindToCPU>no</fBindToCPU>\n"
+	    "	</threadPool>\n"
+	    "	<HTTP>\n"
+	    "		<bindList><bind><address>127.0.0.1:%u</address></bind></bindList>\n"
+	    "		<hostnameList><hostname>*</hostname></hostnameList>\n"
+	    "	</HTTP>\n"
+	    "	<hubProfileList>\n"
+	    "		<hubProfile>\n"
+	    "			<name>bench</name>\n"
+	    "			<fDropSlowClients>no</fDropSlowClients>\n"
+	    "			<ringBufSize>%"PRIu32"</ringBufSize>\n"
+	    "			<skt>\n"
+	    "				<sndBuf>%"PRIu32"</sndBuf>\n"
+	    "				<sndLoWatermark>%"PRIu32"</sndLoWatermark>\n"
+	    "			</skt>\n"
+	    "			<headersList><header>Content-Type: video/mpeg</header></headersList>\n"
+	    "		</hubProfile>\n"
+	    "	</hubProfileList>\n"
+	    "	<sourceProfileList>\n"
+	    "		<sourceProfile>\n"
+	    "			<name>bench</name>\n"
+	    "			<skt><rcvBuf>4096</rcvBuf><rcvTimeout>5</rcvTimeout></skt>\n"
+	    "			<negCacheTTL>0</negCacheTTL>\n"
+	    "			<multicast><ifName>%s</ifName></multicast>\n"
+	    "		</sourceProfile>\n"
+	    "	</sourceProfileList>\n"
+	    "</msd>\n",
+	    threads, rp->http_port, ring_buf,
+	    MAX((snd_block * 4), 512), snd_block, rp->if_name);
+	fclose(fp);
+
+	if (0 != pipe(pipe_fd))
+		return (errno);
+	pid = fork();
+	if (-1 == pid) {
+		error = errno;
+		close(pipe_fd[0]);
+		close(pipe_fd[1]);
+		return (error);
+	}
+	if (0 == pid) { /* Child: wait for counters attach, then exec. */
+		close(pipe_fd[1]);
+		if (1 != read(pipe_fd[0], &ok, 1))
+			_exit(1);
+		close(pipe_fd[0]);
+		fd = open(log, (O_WRONLY | O_CREAT | O_TRUNC), 0644);
+		if (-1 != fd) {
+			dup2(fd, STDOUT_FILENO);
+			dup2(fd, STDERR_FILENO);
+			close(fd);
+		}
+		execl(rp->msd_bin, rp->msd_bin, "-c", cfg, (char*)NULL);
+		_exit(127);
+	}
+	close(pipe_fd[0]);
+	proc->pid = pid;
+#ifdef __linux__
+	proc->perf_fd = bench_proc_perf_open(pid);
+#endif
+	ok = 1;
+	if (1 != write(pipe_fd[1], &ok, 1)) {
+		error = errno;
+		close(pipe_fd[1]);
+		return (error);
+	}
+	close(pipe_fd[1]);
+
+	return (0);
+}
+
+/* Wait for HTTP port, fail if process exit. */
+static int
+bench_proc_wait_ready(bench_proc_p proc, struct sockaddr_storage *addr) {
+	int skt, status;
+	struct timespec tp;
+
+	for (size_t i = 0; i < (BENCH_START_TIMEOUT * 20); i ++) {
+		if (0 != g_stop)
+			return (EINTR);
+		if (proc->pid == waitpid(proc->pid, &status, WNOHANG)) {
+			proc->pid = 0;
+			return (ECHILD);
+		}
+		skt = socket(addr->ss_family, SOCK_STREAM, IPPROTO_TCP);
+		if (-1 == skt)
+			return (errno);
+		if (0 == connect(skt, (struct sockaddr*)addr,
+		    bench_sa_size(addr))) {
+			close(skt);
+			return (0);
+		}
+		close(skt);
+		tp.tv_sec = 0;
+		tp.tv_nsec = 50000000;
+		nanosleep(&tp, NULL);
+	}
+	return (ETIMEDOUT);
+}
+
+static void
+bench_proc_stop(bench_proc_p proc, int keep_log) {
+	char path[128];
+	int status;
+	struct timespec tp;
+
+	if (-1 != proc->perf_fd) {
+		close(proc->perf_fd);
+		proc->perf_fd = -1;
+	}
+	if (0 != proc->pid) {
+		kill(proc->pid, SIGTERM);
+		for (size_t i = 0; i < (BENCH_STOP_TIMEOUT * 20); i ++) {
+			if (proc->pid == waitpid(proc->pid, &status, WNOHANG)) {
+				proc->pid = 0;
+				break;
+			}
+			tp.tv_sec = 0;
+			tp.tv_nsec = 50000000;
+			nanosleep(&tp, NULL);
+		}
+		if (0 != proc->pid) {
+			kill(proc->pid, SIGKILL);
+			waitpid(proc->pid, &status, 0);
+			proc->pid = 0;
+		}
+	}
+	if (0 != keep_log) /* Failed point: config and log for check. */
+		return;
+	snprintf(path, sizeof(path), "%s/msd_lite.conf", proc->dir);
+	unlink(path);
+	snprintf(path, sizeof(path), "%s/msd_lite.log", proc->dir);
+	unlink(path);
+	rmdir(proc->dir);
+}
+
+
+/* One matrix point: JSON line to stdout. */
+static int
+bench_run_point(bench_run_params_p rp, uint32_t channels, uint32_t clients,
+    uint32_t threads, uint32_t snd_block, uint32_t ring_buf) {
+	int error;
+	bench_proc_t proc;
+	bench_proc_stat_t ps1, ps2;
+	bench_gen_p gen = NULL;
+	bench_gen_stat_t gs1, gs2;
+	bench_gen_params_t gen_params;
+	bench_cli_p cli = NULL;
+	bench_cli_stat_t cs1, cs2;
+	bench_cli_params_t cli_params;
+	uint64_t t1, t2, rcvd, cpu_ns;
+	double sec, gbps, mb;
+
+	error = bench_proc_start(rp, threads, snd_block, ring_buf, &proc);
+	if (0 != error) {
+		fprintf(stderr, "msd_lite start: %s\n", strerror(error));
+		return (error);
+	}
+	error = bench_proc_wait_ready(&proc, &rp->cli.server);
+	if (0 != error) {
+		fprintf(stderr, "msd_lite not ready: %s, log: %s/msd_lite.log\n",
+		    strerror(error), proc.dir);
+		bench_proc_stop(&proc, 1);
+		return (error);
+	}
+	memcpy(&gen_params, &rp->gen, sizeof(gen_params));
+	gen_params.channels = channels;
+	error = bench_gen_create(&gen_params, &gen);
+	if (0 != error) {
+		fprintf(stderr, "bench_gen_create(): %s\n", strerror(error));
+		goto err_out;
+	}
+	memcpy(&cli_params, &rp->cli, sizeof(cli_params));
+	cli_params.channels = channels;
+	cli_params.clients = clients;
+	error = bench_cli_create(&cli_params, &cli);
+	if (0 != error) {
+		fprintf(stderr, "bench_cli_create(): %s\n", strerror(error));
+		goto err_out;
+	}
+	if (0 != bench_sleep(rp->warmup)) {
+		error = EINTR;
+		goto err_out;
+	}
+	/* Measure interval. */
+	bench_cli_lag_reset(cli);
+	bench_cli_stat_get(cli, &cs1);
+	bench_gen_stat_get(gen, &gs1);
+	bench_proc_stat_get(&proc, &ps1);
+	t1 = bench_time_ns();
+	if (0 != bench_sleep(rp->duration)) {
+		error = EINTR;
+		goto err_out;
+	}
+	bench_proc_stat_get(&proc, &ps2);
+	bench_gen_stat_get(gen, &gs2);
+	t2 = bench_time_ns();
+	bench_cli_stop(cli);
+	bench_cli_stat_get(cli, &cs2);
+
+	sec = ((double)(t2 - t1) / 1000000000.0);
+	rcvd = (cs2.rcvd_size - cs1.rcvd_size);
+	gbps = (((double)rcvd * 8.0) / sec / 1000000000.0);
+	mb = ((double)rcvd / (1024.0 * 1024.0));
+	cpu_ns = (ps2.cpu_ns - ps1.cpu_ns);
+	printf("{\"label\":\"%s\",\"channels\":%"PRIu32",\"clients\":%"PRIu32
+	    ",\"threads\":%"PRIu32",\"snd_block_kb\":%"PRIu32
+	    ",\"ring_buf_kb\":%"PRIu32",\"rate_kbps\":%"PRIu32
+	    ",\"rtp\":%i,\"duration_s\":%.3f"
+	    ",\"gbps\":%.4f,\"gbps_expected\":%.4f"
+	    ",\"cpu_cores\":%.4f,\"cpu_per_gbps\":%.4f"
+	    ",\"syscalls_per_mb\":%.2f,\"syscalls_src\":\"%s\""
+	    ",\"cli_recv_per_mb\":%.2f"
+	    ",\"join_p50_ms\":%.3f,\"join_p99_ms\":%.3f,\"join_max_ms\":%.3f"
+	    ",\"lag_p50_ms\":%.3f,\"lag_p99_ms\":%.3f,\"lag_max_ms\":%.3f"
+	    ",\"clients_connected\":%"PRIu64",\"conn_fail\":%"PRIu64
+	    ",\"dropped\":%"PRIu64",\"cc_errors\":%"PRIu64
+	    ",\"sync_errors\":%"PRIu64",\"gen_send_errors\":%"PRIu64
+	    ",\"gen_late\":%"PRIu64"}\n",
+	    ((NULL != rp->label) ? rp->label : ""),
+	    channels, clients, threads, snd_block, ring_buf,
+	    rp->gen.rate, rp->gen.rtp, sec,
+	    gbps, (((double)clients * rp->gen.rate) / 1000000.0),
+	    ((double)cpu_ns / (sec * 1000000000.0)),
+	    ((0.0 < gbps) ? ((double)cpu_ns / (sec * 1000000000.0) / gbps) : 0.0),
+	    ((0.0 < mb && 0 != strcmp(ps2.syscalls_src, "none")) ?
+	    ((double)(ps2.syscalls - ps1.syscalls) / mb) : -1.0),
+	    ps2.syscalls_src,
+	    ((0.0 < mb) ? ((double)(cs2.recv_calls - cs1.recv_calls) / mb) : 0.0),
+	    ((double)cs2.join_p50 / 1000000.0),
+	    ((double)cs2.join_p99 / 1000000.0),
+	    ((double)cs2.join_max / 1000000.0),
+	    ((double)cs2.lag_p50 / 1000000.0),
+	    ((double)cs2.lag_p99 / 1000000.0),
+	    ((double)cs2.lag_max / 1000000.0),
+	    cs2.connected, cs2.conn_fail, cs2.dropped,
+	    (cs2.cc_errors - cs1.cc_errors),
+	    (cs2.sync_errors - cs1.sync_errors),
+	    (gs2.send_errors - gs1.send_errors),
+	    (gs2.late_count - gs1.late_count));
+	fflush(stdout);
+
+err_out:
+	bench_cli_destroy(cli);
+	bench_gen_destroy(gen);
+	bench_proc_stop(&proc, (0 != error && EINTR != error));
+
+	return (error);
+}
+
+static int
+bench_run(bench_run_params_p rp) {
+	size_t a, b, c, d, e;
+	int error;
+
+	for (a = 0; a < rp->channels_count; a ++)
+	for (b = 0; b < rp->clients_count; b ++)
+	for (c = 0; c < rp->threads_count; c ++)
+	for (d = 0; d < rp->snd_block_count; d ++)
+	for (e = 0; e < rp->ring_buf_count; e ++) {
+		if (0 == rp->snd_block[d] ||
+		    0 != (rp->ring_buf[e] % rp->snd_block[d])) {
+			fprintf(stderr, "Skip: ringBufSize %"PRIu32" not multiple of sndBlockSize %"PRIu32".\n",
+			    rp->ring_buf[e], rp->snd_block[d]);
+			continue;
+		}
+		error = bench_run_point(rp, rp->channels[a], rp->clients[b],
+		    rp->threads[c], rp->snd_block[d], rp->ring_buf[e]);
+		if (EINTR == error)
+			return (error);
+	}
+	return (0);
+}
+
+/* Standalone generator: until signal. */
+static int
+bench_gen_main(bench_gen_params_p params) {
+	int error;
+	bench_gen_p gen;
+	bench_gen_stat_t gs;
+
+	error = bench_gen_create(params, &gen);
+	if (0 != error) {
+		fprintf(stderr, "bench_gen_create(): %s\n", strerror(error));
+		return (error);
+	}
+	while (0 == bench_sleep(1)) {
+	}
+	bench_gen_stat_get(gen, &gs);
+	bench_gen_destroy(gen);
+	printf("{\"dgrams\":%"PRIu64",\"sended\":%"PRIu64
+	    ",\"send_errors\":%"PRIu64",\"late\":%"PRIu64"}\n",
+	    gs.dgram_count, gs.sended_size, gs.send_errors, gs.late_count);
+
+	return (0);
+}
+
+/* Standalone clients: against running msd_lite. */
+static int
+bench_cli_main(bench_cli_params_p params, uint32_t warmup, uint32_t duration) {
+	int error;
+	bench_cli_p cli;
+	bench_cli_stat_t cs1, cs2;
+	uint64_t t1, t2;
+	double sec;
+
+	error = bench_cli_create(params, &cli);
+	if (0 != error) {
+		fprintf(stderr, "bench_cli_create(): %s\n", strerror(error));
+		return (error);
+	}
+	bench_sleep(warmup);
+	bench_cli_lag_reset(cli);
+	bench_cli_stat_get(cli, &cs1);
+	t1 = bench_time_ns();
+	bench_sleep(duration);
+	t2 = bench_time_ns();
+	bench_cli_stop(cli);
+	bench_cli_stat_get(cli, &cs2);
+	bench_cli_destroy(cli);
+	sec = ((double)(t2 - t1) / 1000000000.0);
+	printf("{\"clients\":%zu,\"duration_s\":%.3f,\"gbps\":%.4f"
+	    ",\"join_p50_ms\":%.3f,\"join_p99_ms\":%.3f"
+	    ",\"lag_p50_ms\":%.3f,\"lag_p99_ms\":%.3f"
+	    ",\"clients_connected\":%"PRIu64",\"conn_fail\":%"PRIu64
+	    ",\"dropped\":%"PRIu64",\"cc_errors\":%"PRIu64
+	    ",\"sync_errors\":%"PRIu64"}\n",
+	    params->clients, sec,
+	    (((double)(cs2.rcvd_size - cs1.rcvd_size) * 8.0) / sec / 1000000000.0),
+	    ((double)cs2.join_p50 / 1000000.0),
+	    ((double)cs2.join_p99 / 1000000.0),
+	    ((double)cs2.lag_p50 / 1000000.0),
+	    ((double)cs2.lag_p99 / 1000000.0),
+	    cs2.connected, cs2.conn_fail, cs2.dropped,
+	    (cs2.cc_errors - cs1.cc_errors),
+	    (cs2.sync_errors - cs1.sync_errors));
+
+	return (0);
+}
+
+
+int
+main(int argc, char *argv[]) {
+	int ch;
+	char straddr[32];
+	const char *mode;
+	bench_run_params_t rp;
+	struct sigaction sa;
+
+	if (2 > argc)
+		usage();
+	mode = argv[1];
+	argc --;
+	argv ++;
+
+	memset(&rp, 0x00, sizeof(rp));
+	bench_gen_def(&rp.gen);
+	bench_cli_def(&rp.cli);
+	rp.if_name = "lo";
+	rp.http_port = BENCH_DEF_HTTP_PORT;
+	rp.duration = BENCH_DEF_DURATION;
+	rp.warmup = BENCH_DEF_WARMUP;
+	rp.cli.threads = BENCH_DEF_CLI_THREADS;
+	bench_sa_from_str(BENCH_DEF_GROUP, &rp.gen.group);
+	bench_sa_from_str("127.0.0.1:7088", &rp.cli.server);
+	rp.channels[0] = 1;
+	rp.channels_count = 1;
+	rp.clients[0] = 100;
+	rp.clients_count = 1;
+	rp.threads[0] = 1;
+	rp.threads_count = 1;
+	rp.snd_block[0] = 64;
+	rp.snd_block_count = 1;
+	rp.ring_buf[0] = 1024;
+	rp.ring_buf_count = 1;
+
+	while (-1 != (ch = getopt(argc, argv, "a:b:c:C:D:g:i:l:m:n:N:p:Pr:R:s:t:T:W:"))) {
+		switch (ch) {
+		case 'a':
+			rp.cli.connect_rate = (uint32_t)strtoul(optarg, NULL, 10);
+			break;
+		case 'b':
+			if (0 != bench_list_parse(optarg, rp.snd_block,
+			    BENCH_LIST_MAX, &rp.snd_block_count))
+				usage();
+			break;
+		case 'c':
+			rp.gen.channels = strtoul(optarg, NULL, 10);
+			rp.channels[0] = (uint32_t)rp.gen.channels;
+			break;
+		case 'C':
+			if (0 != bench_list_parse(optarg, rp.channels,
+			    BENCH_LIST_MAX, &rp.channels_count))
+				usage();
+			break;
+		case 'D':
+			rp.duration = (uint32_t)strtoul(optarg, NULL, 10);
+			break;
+		case 'g':
+			if (0 != bench_sa_from_str(optarg, &rp.gen.group))
+				usage();
+			break;
+		case 'i':
+			rp.if_name = optarg;
+			break;
+		case 'l':
+			rp.label = optarg;
+			break;
+		case 'm':
+			rp.msd_bin = optarg;
+			break;
+		case 'n':
+			rp.clients[0] = (uint32_t)strtoul(optarg, NULL, 10);
+			break;
+		case 'N':
+			if (0 != bench_list_parse(optarg, rp.clients,
+			    BENCH_LIST_MAX, &rp.clients_count))
+				usage();
+			break;
+		case 'p':
+			rp.http_port = (uint16_t)strtoul(optarg, NULL, 10);
+			break;
+		case 'P':
+			rp.gen.rtp = 1;
+			break;
+		case 'r':
+			if (0 != bench_list_parse(optarg, rp.ring_buf,
+			    BENCH_LIST_MAX, &rp.ring_buf_count))
+				usage();
+			break;
+		case 'R':
+			rp.gen.rate = (uint32_t)strtoul(optarg, NULL, 10);
+			break;
+		case 's':
+			if (0 != bench_sa_from_str(optarg, &rp.cli.server))
+				usage();
+			break;
+		case 't':
+			if (0 != bench_list_parse(optarg, rp.threads,
+			    BENCH_LIST_MAX, &rp.threads_count))
+				usage();
+			break;
+		case 'T':
+			rp.cli.threads = strtoul(optarg, NULL, 10);
+			break;
+		case 'W':
+			rp.warmup = (uint32_t)strtoul(optarg, NULL, 10);
+			break;
+		default:
+			usage();
+		}
+	}
+	memcpy(&rp.cli.group, &rp.gen.group, sizeof(rp.cli.group));
+
+	memset(&sa, 0x00, sizeof(sa));
+	sa.sa_handler = bench_sig_handler;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	if (0 == strcmp(mode, "gen"))
+		return (bench_gen_main(&rp.gen));
+	if (0 == strcmp(mode, "cli")) {
+		rp.cli.channels = rp.channels[0];
+		rp.cli.clients = rp.clients[0];
+		return (bench_cli_main(&rp.cli, rp.warmup, rp.duration));
+	}
+	if (0 != strcmp(mode, "run") || NULL == rp.msd_bin)
+		usage();
+	/* msd_lite bind 127.0.0.1:http_port. */
+	snprintf(straddr, sizeof(straddr), "127.0.0.1:%u", rp.http_port);
+	bench_sa_from_str(straddr, &rp.cli.server);
+	return (bench_run(&rp));
+}
@@ -0,0 +1,656 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+
+
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/ioctl.h>
+#ifdef __linux__
+#	include <sys/syscall.h>
+#	include <linux/perf_event.h>
+#endif
+
+#include <stdlib.h> /* malloc, exit */
+#include <stdio.h> /* snprintf, fprintf */
+#include <unistd.h> /* close, write, sysconf */
+#include <fcntl.h> /* For O_* constants */
+#include <inttypes.h>
+#include <string.h> /* bcopy, bzero, memcpy, memmove, memset, strerror... */
+#include <time.h>
+#include <errno.h>
+#if defined(__x86_64__) || defined(__i386__)
+#	include <x86intrin.h>
+#endif
+
+#include "utils/macro.h"
+#include "utils/ring_buffer.h"
+#include "proto/rtp.h"
+#include "proto/mpeg2ts.h"
+#include "stream_sys_pkt.h"
+#include "bench_util.h"
+
+
+/*
+ * msd_ubench: hub hot path microbenchmarks, one JSON line per case.
+ *  classify - str_src_pkt_payload(): TS header check, rtp_payload_get().
+ *  commit   - r_buf_wbuf_get(), copy in (recv() stand in), classify,
+ *             memmove() RTP strip, r_buf_wbuf_set2(); commit_base - same
+ *             without classify and strip.
+ *  flush    - per client r_buf_data_avail_size(), r_buf_data_get(),
+ *             r_buf_data_get_conv2off(), r_buf_rpos_inc(), writer not timed.
+ * Time: TSC / virtual counter ticks, ns from ticks rate; wall_ns_per_op
+ * by clock_gettime() include timer cost. Optional perf counters (user
+ * mode): cycles, instructions, branch and L1D misses.
+ */
+
+#define UB_LIST_MAX		32
+#define UB_PKT_POOL		64	/* Packets copies, power of 2. */
+#define UB_PKT_SIZE_STD		1500	/* As STR_SRC_UDP_PKT_SIZE_STD. */
+#define UB_DEF_ITERS		1000000
+#define UB_DEF_ROUNDS		5
+#define UB_FLUSH_OPS		1000000	/* Client flushes per round. */
+
+/* Perf counters. */
+#define UB_PERF_CYCLES		0
+#define UB_PERF_INSTR		1
+#define UB_PERF_BR_MISS		2
+#define UB_PERF_L1D_MISS	3
+#define UB_PERF_COUNT		4
+
+typedef struct ub_pkt_variant_s {
+	const char	*name;
+	size_t		ts_count;	/* TS packets in payload. */
+	int		rtp;
+	uint8_t		pt;
+	uint8_t		csrc_count;
+	size_t		ext_words;	/* Header extension, 0 = none. */
+	size_t		pad_size;	/* Padding, 0 = none. */
+} ub_pkt_variant_t, *ub_pkt_variant_p;
+
+static const ub_pkt_variant_t ub_pkt_variants[] = {
+	{ "ts188",		1, 0,  0, 0, 0, 0 },
+	{ "ts1316",		7, 0,  0, 0, 0, 0 },
+	{ "rtp188",		1, 1, 33, 0, 0, 0 },
+	{ "rtp1316",		7, 1, 33, 0, 0, 0 },
+	{ "rtp1316_csrc2_ext",	7, 1, 33, 2, 2, 0 },
+	{ "rtp1316_pad",	7, 1, 33, 0, 0, 4 },
+	{ "rtp1316_mpgv",	7, 1, 32, 0, 0, 0 }, /* 4 bytes MPEG video header. */
+	{ NULL,			0, 0,  0, 0, 0, 0 }
+};
+
+typedef struct ub_ctx_s {
+	const char	*label;
+	double		ticks_per_ns;
+	size_t		iters;
+	size_t		rounds;
+	/* Timer. */
+	uint64_t	ns;
+	uint64_t	ticks;
+	uint64_t	t_ns;
+	uint64_t	t_ticks;
+	/* Perf. */
+	int		perf_fd[UB_PERF_COUNT];	/* [0] = group leader. */
+	uint64_t	perf_val[UB_PERF_COUNT];
+	/* Current case. */
+	uint8_t		*pkt[UB_PKT_POOL];
+	size_t		pkt_size;
+	r_buf_p		r_buf;
+	uintptr_t	r_buf_fd;
+	r_buf_rpos_p	rpos;
+	size_t		clients;
+	size_t		block_size;
+	size_t		sink;		/* Keep results alive. */
+} ub_ctx_t, *ub_ctx_p;
+
+typedef size_t (*ub_case_fn)(ub_ctx_p ctx);
+
+
+static inline uint64_t
+ub_ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	_mm_lfence(); /* No early start. */
+	return (__rdtsc());
+#elif defined(__aarch64__)
+	uint64_t val;
+
+	__asm__ __volatile__("isb; mrs %0, cntvct_el0" : "=r" (val));
+	return (val);
+#else
+	return (bench_time_ns());
+#endif
+}
+
+static inline void
+ub_timer_start(ub_ctx_p ctx) {
+
+#ifdef __linux__
+	if (-1 != ctx->perf_fd[0]) {
+		ioctl(ctx->perf_fd[0], PERF_EVENT_IOC_ENABLE,
+		    PERF_IOC_FLAG_GROUP);
+	}
+#endif
+	ctx->t_ns = bench_time_ns();
+	ctx->t_ticks = ub_ticks();
+}
+
+static inline void
+ub_timer_stop(ub_ctx_p ctx) {
+	uint64_t ticks = ub_ticks(), ns = bench_time_ns();
+
+#ifdef __linux__
+	if (-1 != ctx->perf_fd[0]) {
+		ioctl(ctx->perf_fd[0], PERF_EVENT_IOC_DISABLE,
+		    PERF_IOC_FLAG_GROUP);
+	}
+#endif
+	ctx->ticks += (ticks - ctx->t_ticks);
+	ctx->ns += (ns - ctx->t_ns);
+}
+
+
+static void
+usage(void) {
+
+	fprintf(stderr,
+	    "usage: msd_ubench [-l label] [-t classify,commit,flush] [-n iters]\n"
+	    "                  [-R rounds] [-r ring_kb,...] [-c clients,...]\n"
+	    "                  [-b block_kb,...] [-p]\n"
+	    " -p  perf counters, Linux, need perf_event_paranoid <= 2.\n"
+	    " Defaults: -n %i -R %i -r 256,1024,16384 -c 1,10,100,1000,10000 -b 64\n",
+	    UB_DEF_ITERS, UB_DEF_ROUNDS);
+	exit(1);
+}
+
+
+#ifdef __linux__
+static int
+ub_perf_open(ub_ctx_p ctx) {
+	struct perf_event_attr attr;
+	static const struct {
+		uint32_t type;
+		uint64_t config;
+	} events[UB_PERF_COUNT] = {
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+		{ PERF_TYPE_HW_CACHE, (PERF_COUNT_HW_CACHE_L1D |
+		    (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+		    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)) },
+	};
+
+	for (size_t i = 0; i < UB_PERF_COUNT; i ++) {
+		memset(&attr, 0x00, sizeof(attr));
+		attr.type = events[i].type;
+		attr.size = sizeof(attr);
+		attr.config = events[i].config;
+		attr.disabled = ((0 == i) ? 1 : 0);
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP;
+		ctx->perf_fd[i] = (int)syscall(SYS_perf_event_open, &attr, 0,
+		    -1, ((0 == i) ? -1 : ctx->perf_fd[0]), PERF_FLAG_FD_CLOEXEC);
+		if (-1 == ctx->perf_fd[i])
+			return (errno);
+	}
+	return (0);
+}
+
+static void
+ub_perf_close(ub_ctx_p ctx) {
+
+	for (size_t i = UB_PERF_COUNT; 0 < i; i --) {
+		if (-1 == ctx->perf_fd[(i - 1)])
+			continue;
+		close(ctx->perf_fd[(i - 1)]);
+		ctx->perf_fd[(i - 1)] = -1;
+	}
+}
+
+static int
+ub_perf_read(ub_ctx_p ctx) {
+	uint64_t buf[(1 + UB_PERF_COUNT)];
+
+	if (-1 == ctx->perf_fd[0])
+		return (ENOENT);
+	if (sizeof(buf) != read(ctx->perf_fd[0], buf, sizeof(buf)))
+		return (EIO);
+	memcpy(ctx->perf_val, &buf[1], sizeof(ctx->perf_val));
+	return (0);
+}
+#endif
+
+/* TS packets with CC, optional RTP header. */
+static size_t
+ub_pkt_make(const ub_pkt_variant_t *var, uint8_t *buf) {
+	size_t i, off = 0;
+	uint8_t *pkt;
+
+	if (0 != var->rtp) {
+		buf[0] = (uint8_t)(0x80 | ((0 != var->pad_size) ? 0x20 : 0) |
+		    ((0 != var->ext_words) ? 0x10 : 0) | var->csrc_count);
+		buf[1] = var->pt;
+		memset((buf + 2), 0x5a, 10); /* seq, ts, ssrc. */
+		off = 12;
+		memset((buf + off), 0xa5, ((size_t)var->csrc_count * 4));
+		off += ((size_t)var->csrc_count * 4);
+		if (0 != var->ext_words) {
+			buf[off] = 0xbe;
+			buf[(off + 1)] = 0xde;
+			buf[(off + 2)] = (uint8_t)(var->ext_words >> 8);
+			buf[(off + 3)] = (uint8_t)var->ext_words;
+			memset((buf + off + 4), 0, (var->ext_words * 4));
+			off += (4 + (var->ext_words * 4));
+		}
+		if (32 == var->pt || 14 == var->pt) { /* MPEG header. */
+			memset((buf + off), 0, 4);
+			off += 4;
+		}
+	}
+	for (i = 0; i < var->ts_count; i ++) {
+		pkt = (buf + off);
+		memset(pkt, 0xff, MPEG2_TS_PKT_SIZE_188);
+		pkt[0] = 0x47;
+		pkt[1] = 0x01;
+		pkt[2] = 0x00;
+		pkt[3] = (uint8_t)(0x10 | (i & 0x0f));
+		off += MPEG2_TS_PKT_SIZE_188;
+	}
+	if (0 != var->pad_size) {
+		memset((buf + off), 0, var->pad_size);
+		off += var->pad_size;
+		buf[(off - 1)] = (uint8_t)var->pad_size;
+	}
+	return (off);
+}
+
+/* Ring buf same way as hub: file backed, for sendfile(). */
+static int
+ub_r_buf_alloc(ub_ctx_p ctx, size_t size) {
+	char filename[64];
+	int error;
+
+	snprintf(filename, sizeof(filename), "/tmp/msd_ubench-%zu.tmp",
+	    (size_t)getpid());
+	ctx->r_buf_fd = (uintptr_t)open(filename, (O_CREAT | O_EXCL | O_RDWR), 0600);
+	if ((uintptr_t)-1 == ctx->r_buf_fd)
+		return (errno);
+	unlink(filename);
+	if (0 != ftruncate((int)ctx->r_buf_fd, (off_t)size)) {
+		error = errno;
+		goto err_out;
+	}
+	ctx->r_buf = r_buf_alloc(ctx->r_buf_fd, size, MPEG2_TS_PKT_SIZE_188, 0);
+	if (NULL == ctx->r_buf) {
+		error = errno;
+		goto err_out;
+	}
+	return (0);
+
+err_out:
+	close((int)ctx->r_buf_fd);
+	ctx->r_buf_fd = (uintptr_t)-1;
+	return (error);
+}
+
+static void
+ub_r_buf_free(ub_ctx_p ctx) {
+
+	r_buf_free(ctx->r_buf);
+	ctx->r_buf = NULL;
+	close((int)ctx->r_buf_fd);
+	ctx->r_buf_fd = (uintptr_t)-1;
+}
+
+
+static size_t
+ub_case_classify(ub_ctx_p ctx) {
+	size_t i, off, sink = 0;
+
+	ub_timer_start(ctx);
+	for (i = 0; i < ctx->iters; i ++) {
+		off = 0;
+		sink += str_src_pkt_payload(ctx->pkt[(i & (UB_PKT_POOL - 1))],
+		    ctx->pkt_size, &off);
+		sink += off;
+	}
+	ub_timer_stop(ctx);
+	ctx->sink += sink;
+
+	return (ctx->iters);
+}
+
+static size_t
+ub_case_commit_base(ub_ctx_p ctx) {
+	size_t i, buf_size;
+	uint8_t *buf;
+
+	ub_timer_start(ctx);
+	for (i = 0; i < ctx->iters; i ++) {
+		buf_size = r_buf_wbuf_get(ctx->r_buf, UB_PKT_SIZE_STD, &buf);
+		buf_size = MIN(buf_size, ctx->pkt_size);
+		memcpy(buf, ctx->pkt[(i & (UB_PKT_POOL - 1))], buf_size);
+		r_buf_wbuf_set2(ctx->r_buf, buf, buf_size, NULL);
+	}
+	ub_timer_stop(ctx);
+
+	return (ctx->iters);
+}
+
+/* Same as str_src_pkt_commit() without HLS and time-shift. */
+static size_t
+ub_case_commit(ub_ctx_p ctx) {
+	size_t i, off, buf_size;
+	uint8_t *buf;
+
+	ub_timer_start(ctx);
+	for (i = 0; i < ctx->iters; i ++) {
+		buf_size = r_buf_wbuf_get(ctx->r_buf, UB_PKT_SIZE_STD, &buf);
+		buf_size = MIN(buf_size, ctx->pkt_size);
+		memcpy(buf, ctx->pkt[(i & (UB_PKT_POOL - 1))], buf_size);
+		off = 0;
+		buf_size = str_src_pkt_payload(buf, buf_size, &off);
+		if (0 == buf_size)
+			continue;
+		if (0 != off) {
+			memmove(buf, (buf + off), buf_size);
+		}
+		r_buf_wbuf_set2(ctx->r_buf, buf, buf_size, NULL);
+	}
+	ub_timer_stop(ctx);
+
+	return (ctx->iters);
+}
+
+/* Writer add block, then every client take all: as str_hub_send_to_client(). */
+static size_t
+ub_case_flush(ub_ctx_p ctx) {
+	size_t i, j, rounds, wr, buf_size, avail, drop_size, iov_cnt, tr_size;
+	size_t ops = 0;
+	uint8_t *buf;
+	struct iovec iov[4];
+
+	rounds = MAX(16, (UB_FLUSH_OPS / ctx->clients));
+	for (j = 0; j < rounds; j ++) {
+		for (wr = 0; wr < ctx->block_size; wr += buf_size) {
+			buf_size = r_buf_wbuf_get(ctx->r_buf, UB_PKT_SIZE_STD,
+			    &buf);
+			buf_size = MIN(buf_size,
+			    (7 * MPEG2_TS_PKT_SIZE_188));
+			memcpy(buf, ctx->pkt[0], buf_size);
+			r_buf_wbuf_set2(ctx->r_buf, buf, buf_size, NULL);
+		}
+		ub_timer_start(ctx);
+		for (i = 0; i < ctx->clients; i ++) {
+			avail = r_buf_data_avail_size(ctx->r_buf,
+			    &ctx->rpos[i], &drop_size);
+			if (0 == avail)
+				continue;
+			iov_cnt = r_buf_data_get(ctx->r_buf, &ctx->rpos[i],
+			    avail, (iovec_p)iov, 4, &drop_size, NULL);
+			if (0 == iov_cnt)
+				continue;
+			r_buf_data_get_conv2off(ctx->r_buf, (iovec_p)iov,
+			    iov_cnt);
+			for (tr_size = 0; 0 < iov_cnt; iov_cnt --) {
+				tr_size += iov[(iov_cnt - 1)].iov_len;
+			}
+			r_buf_rpos_inc(ctx->r_buf, &ctx->rpos[i], tr_size);
+		}
+		ub_timer_stop(ctx);
+		ops += ctx->clients;
+	}
+
+	return (ops);
+}
+
+
+/* Run case rounds times, print best round. */
+static void
+ub_case_run(ub_ctx_p ctx, ub_case_fn fn, const char *case_name,
+    const char *variant, size_t ring_kb, size_t clients, size_t block_kb) {
+	size_t i, ops = 0;
+	uint64_t ns_op[UB_LIST_MAX], best_ticks = UINT64_MAX, best_ns = 0;
+	uint64_t best_perf[UB_PERF_COUNT];
+	double med, perf_ops;
+	int perf_ok = 0;
+
+	fn(ctx); /* Warm up: caches, page faults. */
+	memset(best_perf, 0x00, sizeof(best_perf));
+	for (i = 0; i < ctx->rounds; i ++) {
+		ctx->ns = 0;
+		ctx->ticks = 0;
+#ifdef __linux__
+		if (-1 != ctx->perf_fd[0]) {
+			ioctl(ctx->perf_fd[0], PERF_EVENT_IOC_RESET,
+			    PERF_IOC_FLAG_GROUP);
+		}
+#endif
+		ops = fn(ctx);
+		/* ps / op, from ticks: clock_gettime() cost not included. */
+		ns_op[i] = (uint64_t)(((double)ctx->ticks * 1000.0) /
+		    ctx->ticks_per_ns / (double)MAX(1, ops));
+		if (ctx->ticks >= best_ticks)
+			continue;
+		best_ticks = ctx->ticks;
+		best_ns = ctx->ns;
+#ifdef __linux__
+		if (0 == ub_perf_read(ctx)) {
+			memcpy(best_perf, ctx->perf_val, sizeof(best_perf));
+			perf_ok = 1;
+		}
+#endif
+	}
+	med = ((double)bench_percentile(ns_op, ctx->rounds, 50) / 1000.0);
+	perf_ops = (double)MAX(1, ops);
+	printf("{\"label\":\"%s\",\"case\":\"%s\",\"variant\":\"%s\""
+	    ",\"pkt_size\":%zu,\"ring_kb\":%zu,\"clients\":%zu,\"block_kb\":%zu"
+	    ",\"ops\":%zu,\"ns_per_op\":%.3f,\"ns_per_op_med\":%.3f"
+	    ",\"ticks_per_op\":%.3f,\"wall_ns_per_op\":%.3f",
+	    ((NULL != ctx->label) ? ctx->label : ""), case_name,
+	    ((NULL != variant) ? variant : ""), ctx->pkt_size,
+	    ring_kb, clients, block_kb, ops,
+	    ((double)best_ticks / ctx->ticks_per_ns / perf_ops), med,
+	    ((double)best_ticks / perf_ops),
+	    ((double)best_ns / perf_ops));
+	if (0 != perf_ok) {
+		printf(",\"cycles_per_op\":%.3f,\"instr_per_op\":%.3f"
+		    ",\"ipc\":%.3f,\"branch_miss_per_op\":%.4f"
+		    ",\"l1d_miss_per_op\":%.4f",
+		    ((double)best_perf[UB_PERF_CYCLES] / perf_ops),
+		    ((double)best_perf[UB_PERF_INSTR] / perf_ops),
+		    ((0 != best_perf[UB_PERF_CYCLES]) ?
+		    ((double)best_perf[UB_PERF_INSTR] /
+		    (double)best_perf[UB_PERF_CYCLES]) : 0.0),
+		    ((double)best_perf[UB_PERF_BR_MISS] / perf_ops),
+		    ((double)best_perf[UB_PERF_L1D_MISS] / perf_ops));
+	}
+	printf("}\n");
+	fflush(stdout);
+}
+
+/* Ticks per ns: TSC / virtual counter rate. */
+static double
+ub_ticks_rate(void) {
+	uint64_t ns, ticks;
+	struct timespec tp = { 0, 100000000 };
+
+	ns = bench_time_ns();
+	ticks = ub_ticks();
+	nanosleep(&tp, NULL);
+	return ((double)(ub_ticks() - ticks) / (double)(bench_time_ns() - ns));
+}
+
+
+int
+main(int argc, char *argv[]) {
+	int ch, error;
+	ub_ctx_t ctx;
+	const char *cases = "classify,commit,flush";
+	uint32_t ring_kb[UB_LIST_MAX] = { 256, 1024, 16384 };
+	uint32_t clients[UB_LIST_MAX] = { 1, 10, 100, 1000, 10000 };
+	uint32_t block_kb[UB_LIST_MAX] = { 64 };
+	size_t ring_kb_count = 3, clients_count = 5, block_kb_count = 1;
+	size_t i, j, k, v;
+	int perf = 0;
+	uint8_t *pkt_mem;
+
+	memset(&ctx, 0x00, sizeof(ctx));
+	ctx.iters = UB_DEF_ITERS;
+	ctx.rounds = UB_DEF_ROUNDS;
+	ctx.r_buf_fd = (uintptr_t)-1;
+	for (i = 0; i < UB_PERF_COUNT; i ++) {
+		ctx.perf_fd[i] = -1;
+	}
+	while (-1 != (ch = getopt(argc, argv, "b:c:l:n:pr:R:t:"))) {
+		switch (ch) {
+		case 'b':
+			if (0 != bench_list_parse(optarg, block_kb,
+			    UB_LIST_MAX, &block_kb_count))
+				usage();
+			break;
+		case 'c':
+			if (0 != bench_list_parse(optarg, clients,
+			    UB_LIST_MAX, &clients_count))
+				usage();
+			break;
+		case 'l':
+			ctx.label = optarg;
+			break;
+		case 'n':
+			ctx.iters = MAX(1, strtoul(optarg, NULL, 10));
+			break;
+		case 'p':
+			perf = 1;
+			break;
+		case 'r':
+			if (0 != bench_list_parse(optarg, ring_kb,
+			    UB_LIST_MAX, &ring_kb_count))
+				usage();
+			break;
+		case 'R':
+			ctx.rounds = MIN(UB_LIST_MAX,
+			    MAX(1, strtoul(optarg, NULL, 10)));
+			break;
+		case 't':
+			cases = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (0 != perf) {
+#ifdef __linux__
+		error = ub_perf_open(&ctx);
+		if (0 != error) {
+			fprintf(stderr, "perf_event_open(): %s, counters off.\n",
+			    strerror(error));
+			ub_perf_close(&ctx);
+		}
+#else
+		fprintf(stderr, "perf counters: Linux only.\n");
+#endif
+	}
+	ctx.ticks_per_ns = ub_ticks_rate();
+	fprintf(stderr, "ticks per ns: %.4f\n", ctx.ticks_per_ns);
+	pkt_mem = malloc((UB_PKT_POOL * UB_PKT_SIZE_STD));
+	if (NULL == pkt_mem)
+		return (ENOMEM);
+	for (i = 0; i < UB_PKT_POOL; i ++) {
+		ctx.pkt[i] = (pkt_mem + (i * UB_PKT_SIZE_STD));
+	}
+
+	for (v = 0; NULL != ub_pkt_variants[v].name; v ++) {
+		for (i = 0; i < UB_PKT_POOL; i ++) {
+			ctx.pkt_size = ub_pkt_make(&ub_pkt_variants[v], ctx.pkt[i]);
+		}
+		if (NULL != strstr(cases, "classify")) {
+			ub_case_run(&ctx, ub_case_classify, "classify",
+			    ub_pkt_variants[v].name, 0, 0, 0);
+		}
+		if (NULL == strstr(cases, "commit"))
+			continue;
+		for (j = 0; j < ring_kb_count; j ++) {
+			error = ub_r_buf_alloc(&ctx, ((size_t)ring_kb[j] * 1024));
+			if (0 != error) {
+				fprintf(stderr, "r_buf_alloc(%"PRIu32" kb): %s\n",
+				    ring_kb[j], strerror(error));
+				continue;
+			}
+			if (0 == ub_pkt_variants[v].rtp) {
+				ub_case_run(&ctx, ub_case_commit_base,
+				    "commit_base", ub_pkt_variants[v].name,
+				    ring_kb[j], 0, 0);
+			}
+			ub_case_run(&ctx, ub_case_commit, "commit",
+			    ub_pkt_variants[v].name, ring_kb[j], 0, 0);
+			ub_r_buf_free(&ctx);
+		}
+	}
+
+	if (NULL != strstr(cases, "flush")) {
+		ctx.pkt_size = ub_pkt_make(&ub_pkt_variants[1], ctx.pkt[0]);
+		for (j = 0; j < ring_kb_count; j ++)
+		for (k = 0; k < block_kb_count; k ++)
+		for (i = 0; i < clients_count; i ++) {
+			ctx.block_size = ((size_t)block_kb[k] * 1024);
+			if (ctx.block_size >= ((size_t)ring_kb[j] * 1024))
+				continue; /* Writer overrun clients. */
+			error = ub_r_buf_alloc(&ctx, ((size_t)ring_kb[j] * 1024));
+			if (0 != error) {
+				fprintf(stderr, "r_buf_alloc(%"PRIu32" kb): %s\n",
+				    ring_kb[j], strerror(error));
+				continue;
+			}
+			ctx.clients = clients[i];
+			ctx.rpos = calloc(ctx.clients, sizeof(r_buf_rpos_t));
+			if (NULL == ctx.rpos) {
+				ub_r_buf_free(&ctx);
+				continue;
+			}
+			for (size_t c = 0; c < ctx.clients; c ++) {
+				r_buf_rpos_init(ctx.r_buf, &ctx.rpos[c], 0);
+			}
+			ub_case_run(&ctx, ub_case_flush, "flush", NULL,
+			    ring_kb[j], ctx.clients, block_kb[k]);
+			free(ctx.rpos);
+			ctx.rpos = NULL;
+			ub_r_buf_free(&ctx);
+		}
+	}
+#ifdef __linux__
+	ub_perf_close(&ctx);
+#endif
+	free(pkt_mem);
+	fprintf(stderr, "sink: %zu\n", ctx.sink);
+
+	return (0);
+}
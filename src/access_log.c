@@ -0,0 +1,448 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <stdlib.h> /* malloc, exit */
+#include <stdio.h> /* snprintf, fprintf, rename */
+#include <unistd.h> /* close, write, sysconf */
+#include <fcntl.h> /* For O_* constants */
+#include <inttypes.h>
+#include <string.h> /* bcopy, bzero, memcpy, memmove, memset, strerror... */
+#include <time.h>
+#include <errno.h>
+#include <syslog.h>
+
+#include "utils/macro.h"
+#include "wr_queue.h"
+#include "access_log.h"
+
+
+#define ACCESS_LOG_BUF_SIZE	(64 * 1024) /* Write batch size. */
+#define ACCESS_LOG_LINE_MAX	1024 /* Max formatted record size. */
+
+
+typedef struct access_log_ring_s {
+	wr_queue_t	q;		/* Records: stream thread -> logger. */
+	atomic_uint_fast64_t dropped_count;
+	access_log_rec_p recs;
+} access_log_ring_t, *access_log_ring_p;
+
+typedef struct access_log_s {
+	access_log_settings_t s;	/* Settings. */
+	size_t		thread_count;
+	access_log_ring_p rings;	/* Per thread. */
+	wr_thread_t	wt;		/* Logger thread. */
+	atomic_int	reopen;		/* Reopen file request. */
+	int		fd;		/* Log file. */
+	uint64_t	file_size;
+	int		last_error;	/* Do not flood syslog. */
+	atomic_uint_fast64_t written_count;
+	atomic_uint_fast64_t rotate_count;
+	size_t		buf_used;
+	uint8_t		*buf;		/* Write batch buffer. */
+} access_log_t;
+
+
+static const char *access_log_ev_names[] = {
+	"-", "attach", "detach", "reject", "hub_create", "hub_destroy"
+};
+
+
+static size_t	access_log_drain(wr_queue_p q, int dead, void *udata);
+static void	access_log_pass(void *udata);
+static size_t	access_log_rec_fmt(access_log_rec_p rec, char *buf,
+		    size_t buf_size);
+static size_t	access_log_addr_fmt(const struct sockaddr_storage *addr,
+		    int with_port, char *buf, size_t buf_size);
+static void	access_log_flush(access_log_p alog);
+static int	access_log_open(access_log_p alog);
+static void	access_log_rotate(access_log_p alog);
+
+
+
+void
+access_log_settings_def(access_log_settings_p p_ret) {
+
+	if (NULL == p_ret)
+		return;
+	memset(p_ret, 0x00, sizeof(access_log_settings_t));
+	p_ret->flags = ACCESS_LOG_S_DEF_FLAGS;
+	p_ret->ring_size = ACCESS_LOG_S_DEF_RING_SIZE;
+	p_ret->flush_interval = ACCESS_LOG_S_DEF_FLUSH_INTERVAL;
+	p_ret->rotate_size = ACCESS_LOG_S_DEF_ROTATE_SIZE;
+	p_ret->rotate_count = ACCESS_LOG_S_DEF_ROTATE_COUNT;
+}
+
+
+int
+access_log_create(access_log_settings_p s, size_t thread_count,
+    access_log_p *alog_ret) {
+	int error;
+	access_log_p alog;
+	size_t i, ring_size;
+
+	if (NULL == s || 0 == thread_count || NULL == alog_ret)
+		return (EINVAL);
+	if (0 == s->file_name[0])
+		return (EINVAL);
+	alog = calloc(1, sizeof(access_log_t));
+	if (NULL == alog)
+		return (ENOMEM);
+	memcpy(&alog->s, s, sizeof(access_log_settings_t));
+	alog->fd = -1;
+	alog->thread_count = thread_count;
+	/* Correct values. */
+	if (0 == alog->s.flush_interval) {
+		alog->s.flush_interval = ACCESS_LOG_S_DEF_FLUSH_INTERVAL;
+	}
+	alog->s.rotate_size *= 1024; /* kb -> bytes */
+	atomic_init(&alog->reopen, 0);
+	atomic_init(&alog->written_count, 0);
+	atomic_init(&alog->rotate_count, 0);
+
+	alog->buf = malloc(ACCESS_LOG_BUF_SIZE);
+	alog->rings = calloc(thread_count, sizeof(access_log_ring_t));
+	if (NULL == alog->buf || NULL == alog->rings) {
+		error = ENOMEM;
+		goto err_out;
+	}
+	for (i = 0; i < thread_count; i ++) {
+		ring_size = wr_queue_init(&alog->rings[i].q, alog->s.ring_size, 16);
+		atomic_init(&alog->rings[i].dropped_count, 0);
+		alog->rings[i].recs = malloc((ring_size * sizeof(access_log_rec_t)));
+		if (NULL == alog->rings[i].recs) {
+			error = ENOMEM;
+			goto err_out;
+		}
+	}
+	alog->s.ring_size = ring_size;
+	error = access_log_open(alog);
+	if (0 != error)
+		goto err_out;
+	/* Batch writes: sleep flush_interval even if got records. */
+	error = wr_thread_start(&alog->wt, alog->s.flush_interval, 0,
+	    access_log_drain, NULL, access_log_pass, alog);
+	if (0 != error)
+		goto err_out;
+	for (i = 0; i < thread_count; i ++) {
+		wr_thread_add(&alog->wt, &alog->rings[i].q);
+	}
+
+	(*alog_ret) = alog;
+	return (0);
+
+err_out:
+	if (-1 != alog->fd) {
+		close(alog->fd);
+	}
+	if (NULL != alog->rings) {
+		for (i = 0; i < thread_count; i ++) {
+			free(alog->rings[i].recs);
+		}
+		free(alog->rings);
+	}
+	free(alog->buf);
+	free(alog);
+	return (error);
+}
+
+void
+access_log_destroy(access_log_p alog) {
+	size_t i;
+
+	if (NULL == alog)
+		return;
+	/* Logger thread drain all rings before exit. */
+	wr_thread_stop(&alog->wt);
+	close(alog->fd);
+	for (i = 0; i < alog->thread_count; i ++) {
+		free(alog->rings[i].recs);
+	}
+	free(alog->rings);
+	free(alog->buf);
+	free(alog);
+}
+
+
+/*
+ * Return free record or NULL if log disabled or ring full.
+ * Call access_log_rec_commit() only after non NULL result.
+ */
+access_log_rec_p
+access_log_rec_get(access_log_p alog, size_t thread_num) {
+	access_log_ring_p ring;
+	size_t wpos;
+
+	if (NULL == alog || alog->thread_count <= thread_num)
+		return (NULL);
+	ring = &alog->rings[thread_num];
+	if (0 != wr_queue_wpos(&ring->q, &wpos)) { /* Full. */
+		atomic_fetch_add_explicit(&ring->dropped_count, 1,
+		    memory_order_relaxed);
+		return (NULL);
+	}
+	return (&ring->recs[(wpos & ring->q.mask)]);
+}
+
+void
+access_log_rec_commit(access_log_p alog, size_t thread_num) {
+
+	if (NULL == alog || alog->thread_count <= thread_num)
+		return;
+	wr_queue_commit(&alog->rings[thread_num].q);
+}
+
+
+void
+access_log_reopen(access_log_p alog) {
+
+	if (NULL == alog)
+		return;
+	atomic_store_explicit(&alog->reopen, 1, memory_order_relaxed);
+}
+
+int
+access_log_stat_get(access_log_p alog, access_log_stat_p stat) {
+	size_t i;
+
+	if (NULL == alog || NULL == stat)
+		return (EINVAL);
+	memset(stat, 0x00, sizeof(access_log_stat_t));
+	stat->written_count = atomic_load_explicit(&alog->written_count,
+	    memory_order_relaxed);
+	stat->rotate_count = atomic_load_explicit(&alog->rotate_count,
+	    memory_order_relaxed);
+	for (i = 0; i < alog->thread_count; i ++) {
+		stat->dropped_count += atomic_load_explicit(
+		    &alog->rings[i].dropped_count, memory_order_relaxed);
+	}
+	return (0);
+}
+
+
+/* One ring. */
+static size_t
+access_log_drain(wr_queue_p q, int dead __unused, void *udata) {
+	access_log_p alog = udata;
+	access_log_ring_p ring = (access_log_ring_p)q;
+	size_t rpos, wpos, count = 0;
+
+	rpos = wr_queue_rpos(q, &wpos);
+	for (; rpos != wpos; rpos ++, count ++) {
+		if (ACCESS_LOG_LINE_MAX > (ACCESS_LOG_BUF_SIZE - alog->buf_used)) {
+			access_log_flush(alog);
+		}
+		alog->buf_used += access_log_rec_fmt(
+		    &ring->recs[(rpos & q->mask)],
+		    (char*)(alog->buf + alog->buf_used),
+		    (ACCESS_LOG_BUF_SIZE - alog->buf_used));
+	}
+	/* Record formatted, slots can be reused. */
+	wr_queue_release(q, rpos);
+	atomic_fetch_add_explicit(&alog->written_count, count,
+	    memory_order_relaxed);
+
+	return (count);
+}
+
+/* All rings drained. */
+static void
+access_log_pass(void *udata) {
+	access_log_p alog = udata;
+
+	if (0 != atomic_exchange_explicit(&alog->reopen, 0, memory_order_relaxed)) {
+		access_log_flush(alog);
+		close(alog->fd);
+		access_log_open(alog);
+	}
+	access_log_flush(alog);
+}
+
+/* One line, fields separated by space, "-" for not set. */
+static size_t
+access_log_rec_fmt(access_log_rec_p rec, char *buf, size_t buf_size) {
+	struct tm stm;
+	size_t i, off;
+	char straddr[64], strxaddr[64], ua[ACCESS_LOG_USER_AGENT_MAX];
+	int ios;
+
+	if (ACCESS_LOG_EV_HUB_DESTROY < rec->event) {
+		rec->event = 0;
+	}
+	localtime_r(&rec->time, &stm);
+	off = strftime(buf, buf_size, "%Y-%m-%d %H:%M:%S", &stm);
+	access_log_addr_fmt(&rec->addr, 1, straddr, sizeof(straddr));
+	access_log_addr_fmt(&rec->xreal_addr, 0, strxaddr, sizeof(strxaddr));
+	/* User-Agent is client controlled: no quotes and control chars. */
+	rec->user_agent_size = MIN(rec->user_agent_size, (sizeof(ua) - 1));
+	for (i = 0; i < rec->user_agent_size; i ++) {
+		ua[i] = rec->user_agent[i];
+		if (' ' > ua[i] || '"' == ua[i] || '\\' == ua[i] || 0x7f == ua[i]) {
+			ua[i] = '_';
+		}
+	}
+	ua[i] = 0;
+	rec->hub_name_size = MIN(rec->hub_name_size, (sizeof(rec->hub_name) - 1));
+	rec->hub_name[rec->hub_name_size] = 0;
+
+	ios = snprintf((buf + off), (buf_size - off),
+	    " %s %s %s %s duration=%jd bytes=%"PRIu64" clients=%zu"
+	    " reason=\"%s\" ua=\"%s\"\n",
+	    access_log_ev_names[rec->event],
+	    ((0 != rec->hub_name_size) ? rec->hub_name : "-"),
+	    straddr, strxaddr,
+	    (intmax_t)rec->duration, rec->sended, rec->cli_count,
+	    ((NULL != rec->reason) ? rec->reason : "-"),
+	    ua);
+	if (0 > ios)
+		return (0);
+	off += MIN((size_t)ios, (buf_size - off - 1));
+
+	return (off);
+}
+
+static size_t
+access_log_addr_fmt(const struct sockaddr_storage *addr, int with_port,
+    char *buf, size_t buf_size) {
+	char straddr[INET6_ADDRSTRLEN];
+	int ios;
+
+	switch (addr->ss_family) {
+	case AF_INET:
+		inet_ntop(AF_INET, &((const struct sockaddr_in*)(const void*)addr)->sin_addr,
+		    straddr, sizeof(straddr));
+		if (0 == with_port)
+			break;
+		ios = snprintf(buf, buf_size, "%s:%u", straddr,
+		    ntohs(((const struct sockaddr_in*)(const void*)addr)->sin_port));
+		return ((0 > ios) ? 0 : (size_t)ios);
+	case AF_INET6:
+		inet_ntop(AF_INET6, &((const struct sockaddr_in6*)(const void*)addr)->sin6_addr,
+		    straddr, sizeof(straddr));
+		if (0 == with_port)
+			break;
+		ios = snprintf(buf, buf_size, "[%s]:%u", straddr,
+		    ntohs(((const struct sockaddr_in6*)(const void*)addr)->sin6_port));
+		return ((0 > ios) ? 0 : (size_t)ios);
+	default:
+		memcpy(straddr, "-", 2);
+		break;
+	}
+	ios = snprintf(buf, buf_size, "%s", straddr);
+	return ((0 > ios) ? 0 : (size_t)ios);
+}
+
+static void
+access_log_flush(access_log_p alog) {
+	ssize_t ios;
+	size_t off = 0;
+	int error = 0;
+
+	while (off < alog->buf_used) {
+		if (-1 == alog->fd) {
+			error = EBADF;
+			break;
+		}
+		ios = write(alog->fd, (alog->buf + off), (alog->buf_used - off));
+		if (-1 == ios) {
+			error = errno;
+			if (EINTR == error)
+				continue;
+			break;
+		}
+		off += (size_t)ios;
+	}
+	alog->file_size += off;
+	alog->buf_used = 0; /* Not written records are lost. */
+	if (error != alog->last_error) {
+		alog->last_error = error;
+		SYSLOG_ERR(LOG_ERR, error, "access log write(%s).",
+		    alog->s.file_name);
+	}
+	if (0 != alog->s.rotate_size &&
+	    alog->s.rotate_size <= alog->file_size) {
+		access_log_rotate(alog);
+	}
+}
+
+static int
+access_log_open(access_log_p alog) {
+	int error;
+	struct stat sb;
+
+	alog->fd = open(alog->s.file_name,
+	    (O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC), 0640);
+	if (-1 == alog->fd) {
+		error = errno;
+		SYSLOG_ERR(LOG_ERR, error, "access log open(%s).",
+		    alog->s.file_name);
+		return (error);
+	}
+	alog->file_size = 0;
+	if (0 == fstat(alog->fd, &sb)) {
+		alog->file_size = (uint64_t)sb.st_size;
+	}
+	return (0);
+}
+
+/* name -> name.1 -> ... -> name.N, oldest removed by rename. */
+static void
+access_log_rotate(access_log_p alog) {
+	uint32_t i;
+	char old_name[(sizeof(alog->s.file_name) + 16)];
+	char new_name[(sizeof(alog->s.file_name) + 16)];
+
+	close(alog->fd);
+	alog->fd = -1;
+	if (0 == alog->s.rotate_count) {
+		unlink(alog->s.file_name);
+	} else {
+		for (i = alog->s.rotate_count; i > 1; i --) {
+			snprintf(old_name, sizeof(old_name), "%s.%"PRIu32,
+			    alog->s.file_name, (i - 1));
+			snprintf(new_name, sizeof(new_name), "%s.%"PRIu32,
+			    alog->s.file_name, i);
+			rename(old_name, new_name);
+		}
+		snprintf(new_name, sizeof(new_name), "%s.1", alog->s.file_name);
+		if (0 != rename(alog->s.file_name, new_name)) {
+			SYSLOG_ERR(LOG_ERR, errno, "access log rename(%s, %s).",
+			    alog->s.file_name, new_name);
+		}
+	}
+	access_log_open(alog);
+	atomic_fetch_add_explicit(&alog->rotate_count, 1, memory_order_relaxed);
+}
@@ -0,0 +1,114 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+#ifndef __MSD_ACCESS_LOG_H__
+#define __MSD_ACCESS_LOG_H__
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <inttypes.h>
+#include <time.h>
+#include <stdatomic.h>
+
+
+/*
+ * Access log: streaming threads put fixed size binary records to own
+ * single producer / single consumer ring, logger thread format them and
+ * write to file.
+ * Record is dropped (and counted) if ring is full, producer never block.
+ */
+
+typedef struct access_log_s	*access_log_p;
+
+/* Events. */
+#define ACCESS_LOG_EV_ATTACH		1 /* Client attached to hub. */
+#define ACCESS_LOG_EV_DETACH		2 /* Client detached from hub. */
+#define ACCESS_LOG_EV_REJECT		3 /* Client rejected. */
+#define ACCESS_LOG_EV_HUB_CREATE	4 /* Stream hub created. */
+#define ACCESS_LOG_EV_HUB_DESTROY	5 /* Stream hub destroyed. */
+
+#define ACCESS_LOG_HUB_NAME_MAX		128
+#define ACCESS_LOG_USER_AGENT_MAX	256
+
+typedef struct access_log_rec_s {
+	uint32_t	event;		/* ACCESS_LOG_EV_*. */
+	const char	*reason;	/* Static string: drop/reject reason or NULL. */
+	time_t		time;		/* Event time, wall clock. */
+	time_t		duration;	/* Connection duration, s. */
+	uint64_t	sended;		/* Bytes sended to client. */
+	size_t		cli_count;	/* Hub clients count after event. */
+	struct sockaddr_storage addr;	/* Client address. */
+	struct sockaddr_storage xreal_addr; /* X-Real-IP or client address. */
+	size_t		hub_name_size;
+	char		hub_name[ACCESS_LOG_HUB_NAME_MAX];
+	size_t		user_agent_size;
+	char		user_agent[ACCESS_LOG_USER_AGENT_MAX];
+} access_log_rec_t, *access_log_rec_p;
+
+
+typedef struct access_log_settings_s {
+	uint32_t	flags;
+	size_t		ring_size;	/* Records per thread, rounded up to power of 2. */
+	uint32_t	flush_interval;	/* Logger wakeup interval, ms. */
+	uint64_t	rotate_size;	/* Rotate file at size, kb. 0 = never. */
+	uint32_t	rotate_count;	/* Keep old files: name.1 ... name.N. */
+	char		file_name[1024];
+} access_log_settings_t, *access_log_settings_p;
+/* Flags. */
+#define ACCESS_LOG_S_F_ENABLE		(((uint32_t)1) << 0)
+/* Default values. */
+#define ACCESS_LOG_S_DEF_FLAGS		(0)
+#define ACCESS_LOG_S_DEF_RING_SIZE	(4096)
+#define ACCESS_LOG_S_DEF_FLUSH_INTERVAL	(200)	/* ms */
+#define ACCESS_LOG_S_DEF_ROTATE_SIZE	(64 * 1024) /* kb */
+#define ACCESS_LOG_S_DEF_ROTATE_COUNT	(4)
+
+
+typedef struct access_log_stat_s {
+	uint64_t	written_count;	/* Records written to file. */
+	uint64_t	dropped_count;	/* Records dropped: ring full. */
+	uint64_t	rotate_count;	/* File rotations. */
+} access_log_stat_t, *access_log_stat_p;
+
+
+void	access_log_settings_def(access_log_settings_p p_ret);
+
+int	access_log_create(access_log_settings_p s, size_t thread_count,
+	    access_log_p *alog_ret);
+void	access_log_destroy(access_log_p alog);
+
+/* Producer: only from thread thread_num. */
+access_log_rec_p access_log_rec_get(access_log_p alog, size_t thread_num);
+void	access_log_rec_commit(access_log_p alog, size_t thread_num);
+
+void	access_log_reopen(access_log_p alog);
+int	access_log_stat_get(access_log_p alog, access_log_stat_p stat);
+
+
+#endif // __MSD_ACCESS_LOG_H__
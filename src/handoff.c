@@ -0,0 +1,569 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <stdlib.h> /* malloc, exit */
+#include <stdio.h> /* snprintf, fprintf */
+#include <unistd.h> /* close, write, sysconf */
+#include <fcntl.h> /* For O_* constants */
+#include <poll.h>
+#include <inttypes.h>
+#include <string.h> /* bcopy, bzero, memcpy, memmove, memset, strerror... */
+#include <time.h>
+#include <errno.h>
+#include <syslog.h>
+
+#include "utils/macro.h"
+#include "utils/sys.h"
+#include "threadpool/threadpool.h"
+#include "threadpool/threadpool_task.h"
+#include "stream_sys.h"
+#include "handoff.h"
+
+
+typedef struct handoff_s {
+	tp_task_p	tptask;		/* Listen socket. */
+	handoff_req_cb	req_cb;
+	void		*udata;
+	int		started;	/* Handoff possible only once. */
+} handoff_t;
+
+
+static int	handoff_rec_send_int(uintptr_t skt, handoff_rec_p rec,
+		    uintptr_t fd, int wait);
+static int	handoff_skt_timeout_set(uintptr_t skt, time_t timeout);
+static int	handoff_addr_set(const char *file_name, struct sockaddr_un *addr);
+static int	handoff_accept_cb(tp_task_p tptask, int error, uint32_t eof,
+		    size_t data2transfer_size, void *arg);
+
+
+
+void
+handoff_rec_init(handoff_rec_p rec, uint32_t type) {
+
+	if (NULL == rec)
+		return;
+	memset(rec, 0x00, sizeof(handoff_rec_t));
+	rec->magic = HANDOFF_MAGIC;
+	rec->version = HANDOFF_VERSION;
+	rec->size = sizeof(handoff_rec_t);
+	rec->type = type;
+}
+
+/* Send record on blocking socket. */
+int
+handoff_rec_send(uintptr_t skt, handoff_rec_p rec, uintptr_t fd) {
+
+	return (handoff_rec_send_int(skt, rec, fd, -1));
+}
+
+/*
+ * Send record without blocking caller thread for long: wait at most
+ * HANDOFF_SND_WAIT ms for socket buf space.
+ * EAGAIN: nothing sended, stream still usable, caller may skip record.
+ * Other errors: stream is broken.
+ */
+int
+handoff_rec_send_nb(uintptr_t skt, handoff_rec_p rec, uintptr_t fd) {
+
+	return (handoff_rec_send_int(skt, rec, fd, HANDOFF_SND_WAIT));
+}
+
+/* Send record, fd (if not -1) attached with SCM_RIGHTS. */
+static int
+handoff_rec_send_int(uintptr_t skt, handoff_rec_p rec, uintptr_t fd, int wait) {
+	struct msghdr mhdr;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	uint8_t cmsg_buf[CMSG_SPACE(sizeof(int))];
+	struct pollfd pfd;
+	ssize_t ios;
+	size_t off = 0;
+
+	if ((uintptr_t)-1 == skt || NULL == rec)
+		return (EINVAL);
+	memset(&mhdr, 0x00, sizeof(mhdr));
+	mhdr.msg_iov = &iov;
+	mhdr.msg_iovlen = 1;
+	if ((uintptr_t)-1 != fd) {
+		memset(cmsg_buf, 0x00, sizeof(cmsg_buf));
+		mhdr.msg_control = cmsg_buf;
+		mhdr.msg_controllen = sizeof(cmsg_buf);
+		cmsg = CMSG_FIRSTHDR(&mhdr);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+		(*((int*)(void*)CMSG_DATA(cmsg))) = (int)fd;
+	}
+	while (off < sizeof(handoff_rec_t)) {
+		iov.iov_base = (((uint8_t*)rec) + off);
+		iov.iov_len = (sizeof(handoff_rec_t) - off);
+		ios = sendmsg((int)skt, &mhdr, (MSG_NOSIGNAL |
+		    ((-1 == wait) ? 0 : MSG_DONTWAIT)));
+		if (-1 == ios) {
+			if (EINTR == errno)
+				continue;
+			if (-1 == wait || (EAGAIN != errno && EWOULDBLOCK != errno))
+				return (errno);
+			pfd.fd = (int)skt;
+			pfd.events = POLLOUT;
+			pfd.revents = 0;
+			ios = poll(&pfd, 1, wait);
+			if (0 < ios || (-1 == ios && EINTR == errno))
+				continue;
+			/* No progress: tell if stream still in sync. */
+			return ((0 == off) ? EAGAIN : ETIMEDOUT);
+		}
+		off += (size_t)ios;
+		/* fd already passed with first part. */
+		mhdr.msg_control = NULL;
+		mhdr.msg_controllen = 0;
+	}
+	return (0);
+}
+
+int
+handoff_rec_recv(uintptr_t skt, handoff_rec_p rec, uintptr_t *fd_ret) {
+	struct msghdr mhdr;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	uint8_t cmsg_buf[CMSG_SPACE(sizeof(int))];
+	ssize_t ios;
+	size_t off = 0;
+	uintptr_t fd = (uintptr_t)-1;
+
+	if ((uintptr_t)-1 == skt || NULL == rec || NULL == fd_ret)
+		return (EINVAL);
+	while (off < sizeof(handoff_rec_t)) {
+		memset(&mhdr, 0x00, sizeof(mhdr));
+		iov.iov_base = (((uint8_t*)rec) + off);
+		iov.iov_len = (sizeof(handoff_rec_t) - off);
+		mhdr.msg_iov = &iov;
+		mhdr.msg_iovlen = 1;
+		mhdr.msg_control = cmsg_buf;
+		mhdr.msg_controllen = sizeof(cmsg_buf);
+		ios = recvmsg((int)skt, &mhdr, MSG_CMSG_CLOEXEC);
+		if (-1 == ios) {
+			if (EINTR == errno)
+				continue;
+			goto err_out;
+		}
+		if (0 == ios) {
+			errno = ECONNRESET;
+			goto err_out;
+		}
+		off += (size_t)ios;
+		for (cmsg = CMSG_FIRSTHDR(&mhdr); NULL != cmsg;
+		    cmsg = CMSG_NXTHDR(&mhdr, cmsg)) {
+			if (SOL_SOCKET != cmsg->cmsg_level ||
+			    SCM_RIGHTS != cmsg->cmsg_type ||
+			    CMSG_LEN(sizeof(int)) > cmsg->cmsg_len)
+				continue;
+			if ((uintptr_t)-1 != fd) { /* Only one fd per record. */
+				close((int)fd);
+			}
+			fd = (uintptr_t)(*((int*)(void*)CMSG_DATA(cmsg)));
+		}
+	}
+	if (HANDOFF_MAGIC != rec->magic ||
+	    HANDOFF_VERSION != rec->version ||
+	    sizeof(handoff_rec_t) != rec->size) {
+		errno = EPROTO;
+		goto err_out;
+	}
+	(*fd_ret) = fd;
+	return (0);
+
+err_out:
+	if ((uintptr_t)-1 != fd) {
+		close((int)fd);
+	}
+	return (errno);
+}
+
+/* Source params to fixed layout record part. */
+int
+handoff_src_set(handoff_src_p src,
+    const str_src_conn_params_t *src_conn_params) {
+
+	if (NULL == src || NULL == src_conn_params)
+		return (EINVAL);
+	memset(src, 0x00, sizeof(handoff_src_t));
+	src->type = src_conn_params->udp.type;
+	src->if_index = src_conn_params->mc.if_index;
+	src->rejoin_time = src_conn_params->mc.rejoin_time;
+	memcpy(&src->addr, &src_conn_params->udp.addr,
+	    sizeof(struct sockaddr_storage));
+	memcpy(&src->src, &src_conn_params->mc.src,
+	    sizeof(struct sockaddr_storage));
+	switch (src->type) {
+	case STR_SRC_CONN_T_MC:
+		break;
+	case STR_SRC_CONN_T_HTTP:
+		if (HANDOFF_ORIGIN_MAX < src_conn_params->http.origin_count ||
+		    HANDOFF_PATH_MAX <= src_conn_params->http.path_size)
+			return (ENOBUFS);
+		src->origin_count = (uint32_t)src_conn_params->http.origin_count;
+		memcpy(src->origin, src_conn_params->http.origin,
+		    (sizeof(struct sockaddr_storage) * src->origin_count));
+		src->path_size = (uint32_t)src_conn_params->http.path_size;
+		memcpy(src->path, src_conn_params->http.path, src->path_size);
+		break;
+	case STR_SRC_CONN_T_FILE:
+		if (HANDOFF_PATH_MAX <= src_conn_params->file.path_size)
+			return (ENOBUFS);
+		src->flags = src_conn_params->file.flags;
+		src->path_size = (uint32_t)src_conn_params->file.path_size;
+		memcpy(src->path, src_conn_params->file.path, src->path_size);
+		break;
+	default:
+		return (EINVAL);
+	}
+	return (0);
+}
+
+/* Record part to source params, with checks: peer may be other build. */
+int
+handoff_src_get(const handoff_src_t *src,
+    str_src_conn_params_p src_conn_params) {
+
+	if (NULL == src || NULL == src_conn_params)
+		return (EINVAL);
+	str_src_conn_def(src_conn_params);
+	src_conn_params->udp.type = src->type;
+	src_conn_params->mc.if_index = src->if_index;
+	src_conn_params->mc.rejoin_time = src->rejoin_time;
+	memcpy(&src_conn_params->udp.addr, &src->addr,
+	    sizeof(struct sockaddr_storage));
+	memcpy(&src_conn_params->mc.src, &src->src,
+	    sizeof(struct sockaddr_storage));
+	switch (src->type) {
+	case STR_SRC_CONN_T_MC:
+		break;
+	case STR_SRC_CONN_T_HTTP:
+		if (0 == src->origin_count ||
+		    STR_SRC_CONN_HTTP_ORIGIN_MAX < src->origin_count ||
+		    HANDOFF_ORIGIN_MAX < src->origin_count ||
+		    sizeof(src_conn_params->http.path) <= src->path_size)
+			return (EPROTO);
+		src_conn_params->http.origin_count = src->origin_count;
+		memcpy(src_conn_params->http.origin, src->origin,
+		    (sizeof(struct sockaddr_storage) * src->origin_count));
+		src_conn_params->http.path_size = src->path_size;
+		memcpy(src_conn_params->http.path, src->path, src->path_size);
+		src_conn_params->http.path[src->path_size] = 0;
+		break;
+	case STR_SRC_CONN_T_FILE:
+		if (0 == src->path_size ||
+		    sizeof(src_conn_params->file.path) <= src->path_size)
+			return (EPROTO);
+		src_conn_params->file.flags = src->flags;
+		src_conn_params->file.path_size = src->path_size;
+		memcpy(src_conn_params->file.path, src->path, src->path_size);
+		src_conn_params->file.path[src->path_size] = 0;
+		break;
+	default:
+		return (EPROTO);
+	}
+	return (0);
+}
+
+
+int
+handoff_listen_create(tp_p tp, const char *file_name,
+    handoff_req_cb req_cb, void *udata, handoff_p *ho_ret) {
+	int error;
+	uintptr_t skt;
+	struct sockaddr_un addr;
+	handoff_p ho;
+	mode_t omask;
+
+	if (NULL == tp || NULL == file_name || NULL == req_cb || NULL == ho_ret)
+		return (EINVAL);
+	error = handoff_addr_set(file_name, &addr);
+	if (0 != error)
+		return (error);
+	ho = calloc(1, sizeof(handoff_t));
+	if (NULL == ho)
+		return (ENOMEM);
+	ho->req_cb = req_cb;
+	ho->udata = udata;
+	skt = (uintptr_t)socket(AF_UNIX, (SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC), 0);
+	if ((uintptr_t)-1 == skt) {
+		error = errno;
+		goto err_out;
+	}
+	unlink(file_name); /* Previous process already connected or gone. */
+	/* Create file as 0600, no window with default mode. Called on start. */
+	omask = umask(0177);
+	error = bind((int)skt, (struct sockaddr*)&addr, sizeof(addr));
+	umask(omask);
+	if (0 != error ||
+	    0 != listen((int)skt, 1)) {
+		error = errno;
+		goto err_out;
+	}
+	error = tp_task_notify_create(tp_thread_get_rr(tp), skt,
+	    TP_TASK_F_CLOSE_ON_DESTROY, TP_EV_READ, 0, handoff_accept_cb,
+	    ho, &ho->tptask);
+	if (0 != error)
+		goto err_out;
+
+	(*ho_ret) = ho;
+	return (0);
+
+err_out:
+	if ((uintptr_t)-1 != skt) {
+		close((int)skt);
+	}
+	free(ho);
+	return (error);
+}
+
+/* File not removed: it may belong to new process already. */
+void
+handoff_listen_destroy(handoff_p ho) {
+
+	if (NULL == ho)
+		return;
+	tp_task_destroy(ho->tptask);
+	free(ho);
+}
+
+static int
+handoff_accept_cb(tp_task_p tptask, int error, uint32_t eof __unused,
+    size_t data2transfer_size __unused, void *arg) {
+	handoff_p ho = arg;
+	handoff_rec_t rec;
+	uintptr_t skt, fd = (uintptr_t)-1;
+	int snd_buf = HANDOFF_SND_BUF;
+
+	if (0 != error) {
+		SYSLOG_ERR(LOG_ERR, error, "On handoff listen socket.");
+		return (TP_TASK_CB_CONTINUE);
+	}
+	skt = (uintptr_t)accept4((int)tp_task_ident_get(tptask), NULL, NULL,
+	    SOCK_CLOEXEC);
+	if ((uintptr_t)-1 == skt)
+		return (TP_TASK_CB_CONTINUE);
+	if (0 != ho->started) {
+		close((int)skt);
+		return (TP_TASK_CB_CONTINUE);
+	}
+	/*
+	 * Request sended right after connect: short blocking read.
+	 * Records sended with handoff_rec_send_nb(), large buf to not wait.
+	 */
+	error = handoff_skt_timeout_set(skt, HANDOFF_REQ_TIMEOUT);
+	if (0 == error) {
+		error = handoff_rec_recv(skt, &rec, &fd);
+	}
+	if (0 == error &&
+	    0 != setsockopt((int)skt, SOL_SOCKET, SO_SNDBUF, &snd_buf,
+	    sizeof(snd_buf))) {
+		SYSLOG_ERR(LOG_NOTICE, errno, "Handoff: setsockopt(SO_SNDBUF).");
+	}
+	if ((uintptr_t)-1 != fd) {
+		close((int)fd);
+	}
+	if (0 == error && HANDOFF_REC_REQ != rec.type) {
+		error = EPROTO;
+	}
+	if (0 != error) {
+		SYSLOG_ERR(LOG_ERR, error, "Handoff request.");
+		close((int)skt);
+		return (TP_TASK_CB_CONTINUE);
+	}
+	ho->started = 1;
+	syslog(LOG_NOTICE, "Handoff requested, passing clients to new process...");
+	ho->req_cb(skt, ho->udata);
+
+	return (TP_TASK_CB_CONTINUE);
+}
+
+
+/*
+ * Connect to running process and receive its hubs and clients.
+ * Return ENOENT or ECONNREFUSED if no running process.
+ */
+int
+handoff_import(const char *file_name, str_hubs_bckt_p shbskt,
+    size_t *hub_count, size_t *cli_count) {
+	int error;
+	uintptr_t skt, fd;
+	struct sockaddr_un addr;
+	handoff_rec_p rec;
+	str_hub_cli_p strh_cli;
+	str_src_conn_params_t src_conn_params;
+	size_t hubs = 0, clis = 0;
+
+	if (NULL == file_name || NULL == shbskt)
+		return (EINVAL);
+	error = handoff_addr_set(file_name, &addr);
+	if (0 != error)
+		return (error);
+	rec = malloc(sizeof(handoff_rec_t));
+	if (NULL == rec)
+		return (ENOMEM);
+	skt = (uintptr_t)socket(AF_UNIX, (SOCK_STREAM | SOCK_CLOEXEC), 0);
+	if ((uintptr_t)-1 == skt) {
+		error = errno;
+		goto err_out;
+	}
+	if (0 != connect((int)skt, (struct sockaddr*)&addr, sizeof(addr))) {
+		error = errno;
+		goto err_out;
+	}
+	error = handoff_skt_timeout_set(skt, HANDOFF_TIMEOUT);
+	if (0 != error)
+		goto err_out;
+	handoff_rec_init(rec, HANDOFF_REC_REQ);
+	error = handoff_rec_send(skt, rec, (uintptr_t)-1);
+	if (0 != error)
+		goto err_out;
+
+	for (;;) {
+		error = handoff_rec_recv(skt, rec, &fd);
+		if (0 != error)
+			break;
+		rec->hub_name_size = MIN(rec->hub_name_size, (sizeof(rec->hub_name) - 1));
+		rec->hub_name[rec->hub_name_size] = 0;
+		rec->prof_name_size = MIN(rec->prof_name_size, (sizeof(rec->prof_name) - 1));
+		if (HANDOFF_REC_END == rec->type) {
+			if ((uintptr_t)-1 != fd) {
+				close((int)fd);
+			}
+			break;
+		}
+		if ((uintptr_t)-1 == fd || 0 == rec->hub_name_size ||
+		    0 != handoff_src_get(&rec->src, &src_conn_params)) {
+			SYSLOG_ERR(LOG_ERR, EPROTO, "Handoff: bad record, skipped.");
+			if ((uintptr_t)-1 != fd) {
+				close((int)fd);
+			}
+			continue;
+		}
+		switch (rec->type) {
+		case HANDOFF_REC_HUB:
+			error = str_hub_import(shbskt, rec->hub_name,
+			    rec->hub_name_size, rec->prof_name, rec->prof_name_size,
+			    &src_conn_params, fd);
+			if (0 != error) {
+				SYSLOG_ERR(LOG_ERR, error, "%s: str_hub_import().",
+				    rec->hub_name);
+				close((int)fd);
+				break;
+			}
+			hubs ++;
+			break;
+		case HANDOFF_REC_CLI:
+			strh_cli = str_hub_cli_alloc(fd, (const char*)rec->user_agent,
+			    MIN(rec->user_agent_size, sizeof(rec->user_agent)));
+			if (NULL == strh_cli) {
+				close((int)fd);
+				break;
+			}
+			/* HTTP headers already sended by previous process. */
+			strh_cli->flags = STR_HUB_CLI_STATE_F_HTTP_HDRS_SENDED;
+			strh_cli->conn_time = (time_t)rec->conn_time;
+			strh_cli->sended_count = rec->sended_count;
+			memcpy(&strh_cli->remonte_addr, &rec->remonte_addr,
+			    sizeof(struct sockaddr_storage));
+			memcpy(&strh_cli->xreal_addr, &rec->xreal_addr,
+			    sizeof(struct sockaddr_storage));
+			strh_cli->tail_size = MIN(rec->tail_size, sizeof(strh_cli->tail));
+			memcpy(strh_cli->tail, rec->tail, strh_cli->tail_size);
+			error = str_hub_cli_attach(shbskt, strh_cli, rec->hub_name,
+			    rec->hub_name_size, rec->prof_name, rec->prof_name_size,
+			    &src_conn_params);
+			if (0 != error) {
+				SYSLOG_ERR(LOG_ERR, error, "%s: str_hub_cli_attach().",
+				    rec->hub_name);
+				str_hub_cli_destroy(NULL, strh_cli);
+				break;
+			}
+			clis ++;
+			break;
+		default:
+			close((int)fd);
+			break;
+		}
+		error = 0;
+	}
+
+err_out:
+	if ((uintptr_t)-1 != skt) {
+		close((int)skt);
+	}
+	free(rec);
+	if (NULL != hub_count) {
+		(*hub_count) = hubs;
+	}
+	if (NULL != cli_count) {
+		(*cli_count) = clis;
+	}
+	return (error);
+}
+
+
+static int
+handoff_skt_timeout_set(uintptr_t skt, time_t timeout) {
+	struct timeval tv;
+
+	tv.tv_sec = timeout;
+	tv.tv_usec = 0;
+	if (0 != setsockopt((int)skt, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) ||
+	    0 != setsockopt((int)skt, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)))
+		return (errno);
+	/* Accepted socket may inherit O_NONBLOCK on some systems. */
+	if (-1 == fcntl((int)skt, F_SETFL,
+	    (fcntl((int)skt, F_GETFL, 0) & ~O_NONBLOCK)))
+		return (errno);
+	return (0);
+}
+
+static int
+handoff_addr_set(const char *file_name, struct sockaddr_un *addr) {
+	size_t file_name_size;
+
+	file_name_size = strlen(file_name);
+	if (0 == file_name_size ||
+	    sizeof(addr->sun_path) <= file_name_size)
+		return (ENAMETOOLONG);
+	memset(addr, 0x00, sizeof(struct sockaddr_un));
+	addr->sun_family = AF_UNIX;
+	memcpy(addr->sun_path, file_name, file_name_size);
+	return (0);
+}
@@ -0,0 +1,138 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+#ifndef __MSD_HANDOFF_H__
+#define __MSD_HANDOFF_H__
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "threadpool/threadpool.h"
+#include "stream_sys.h"
+
+
+/*
+ * Zero downtime upgrade.
+ * Old process listen unix socket, new process connect to it on start and
+ * send request. Old process stop accept new HTTP clients, pass all stream
+ * hubs multicast sockets and clients sockets with SCM_RIGHTS and exit.
+ * New process re create hubs with passed sockets and continue send.
+ *
+ * HTTP listening sockets are created by HTTP server from config and can
+ * not be passed: bind them with SO_REUSEPORT, so both processes can
+ * listen at same time.
+ */
+
+typedef struct handoff_s	*handoff_p;
+
+/*
+ * Record layout is the handoff protocol: only fixed size fields, no
+ * internal structures, so old and new builds agree on it.
+ * Any layout change must bump HANDOFF_VERSION.
+ */
+#define HANDOFF_MAGIC		0x4d534448 /* "MSDH" */
+#define HANDOFF_VERSION		4
+#define HANDOFF_HUB_NAME_MAX	512
+#define HANDOFF_PROF_NAME_MAX	32
+#define HANDOFF_UA_MAX		256
+#define HANDOFF_TAIL_MAX	188 /* One TS packet. */
+#define HANDOFF_ORIGIN_MAX	4
+#define HANDOFF_PATH_MAX	256
+#define HANDOFF_TIMEOUT		10 /* s, new process socket send/recv timeout. */
+#define HANDOFF_REQ_TIMEOUT	1 /* s, old process request recv timeout. */
+#define HANDOFF_SND_WAIT	100 /* ms, old process max wait per record. */
+#define HANDOFF_SND_BUF		(1024 * 1024) /* Old process socket send buf. */
+
+/* Record types. */
+#define HANDOFF_REC_REQ		1 /* New -> old: start handoff. */
+#define HANDOFF_REC_HUB		2 /* Stream hub + multicast socket. */
+#define HANDOFF_REC_CLI		3 /* Client + client socket. */
+#define HANDOFF_REC_END		4 /* No more records. */
+
+/* Source, values of type are STR_SRC_CONN_T_*. */
+typedef struct handoff_src_s {
+	uint32_t	type;
+	uint32_t	if_index;
+	uint32_t	rejoin_time;
+	uint32_t	flags;		/* File: REPLAY_F_*. */
+	struct sockaddr_storage	addr;
+	struct sockaddr_storage	src;	/* SSM source. */
+	uint32_t	origin_count;	/* HTTP. */
+	uint32_t	path_size;	/* HTTP, file. */
+	struct sockaddr_storage	origin[HANDOFF_ORIGIN_MAX];
+	char		path[HANDOFF_PATH_MAX];
+} handoff_src_t, *handoff_src_p;
+
+typedef struct handoff_rec_s {
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	size;		/* sizeof(handoff_rec_t). */
+	uint32_t	type;		/* HANDOFF_REC_*. */
+	uint32_t	flags;		/* Client flags. */
+	uint32_t	hub_name_size;
+	uint8_t		hub_name[HANDOFF_HUB_NAME_MAX];
+	uint32_t	prof_name_size;
+	char		prof_name[HANDOFF_PROF_NAME_MAX]; /* Hub settings profile. */
+	handoff_src_t	src;
+	/* Client. */
+	int64_t		conn_time;	/* Monotonic, same clock for both processes. */
+	uint64_t	sended_count;
+	struct sockaddr_storage remonte_addr;
+	struct sockaddr_storage	xreal_addr;
+	uint32_t	user_agent_size;
+	uint8_t		user_agent[HANDOFF_UA_MAX];
+	uint32_t	tail_size;	/* Rest of TS packet to send first. */
+	uint8_t		tail[HANDOFF_TAIL_MAX];
+} handoff_rec_t, *handoff_rec_p;
+
+/* Called from thread pool thread, skt is owned by callee. */
+typedef void (*handoff_req_cb)(uintptr_t skt, void *udata);
+
+
+void	handoff_rec_init(handoff_rec_p rec, uint32_t type);
+int	handoff_rec_send(uintptr_t skt, handoff_rec_p rec, uintptr_t fd);
+int	handoff_rec_send_nb(uintptr_t skt, handoff_rec_p rec, uintptr_t fd);
+int	handoff_rec_recv(uintptr_t skt, handoff_rec_p rec, uintptr_t *fd_ret);
+
+int	handoff_src_set(handoff_src_p src,
+	    const str_src_conn_params_t *src_conn_params);
+int	handoff_src_get(const handoff_src_t *src,
+	    str_src_conn_params_p src_conn_params);
+
+int	handoff_listen_create(tp_p tp, const char *file_name,
+	    handoff_req_cb req_cb, void *udata, handoff_p *ho_ret);
+void	handoff_listen_destroy(handoff_p ho);
+
+int	handoff_import(const char *file_name, str_hubs_bckt_p shbskt,
+	    size_t *hub_count, size_t *cli_count);
+
+
+#endif // __MSD_HANDOFF_H__
@@ -0,0 +1,479 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h> /* For mode constants */
+#include <fcntl.h> /* For O_* constants */
+
+#include <stdlib.h> /* malloc, exit */
+#include <unistd.h> /* close, write, sysconf */
+#include <inttypes.h>
+#include <string.h> /* bcopy, bzero, memcpy, memmove, memset, strerror... */
+#include <errno.h>
+
+#include "utils/macro.h"
+#include "utils/io_buf.h"
+#include "proto/mpeg2ts.h"
+#include "hls.h"
+
+
+#define HLS_PID_NONE		0x1fff /* Null packet PID. */
+#define HLS_FORCE_CUT_MUL	3 /* No RAP: cut on PES start after X * duration. */
+
+typedef struct hls_seg_s {
+	uint64_t	seq;		/* 0 = empty. */
+	size_t		size;
+	uint64_t	duration;	/* ms, 0 = still writing. */
+	uint32_t	slot;		/* Data slot in memfd. */
+} hls_seg_t, *hls_seg_p;
+
+typedef struct hls_s {
+	hls_settings_t	s;
+	uintptr_t	fd;		/* memfd with all slots. */
+	uint8_t		*mem;
+	size_t		mem_size;
+	hls_seg_p	seg;		/* Segments, seq % seg_count. */
+	uint32_t	*slot_refs;	/* Per slot: segment + pins, 0 = free. */
+	uint32_t	slot_count;	/* seg_count + HLS_SLOT_SPARE. */
+	uint32_t	slot_next;	/* Free slot search start. */
+	int		slot_wait;	/* No free slot: skip data until RAP. */
+	uint64_t	seq;		/* Writing segment, 0 = not started. */
+	uint64_t	seg_start;	/* Writing segment start time, ms. */
+	uint16_t	pmt_pid;	/* 0 = PAT not seen. */
+	uint16_t	cut_pid;	/* Video PID, else first ES. NONE = PMT not seen. */
+	int		cut_pid_video;
+	uint8_t		pat[MPEG2_TS_PKT_SIZE_188]; /* Last PAT, 0 = none. */
+	uint8_t		pmt[MPEG2_TS_PKT_SIZE_188]; /* Last PMT, 0 = none. */
+} hls_t;
+
+#define HLS_TS_PID(__pkt)						\
+    ((uint16_t)((((uint16_t)((__pkt)[1] & 0x1f)) << 8) | (__pkt)[2]))
+#define HLS_TS_PUSI(__pkt)	(0 != (0x40 & (__pkt)[1]))
+#define HLS_TS_HAS_AF(__pkt)	(0 != (0x20 & (__pkt)[3]))
+#define HLS_TS_HAS_PAYLOAD(__pkt) (0 != (0x10 & (__pkt)[3]))
+/* Adaptation field random_access_indicator. */
+#define HLS_TS_RAI(__pkt)						\
+    (HLS_TS_HAS_AF(__pkt) && 0 != (__pkt)[4] && 0 != (0x40 & (__pkt)[5]))
+
+
+static const uint8_t *hls_ts_psi_get(const uint8_t *pkt, uint8_t table_id,
+		    size_t *size);
+static void	hls_pat_parse(hls_p hls, const uint8_t *pkt);
+static void	hls_pmt_parse(hls_p hls, const uint8_t *pkt);
+static int	hls_seg_open(hls_p hls, uint64_t time_ms);
+static void	hls_seg_close(hls_p hls, uint64_t time_ms);
+
+
+void
+hls_settings_def(hls_settings_p p_ret) {
+
+	if (NULL == p_ret)
+		return;
+	memset(p_ret, 0x00, sizeof(hls_settings_t));
+	p_ret->seg_count = HLS_S_DEF_SEG_COUNT;
+	p_ret->seg_duration = HLS_S_DEF_SEG_DURATION;
+	p_ret->seg_size_max = HLS_S_DEF_SEG_SIZE_MAX;
+}
+
+int
+hls_create(hls_settings_p s, hls_p *hls_ret) {
+	int error;
+	hls_p hls;
+	size_t mem_size;
+
+	if (NULL == s || NULL == hls_ret ||
+	    HLS_SEG_COUNT_MIN > s->seg_count || 0 == s->seg_duration ||
+	    MPEG2_TS_PKT_SIZE_188 > s->seg_size_max)
+		return (EINVAL);
+	hls = calloc(1, (sizeof(hls_t) + (s->seg_count * sizeof(hls_seg_t)) +
+	    ((s->seg_count + HLS_SLOT_SPARE) * sizeof(uint32_t))));
+	if (NULL == hls)
+		return (ENOMEM);
+	memcpy(&hls->s, s, sizeof(hls_settings_t));
+	/* Slot hold whole TS packets. */
+	hls->s.seg_size_max -= (hls->s.seg_size_max % MPEG2_TS_PKT_SIZE_188);
+	hls->seg = (hls_seg_p)(hls + 1);
+	hls->slot_refs = (uint32_t*)(hls->seg + hls->s.seg_count);
+	hls->slot_count = (hls->s.seg_count + HLS_SLOT_SPARE);
+	hls->cut_pid = HLS_PID_NONE;
+	mem_size = (hls->slot_count * hls->s.seg_size_max);
+#ifdef __linux__ /* Linux specific code. */
+	hls->fd = (uintptr_t)memfd_create("msd_hls", MFD_CLOEXEC);
+#else
+	hls->fd = (uintptr_t)shm_open(SHM_ANON, (O_RDWR | O_CLOEXEC), 0600);
+#endif
+	if ((uintptr_t)-1 == hls->fd) {
+		error = errno;
+		goto err_out;
+	}
+	if (0 != ftruncate((int)hls->fd, (off_t)mem_size)) {
+		error = errno;
+		goto err_out;
+	}
+	hls->mem = mmap(NULL, mem_size, (PROT_READ | PROT_WRITE), MAP_SHARED,
+	    (int)hls->fd, 0);
+	if (MAP_FAILED == hls->mem) {
+		hls->mem = NULL;
+		error = errno;
+		goto err_out;
+	}
+	hls->mem_size = mem_size;
+
+	(*hls_ret) = hls;
+
+	return (0);
+
+err_out:
+	hls_destroy(hls);
+	return (error);
+}
+
+void
+hls_destroy(hls_p hls) {
+
+	if (NULL == hls)
+		return;
+	if (NULL != hls->mem) {
+		munmap(hls->mem, hls->mem_size);
+	}
+	if ((uintptr_t)-1 != hls->fd) {
+		close((int)hls->fd);
+	}
+	free(hls);
+}
+
+
+/* Return section from PSI packet start, without CRC. */
+static const uint8_t *
+hls_ts_psi_get(const uint8_t *pkt, uint8_t table_id, size_t *size) {
+	size_t off, sec_size;
+
+	if (0 == HLS_TS_PUSI(pkt) || 0 == HLS_TS_HAS_PAYLOAD(pkt))
+		return (NULL);
+	off = 4;
+	if (HLS_TS_HAS_AF(pkt)) {
+		off += (1 + (size_t)pkt[4]);
+	}
+	if (MPEG2_TS_PKT_SIZE_188 <= off)
+		return (NULL);
+	off += (1 + (size_t)pkt[off]); /* Pointer field. */
+	if (MPEG2_TS_PKT_SIZE_188 < (off + 3) || table_id != pkt[off])
+		return (NULL);
+	sec_size = ((((size_t)(pkt[(off + 1)] & 0x0f)) << 8) | pkt[(off + 2)]);
+	/* Only single packet sections. */
+	if (9 > sec_size || MPEG2_TS_PKT_SIZE_188 < (off + 3 + sec_size))
+		return (NULL);
+	(*size) = (3 + sec_size - 4);
+
+	return ((pkt + off));
+}
+
+static void
+hls_pat_parse(hls_p hls, const uint8_t *pkt) {
+	const uint8_t *sec;
+	size_t i, sec_size;
+	uint16_t prog_num;
+
+	sec = hls_ts_psi_get(pkt, 0x00, &sec_size);
+	if (NULL == sec)
+		return;
+	for (i = 8; (i + 4) <= sec_size; i += 4) {
+		prog_num = ((((uint16_t)sec[i]) << 8) | sec[(i + 1)]);
+		if (0 == prog_num)
+			continue; /* Network PID. */
+		hls->pmt_pid = ((((uint16_t)(sec[(i + 2)] & 0x1f)) << 8) |
+		    sec[(i + 3)]);
+		memcpy(hls->pat, pkt, MPEG2_TS_PKT_SIZE_188);
+		return;
+	}
+}
+
+static void
+hls_pmt_parse(hls_p hls, const uint8_t *pkt) {
+	const uint8_t *sec;
+	size_t i, sec_size;
+	uint16_t pid, cut_pid = HLS_PID_NONE;
+	int video = 0;
+
+	sec = hls_ts_psi_get(pkt, 0x02, &sec_size);
+	if (NULL == sec || 12 > sec_size)
+		return;
+	i = (12 + ((((size_t)(sec[10] & 0x0f)) << 8) | sec[11]));
+	for (; (i + 5) <= sec_size;
+	    i += (5 + ((((size_t)(sec[(i + 3)] & 0x0f)) << 8) | sec[(i + 4)]))) {
+		pid = ((((uint16_t)(sec[(i + 1)] & 0x1f)) << 8) | sec[(i + 2)]);
+		switch (sec[i]) { /* stream_type */
+		case 0x01: /* MPEG1 video. */
+		case 0x02: /* MPEG2 video. */
+		case 0x10: /* MPEG4 part 2. */
+		case 0x1b: /* H.264 */
+		case 0x24: /* H.265 */
+		case 0x42: /* AVS */
+		case 0xea: /* VC-1 */
+			if (0 == video) {
+				cut_pid = pid;
+				video = 1;
+			}
+			break;
+		default:
+			if (HLS_PID_NONE == cut_pid) {
+				cut_pid = pid;
+			}
+		}
+	}
+	if (HLS_PID_NONE == cut_pid)
+		return;
+	hls->cut_pid = cut_pid;
+	hls->cut_pid_video = video;
+	memcpy(hls->pmt, pkt, MPEG2_TS_PKT_SIZE_188);
+}
+
+static int
+hls_seg_open(hls_p hls, uint64_t time_ms) {
+	hls_seg_p seg;
+	uint8_t *mem;
+	uint32_t i, slot = 0;
+
+	seg = &hls->seg[((hls->seq + 1) % hls->s.seg_count)];
+	if (0 != seg->seq) { /* Old segment gone, slot free if not pinned. */
+		hls->slot_refs[seg->slot] --;
+		seg->seq = 0;
+	}
+	for (i = 0; i < hls->slot_count; i ++) {
+		slot = ((hls->slot_next + i) % hls->slot_count);
+		if (0 == hls->slot_refs[slot])
+			break;
+	}
+	if (i == hls->slot_count) {
+		hls->slot_wait = 1;
+		return (EBUSY); /* All pinned by slow clients. */
+	}
+	hls->slot_next = ((slot + 1) % hls->slot_count);
+	hls->slot_refs[slot] ++;
+	hls->slot_wait = 0;
+	hls->seq ++;
+	hls->seg_start = time_ms;
+	seg->seq = hls->seq;
+	seg->size = 0;
+	seg->duration = 0;
+	seg->slot = slot;
+	/* Decoder need PAT + PMT before any data. */
+	mem = (hls->mem + (slot * hls->s.seg_size_max));
+	if (0 != hls->pat[0]) {
+		memcpy((mem + seg->size), hls->pat, MPEG2_TS_PKT_SIZE_188);
+		seg->size += MPEG2_TS_PKT_SIZE_188;
+	}
+	if (0 != hls->pmt[0]) {
+		memcpy((mem + seg->size), hls->pmt, MPEG2_TS_PKT_SIZE_188);
+		seg->size += MPEG2_TS_PKT_SIZE_188;
+	}
+
+	return (0);
+}
+
+static void
+hls_seg_close(hls_p hls, uint64_t time_ms) {
+	hls_seg_p seg = &hls->seg[(hls->seq % hls->s.seg_count)];
+
+	seg->duration = MAX(1, (time_ms - hls->seg_start));
+}
+
+void
+hls_write(hls_p hls, const uint8_t *buf, size_t buf_size, uint64_t time_ms) {
+	const uint8_t *pkt;
+	size_t off;
+	uint16_t pid;
+	uint64_t elapsed;
+	hls_seg_p seg;
+	int rap, pes_start;
+
+	if (NULL == hls || NULL == buf)
+		return;
+	for (off = 0; (off + MPEG2_TS_PKT_SIZE_188) <= buf_size;) {
+		pkt = (buf + off);
+		if (0x47 != pkt[0]) { /* Resync. */
+			off ++;
+			continue;
+		}
+		off += MPEG2_TS_PKT_SIZE_188;
+		pid = HLS_TS_PID(pkt);
+		if (0 == pid) {
+			hls_pat_parse(hls, pkt);
+		} else if (0 != hls->pmt_pid && hls->pmt_pid == pid) {
+			hls_pmt_parse(hls, pkt);
+		}
+		if (HLS_PID_NONE == hls->cut_pid)
+			continue; /* Wait PMT. */
+		pes_start = (pid == hls->cut_pid && HLS_TS_PUSI(pkt));
+		rap = (pes_start &&
+		    (HLS_TS_RAI(pkt) || 0 == hls->cut_pid_video));
+		if (0 == hls->seq || 0 != hls->slot_wait) {
+			/* First segment start from RAP. */
+			if (0 == rap || 0 != hls_seg_open(hls, time_ms))
+				continue;
+		} else {
+			seg = &hls->seg[(hls->seq % hls->s.seg_count)];
+			elapsed = (time_ms - hls->seg_start);
+			if ((seg->size + MPEG2_TS_PKT_SIZE_188) > hls->s.seg_size_max ||
+			    (0 != rap && elapsed >= hls->s.seg_duration) ||
+			    (0 != pes_start &&
+			    elapsed >= (HLS_FORCE_CUT_MUL * (uint64_t)hls->s.seg_duration))) {
+				hls_seg_close(hls, time_ms);
+				if (0 != hls_seg_open(hls, time_ms))
+					continue;
+			}
+		}
+		seg = &hls->seg[(hls->seq % hls->s.seg_count)];
+		memcpy((hls->mem + (seg->slot * hls->s.seg_size_max) +
+		    seg->size), pkt, MPEG2_TS_PKT_SIZE_188);
+		seg->size += MPEG2_TS_PKT_SIZE_188;
+	}
+}
+
+
+size_t
+hls_playlist_size_max(hls_settings_p s, size_t args_size) {
+
+	if (NULL == s)
+		return (0);
+	return (128 + (s->seg_count * (64 + args_size)));
+}
+
+int
+hls_playlist_gen(hls_p hls, const uint8_t *args, size_t args_size,
+    io_buf_p buf) {
+	uint64_t seq, first, target = 0;
+	hls_seg_p seg;
+
+	if (NULL == hls || NULL == buf)
+		return (EINVAL);
+	if (2 > hls->seq)
+		return (ENOENT); /* No complete segments. */
+	/*
+	 * Writing slot and two margin slots excluded: segment stay
+	 * available for late requests after leaving playlist.
+	 */
+	first = (hls->seq - 1);
+	while (1 < first &&
+	    (hls->seq - first) < (hls->s.seg_count - 3) &&
+	    hls->seg[((first - 1) % hls->s.seg_count)].seq == (first - 1)) {
+		first --;
+	}
+	for (seq = first; seq < hls->seq; seq ++) {
+		seg = &hls->seg[(seq % hls->s.seg_count)];
+		target = MAX(target, seg->duration);
+	}
+	target = MAX(target, hls->s.seg_duration);
+	io_buf_printf(buf,
+	    "#EXTM3U\r\n"
+	    "#EXT-X-VERSION:3\r\n"
+	    "#EXT-X-TARGETDURATION:%"PRIu64"\r\n"
+	    "#EXT-X-MEDIA-SEQUENCE:%"PRIu64"\r\n",
+	    ((target + 999) / 1000), first);
+	for (seq = first; seq < hls->seq; seq ++) {
+		seg = &hls->seg[(seq % hls->s.seg_count)];
+		io_buf_printf(buf,
+		    "#EXTINF:%"PRIu64".%03"PRIu64",\r\n"
+		    "%"PRIu64".ts%s%.*s\r\n",
+		    (seg->duration / 1000), (seg->duration % 1000), seq,
+		    ((0 != args_size) ? "?" : ""), (int)args_size,
+		    ((NULL != args) ? (const char*)args : ""));
+	}
+
+	return (0);
+}
+
+int
+hls_seg_get(hls_p hls, uint64_t seq, uintptr_t *fd, off_t *off,
+    size_t *size) {
+	hls_seg_p seg;
+
+	if (NULL == hls || 0 == seq)
+		return (EINVAL);
+	seg = &hls->seg[(seq % hls->s.seg_count)];
+	if (seq != seg->seq || 0 == seg->duration)
+		return (ENOENT);
+	if (NULL != fd) {
+		(*fd) = hls->fd;
+	}
+	if (NULL != off) {
+		(*off) = (off_t)(seg->slot * hls->s.seg_size_max);
+	}
+	if (NULL != size) {
+		(*size) = seg->size;
+	}
+
+	return (0);
+}
+
+int
+hls_seg_pin(hls_p hls, uint64_t seq, uint32_t *slot, size_t *size) {
+	hls_seg_p seg;
+
+	if (NULL == hls || 0 == seq || NULL == slot)
+		return (EINVAL);
+	seg = &hls->seg[(seq % hls->s.seg_count)];
+	if (seq != seg->seq || 0 == seg->duration)
+		return (ENOENT);
+	hls->slot_refs[seg->slot] ++;
+	(*slot) = seg->slot;
+	if (NULL != size) {
+		(*size) = seg->size;
+	}
+
+	return (0);
+}
+
+void
+hls_slot_unpin(hls_p hls, uint32_t slot) {
+
+	if (NULL == hls || slot >= hls->slot_count ||
+	    0 == hls->slot_refs[slot])
+		return;
+	hls->slot_refs[slot] --;
+}
+
+int
+hls_slot_get(hls_p hls, uint32_t slot, uintptr_t *fd, off_t *off) {
+
+	if (NULL == hls || slot >= hls->slot_count)
+		return (EINVAL);
+	if (NULL != fd) {
+		(*fd) = hls->fd;
+	}
+	if (NULL != off) {
+		(*off) = (off_t)(slot * hls->s.seg_size_max);
+	}
+
+	return (0);
+}
@@ -0,0 +1,91 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+
+
+#ifndef __MSD_HLS_H__
+#define __MSD_HLS_H__
+
+#include <sys/types.h>
+#include <inttypes.h>
+
+#include "utils/io_buf.h"
+
+
+/*
+ * HLS segmenter: cut MPEG2-TS stream at random access points into fixed
+ * ring of segment slots in one memfd, so segments can be sendfile()'d.
+ * Each segment start with last PAT + PMT.
+ * Slot pinned by sender is not reused until unpin: sendfile() pages may
+ * stay in socket buf after send, spare slots used meanwhile.
+ * Not thread safe: all calls from hub thread.
+ */
+
+typedef struct hls_s	*hls_p;
+
+typedef struct hls_settings_s {
+	uint32_t	seg_count;	/* Segment slots in ring. */
+	uint32_t	seg_duration;	/* Target segment duration, ms. */
+	size_t		seg_size_max;	/* Segment slot size, bytes. */
+} hls_settings_t, *hls_settings_p;
+/* Default values. */
+#define HLS_S_DEF_SEG_COUNT		(6)
+#define HLS_S_DEF_SEG_DURATION		(2)	/* s */
+#define HLS_S_DEF_SEG_SIZE_MAX		(4096)	/* kb */
+#define HLS_SEG_COUNT_MIN		(5)	/* 2 in playlist + writing + 2 margin. */
+#define HLS_SLOT_SPARE			(2)	/* Extra slots for pinned segments. */
+
+void	hls_settings_def(hls_settings_p p_ret);
+
+int	hls_create(hls_settings_p s, hls_p *hls_ret);
+void	hls_destroy(hls_p hls);
+
+/* Feed TS packets, time_ms: monotonic arrival time. */
+void	hls_write(hls_p hls, const uint8_t *buf, size_t buf_size,
+	    uint64_t time_ms);
+
+/* Live playlist, segment URIs: SEQ.ts[?args]. ENOENT: no segments yet. */
+size_t	hls_playlist_size_max(hls_settings_p s, size_t args_size);
+int	hls_playlist_gen(hls_p hls, const uint8_t *args, size_t args_size,
+	    io_buf_p buf);
+
+/*
+ * Segment location in fd, ENOENT: not ready or already overwritten.
+ * Recheck while sending: slot reused when ring wraps.
+ */
+int	hls_seg_get(hls_p hls, uint64_t seq, uintptr_t *fd, off_t *off,
+	    size_t *size);
+/* Pin segment slot for send, ENOENT: not ready or already overwritten. */
+int	hls_seg_pin(hls_p hls, uint64_t seq, uint32_t *slot, size_t *size);
+void	hls_slot_unpin(hls_p hls, uint32_t slot);
+/* Pinned slot location in fd. */
+int	hls_slot_get(hls_p hls, uint32_t slot, uintptr_t *fd, off_t *off);
+
+
+#endif /* __MSD_HLS_H__ */
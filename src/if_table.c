@@ -0,0 +1,445 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <net/if.h>
+#ifdef __linux__ /* Linux specific code. */
+#	include <linux/netlink.h>
+#	include <linux/rtnetlink.h>
+#else
+#	include <net/route.h>
+#endif
+
+#include <stdlib.h> /* malloc, exit */
+#include <unistd.h> /* close, write, sysconf */
+#include <inttypes.h>
+#include <string.h> /* bcopy, bzero, memcpy, memmove, memset, strerror... */
+#include <pthread.h>
+#include <errno.h>
+#include <syslog.h>
+
+#include "utils/macro.h"
+#include "threadpool/threadpool.h"
+#include "threadpool/threadpool_task.h"
+#include "if_table.h"
+
+
+#define IF_TABLE_RCV_BUF_SIZE	16384
+#define IF_TABLE_LINK_UP(__flags)					\
+	((IFF_UP | IFF_RUNNING) == ((IFF_UP | IFF_RUNNING) & (__flags)))
+
+typedef struct if_table_ent_s {
+	uint32_t	index;
+	uint32_t	flags;		/* IFF_*. */
+	char		name[IFNAMSIZ];
+} if_table_ent_t, *if_table_ent_p;
+
+typedef struct if_table_s {
+	pthread_rwlock_t rwlock;
+	if_table_ent_p	ent;
+	size_t		count;
+	size_t		allocated;
+	tp_task_p	tptask;		/* Routing socket. */
+	if_table_link_cb link_cb;
+	void		*udata;
+	int		running;	/* Set only before thread pool start. */
+} if_table_t;
+
+static if_table_t g_ift;
+
+
+static int	if_table_fill(void);
+static if_table_ent_p if_table_find(uint32_t if_index);
+static int	if_table_update(uint32_t if_index, const char *if_name,
+		    size_t if_name_size, uint32_t flags, int flags_valid);
+static void	if_table_del(uint32_t if_index);
+static void	if_table_msg_process(uint8_t *buf, size_t buf_size);
+static int	if_table_rcv_cb(tp_task_p tptask, int error, uint32_t eof,
+		    size_t data2transfer_size, void *arg);
+
+
+
+int
+if_table_create(tp_p tp, if_table_link_cb link_cb, void *udata) {
+	int error;
+	uintptr_t skt;
+#ifdef __linux__ /* Linux specific code. */
+	struct sockaddr_nl snl;
+#endif
+
+	if (NULL == tp)
+		return (EINVAL);
+	if (0 != g_ift.running)
+		return (EEXIST);
+	error = pthread_rwlock_init(&g_ift.rwlock, NULL);
+	if (0 != error)
+		return (error);
+	g_ift.link_cb = link_cb;
+	g_ift.udata = udata;
+	/* Open socket before fill: do not miss changes. */
+#ifdef __linux__ /* Linux specific code. */
+	skt = (uintptr_t)socket(AF_NETLINK,
+	    (SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC), NETLINK_ROUTE);
+	if ((uintptr_t)-1 == skt) {
+		error = errno;
+		goto err_out;
+	}
+	memset(&snl, 0x00, sizeof(snl));
+	snl.nl_family = AF_NETLINK;
+	snl.nl_groups = RTMGRP_LINK;
+	if (0 != bind((int)skt, (struct sockaddr*)&snl, sizeof(snl))) {
+		error = errno;
+		goto err_out;
+	}
+#else
+	skt = (uintptr_t)socket(PF_ROUTE,
+	    (SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC), AF_UNSPEC);
+	if ((uintptr_t)-1 == skt) {
+		error = errno;
+		goto err_out;
+	}
+#endif
+	error = if_table_fill();
+	if (0 != error)
+		goto err_out;
+	error = tp_task_notify_create(tp_thread_get_rr(tp), skt,
+	    TP_TASK_F_CLOSE_ON_DESTROY, TP_EV_READ, 0, if_table_rcv_cb,
+	    NULL, &g_ift.tptask);
+	if (0 != error)
+		goto err_out;
+	g_ift.running = 1;
+
+	return (0);
+
+err_out:
+	if ((uintptr_t)-1 != skt) {
+		close((int)skt);
+	}
+	free(g_ift.ent);
+	g_ift.ent = NULL;
+	g_ift.count = 0;
+	g_ift.allocated = 0;
+	pthread_rwlock_destroy(&g_ift.rwlock);
+	return (error);
+}
+
+/* Call after thread pool stopped. */
+void
+if_table_destroy(void) {
+
+	if (0 == g_ift.running)
+		return;
+	g_ift.running = 0;
+	tp_task_destroy(g_ift.tptask);
+	free(g_ift.ent);
+	pthread_rwlock_destroy(&g_ift.rwlock);
+	memset(&g_ift, 0x00, sizeof(g_ift));
+}
+
+
+uint32_t
+if_table_index_get(const char *if_name) {
+	uint32_t ret = 0;
+
+	if (NULL == if_name)
+		return (0);
+	if (0 == g_ift.running)
+		return (if_nametoindex(if_name));
+	pthread_rwlock_rdlock(&g_ift.rwlock);
+	for (size_t i = 0; i < g_ift.count; i ++) {
+		if (0 != strncmp(g_ift.ent[i].name, if_name, IFNAMSIZ))
+			continue;
+		ret = g_ift.ent[i].index;
+		break;
+	}
+	pthread_rwlock_unlock(&g_ift.rwlock);
+
+	return (ret);
+}
+
+char *
+if_table_name_get(uint32_t if_index, char *if_name) {
+	if_table_ent_p ent;
+	char *ret = NULL;
+
+	if (NULL == if_name)
+		return (NULL);
+	if (0 == g_ift.running)
+		return (if_indextoname(if_index, if_name));
+	pthread_rwlock_rdlock(&g_ift.rwlock);
+	ent = if_table_find(if_index);
+	if (NULL != ent) {
+		memcpy(if_name, ent->name, IFNAMSIZ);
+		ret = if_name;
+	}
+	pthread_rwlock_unlock(&g_ift.rwlock);
+
+	return (ret);
+}
+
+/* Unknown state = up. */
+int
+if_table_is_up(uint32_t if_index) {
+	if_table_ent_p ent;
+	int ret = 1;
+
+	if (0 == g_ift.running)
+		return (1);
+	pthread_rwlock_rdlock(&g_ift.rwlock);
+	ent = if_table_find(if_index);
+	if (NULL != ent) {
+		ret = IF_TABLE_LINK_UP(ent->flags);
+	}
+	pthread_rwlock_unlock(&g_ift.rwlock);
+
+	return (ret);
+}
+
+
+/* Read all interfaces: once on start and on routing socket overflow. */
+static int
+if_table_fill(void) {
+	int skt;
+	struct if_nameindex *ifni, *ifn;
+	struct ifreq ifr;
+	uint32_t flags;
+
+	ifni = if_nameindex();
+	if (NULL == ifni)
+		return (errno);
+	skt = socket(AF_INET, (SOCK_DGRAM | SOCK_CLOEXEC), 0);
+	for (ifn = ifni; 0 != ifn->if_index && NULL != ifn->if_name; ifn ++) {
+		flags = (IFF_UP | IFF_RUNNING); /* Assume up if unknown. */
+		memset(&ifr, 0x00, sizeof(ifr));
+		strncpy(ifr.ifr_name, ifn->if_name, (sizeof(ifr.ifr_name) - 1));
+		if (-1 != skt &&
+		    0 == ioctl(skt, SIOCGIFFLAGS, &ifr)) {
+			flags = (0xffff & (uint32_t)ifr.ifr_flags);
+		}
+		if_table_update(ifn->if_index, ifn->if_name,
+		    strnlen(ifn->if_name, IFNAMSIZ), flags, 1);
+	}
+	if (-1 != skt) {
+		close(skt);
+	}
+	if_freenameindex(ifni);
+
+	return (0);
+}
+
+/* Must be called with lock held. */
+static if_table_ent_p
+if_table_find(uint32_t if_index) {
+
+	for (size_t i = 0; i < g_ift.count; i ++) {
+		if (if_index == g_ift.ent[i].index)
+			return (&g_ift.ent[i]);
+	}
+	return (NULL);
+}
+
+/* Add/update interface, call link_cb if link state changed. */
+static int
+if_table_update(uint32_t if_index, const char *if_name,
+    size_t if_name_size, uint32_t flags, int flags_valid) {
+	int error = 0, was_up, is_up = 1, changed = 0;
+	if_table_ent_p ent;
+	char name[IFNAMSIZ];
+
+	if (0 == if_index)
+		return (EINVAL);
+	pthread_rwlock_wrlock(&g_ift.rwlock);
+	ent = if_table_find(if_index);
+	if (NULL == ent) {
+		if (g_ift.count == g_ift.allocated) {
+			ent = reallocarray(g_ift.ent, (g_ift.allocated + 16),
+			    sizeof(if_table_ent_t));
+			if (NULL == ent) {
+				error = ENOMEM;
+				goto err_out;
+			}
+			g_ift.ent = ent;
+			g_ift.allocated += 16;
+		}
+		ent = &g_ift.ent[g_ift.count];
+		memset(ent, 0x00, sizeof(if_table_ent_t));
+		ent->index = if_index;
+		ent->flags = (IFF_UP | IFF_RUNNING);
+		g_ift.count ++;
+	}
+	if (NULL != if_name && 0 != if_name_size) {
+		if_name_size = MIN((IFNAMSIZ - 1), if_name_size);
+		memcpy(ent->name, if_name, if_name_size);
+		ent->name[if_name_size] = 0;
+	}
+	if (0 != flags_valid) {
+		was_up = IF_TABLE_LINK_UP(ent->flags);
+		is_up = IF_TABLE_LINK_UP(flags);
+		changed = (was_up != is_up);
+		ent->flags = flags;
+	}
+	memcpy(name, ent->name, IFNAMSIZ);
+err_out:
+	pthread_rwlock_unlock(&g_ift.rwlock);
+	if (0 == error && 0 != changed) {
+		syslog(LOG_NOTICE, "%s: link %s.", name,
+		    ((0 != is_up) ? "up" : "down"));
+		if (NULL != g_ift.link_cb) {
+			g_ift.link_cb(if_index, is_up, g_ift.udata);
+		}
+	}
+
+	return (error);
+}
+
+static void
+if_table_del(uint32_t if_index) {
+	if_table_ent_p ent;
+
+	pthread_rwlock_wrlock(&g_ift.rwlock);
+	ent = if_table_find(if_index);
+	if (NULL != ent) {
+		g_ift.count --;
+		memmove(ent, (ent + 1),
+		    ((size_t)(&g_ift.ent[g_ift.count] - ent) * sizeof(if_table_ent_t)));
+	}
+	pthread_rwlock_unlock(&g_ift.rwlock);
+}
+
+
+#ifdef __linux__ /* Linux specific code. */
+static void
+if_table_msg_process(uint8_t *buf, size_t buf_size) {
+	struct nlmsghdr *nlh;
+	struct ifinfomsg *ifi;
+	struct rtattr *rta;
+	int len = (int)buf_size, attr_len;
+	const char *name;
+	size_t name_size;
+
+	for (nlh = (struct nlmsghdr*)(void*)buf; NLMSG_OK(nlh, len);
+	    nlh = NLMSG_NEXT(nlh, len)) {
+		if (RTM_NEWLINK != nlh->nlmsg_type &&
+		    RTM_DELLINK != nlh->nlmsg_type)
+			continue;
+		if (NLMSG_LENGTH(sizeof(struct ifinfomsg)) > nlh->nlmsg_len)
+			continue;
+		ifi = NLMSG_DATA(nlh);
+		if (0 >= ifi->ifi_index)
+			continue;
+		if (RTM_DELLINK == nlh->nlmsg_type) {
+			if_table_del((uint32_t)ifi->ifi_index);
+			continue;
+		}
+		name = NULL;
+		name_size = 0;
+		attr_len = (int)IFLA_PAYLOAD(nlh);
+		for (rta = IFLA_RTA(ifi); RTA_OK(rta, attr_len);
+		    rta = RTA_NEXT(rta, attr_len)) {
+			if (IFLA_IFNAME != rta->rta_type)
+				continue;
+			name = RTA_DATA(rta);
+			name_size = strnlen(name, RTA_PAYLOAD(rta));
+			break;
+		}
+		if_table_update((uint32_t)ifi->ifi_index, name, name_size,
+		    ifi->ifi_flags, 1);
+	}
+}
+#else
+static void
+if_table_msg_process(uint8_t *buf, size_t buf_size) {
+	struct rt_msghdr *rtm;
+	struct if_msghdr *ifm;
+	struct if_announcemsghdr *ifan;
+	char name[IFNAMSIZ];
+	size_t off;
+
+	for (off = 0; (off + sizeof(struct rt_msghdr)) <= buf_size;
+	    off += rtm->rtm_msglen) {
+		rtm = (struct rt_msghdr*)(void*)(buf + off);
+		if (0 == rtm->rtm_msglen ||
+		    (off + rtm->rtm_msglen) > buf_size)
+			break;
+		switch (rtm->rtm_type) {
+		case RTM_IFINFO:
+			ifm = (struct if_msghdr*)(void*)rtm;
+			/* Name not in message, link events are rare. */
+			if (NULL == if_indextoname(ifm->ifm_index, name)) {
+				name[0] = 0;
+			}
+			if_table_update(ifm->ifm_index, name,
+			    strnlen(name, IFNAMSIZ), (uint32_t)ifm->ifm_flags, 1);
+			break;
+		case RTM_IFANNOUNCE:
+			ifan = (struct if_announcemsghdr*)(void*)rtm;
+			if (IFAN_DEPARTURE == ifan->ifan_what) {
+				if_table_del(ifan->ifan_index);
+				break;
+			}
+			if_table_update(ifan->ifan_index, ifan->ifan_name,
+			    strnlen(ifan->ifan_name, IFNAMSIZ), 0, 0);
+			break;
+		}
+	}
+}
+#endif
+
+static int
+if_table_rcv_cb(tp_task_p tptask, int error, uint32_t eof __unused,
+    size_t data2transfer_size __unused, void *arg __unused) {
+	uint64_t buf[(IF_TABLE_RCV_BUF_SIZE / sizeof(uint64_t))]; /* Aligned. */
+	ssize_t ios;
+
+	if (0 != error) {
+		SYSLOG_ERR(LOG_ERR, error, "On routing socket.");
+		return (TP_TASK_CB_CONTINUE);
+	}
+	for (;;) {
+		ios = recv((int)tp_task_ident_get(tptask), buf, sizeof(buf),
+		    MSG_DONTWAIT);
+		if (-1 == ios) {
+			if (ENOBUFS == errno) { /* Messages lost: re read all. */
+				syslog(LOG_NOTICE, "Routing socket overflow, re read interfaces.");
+				if_table_fill();
+				continue;
+			}
+			break;
+		}
+		if (0 == ios)
+			break;
+		if_table_msg_process((uint8_t*)buf, (size_t)ios);
+	}
+
+	return (TP_TASK_CB_CONTINUE);
+}
@@ -0,0 +1,61 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+
+#ifndef __MSD_IF_TABLE_H__
+#define __MSD_IF_TABLE_H__
+
+#include <sys/types.h>
+#include <inttypes.h>
+
+#include "threadpool/threadpool.h"
+
+
+/*
+ * Network interfaces table: name, index and link state.
+ * Filled once on create and then updated from routing socket
+ * (rtnetlink on Linux), so lookups do not do syscalls.
+ * Without table (not created or failed) lookups fall back to
+ * if_nametoindex() / if_indextoname().
+ */
+
+/* Called from thread pool thread on link state change. */
+typedef void (*if_table_link_cb)(uint32_t if_index, int up, void *udata);
+
+
+int	if_table_create(tp_p tp, if_table_link_cb link_cb, void *udata);
+void	if_table_destroy(void);
+
+/* Same as if_nametoindex() / if_indextoname(). */
+uint32_t if_table_index_get(const char *if_name);
+char	*if_table_name_get(uint32_t if_index, char *if_name);
+int	if_table_is_up(uint32_t if_index);
+
+
+#endif // __MSD_IF_TABLE_H__
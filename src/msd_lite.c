@@ -71,6 +71,8 @@
 #include "utils/cmd_line_daemon.h"
 #include "utils/sys_res_limits_xml.h"
 #include "msd_lite_stat_text.h"
+#include "handoff.h"
+#include "if_table.h"
 
 
 
@@ -92,14 +94,31 @@ struct prog_settings {
 	info_sysres_t sysres;	/* System resources statistic data. */
 
 
-	str_hub_settings_t	hub_params; /* Stream hub params. */
-	str_src_settings_t	src_params; /* Stream hub source params. */
-	str_src_conn_params_t	src_conn_params; /* Stream hub source connection params. */
-
-	uintptr_t	log_fd;		// log file descriptor
+	access_log_settings_t	alog_params; /* Access log settings. */
+	access_log_p	alog;		/* Access log. */
+	tshift_writer_settings_t tsw_params; /* Time-shift writer settings. */
+	tshift_writer_p	tsw;		/* Time-shift writer. */
+	rec_writer_settings_t rw_params; /* Recordings settings. */
+	rec_writer_p	rw;		/* Recordings I/O thread. */
+	udp_push_settings_t push_params; /* UDP push outputs senders. */
+	char		handoff_file[1024]; /* Unix socket for zero downtime upgrade. */
+	handoff_p	handoff;	/* Handoff listener. */
+	volatile int	handed_off;	/* Clients passed to new process. */
+	const char	*cfg_file_name;	/* For reload. */
+	tp_udata_t	reload_tmr;	/* SIGHUP poll timer. */
 };
+static volatile sig_atomic_t msd_reload_pending = 0;
 static struct prog_settings g_data;
 
+/* Reloadable part of config, copied by stream hubs bucket. */
+typedef struct msd_settings_s {
+	str_hub_prof_p	prof;		/* Profiles, first is default. */
+	size_t		prof_count;
+	str_hub_chan_p	chan;		/* Channel map. */
+	size_t		chan_count;
+	str_hubs_limits_t limits;	/* Admission control. */
+} msd_settings_t, *msd_settings_p;
+
 int		msd_http_cust_hdrs_load(const uint8_t *buf, size_t buf_size,
 		    uint8_t **hdrs, size_t *hdrs_size_ret);
 int		msd_hub_profile_load(const uint8_t *data, size_t data_size,
@@ -108,21 +127,67 @@ int		msd_src_profile_load(const uint8_t *data, size_t data_size,
 		    str_src_settings_p params);
 int		msd_src_conn_profile_load(const uint8_t *data, size_t data_size,
 		    void *conn_params);
+int		msd_limits_load(const uint8_t *data, size_t data_size,
+		    str_hubs_limits_p limits);
+int		msd_access_log_load(const uint8_t *data, size_t data_size,
+		    access_log_settings_p params);
+int		msd_tshift_writer_load(const uint8_t *data, size_t data_size,
+		    tshift_writer_settings_p params);
+int		msd_rec_writer_load(const uint8_t *data, size_t data_size,
+		    rec_writer_settings_p params);
+static void	msd_rec_start_cfg(const uint8_t *data, size_t data_size);
+static int	msd_http_srv_rec_ctl(http_srv_cli_p cli, http_srv_req_p req,
+		    http_srv_resp_p resp);
+int		msd_udp_push_load(const uint8_t *data, size_t data_size,
+		    udp_push_settings_p params);
+static void	msd_udp_push_start_cfg(const uint8_t *data, size_t data_size);
+static int	msd_http_srv_push_ctl(http_srv_cli_p cli, http_srv_req_p req,
+		    http_srv_resp_p resp);
+int		msd_src_ranges_load(const uint8_t *data, size_t data_size,
+		    str_hub_prof_range_p *ranges_ret, size_t *ranges_count_ret);
+static int	msd_cfg_prof_find(const uint8_t *cfg_file_buf,
+		    size_t cfg_file_buf_size, const char *list_name,
+		    const char *item_name, const uint8_t *name, size_t name_size,
+		    const uint8_t **data, size_t *data_size);
+int		msd_chan_load(const uint8_t *data, size_t data_size,
+		    str_hub_chan_p chan);
+static int	msd_settings_load(const uint8_t *cfg_file_buf,
+		    size_t cfg_file_buf_size, msd_settings_p settings);
+static void	msd_settings_free(msd_settings_p settings);
+int		msd_reload(void);
+static void	msd_sighup_handler(int sig);
+static void	msd_reload_tmr_cb(tp_event_p ev, tp_udata_p tp_udata);
 
 
 
 int		msd_http_srv_hub_attach(http_srv_cli_p cli,
 		    uint8_t *hub_name, size_t hub_name_size,
-		    str_src_conn_params_p src_conn_params);
-uint32_t	msd_http_req_url_parse(http_srv_req_p req,
-		    struct sockaddr_storage *ssaddr,
-		    uint32_t *if_index, uint32_t *rejoin_time,
+		    str_hub_prof_p prof, str_src_conn_params_p src_conn_params);
+uint32_t	msd_http_req_url_parse(http_srv_req_p req, size_t path_size,
+		    str_src_conn_params_p src_conn_params,
 		    uint8_t *hub_name, size_t hub_name_size,
 		    size_t *hub_name_size_ret);
 
 
 static int	msd_http_srv_on_req_rcv_cb(http_srv_cli_p cli, void *udata,
 		    http_srv_req_p req, http_srv_resp_p resp);
+static int	msd_http_srv_hub_req(http_srv_cli_p cli, http_srv_req_p req,
+		    http_srv_resp_p resp, str_hubs_settings_p settings,
+		    str_hub_prof_p prof, uint8_t *hub_name, size_t hub_name_size,
+		    str_src_conn_params_p src_conn_params);
+static int	msd_http_hls_path_parse(const uint8_t *path, size_t *path_size,
+		    size_t prefix_size, uint64_t *seq);
+static int	msd_http_srv_hls_req(http_srv_cli_p cli, http_srv_req_p req,
+		    http_srv_resp_p resp, str_hubs_settings_p settings,
+		    str_hub_prof_p prof, uint8_t *hub_name, size_t hub_name_size,
+		    str_src_conn_params_p src_conn_params, uint64_t seq);
+static int	msd_http_playlist_gen(http_srv_cli_p cli, http_srv_req_p req,
+		    str_hubs_settings_p settings);
+
+static void	msd_handoff_req_cb(uintptr_t skt, void *udata);
+static void	msd_if_link_cb(uint32_t if_index, int up, void *udata);
+static void	msd_handoff_done_cb(tpt_p tpt, size_t send_msg_cnt,
+		    size_t error_cnt, void *udata);
 
 
 #define MSD_CFG_CALC_VAL_COUNT(args...)					\
@@ -213,9 +278,52 @@ msd_hub_profile_load(const uint8_t *data, size_t data_size, str_hub_settings_p p
 	    (const uint8_t*)"precache", NULL);
 	xml_get_val_size_t_args(data, data_size, NULL, &params->snd_block_min_size,
 	    (const uint8_t*)"sndBlockSize", NULL);
+	xml_get_val_uint64_args(data, data_size, NULL, &params->cli_lag_max,
+	    (const uint8_t*)"cliLagMax", NULL);
+	xml_get_val_uint32_args(data, data_size, NULL, &params->tcp_info_interval,
+	    (const uint8_t*)"tcpInfo", "interval", NULL);
+	xml_get_val_uint32_args(data, data_size, NULL, &params->tcp_info_per_tick,
+	    (const uint8_t*)"tcpInfo", "clientsPerTick", NULL);
 
 	xml_get_val_uint32_args(data, data_size, NULL, &params->skt_snd_buf,
 	    (const uint8_t*)"skt", "sndBuf", NULL);
+	if (0 == xml_get_val_args(data, data_size, NULL, NULL, NULL, &ptm, &tm,
+	    (const uint8_t*)"skt", "sndBufAuto", "fEnable", NULL)) {
+		yn_set_flag32(ptm, tm, STR_HUB_S_F_SKT_SND_BUF_AUTO, &params->flags);
+	}
+	xml_get_val_uint32_args(data, data_size, NULL, &params->skt_snd_buf_min,
+	    (const uint8_t*)"skt", "sndBufAuto", "min", NULL);
+	xml_get_val_uint32_args(data, data_size, NULL, &params->skt_snd_buf_max,
+	    (const uint8_t*)"skt", "sndBufAuto", "max", NULL);
+	xml_get_val_uint32_args(data, data_size, NULL, &params->skt_snd_buf_factor,
+	    (const uint8_t*)"skt", "sndBufAuto", "factor", NULL);
+
+	/* HLS. */
+	if (0 == xml_get_val_args(data, data_size, NULL, NULL, NULL, &ptm, &tm,
+	    (const uint8_t*)"hls", "fEnable", NULL)) {
+		yn_set_flag32(ptm, tm, STR_HUB_S_F_HLS, &params->flags);
+	}
+	xml_get_val_uint32_args(data, data_size, NULL, &params->hls.seg_count,
+	    (const uint8_t*)"hls", "segCount", NULL);
+	xml_get_val_uint32_args(data, data_size, NULL, &params->hls.seg_duration,
+	    (const uint8_t*)"hls", "segDuration", NULL);
+	xml_get_val_size_t_args(data, data_size, NULL, &params->hls.seg_size_max,
+	    (const uint8_t*)"hls", "segSizeMax", NULL);
+	xml_get_val_uint32_args(data, data_size, NULL, &params->hls_idle_timeout,
+	    (const uint8_t*)"hls", "idleTimeout", NULL);
+	/* Time-shift store. */
+	if (0 == xml_get_val_args(data, data_size, NULL, NULL, NULL, &ptm, &tm,
+	    (const uint8_t*)"timeShift", "fEnable", NULL)) {
+		yn_set_flag32(ptm, tm, STR_HUB_S_F_TSHIFT, &params->flags);
+	}
+	xml_get_val_size_t_args(data, data_size, NULL, &params->tshift.seg_size,
+	    (const uint8_t*)"timeShift", "segSize", NULL);
+	xml_get_val_uint32_args(data, data_size, NULL, &params->tshift.seg_count,
+	    (const uint8_t*)"timeShift", "segCount", NULL);
+	xml_get_val_size_t_args(data, data_size, NULL, &params->tshift.blk_size,
+	    (const uint8_t*)"timeShift", "blockSize", NULL);
+	xml_get_val_uint32_args(data, data_size, NULL, &params->tshift.queue_size,
+	    (const uint8_t*)"timeShift", "queueSize", NULL);
 
 	/* Load custom http headers. */
 	if (0 == xml_get_val_args(data, data_size, NULL, NULL, NULL,
@@ -228,6 +336,8 @@ msd_hub_profile_load(const uint8_t *data, size_t data_size, str_hub_settings_p p
 
 int
 msd_src_profile_load(const uint8_t *data, size_t data_size, str_src_settings_p params) {
+	const uint8_t *ptm;
+	size_t tm;
 
 	if (NULL == data || 0 == data_size || NULL == params)
 		return (EINVAL);
@@ -240,6 +350,72 @@ msd_src_profile_load(const uint8_t *data, size_t data_size, str_src_settings_p p
 	    (const uint8_t*)"skt", "rcvLoWatermark", NULL);
 	xml_get_val_uint64_args(data, data_size, NULL, &params->rcv_timeout,
 	    (const uint8_t*)"skt", "rcvTimeout", NULL);
+	if (0 == xml_get_val_args(data, data_size, NULL, NULL, NULL, &ptm, &tm,
+	    (const uint8_t*)"skt", "fUDPGRO", NULL)) {
+		yn_set_flag32(ptm, tm, STR_SRC_S_F_UDP_GRO, &params->flags);
+	}
+	if (0 == xml_get_val_args(data, data_size, NULL, NULL, NULL, &ptm, &tm,
+	    (const uint8_t*)"skt", "fRcvTimestamp", NULL)) {
+		yn_set_flag32(ptm, tm, STR_SRC_S_F_RCV_TIMESTAMP, &params->flags);
+	}
+	xml_get_val_uint32_args(data, data_size, NULL, &params->neg_cache_ttl,
+	    (const uint8_t*)"negCacheTTL", NULL);
+	/* Busy poll. */
+	xml_get_val_uint32_args(data, data_size, NULL, &params->busy_poll,
+	    (const uint8_t*)"busyPoll", "time", NULL);
+	xml_get_val_uint32_args(data, data_size, NULL, &params->busy_poll_budget,
+	    (const uint8_t*)"busyPoll", "budget", NULL);
+	if (0 == xml_get_val_args(data, data_size, NULL, NULL, NULL, &ptm, &tm,
+	    (const uint8_t*)"busyPoll", "fPrefer", NULL)) {
+		yn_set_flag32(ptm, tm, STR_SRC_S_F_BUSY_POLL_PREFER, &params->flags);
+	}
+	/* Packet ring. */
+	if (0 == xml_get_val_args(data, data_size, NULL, NULL, NULL, &ptm, &tm,
+	    (const uint8_t*)"packetRing", "fEnable", NULL)) {
+		yn_set_flag32(ptm, tm, STR_SRC_S_F_PKT_RING, &params->flags);
+	}
+	xml_get_val_uint32_args(data, data_size, NULL,
+	    &params->pkt_ring.block_size,
+	    (const uint8_t*)"packetRing", "blockSize", NULL);
+	xml_get_val_uint32_args(data, data_size, NULL,
+	    &params->pkt_ring.block_count,
+	    (const uint8_t*)"packetRing", "blockCount", NULL);
+	xml_get_val_uint32_args(data, data_size, NULL,
+	    &params->pkt_ring.block_timeout,
+	    (const uint8_t*)"packetRing", "blockTimeout", NULL);
+	/* HTTP pull source. */
+	if (0 == xml_get_val_args(data, data_size, NULL, NULL, NULL, &ptm, &tm,
+	    (const uint8_t*)"http", "fURLEnable", NULL)) {
+		yn_set_flag32(ptm, tm, STR_SRC_S_F_HTTP_URL, &params->flags);
+	}
+	xml_get_val_uint32_args(data, data_size, NULL,
+	    &params->http_conn_timeout,
+	    (const uint8_t*)"http", "connectTimeout", NULL);
+	xml_get_val_uint32_args(data, data_size, NULL,
+	    &params->http_retry_max,
+	    (const uint8_t*)"http", "retryMax", NULL);
+	xml_get_val_uint32_args(data, data_size, NULL,
+	    &params->http_fail_timeout,
+	    (const uint8_t*)"http", "failTimeout", NULL);
+	xml_get_val_uint32_args(data, data_size, NULL,
+	    &params->http_rcv_size,
+	    (const uint8_t*)"http", "rcvSize", NULL);
+	/* RTP retransmission. */
+	if (0 == xml_get_val_args(data, data_size, NULL, NULL, NULL, &ptm, &tm,
+	    (const uint8_t*)"rtpArq", "fEnable", NULL)) {
+		yn_set_flag32(ptm, tm, STR_SRC_S_F_RTP_ARQ, &params->flags);
+	}
+	xml_get_val_uint32_args(data, data_size, NULL, &params->arq.window,
+	    (const uint8_t*)"rtpArq", "window", NULL);
+	xml_get_val_uint32_args(data, data_size, NULL, &params->arq.delay,
+	    (const uint8_t*)"rtpArq", "delay", NULL);
+	xml_get_val_uint32_args(data, data_size, NULL, &params->arq.reorder,
+	    (const uint8_t*)"rtpArq", "reorder", NULL);
+	xml_get_val_uint32_args(data, data_size, NULL,
+	    &params->arq.nack_interval,
+	    (const uint8_t*)"rtpArq", "nackInterval", NULL);
+	xml_get_val_uint32_args(data, data_size, NULL, &params->arq.retries,
+	    (const uint8_t*)"rtpArq", "retries", NULL);
 
 	return (0);
 }
@@ -263,7 +439,7 @@ msd_src_conn_profile_load(const uint8_t *data, size_t data_size, void *conn) {
 	    &ptm, &tm, (const uint8_t*)"multicast", "ifName", NULL)) {
 		memcpy(if_name, ptm, MIN(IFNAMSIZ, tm));
 		if_name[MIN(IFNAMSIZ, tm)] = 0;
-		((str_src_conn_mc_p)conn)->if_index = if_nametoindex(if_name);
+		((str_src_conn_mc_p)conn)->if_index = if_table_index_get(if_name);
 	}
 	xml_get_val_uint32_args(data, data_size, NULL,
 	    &((str_src_conn_mc_p)conn)->rejoin_time,
@@ -272,6 +448,565 @@ msd_src_conn_profile_load(const uint8_t *data, size_t data_size, void *conn) {
 	return (0);
 }
 
+int
+msd_limits_load(const uint8_t *data, size_t data_size, str_hubs_limits_p limits) {
+
+	if (NULL == data || 0 == data_size || NULL == limits)
+		return (EINVAL);
+
+	/* Read from config. */
+	xml_get_val_uint32_args(data, data_size, NULL, &limits->hub_cli_max,
+	    (const uint8_t*)"hubClientsMax", NULL);
+	xml_get_val_uint32_args(data, data_size, NULL, &limits->hubs_max,
+	    (const uint8_t*)"hubsMax", NULL);
+	xml_get_val_uint64_args(data, data_size, NULL, &limits->thread_rate_out_max,
+	    (const uint8_t*)"threadRateOutMax", NULL);
+	xml_get_val_uint64_args(data, data_size, NULL, &limits->rate_out_max,
+	    (const uint8_t*)"rateOutMax", NULL);
+	xml_get_val_uint32_args(data, data_size, NULL, &limits->retry_after,
+	    (const uint8_t*)"retryAfter", NULL);
+
+	return (0);
+}
+
+int
+msd_access_log_load(const uint8_t *data, size_t data_size,
+    access_log_settings_p params) {
+	const uint8_t *ptm;
+	size_t tm;
+
+	if (NULL == data || 0 == data_size || NULL == params)
+		return (EINVAL);
+
+	/* Read from config. */
+	if (0 == xml_get_val_args(data, data_size, NULL, NULL, NULL, &ptm, &tm,
+	    (const uint8_t*)"fEnable", NULL)) {
+		yn_set_flag32(ptm, tm, ACCESS_LOG_S_F_ENABLE, &params->flags);
+	}
+	if (0 == xml_get_val_args(data, data_size, NULL, NULL, NULL, &ptm, &tm,
+	    (const uint8_t*)"file", NULL) &&
+	    sizeof(params->file_name) > tm) {
+		memcpy(params->file_name, ptm, tm);
+		params->file_name[tm] = 0;
+	}
+	xml_get_val_size_t_args(data, data_size, NULL, &params->ring_size,
+	    (const uint8_t*)"ringSize", NULL);
+	xml_get_val_uint32_args(data, data_size, NULL, &params->flush_interval,
+	    (const uint8_t*)"flushInterval", NULL);
+	xml_get_val_uint64_args(data, data_size, NULL, &params->rotate_size,
+	    (const uint8_t*)"rotateSize", NULL);
+	xml_get_val_uint32_args(data, data_size, NULL, &params->rotate_count,
+	    (const uint8_t*)"rotateCount", NULL);
+
+	return (0);
+}
+
+int
+msd_tshift_writer_load(const uint8_t *data, size_t data_size,
+    tshift_writer_settings_p params) {
+	const uint8_t *ptm;
+	size_t tm;
+
+	if (NULL == data || 0 == data_size || NULL == params)
+		return (EINVAL);
+
+	/* Read from config. */
+	if (0 == xml_get_val_args(data, data_size, NULL, NULL, NULL, &ptm, &tm,
+	    (const uint8_t*)"fEnable", NULL)) {
+		yn_set_flag32(ptm, tm, TSHIFT_W_S_F_ENABLE, &params->flags);
+	}
+	if (0 == xml_get_val_args(data, data_size, NULL, NULL, NULL, &ptm, &tm,
+	    (const uint8_t*)"dir", NULL) &&
+	    sizeof(params->dir) > tm) {
+		memcpy(params->dir, ptm, tm);
+		params->dir[tm] = 0;
+	}
+	xml_get_val_uint32_args(data, data_size, NULL, &params->write_interval,
+	    (const uint8_t*)"writeInterval", NULL);
+
+	return (0);
+}
+
+int
+msd_rec_writer_load(const uint8_t *data, size_t data_size,
+    rec_writer_settings_p params) {
+	const uint8_t *ptm;
+	size_t tm;
+
+	if (NULL == data || 0 == data_size || NULL == params)
+		return (EINVAL);
+
+	/* Read from config. */
+	if (0 == xml_get_val_args(data, data_size, NULL, NULL, NULL, &ptm, &tm,
+	    (const uint8_t*)"fEnable", NULL)) {
+		yn_set_flag32(ptm, tm, REC_W_S_F_ENABLE, &params->flags);
+	}
+	if (0 == xml_get_val_args(data, data_size, NULL, NULL, NULL, &ptm, &tm,
+	    (const uint8_t*)"fODirect", NULL)) {
+		yn_set_flag32(ptm, tm, REC_W_S_F_O_DIRECT, &params->flags);
+	}
+	if (0 == xml_get_val_args(data, data_size, NULL, NULL, NULL, &ptm, &tm,
+	    (const uint8_t*)"dir", NULL) &&
+	    sizeof(params->dir) > tm) {
+		memcpy(params->dir, ptm, tm);
+		params->dir[tm] = 0;
+	}
+	xml_get_val_uint32_args(data, data_size, NULL, &params->write_interval,
+	    (const uint8_t*)"writeInterval", NULL);
+	xml_get_val_size_t_args(data, data_size, NULL, &params->chunk_size,
+	    (const uint8_t*)"chunkSize", NULL);
+	xml_get_val_uint32_args(data, data_size, NULL, &params->queue_size,
+	    (const uint8_t*)"queueSize", NULL);
+	xml_get_val_uint64_args(data, data_size, NULL, &params->rotate_size,
+	    (const uint8_t*)"rotateSize", NULL);
+	xml_get_val_uint32_args(data, data_size, NULL, &params->rotate_time,
+	    (const uint8_t*)"rotateTime", NULL);
+
+	return (0);
+}
+
+/* Start recordings from config: channel names from channel map. */
+static void
+msd_rec_start_cfg(const uint8_t *data, size_t data_size) {
+	int error;
+	const uint8_t *cur_pos, *ptm;
+	size_t tm;
+	str_hub_chan_p chan;
+	str_hubs_settings_p settings = STR_HUBS_BCKT_SETTINGS(g_data.shbskt);
+
+	cur_pos = NULL;
+	while (0 == xml_get_val_args(data, data_size, &cur_pos, NULL, NULL,
+	    &ptm, &tm, (const uint8_t*)"channelList", "channel", NULL)) {
+		chan = str_hubs_settings_chan_get(settings, ptm, tm);
+		if (NULL == chan) {
+			syslog(LOG_ERR, "Recording: channel %.*s not found.",
+			    (int)tm, ptm);
+			continue;
+		}
+		error = str_hub_rec_ctl(g_data.shbskt, NULL, 1,
+		    chan->hub_name, chan->hub_name_size,
+		    chan->prof->name, chan->prof->name_size,
+		    &chan->src_conn_params, chan->name, chan->name_size);
+		SYSLOG_ERR(LOG_ERR, error, "str_hub_rec_ctl(%s).", chan->name);
+	}
+}
+
+int
+msd_udp_push_load(const uint8_t *data, size_t data_size,
+    udp_push_settings_p params) {
+	const uint8_t *ptm;
+	size_t tm;
+
+	if (NULL == data || 0 == data_size || NULL == params)
+		return (EINVAL);
+
+	/* Read from config. */
+	if (0 == xml_get_val_args(data, data_size, NULL, NULL, NULL, &ptm, &tm,
+	    (const uint8_t*)"fEnable", NULL)) {
+		yn_set_flag32(ptm, tm, UDP_PUSH_S_F_ENABLE, &params->flags);
+	}
+	if (0 == xml_get_val_args(data, data_size, NULL, NULL, NULL, &ptm, &tm,
+	    (const uint8_t*)"fGSO", NULL)) {
+		yn_set_flag32(ptm, tm, UDP_PUSH_S_F_GSO, &params->flags);
+	}
+	xml_get_val_uint32_args(data, data_size, NULL, &params->skt_snd_buf,
+	    (const uint8_t*)"sndBuf", NULL);
+	xml_get_val_uint32_args(data, data_size, NULL, &params->ttl,
+	    (const uint8_t*)"ttl", NULL);
+	xml_get_val_uint32_args(data, data_size, NULL, &params->tos,
+	    (const uint8_t*)"tos", NULL);
+	xml_get_val_uint32_args(data, data_size, NULL, &params->burst,
+	    (const uint8_t*)"burst", NULL);
+
+	return (0);
+}
+
+/*
+ * Start push outputs and multicast relays from config: channel names
+ * from channel map.
+ */
+static void
+msd_udp_push_start_cfg(const uint8_t *data, size_t data_size) {
+	int error;
+	const uint8_t *cur_pos, *odata, *ptm;
+	size_t odata_size, tm;
+	str_hub_chan_p chan;
+	udp_push_params_t push_params;
+	char if_name[(IFNAMSIZ + 1)];
+	str_hubs_settings_p settings = STR_HUBS_BCKT_SETTINGS(g_data.shbskt);
+
+	cur_pos = NULL;
+	while (0 == xml_get_val_args(data, data_size, &cur_pos, NULL, NULL,
+	    &odata, &odata_size, (const uint8_t*)"outputList", "output", NULL)) {
+		if (0 != xml_get_val_args(odata, odata_size, NULL, NULL, NULL,
+		    &ptm, &tm, (const uint8_t*)"channel", NULL) ||
+		    NULL == (chan = str_hubs_settings_chan_get(settings,
+		    ptm, tm))) {
+			syslog(LOG_ERR, "UDP push: channel not found.");
+			continue;
+		}
+		memset(&push_params, 0x00, sizeof(push_params));
+		if (0 != xml_get_val_args(odata, odata_size, NULL, NULL, NULL,
+		    &ptm, &tm, (const uint8_t*)"address", NULL) ||
+		    0 != sa_addr_port_from_str(&push_params.addr,
+		    (const char*)ptm, tm)) {
+			syslog(LOG_ERR, "UDP push: %s: invalid address.",
+			    chan->name);
+			continue;
+		}
+		if (0 == xml_get_val_args(odata, odata_size, NULL, NULL, NULL,
+		    &ptm, &tm, (const uint8_t*)"fRTP", NULL)) {
+			yn_set_flag32(ptm, tm, UDP_PUSH_F_RTP,
+			    &push_params.flags);
+		}
+		if (0 == xml_get_val_args(odata, odata_size, NULL, NULL, NULL,
+		    &ptm, &tm, (const uint8_t*)"ifName", NULL) &&
+		    IFNAMSIZ > tm) {
+			memcpy(if_name, ptm, tm);
+			if_name[tm] = 0;
+			push_params.if_index = if_table_index_get(if_name);
+			if (0 == push_params.if_index) {
+				syslog(LOG_ERR, "UDP push: %s: interface %s not found.",
+				    chan->name, if_name);
+				continue;
+			}
+		}
+		xml_get_val_uint32_args(odata, odata_size, NULL,
+		    &push_params.ttl, (const uint8_t*)"ttl", NULL);
+		xml_get_val_uint32_args(odata, odata_size, NULL,
+		    &push_params.pacing_rate, (const uint8_t*)"pacingRate", NULL);
+		error = str_hub_push_ctl(g_data.shbskt, NULL, 1,
+		    chan->hub_name, chan->hub_name_size,
+		    chan->prof->name, chan->prof->name_size,
+		    &chan->src_conn_params, &push_params);
+		SYSLOG_ERR(LOG_ERR, error, "str_hub_push_ctl(%s).", chan->name);
+	}
+}
+
+/* "first-last" addresses pairs from <groupRangeList>. */
+int
+msd_src_ranges_load(const uint8_t *data, size_t data_size,
+    str_hub_prof_range_p *ranges_ret, size_t *ranges_count_ret) {
+	const uint8_t *cur_pos, *ptm, *sep;
+	size_t tm, count;
+	str_hub_prof_range_p ranges;
+
+	if (NULL == data || 0 == data_size || NULL == ranges_ret ||
+	    NULL == ranges_count_ret)
+		return (EINVAL);
+	(*ranges_ret) = NULL;
+	(*ranges_count_ret) = 0;
+	count = xml_calc_tag_count_args(data, data_size,
+	    (const uint8_t*)"groupRangeList", "range", NULL);
+	if (0 == count)
+		return (0);
+	ranges = calloc(count, sizeof(str_hub_prof_range_t));
+	if (NULL == ranges)
+		return (ENOMEM);
+	count = 0;
+	cur_pos = NULL;
+	while (0 == xml_get_val_args(data, data_size, &cur_pos, NULL, NULL,
+	    &ptm, &tm, (const uint8_t*)"groupRangeList", "range", NULL)) {
+		sep = mem_chr(ptm, tm, '-');
+		if (NULL == sep ||
+		    0 != sa_addr_from_str(&ranges[count].first, (const char*)ptm,
+		    (size_t)(sep - ptm)) ||
+		    0 != sa_addr_from_str(&ranges[count].last, (const char*)(sep + 1),
+		    (size_t)(tm - (size_t)(sep - ptm) - 1)) ||
+		    ranges[count].first.ss_family != ranges[count].last.ss_family) {
+			syslog(LOG_WARNING, "Invalid group range: %.*s, skipped.",
+			    (int)tm, (const char*)ptm);
+			continue;
+		}
+		count ++;
+	}
+	(*ranges_ret) = ranges;
+	(*ranges_count_ret) = count;
+
+	return (0);
+}
+
+int
+msd_chan_load(const uint8_t *data, size_t data_size, str_hub_chan_p chan) {
+	int error;
+	const uint8_t *ptm;
+	size_t tm;
+	char if_name[(IFNAMSIZ + 1)];
+
+	if (NULL == data || 0 == data_size || NULL == chan)
+		return (EINVAL);
+
+	memset(chan, 0x00, sizeof(str_hub_chan_t));
+	str_src_conn_def(&chan->src_conn_params);
+	/* Read from config. */
+	if (0 != xml_get_val_args(data, data_size, NULL, NULL, NULL, &ptm, &tm,
+	    (const uint8_t*)"name", NULL) ||
+	    0 == tm || sizeof(chan->name) <= tm) {
+		syslog(LOG_WARNING, "Channel without name or name too long, skipped.");
+		return (EINVAL);
+	}
+	memcpy(chan->name, ptm, tm);
+	chan->name_size = tm;
+	if (0 != xml_get_val_args(data, data_size, NULL, NULL, NULL, &ptm, &tm,
+	    (const uint8_t*)"address", NULL)) {
+		error = EINVAL;
+	} else if (7 < tm && 0 == memcmp(ptm, "http://", 7)) {
+		error = str_src_conn_http_from_str(&chan->src_conn_params,
+		    (const char*)(ptm + 7), (tm - 7));
+	} else if (7 < tm && 0 == memcmp(ptm, "file://", 7)) {
+		/* Local files: only from config, never from URL. */
+		error = str_src_conn_file_from_str(&chan->src_conn_params,
+		    (const char*)(ptm + 7), (tm - 7));
+	} else {
+		error = str_src_conn_addr_from_str(&chan->src_conn_params,
+		    (const char*)ptm, tm);
+	}
+	if (0 != error) {
+		syslog(LOG_WARNING, "Channel \"%s\": no or bad address, skipped.",
+		    chan->name);
+		return (EINVAL);
+	}
+	if (0 == xml_get_val_args(data, data_size, NULL, NULL, NULL, &ptm, &tm,
+	    (const uint8_t*)"title", NULL)) {
+		chan->title_size = MIN(tm, (sizeof(chan->title) - 1));
+		memcpy(chan->title, ptm, chan->title_size);
+	}
+	if (0 == xml_get_val_args(data, data_size, NULL, NULL, NULL, &ptm, &tm,
+	    (const uint8_t*)"profile", NULL) && sizeof(chan->prof_name) > tm) {
+		memcpy(chan->prof_name, ptm, tm);
+		chan->prof_name_size = tm;
+	}
+	if (0 == xml_get_val_args(data, data_size, NULL, NULL, NULL, &ptm, &tm,
+	    (const uint8_t*)"ifName", NULL) && IFNAMSIZ > tm) {
+		memcpy(if_name, ptm, tm);
+		if_name[tm] = 0;
+		chan->src_conn_params.mc.if_index = if_table_index_get(if_name);
+		chan->flags |= STR_HUB_CHAN_F_IFINDEX;
+	}
+	if (0 == xml_get_val_uint32_args(data, data_size, NULL,
+	    &chan->src_conn_params.mc.rejoin_time,
+	    (const uint8_t*)"rejoinTime", NULL)) {
+		chan->flags |= STR_HUB_CHAN_F_REJOIN_TIME;
+	}
+
+	return (0);
+}
+
+/* Find list item with <name>, NULL name = first item. */
+static int
+msd_cfg_prof_find(const uint8_t *cfg_file_buf, size_t cfg_file_buf_size,
+    const char *list_name, const char *item_name,
+    const uint8_t *name, size_t name_size,
+    const uint8_t **data, size_t *data_size) {
+	const uint8_t *cur_pos = NULL, *ptm;
+	size_t tm;
+
+	while (0 == MSD_CFG_GET_VAL_DATA(&cur_pos, data, data_size,
+	    list_name, item_name, NULL)) {
+		if (NULL == name)
+			return (0);
+		if (0 == xml_get_val_args((*data), (*data_size), NULL, NULL, NULL,
+		    &ptm, &tm, (const uint8_t*)"name", NULL) &&
+		    tm == name_size && 0 == memcmp(ptm, name, name_size))
+			return (0);
+	}
+	return (ESPIPE);
+}
+
+/*
+ * Stream hubs settings: defaults + config, used on start and on reload.
+ * Profile = <hubProfile> + <sourceProfile> with same <name>, missing part
+ * taken from first one. Profile 0 = first hub and source profiles.
+ */
+static int
+msd_settings_load(const uint8_t *cfg_file_buf, size_t cfg_file_buf_size,
+    msd_settings_p settings) {
+	const uint8_t *data, *cur_pos, *ptm;
+	size_t data_size, tm, i, j, prof_count, prof_count_max;
+	str_hub_prof_p prof;
+	static const char *lists[2][2] = {
+		{ "hubProfileList", "hubProfile" },
+		{ "sourceProfileList", "sourceProfile" }
+	};
+
+	prof_count_max = (1 +
+	    MSD_CFG_CALC_VAL_COUNT("hubProfileList", "hubProfile", NULL) +
+	    MSD_CFG_CALC_VAL_COUNT("sourceProfileList", "sourceProfile", NULL));
+	prof = calloc(prof_count_max, sizeof(str_hub_prof_t));
+	if (NULL == prof)
+		return (ENOMEM);
+	/* Collect unique names, profile 0 is default without name. */
+	prof_count = 1;
+	for (i = 0; i < 2; i ++) {
+		cur_pos = NULL;
+		while (0 == MSD_CFG_GET_VAL_DATA(&cur_pos, &data, &data_size,
+		    lists[i][0], lists[i][1], NULL)) {
+			if (0 != xml_get_val_args(data, data_size, NULL, NULL, NULL,
+			    &ptm, &tm, (const uint8_t*)"name", NULL) ||
+			    0 == tm)
+				continue;
+			if (STR_HUB_PROF_NAME_MAX <= tm) {
+				syslog(LOG_WARNING, "Profile name too long: %.*s, skipped.",
+				    (int)tm, (const char*)ptm);
+				continue;
+			}
+			for (j = 1; j < prof_count; j ++) {
+				if (prof[j].name_size == tm &&
+				    0 == memcmp(prof[j].name, ptm, tm))
+					break;
+			}
+			if (j < prof_count) /* Allready exist. */
+				continue;
+			memcpy(prof[prof_count].name, ptm, tm);
+			prof[prof_count].name_size = tm;
+			prof_count ++;
+		}
+	}
+
+	for (i = 0; i < prof_count; i ++) {
+		/* Default settings. */
+		str_hub_settings_def(&prof[i].hub);
+		str_src_settings_def(&prof[i].src);
+		str_src_conn_def(&prof[i].src_conn);
+		/* Stream hub params. */
+		if (0 == msd_cfg_prof_find(cfg_file_buf, cfg_file_buf_size,
+		    lists[0][0], lists[0][1], (const uint8_t*)prof[i].name,
+		    prof[i].name_size, &data, &data_size) ||
+		    0 == msd_cfg_prof_find(cfg_file_buf, cfg_file_buf_size,
+		    lists[0][0], lists[0][1], NULL, 0, &data, &data_size)) {
+			msd_hub_profile_load(data, data_size, &prof[i].hub);
+		}
+		/* Stream source params. */
+		if (0 != i &&
+		    0 == msd_cfg_prof_find(cfg_file_buf, cfg_file_buf_size,
+		    lists[1][0], lists[1][1], (const uint8_t*)prof[i].name,
+		    prof[i].name_size, &data, &data_size)) {
+			/* Ranges only from own source profile. */
+			msd_src_ranges_load(data, data_size, &prof[i].ranges,
+			    &prof[i].ranges_count);
+		} else if (0 != msd_cfg_prof_find(cfg_file_buf, cfg_file_buf_size,
+		    lists[1][0], lists[1][1], NULL, 0, &data, &data_size)) {
+			continue;
+		}
+		msd_src_profile_load(data, data_size, &prof[i].src);
+		msd_src_conn_profile_load(data, data_size, &prof[i].src_conn);
+	}
+
+	settings->prof = prof;
+	settings->prof_count = prof_count;
+
+	/* Channel map. */
+	settings->chan = NULL;
+	settings->chan_count = 0;
+	tm = MSD_CFG_CALC_VAL_COUNT("channelList", "channel", NULL);
+	if (0 != tm) {
+		settings->chan = calloc(tm, sizeof(str_hub_chan_t));
+		if (NULL == settings->chan) {
+			msd_settings_free(settings);
+			return (ENOMEM);
+		}
+		cur_pos = NULL;
+		while (0 == MSD_CFG_GET_VAL_DATA(&cur_pos, &data, &data_size,
+		    "channelList", "channel", NULL)) {
+			if (0 != msd_chan_load(data, data_size,
+			    &settings->chan[settings->chan_count]))
+				continue;
+			settings->chan_count ++;
+		}
+	}
+
+	/* Admission control. */
+	str_hubs_limits_def(&settings->limits);
+	if (0 == MSD_CFG_GET_VAL_DATA(NULL, &data, &data_size,
+	    "limits", NULL)) {
+		msd_limits_load(data, data_size, &settings->limits);
+	}
+
+	return (0);
+}
+
+static void
+msd_settings_free(msd_settings_p settings) {
+	size_t i;
+
+	if (NULL == settings->prof)
+		return;
+	for (i = 0; i < settings->prof_count; i ++) {
+		free(settings->prof[i].hub.cust_http_hdrs);
+		free(settings->prof[i].ranges);
+	}
+	free(settings->prof);
+	free(settings->chan);
+	settings->prof = NULL;
+	settings->chan = NULL;
+}
+
+/*
+ * Re read config and apply hubs, sources and limits settings.
+ * Access log file reopened: for logrotate.
+ * HTTP bindings, thread pool, access log settings and handoff require restart.
+ */
+int
+msd_reload(void) {
+	int error;
+	uint8_t *cfg_file_buf = NULL;
+	size_t cfg_file_buf_size = 0;
+	uint32_t log_level;
+	msd_settings_t settings;
+
+	access_log_reopen(g_data.alog); /* Even if config is broken. */
+	error = read_file(g_data.cfg_file_name, 0, 0, 0,
+	    CFG_FILE_MAX_SIZE, &cfg_file_buf, &cfg_file_buf_size);
+	if (0 != error) {
+		SYSLOG_ERR(LOG_ERR, error, "config read_file().");
+		return (error);
+	}
+	if (0 != xml_get_val_args(cfg_file_buf, cfg_file_buf_size,
+	    NULL, NULL, NULL, NULL, NULL,
+	    (const uint8_t*)"msd", NULL)) {
+		syslog(LOG_ERR, "Config file XML format invalid, reload canceled.");
+		free(cfg_file_buf);
+		return (EINVAL);
+	}
+	/* Log level. */
+	if (0 == MSD_CFG_GET_VAL_UINT(NULL, &log_level, "log", "level", NULL)) {
+		setlogmask(LOG_UPTO(log_level));
+	}
+	error = msd_settings_load(cfg_file_buf, cfg_file_buf_size, &settings);
+	free(cfg_file_buf);
+	if (0 != error) {
+		SYSLOG_ERR(LOG_ERR, error, "msd_settings_load().");
+		return (error);
+	}
+	error = str_hubs_bckt_reload(g_data.shbskt, settings.prof,
+	    settings.prof_count, settings.chan, settings.chan_count,
+	    &settings.limits);
+	msd_settings_free(&settings); /* Copied by str_hubs_bckt_reload(). */
+	if (0 != error) {
+		SYSLOG_ERR(LOG_ERR, error, "str_hubs_bckt_reload().");
+		return (error);
+	}
+	syslog(LOG_NOTICE, "Config reloaded.");
+
+	return (0);
+}
+
+/* Only set flag here, reload from timer on thread pool. */
+static void
+msd_sighup_handler(int sig __unused) {
+
+	msd_reload_pending = 1;
+}
+
+static void
+msd_reload_tmr_cb(tp_event_p ev __unused, tp_udata_p tp_udata __unused) {
+
+	if (0 == msd_reload_pending)
+		return;
+	msd_reload_pending = 0;
+	msd_reload();
+}
+
 
 
 int
@@ -304,6 +1039,7 @@ main(int argc, char *argv[]) {
     { /* Process config file. */
 	const uint8_t *data;
 	size_t data_size;
+	msd_settings_t settings;
 	tp_settings_t tp_s;
 	tp_params_t tp_prms;
 	http_srv_cli_ccb_t ccb;
@@ -389,31 +1125,117 @@ main(int argc, char *argv[]) {
 		goto err_out;
 	}
 
-	/* Default settings. */
-	/* Stream hub defaults. */
-	g_data.hub_params.flags = STR_HUB_S_DEF_FLAGS;
-	g_data.hub_params.skt_snd_buf = STR_HUB_S_DEF_SKT_SND_BUF;
-	/* Stream source defaults params. */
-	str_src_conn_def(&g_data.src_conn_params);
-	str_src_settings_def(&g_data.src_params);
-
-	/* Stream hub params. */
+	/* Stream hubs, sources, channels, admission control. */
+	error = msd_settings_load(cfg_file_buf, cfg_file_buf_size, &settings);
+	if (0 != error) {
+		SYSLOG_ERR(LOG_CRIT, error, "msd_settings_load().");
+		goto err_out;
+	}
+	/* Access log. */
+	access_log_settings_def(&g_data.alog_params);
+	if (0 == MSD_CFG_GET_VAL_DATA(NULL, &data, &data_size,
+	    "log", "accessLog", NULL)) {
+		msd_access_log_load(data, data_size, &g_data.alog_params);
+	}
+	if (0 != (ACCESS_LOG_S_F_ENABLE & g_data.alog_params.flags)) {
+		error = access_log_create(&g_data.alog_params,
+		    tp_thread_count_max_get(tp), &g_data.alog);
+		if (0 != error) {
+			SYSLOG_ERR(LOG_CRIT, error, "access_log_create().");
+			goto err_out;
+		}
+	}
+	/* Time-shift writer. */
+	tshift_writer_settings_def(&g_data.tsw_params);
 	if (0 == MSD_CFG_GET_VAL_DATA(NULL, &data, &data_size,
-	    "hubProfileList", "hubProfile", NULL)) {
-		msd_hub_profile_load(data, data_size, &g_data.hub_params);
+	    "timeShift", NULL)) {
+		msd_tshift_writer_load(data, data_size, &g_data.tsw_params);
+	}
+	if (0 != (TSHIFT_W_S_F_ENABLE & g_data.tsw_params.flags)) {
+		error = tshift_writer_create(&g_data.tsw_params, &g_data.tsw);
+		if (0 != error) {
+			SYSLOG_ERR(LOG_CRIT, error, "tshift_writer_create().");
+			goto err_out;
+		}
 	}
-	/* Stream source params. */
+	/* Recordings I/O thread. */
+	rec_writer_settings_def(&g_data.rw_params);
 	if (0 == MSD_CFG_GET_VAL_DATA(NULL, &data, &data_size,
-	    "sourceProfileList", "sourceProfile", NULL)) {
-		msd_src_profile_load(data, data_size, &g_data.src_params);
-		msd_src_conn_profile_load(data, data_size, &g_data.src_conn_params);
+	    "recording", NULL)) {
+		msd_rec_writer_load(data, data_size, &g_data.rw_params);
 	}
-	error = str_hubs_bckt_create(tp, PACKAGE_NAME"/"PACKAGE_VERSION, &g_data.hub_params,
-	    &g_data.src_params, &g_data.shbskt);
+	if (0 != (REC_W_S_F_ENABLE & g_data.rw_params.flags)) {
+		error = rec_writer_create(&g_data.rw_params, &g_data.rw);
+		if (0 != error) {
+			SYSLOG_ERR(LOG_CRIT, error, "rec_writer_create().");
+			goto err_out;
+		}
+	}
+	/* UDP push outputs: per thread senders created on demand. */
+	udp_push_settings_def(&g_data.push_params);
+	if (0 == MSD_CFG_GET_VAL_DATA(NULL, &data, &data_size,
+	    "udpPush", NULL)) {
+		msd_udp_push_load(data, data_size, &g_data.push_params);
+	}
+	error = str_hubs_bckt_create(tp, PACKAGE_NAME"/"PACKAGE_VERSION,
+	    settings.prof, settings.prof_count, settings.chan,
+	    settings.chan_count, &settings.limits, g_data.alog, g_data.tsw,
+	    g_data.rw, &g_data.push_params, &g_data.shbskt);
+	msd_settings_free(&settings); /* Copied by str_hubs_bckt_create(). */
 	if (0 != error) {
 		SYSLOG_ERR(LOG_CRIT, error, "str_hubs_bckt_create().");
 		goto err_out;
 	}
+	/* Interfaces table: no syscalls on requests, re join on link up. */
+	error = if_table_create(tp, msd_if_link_cb, NULL);
+	if (0 != error) {
+		SYSLOG_ERR(LOG_ERR, error, "if_table_create().");
+	}
+	/* Reload: SIGHUP only set flag, check it every second. */
+	g_data.cfg_file_name = cmd_line_data.cfg_file_name;
+	g_data.reload_tmr.cb_func = msd_reload_tmr_cb;
+	g_data.reload_tmr.ident = (uintptr_t)&g_data;
+	error = tpt_ev_add_args(tp_thread_get_rr(tp), TP_EV_TIMER,
+	    0, TP_FF_T_MSEC, 1000 /* 1 sec. */, &g_data.reload_tmr);
+	if (0 != error) {
+		SYSLOG_ERR(LOG_ERR, error, "tpt_ev_add_args().");
+	}
+	/* Handoff: take clients from running process, then wait for next. */
+	if (0 == MSD_CFG_GET_VAL_DATA(NULL, &data, &data_size,
+	    "handoff", "socketFile", NULL) &&
+	    0 != data_size && sizeof(g_data.handoff_file) > data_size) {
+		memcpy(g_data.handoff_file, data, data_size);
+		g_data.handoff_file[data_size] = 0;
+	}
+	if (0 != g_data.handoff_file[0]) {
+		size_t hub_count, cli_count;
+
+		error = handoff_import(g_data.handoff_file, g_data.shbskt,
+		    &hub_count, &cli_count);
+		if (0 == error) {
+			syslog(LOG_NOTICE, "Handoff: received %zu hubs, %zu clients.",
+			    hub_count, cli_count);
+		} else if (ENOENT != error && ECONNREFUSED != error) {
+			SYSLOG_ERR(LOG_ERR, error, "handoff_import().");
+		}
+		error = handoff_listen_create(tp, g_data.handoff_file,
+		    msd_handoff_req_cb, NULL, &g_data.handoff);
+		if (0 != error) {
+			SYSLOG_ERR(LOG_ERR, error, "handoff_listen_create(%s).",
+			    g_data.handoff_file);
+		}
+	}
+	/* Recordings: after handoff, so imported hubs are reused. */
+	if (NULL != g_data.rw &&
+	    0 == MSD_CFG_GET_VAL_DATA(NULL, &data, &data_size,
+	    "recording", NULL)) {
+		msd_rec_start_cfg(data, data_size);
+	}
+	if (0 != (UDP_PUSH_S_F_ENABLE & g_data.push_params.flags) &&
+	    0 == MSD_CFG_GET_VAL_DATA(NULL, &data, &data_size,
+	    "udpPush", NULL)) {
+		msd_udp_push_start_cfg(data, data_size);
+	}
 	free(cfg_file_buf);
     } /* Done with config. */
 
@@ -430,6 +1252,15 @@ main(int argc, char *argv[]) {
 
 	tp_signal_handler_add_tp(tp);
 	signal_install(tp_signal_handler);
+    { /* SIGHUP = reload config. */
+	struct sigaction sact;
+
+	memset(&sact, 0x00, sizeof(sact));
+	sact.sa_handler = msd_sighup_handler;
+	sigemptyset(&sact.sa_mask);
+	sact.sa_flags = SA_RESTART;
+	sigaction(SIGHUP, &sact, NULL);
+    }
 
 	write_pid(cmd_line_data.pid_file_name); /* Store pid to file. */
 	set_user_and_group(cmd_line_data.pw_uid, cmd_line_data.pw_gid); /* Drop rights. */
@@ -441,10 +1272,20 @@ main(int argc, char *argv[]) {
 	}
 
 	/* Deinitialization... */
-	http_srv_shutdown(g_data.http_srv); /* No more new clients. */
+	tpt_ev_del_args1(TP_EV_TIMER, &g_data.reload_tmr);
+	handoff_listen_destroy(g_data.handoff);
+	if (0 == g_data.handed_off) { /* Allready stopped on handoff. */
+		http_srv_shutdown(g_data.http_srv); /* No more new clients. */
+	}
 	http_srv_destroy(g_data.http_srv); /* AFTER radius is shut down! */
 	str_hubs_bckt_destroy(g_data.shbskt);
-	if (NULL != cmd_line_data.pid_file_name) {
+	if_table_destroy();
+	access_log_destroy(g_data.alog); /* After all clients detached. */
+	tshift_writer_destroy(g_data.tsw); /* After all hubs destroyed. */
+	rec_writer_destroy(g_data.rw); /* After all hubs destroyed. */
+	/* Pid file belong to new process after handoff. */
+	if (NULL != cmd_line_data.pid_file_name &&
+	    0 == g_data.handed_off) {
 		unlink(cmd_line_data.pid_file_name); // Remove pid file
 	}
 
@@ -457,12 +1298,48 @@ err_out:
 }
 
 
+static void
+msd_if_link_cb(uint32_t if_index, int up, void *udata __unused) {
+
+	str_hubs_bckt_link_state(g_data.shbskt, if_index, up);
+}
+
+/* New process connected: stop accept clients and pass all to it. */
+static void
+msd_handoff_req_cb(uintptr_t skt, void *udata __unused) {
+	int error;
+
+	g_data.handed_off = 1;
+	http_srv_shutdown(g_data.http_srv); /* No more new clients. */
+	error = str_hubs_bckt_handoff_send(g_data.shbskt, skt,
+	    msd_handoff_done_cb, (void*)skt);
+	if (0 != error) {
+		SYSLOG_ERR(LOG_ERR, error, "str_hubs_bckt_handoff_send().");
+		msd_handoff_done_cb(NULL, 0, 0, (void*)skt);
+	}
+}
+
+static void
+msd_handoff_done_cb(tpt_p tpt __unused, size_t send_msg_cnt __unused,
+    size_t error_cnt __unused, void *udata) {
+	uintptr_t skt = (uintptr_t)udata;
+	handoff_rec_t rec;
+
+	handoff_rec_init(&rec, HANDOFF_REC_END);
+	/* On error new process see EOF: same as end. */
+	handoff_rec_send_nb(skt, &rec, (uintptr_t)-1);
+	close((int)skt);
+	syslog(LOG_NOTICE, "Handoff done, exiting.");
+	tp_shutdown(g_data.shbskt->tp);
+}
+
+
 /*
  * tcpcc = congestion ctrl name
  */
 int
 msd_http_srv_hub_attach(http_srv_cli_p cli, uint8_t *hub_name, size_t hub_name_size,
-    str_src_conn_params_p src_conn_params) {
+    str_hub_prof_p prof, str_src_conn_params_p src_conn_params) {
 	int error;
 	str_hub_cli_p strh_cli;
 	http_srv_req_p req;
@@ -496,6 +1373,15 @@ msd_http_srv_hub_attach(http_srv_cli_p cli, uint8_t *hub_name, size_t hub_name_s
 		syslog(LOG_ERR, "str_hub_cli_alloc().");
 		return (ENOMEM);
 	}
+	/* Time-shift: "offset=-600", seconds back from live. */
+	if (0 == http_query_val_get(req->line.query, req->line.query_size,
+	    (const uint8_t*)"offset", 6, &ptm, &tm)) {
+		if (0 != tm && '-' == ptm[0]) {
+			ptm ++;
+			tm --;
+		}
+		strh_cli->tshift_offset = ustr2u32(ptm, tm);
+	}
 	/*
 	 * Set stream hub client data: some form http server client other from
 	 * http request.
@@ -512,7 +1398,7 @@ msd_http_srv_hub_attach(http_srv_cli_p cli, uint8_t *hub_name, size_t hub_name_s
 
 	SYSLOGD_EX(LOG_DEBUG, "%s - : attach...", hub_name);
 	error = str_hub_cli_attach(g_data.shbskt, strh_cli, hub_name, hub_name_size,
-	    src_conn_params);
+	    prof->name, prof->name_size, src_conn_params);
 	/* Do not read/write to stream hub client, stream hub is new owner! */
 	if (0 != error) {
 		strh_cli->skt = (uintptr_t)-1;
@@ -525,47 +1411,42 @@ msd_http_srv_hub_attach(http_srv_cli_p cli, uint8_t *hub_name, size_t hub_name_s
 	return (error);
 }
 
+/* path_size: abs_path size without HLS suffix. */
 uint32_t
-msd_http_req_url_parse(http_srv_req_p req, struct sockaddr_storage *ssaddr,
-    uint32_t *if_index, uint32_t *rejoin_time,
+msd_http_req_url_parse(http_srv_req_p req, size_t path_size,
+    str_src_conn_params_p src_conn_params,
     uint8_t *hub_name, size_t hub_name_size, size_t *hub_name_size_ret) {
 	const uint8_t *ptm;
 	size_t tm;
 	uint32_t ifindex, rejointime;
-	char straddr[STR_ADDR_LEN], ifname[(IFNAMSIZ + 1)];
-	struct sockaddr_storage ss;
+	char ifname[(IFNAMSIZ + 1)];
+	uint32_t *if_index, *rejoin_time;
 
 	SYSLOGD_EX(LOG_DEBUG, "...");
 
-	if (NULL == req || NULL == hub_name || 0 == hub_name_size)
+	if (NULL == req || NULL == src_conn_params ||
+	    NULL == hub_name || 0 == hub_name_size)
 		return (500);
-	/* Get multicast address. */
-	if (0 != sa_addr_port_from_str(&ss, (const char*)(req->line.abs_path + 5),
-	    (req->line.abs_path_size - 5)))
+	if_index = &src_conn_params->mc.if_index;
+	rejoin_time = &src_conn_params->mc.rejoin_time;
+	/* Get multicast address and SSM source: /udp/[SOURCE@]GROUP[:PORT] */
+	if (0 != str_src_conn_addr_from_str(src_conn_params,
+	    (const char*)(req->line.abs_path + 5), (path_size - 5)))
 		return (400);
-	if (0 == sa_port_get(&ss)) { /* Def udp port. */
-		sa_port_set(&ss, 1234);
-	}
 	/* ifname, ifindex. */
 	if (0 == http_query_val_get(req->line.query, req->line.query_size,
 	    (const uint8_t*)"ifname", 6, &ptm, &tm) && IFNAMSIZ > tm) {
 		memcpy(ifname, ptm, tm);
 		ifname[tm] = 0;
-		ifindex = if_nametoindex(ifname);
+		ifindex = if_table_index_get(ifname);
 	} else {
 		if (0 == http_query_val_get(req->line.query, 
 		    req->line.query_size, (const uint8_t*)"ifindex", 7,
 		    &ptm, &tm)) {
 			ifindex = ustr2u32(ptm, tm);
 		} else { /* Default value. */
-			if (NULL != if_index) {
-				ifindex = (*if_index);
-			} else {
-				ifindex = (uint32_t)-1;
-			}
+			ifindex = (*if_index);
 		}
-		ifname[0] = 0;
-		if_indextoname(ifindex, ifname);
 	}
 
 	/* rejoin_time. */
@@ -574,26 +1455,13 @@ msd_http_req_url_parse(http_srv_req_p req, struct sockaddr_storage *ssaddr,
 	    &ptm, &tm)) {
 		rejointime = ustr2u32(ptm, tm);
 	} else { /* Default value. */
-		if (NULL != if_index) {
-			rejointime = (*rejoin_time);
-		} else {
-			rejointime = 0;
-		}
+		rejointime = (*rejoin_time);
 	}
 
-	if (0 != sa_addr_port_to_str(&ss, straddr, sizeof(straddr), NULL))
+	(*if_index) = ifindex;
+	(*rejoin_time) = rejointime;
+	if (0 != str_hub_name_make(src_conn_params, hub_name, hub_name_size, &tm))
 		return (400);
-	tm = (size_t)snprintf((char*)hub_name, hub_name_size,
-	    "/udp/%s@%s", straddr, ifname);
-	if (NULL != ssaddr) {
-		sa_copy(&ss, ssaddr);
-	}
-	if (NULL != if_index) {
-		(*if_index) = ifindex;
-	}
-	if (NULL != rejoin_time) {
-		(*rejoin_time) = rejointime;
-	}
 	if (NULL != hub_name_size_ret) {
 		(*hub_name_size_ret) = tm;
 	}
@@ -603,6 +1471,281 @@ msd_http_req_url_parse(http_srv_req_p req, struct sockaddr_storage *ssaddr,
 
 
 
+/* Common part for /udp/ and /ch/ requests. */
+static int
+msd_http_srv_hub_req(http_srv_cli_p cli, http_srv_req_p req,
+    http_srv_resp_p resp, str_hubs_settings_p settings, str_hub_prof_p prof,
+    uint8_t *hub_name, size_t hub_name_size,
+    str_src_conn_params_p src_conn_params) {
+
+	if (HTTP_REQ_METHOD_HEAD == req->line.method_code) {
+		/* Send HTTP headers only... */
+		resp->status_code = 200;
+		resp->p_flags &= ~HTTP_SRV_RESP_P_F_CONTENT_LEN;
+		if (8 < prof->hub.cust_http_hdrs_size) {
+			/* Without final CRLF. */
+			resp->hdrs_count = 1;
+			resp->hdrs[0].iov_base = prof->hub.cust_http_hdrs;
+			resp->hdrs[0].iov_len = (prof->hub.cust_http_hdrs_size - 2);
+		}
+		return (HTTP_SRV_CB_CONTINUE);
+	}
+	/* Admission control: before any socket tuning and hub creation. */
+	if (STR_HUBS_REJ_R_NONE != str_hubs_bckt_admit(g_data.shbskt,
+	    hub_name, hub_name_size)) {
+		resp->status_code = 503;
+		resp->hdrs_count = 1;
+		resp->hdrs[0].iov_base = settings->retry_after_hdr;
+		resp->hdrs[0].iov_len = settings->retry_after_hdr_size;
+		return (HTTP_SRV_CB_CONTINUE);
+	}
+	if (0 != msd_http_srv_hub_attach(cli, hub_name, hub_name_size, prof,
+	    src_conn_params)) {
+		resp->status_code = 500;
+		return (HTTP_SRV_CB_CONTINUE);
+	}
+	/* Will send reply later... */
+	return (HTTP_SRV_CB_NONE);
+}
+
+/*
+ * HLS URL: BASE/index.m3u8 or BASE/SEQ.ts
+ * Return 0 and cut path_size to BASE if HLS and BASE longer than prefix.
+ */
+static int
+msd_http_hls_path_parse(const uint8_t *path, size_t *path_size,
+    size_t prefix_size, uint64_t *seq) {
+	const uint8_t *ptm;
+	size_t tm;
+
+	ptm = mem_rchr(path, (*path_size), '/');
+	if (NULL == ptm || (path + prefix_size) >= ptm)
+		return (ENOENT);
+	ptm ++;
+	tm = (size_t)((path + (*path_size)) - ptm);
+	if (0 == mem_cmpin_cstr("index.m3u8", ptm, tm)) {
+		(*seq) = STR_HUB_HLS_PLAYLIST;
+	} else if (3 < tm && 0 == mem_cmpin_cstr(".ts", (ptm + (tm - 3)), 3)) {
+		(*seq) = ustr2u64(ptm, (tm - 3));
+		if (STR_HUB_HLS_PLAYLIST == (*seq))
+			return (ENOENT);
+	} else {
+		return (ENOENT);
+	}
+	(*path_size) = (size_t)((ptm - 1) - path);
+
+	return (0);
+}
+
+/* Common part for HLS playlist and segment requests. */
+static int
+msd_http_srv_hls_req(http_srv_cli_p cli, http_srv_req_p req,
+    http_srv_resp_p resp, str_hubs_settings_p settings,
+    str_hub_prof_p prof, uint8_t *hub_name, size_t hub_name_size,
+    str_src_conn_params_p src_conn_params, uint64_t seq) {
+	int error;
+
+	if (0 == (STR_HUB_S_F_HLS & prof->hub.flags)) {
+		resp->status_code = 404;
+		return (HTTP_SRV_CB_CONTINUE);
+	}
+	if (HTTP_REQ_METHOD_GET != req->line.method_code) {
+		resp->status_code = 400;
+		return (HTTP_SRV_CB_CONTINUE);
+	}
+	if (STR_HUB_HLS_PLAYLIST == seq) {
+		/* Admission control: playlist may create hub. */
+		if (STR_HUBS_REJ_R_NONE != str_hubs_bckt_admit(g_data.shbskt,
+		    hub_name, hub_name_size)) {
+			resp->status_code = 503;
+			resp->hdrs_count = 1;
+			resp->hdrs[0].iov_base = settings->retry_after_hdr;
+			resp->hdrs[0].iov_len = settings->retry_after_hdr_size;
+			return (HTTP_SRV_CB_CONTINUE);
+		}
+		/* Hub thread only write to buf. */
+		error = http_srv_cli_buf_realloc(cli, 0,
+		    hls_playlist_size_max(&prof->hub.hls, req->line.query_size));
+		if (0 != error) {
+			resp->status_code = 500;
+			return (HTTP_SRV_CB_CONTINUE);
+		}
+	}
+	error = str_hub_hls_req(g_data.shbskt, cli, hub_name, hub_name_size,
+	    prof->name, prof->name_size, src_conn_params, seq);
+	if (0 != error) {
+		SYSLOG_ERR(LOG_ERR, error, "str_hub_hls_req().");
+		resp->status_code = 500;
+		return (HTTP_SRV_CB_CONTINUE);
+	}
+	if (STR_HUB_HLS_PLAYLIST != seq) {
+		/* Do not read/write to socket, stream hub is new owner! */
+		tp_task_flags_del(http_srv_cli_get_tptask(cli),
+		    TP_TASK_F_CLOSE_ON_DESTROY);
+		http_srv_cli_free(cli);
+	}
+	/* Will send reply later... */
+	return (HTTP_SRV_CB_NONE);
+}
+
+/* /rec/start/NAME, /rec/stop/NAME: NAME from channel map. */
+static int
+msd_http_srv_rec_ctl(http_srv_cli_p cli, http_srv_req_p req,
+    http_srv_resp_p resp) {
+	int error, start;
+	const uint8_t *name;
+	size_t name_size;
+	str_hub_chan_p chan;
+
+	if (11 < req->line.abs_path_size &&
+	    0 == memcmp(req->line.abs_path, "/rec/start/", 11)) {
+		start = 1;
+		name = (req->line.abs_path + 11);
+		name_size = (req->line.abs_path_size - 11);
+	} else if (10 < req->line.abs_path_size &&
+	    0 == memcmp(req->line.abs_path, "/rec/stop/", 10)) {
+		start = 0;
+		name = (req->line.abs_path + 10);
+		name_size = (req->line.abs_path_size - 10);
+	} else {
+		resp->status_code = 404;
+		return (HTTP_SRV_CB_CONTINUE);
+	}
+	chan = str_hubs_settings_chan_get(STR_HUBS_BCKT_SETTINGS(g_data.shbskt),
+	    name, name_size);
+	if (NULL == chan) {
+		resp->status_code = 404;
+		return (HTTP_SRV_CB_CONTINUE);
+	}
+	error = str_hub_rec_ctl(g_data.shbskt, cli, start,
+	    chan->hub_name, chan->hub_name_size,
+	    chan->prof->name, chan->prof->name_size,
+	    &chan->src_conn_params, chan->name, chan->name_size);
+	if (0 != error) {
+		SYSLOG_ERR(LOG_ERR, error, "str_hub_rec_ctl().");
+		resp->status_code = ((ENOTSUP == error) ? 501 : 500);
+		return (HTTP_SRV_CB_CONTINUE);
+	}
+	/* Will send reply later... */
+	return (HTTP_SRV_CB_NONE);
+}
+
+/*
+ * /push/start/NAME?dst=ADDR:PORT[&rtp=1][&if=IF_NAME][&ttl=N][&rate=KBITS]
+ * /push/stop/NAME?dst=ADDR:PORT
+ * NAME from channel map.
+ */
+static int
+msd_http_srv_push_ctl(http_srv_cli_p cli, http_srv_req_p req,
+    http_srv_resp_p resp) {
+	int error, start;
+	const uint8_t *name, *ptm;
+	size_t name_size, tm;
+	str_hub_chan_p chan;
+	udp_push_params_t push_params;
+	char if_name[(IFNAMSIZ + 1)];
+
+	if (12 < req->line.abs_path_size &&
+	    0 == memcmp(req->line.abs_path, "/push/start/", 12)) {
+		start = 1;
+		name = (req->line.abs_path + 12);
+		name_size = (req->line.abs_path_size - 12);
+	} else if (11 < req->line.abs_path_size &&
+	    0 == memcmp(req->line.abs_path, "/push/stop/", 11)) {
+		start = 0;
+		name = (req->line.abs_path + 11);
+		name_size = (req->line.abs_path_size - 11);
+	} else {
+		resp->status_code = 404;
+		return (HTTP_SRV_CB_CONTINUE);
+	}
+	memset(&push_params, 0x00, sizeof(push_params));
+	if (0 != http_query_val_get(req->line.query, req->line.query_size,
+	    (const uint8_t*)"dst", 3, &ptm, &tm) ||
+	    0 != sa_addr_port_from_str(&push_params.addr,
+	    (const char*)ptm, tm)) {
+		resp->status_code = 400;
+		return (HTTP_SRV_CB_CONTINUE);
+	}
+	if (0 == http_query_val_get(req->line.query, req->line.query_size,
+	    (const uint8_t*)"rtp", 3, &ptm, &tm) &&
+	    0 != ustr2u32(ptm, tm)) {
+		push_params.flags |= UDP_PUSH_F_RTP;
+	}
+	if (0 == http_query_val_get(req->line.query, req->line.query_size,
+	    (const uint8_t*)"if", 2, &ptm, &tm)) {
+		if (IFNAMSIZ <= tm) {
+			resp->status_code = 400;
+			return (HTTP_SRV_CB_CONTINUE);
+		}
+		memcpy(if_name, ptm, tm);
+		if_name[tm] = 0;
+		push_params.if_index = if_table_index_get(if_name);
+		if (0 == push_params.if_index) {
+			resp->status_code = 400;
+			return (HTTP_SRV_CB_CONTINUE);
+		}
+	}
+	if (0 == http_query_val_get(req->line.query, req->line.query_size,
+	    (const uint8_t*)"ttl", 3, &ptm, &tm)) {
+		push_params.ttl = ustr2u32(ptm, tm);
+	}
+	if (0 == http_query_val_get(req->line.query, req->line.query_size,
+	    (const uint8_t*)"rate", 4, &ptm, &tm)) {
+		push_params.pacing_rate = ustr2u32(ptm, tm);
+	}
+	chan = str_hubs_settings_chan_get(STR_HUBS_BCKT_SETTINGS(g_data.shbskt),
+	    name, name_size);
+	if (NULL == chan) {
+		resp->status_code = 404;
+		return (HTTP_SRV_CB_CONTINUE);
+	}
+	error = str_hub_push_ctl(g_data.shbskt, cli, start,
+	    chan->hub_name, chan->hub_name_size,
+	    chan->prof->name, chan->prof->name_size,
+	    &chan->src_conn_params, &push_params);
+	if (0 != error) {
+		SYSLOG_ERR(LOG_ERR, error, "str_hub_push_ctl().");
+		resp->status_code = ((ENOTSUP == error) ? 501 : 500);
+		return (HTTP_SRV_CB_CONTINUE);
+	}
+	/* Will send reply later... */
+	return (HTTP_SRV_CB_NONE);
+}
+
+/* M3U from channel map, URLs point to same host as request. */
+static int
+msd_http_playlist_gen(http_srv_cli_p cli, http_srv_req_p req,
+    str_hubs_settings_p settings) {
+	int error;
+	size_t i;
+	io_buf_p buf;
+	str_hub_chan_p chan;
+
+	error = http_srv_cli_buf_realloc(cli, 0,
+	    (64 + (settings->chan_count * (STR_HUB_CHAN_TITLE_MAX +
+	    STR_HUB_CHAN_NAME_MAX + req->host_size + 32))));
+	if (0 != error) /* Need more space! */
+		return (error);
+	buf = http_srv_cli_get_buf(cli);
+	IO_BUF_COPYIN_CSTR(buf, "#EXTM3U\r\n");
+	for (i = 0; i < settings->chan_count; i ++) {
+		chan = &settings->chan[i];
+		io_buf_printf(buf, "#EXTINF:-1,%s\r\n",
+		    ((0 != chan->title_size) ? chan->title : chan->name));
+		if (0 != req->host_size) {
+			io_buf_printf(buf, "http://%.*s/ch/%s\r\n",
+			    (int)req->host_size, (const char*)req->host,
+			    chan->name);
+		} else {
+			io_buf_printf(buf, "/ch/%s\r\n", chan->name);
+		}
+	}
+
+	return (0);
+}
+
+
 /* http request from client is received now, process it. */
 /* http_srv_on_req_rcv_cb */
 static int
@@ -612,8 +1755,19 @@ msd_http_srv_on_req_rcv_cb(http_srv_cli_p cli, void *udata __unused,
 	int error;
 	uint8_t buf[512];
 	str_src_conn_params_t src_conn_params;
+	const uint8_t *ptm;
+	size_t tm;
+	str_hubs_settings_p settings;
+	str_hub_prof_p prof;
+	str_hub_chan_p chan;
+	struct sockaddr_storage addr;
+	size_t path_size;
+	uint64_t hls_seq;
+	int hls;
 	static const char *cttype = 	"Content-Type: text/plain\r\n"
 					"Pragma: no-cache";
+	static const char m3u_cttype[] = "Content-Type: audio/x-mpegurl\r\n"
+					"Pragma: no-cache";
 
 	SYSLOGD_EX(LOG_DEBUG, "...");
 
@@ -644,6 +1798,39 @@ msd_http_srv_on_req_rcv_cb(http_srv_cli_p cli, void *udata __unused,
 		}
 		return (HTTP_SRV_CB_CONTINUE);
 	}
+	/* Config reload request: from localhost only. */
+	if (HTTP_REQ_METHOD_GET == req->line.method_code &&
+	    0 == mem_cmpin_cstr("/reload", req->line.abs_path, req->line.abs_path_size)) {
+		http_srv_cli_get_addr(cli, &addr);
+		if (0 == sa_addr_is_loopback(&addr)) {
+			resp->status_code = 403;
+			return (HTTP_SRV_CB_CONTINUE);
+		}
+		resp->status_code = ((0 == msd_reload()) ? 200 : 500);
+		return (HTTP_SRV_CB_CONTINUE);
+	}
+	/* Recording control: from localhost only. */
+	if (HTTP_REQ_METHOD_GET == req->line.method_code &&
+	    5 < req->line.abs_path_size &&
+	    0 == memcmp(req->line.abs_path, "/rec/", 5)) {
+		http_srv_cli_get_addr(cli, &addr);
+		if (0 == sa_addr_is_loopback(&addr)) {
+			resp->status_code = 403;
+			return (HTTP_SRV_CB_CONTINUE);
+		}
+		return (msd_http_srv_rec_ctl(cli, req, resp));
+	}
+	/* UDP push control: from localhost only. */
+	if (HTTP_REQ_METHOD_GET == req->line.method_code &&
+	    6 < req->line.abs_path_size &&
+	    0 == memcmp(req->line.abs_path, "/push/", 6)) {
+		http_srv_cli_get_addr(cli, &addr);
+		if (0 == sa_addr_is_loopback(&addr)) {
+			resp->status_code = 403;
+			return (HTTP_SRV_CB_CONTINUE);
+		}
+		return (msd_http_srv_push_ctl(cli, req, resp));
+	}
 	/* Stream Hub statistic request. */
 	if (HTTP_REQ_METHOD_GET == req->line.method_code &&
 	    7 < req->line.abs_path_size &&
@@ -660,34 +1847,115 @@ msd_http_srv_on_req_rcv_cb(http_srv_cli_p cli, void *udata __unused,
 	if (12 < req->line.abs_path_size &&
 	    (0 == memcmp(req->line.abs_path, "/udp/", 5) ||
 	    0 == memcmp(req->line.abs_path, "/rtp/", 5))) {
+		/* Profile: by name from "profile" arg, else by group address. */
+		settings = STR_HUBS_BCKT_SETTINGS(g_data.shbskt);
+		if (0 != http_query_val_get(req->line.query, req->line.query_size,
+		    (const uint8_t*)"profile", 7, &ptm, &tm)) {
+			ptm = NULL;
+			tm = 0;
+		}
+		path_size = req->line.abs_path_size;
+		hls = (0 == msd_http_hls_path_parse(req->line.abs_path,
+		    &path_size, 5, &hls_seq));
+		if (0 != str_src_conn_addr_from_str(&src_conn_params,
+		    (const char*)(req->line.abs_path + 5), (path_size - 5))) {
+			resp->status_code = 400;
+			return (HTTP_SRV_CB_CONTINUE);
+		}
+		prof = str_hubs_settings_prof_get(settings, (const char*)ptm, tm,
+		    &src_conn_params.udp.addr);
+		if (NULL == prof) {
+			resp->status_code = 404;
+			return (HTTP_SRV_CB_CONTINUE);
+		}
 		/* Default value. */
-		memcpy(&src_conn_params, &g_data.src_conn_params, sizeof(str_src_conn_mc_t));
-		/* Get multicast address, ifindex, hub name. */
-		resp->status_code = msd_http_req_url_parse(req,
-		    &src_conn_params.udp.addr,
-		    &src_conn_params.mc.if_index,
-		    &src_conn_params.mc.rejoin_time,
-		    buf, sizeof(buf), &buf_size);
+		memcpy(&src_conn_params, &prof->src_conn, sizeof(str_src_conn_mc_t));
+		/* Get multicast address, source, ifindex, hub name. */
+		resp->status_code = msd_http_req_url_parse(req, path_size,
+		    &src_conn_params, buf, sizeof(buf), &buf_size);
 		if (200 != resp->status_code)
 			return (HTTP_SRV_CB_CONTINUE);
-		if (HTTP_REQ_METHOD_HEAD == req->line.method_code) {
-			/* Send HTTP headers only... */
-			resp->status_code = 200;
-			resp->p_flags &= ~HTTP_SRV_RESP_P_F_CONTENT_LEN;
-			if (6 < g_data.hub_params.cust_http_hdrs_size) {
-				resp->hdrs_count = 1;
-				resp->hdrs[0].iov_base = g_data.hub_params.cust_http_hdrs;
-				resp->hdrs[0].iov_len = g_data.hub_params.cust_http_hdrs_size;
-			}
+		if (0 != hls)
+			return (msd_http_srv_hls_req(cli, req, resp, settings,
+			    prof, buf, buf_size, &src_conn_params, hls_seq));
+		return (msd_http_srv_hub_req(cli, req, resp, settings, prof,
+		    buf, buf_size, &src_conn_params));
+	} /* "/udp/" / "/rtp/" */
+
+	/* HTTP pull source: /http/ORIGIN[:PORT][,ORIGIN[:PORT]...]/PATH */
+	if (7 < req->line.abs_path_size &&
+	    0 == memcmp(req->line.abs_path, "/http/", 6)) {
+		settings = STR_HUBS_BCKT_SETTINGS(g_data.shbskt);
+		if (0 != http_query_val_get(req->line.query, req->line.query_size,
+		    (const uint8_t*)"profile", 7, &ptm, &tm)) {
+			ptm = NULL;
+			tm = 0;
+		}
+		path_size = req->line.abs_path_size;
+		hls = (0 == msd_http_hls_path_parse(req->line.abs_path,
+		    &path_size, 6, &hls_seq));
+		str_src_conn_def(&src_conn_params);
+		if (0 != str_src_conn_http_from_str(&src_conn_params,
+		    (const char*)(req->line.abs_path + 6), (path_size - 6)) ||
+		    0 != str_hub_name_make(&src_conn_params, buf, sizeof(buf),
+		    &buf_size)) {
+			resp->status_code = 400;
 			return (HTTP_SRV_CB_CONTINUE);
 		}
-		if (0 != msd_http_srv_hub_attach(cli, buf, buf_size, &src_conn_params)) {
-			resp->status_code = 500;
+		prof = str_hubs_settings_prof_get(settings, (const char*)ptm, tm,
+		    &src_conn_params.udp.addr);
+		if (NULL == prof) {
+			resp->status_code = 404;
 			return (HTTP_SRV_CB_CONTINUE);
 		}
-		/* Will send reply later... */
-		return (HTTP_SRV_CB_NONE);
-	} /* "/udp/" / "/rtp/" */
+		/* Do not connect anywhere by client request unless allowed. */
+		if (0 == (STR_SRC_S_F_HTTP_URL & prof->src.flags)) {
+			resp->status_code = 403;
+			return (HTTP_SRV_CB_CONTINUE);
+		}
+		if (0 != hls)
+			return (msd_http_srv_hls_req(cli, req, resp, settings,
+			    prof, buf, buf_size, &src_conn_params, hls_seq));
+		return (msd_http_srv_hub_req(cli, req, resp, settings, prof,
+		    buf, buf_size, &src_conn_params));
+	} /* "/http/" */
+
+	/* Channel map. */
+	if (4 < req->line.abs_path_size &&
+	    0 == memcmp(req->line.abs_path, "/ch/", 4)) {
+		settings = STR_HUBS_BCKT_SETTINGS(g_data.shbskt);
+		path_size = req->line.abs_path_size;
+		hls = (0 == msd_http_hls_path_parse(req->line.abs_path,
+		    &path_size, 4, &hls_seq));
+		chan = str_hubs_settings_chan_get(settings,
+		    (req->line.abs_path + 4), (path_size - 4));
+		if (NULL == chan) {
+			resp->status_code = 404;
+			return (HTTP_SRV_CB_CONTINUE);
+		}
+		memcpy(&src_conn_params, &chan->src_conn_params,
+		    sizeof(str_src_conn_params_t));
+		if (0 != hls)
+			return (msd_http_srv_hls_req(cli, req, resp, settings,
+			    chan->prof, chan->hub_name, chan->hub_name_size,
+			    &src_conn_params, hls_seq));
+		return (msd_http_srv_hub_req(cli, req, resp, settings, chan->prof,
+		    chan->hub_name, chan->hub_name_size, &src_conn_params));
+	}
+	if (HTTP_REQ_METHOD_GET == req->line.method_code &&
+	    0 == mem_cmpin_cstr("/playlist.m3u", req->line.abs_path, req->line.abs_path_size)) {
+		error = msd_http_playlist_gen(cli, req,
+		    STR_HUBS_BCKT_SETTINGS(g_data.shbskt));
+		if (0 == error) {
+			resp->status_code = 200;
+			resp->hdrs_count = 1;
+			resp->hdrs[0].iov_base = MK_RW_PTR(m3u_cttype);
+			resp->hdrs[0].iov_len = (sizeof(m3u_cttype) - 1);
+		} else {
+			resp->status_code = 500;
+		}
+		return (HTTP_SRV_CB_CONTINUE);
+	}
 
 	/* URL not found. */
 	resp->status_code = 404;
@@ -58,6 +58,7 @@
 #include "stream_sys.h"
 #include "utils/info.h"
 #include "msd_lite_stat_text.h"
+#include "if_table.h"
 
 
 
@@ -76,9 +77,10 @@ gen_hub_stat_text_send_async(str_hubs_bckt_p shbskt, http_srv_cli_p cli) {
 	if (0 != error)
 		return (error);
 	tm = (16384 +
-	    (hstat.str_hub_count * 1024) +
+	    (hstat.str_hub_count * (1024 + 512)) +
 	    1024 +
-	    (hstat.cli_count * (160 + 256 + 1024))
+	    (hstat.cli_count * (160 + 256 + 1024 + 128)) +
+	    (hstat.push_count * 320)
 	    );
 	error = http_srv_cli_buf_realloc(cli, 0, tm);
 	if (0 != error) /* Need more space! */
@@ -96,33 +98,149 @@ gen_hub_stat_text_entry_enum_cb(tpt_p tpt, str_hub_p str_hub, void *udata) {
 	str_hub_cli_p strh_cli, strh_cli_temp;
 	time_t cur_time, time_conn;
 	char straddr[STR_ADDR_LEN], straddr2[STR_ADDR_LEN], ifname[(IFNAMSIZ + 1)], str_time[64];
-	uint32_t i;
-	size_t stm;
+	char strsrc[STR_ADDR_LEN];
+	size_t j;
+	str_hub_cli_tcp_info_p cti;
 	//str_hub_src_conn_udp_tcp_p conn_udp_tcp;
 	str_src_conn_mc_p conn_mc;
+	str_src_conn_http_p conn_http;
+	str_hls_cli_p hls_cli;
+	size_t hls_cli_cnt;
+	tshift_stat_t tss;
+	rec_stat_t rss;
+	rtp_arq_stat_t ras;
+	replay_stat_t rps;
+	str_hub_push_p strh_push;
+	udp_push_stat_t ups;
+	const udp_push_params_t *upp;
 
 	cur_time = gettime_monotonic();
 	io_buf_printf(buf,
 	    "\r\n"
-	    "Stream hub: %s		[thread: %zu @ cpu %i, clients: %zu, dropped clients: %"PRIu64"]\r\n",
+	    "Stream hub: %s		[thread: %zu @ cpu %i, clients: %zu, outputs: %zu, dropped clients: %"PRIu64"]\r\n",
 	    str_hub->name,
 	    tpt_get_num(tpt), tpt_get_cpu_id(tpt),
-	    str_hub->cli_count, str_hub->dropped_count);
+	    str_hub->cli_count, str_hub->push_count, str_hub->dropped_count);
 	/* Sources. */
-	IO_BUF_COPYIN_CSTR(buf, "  Source: multicast");
+	if (STR_SRC_CONN_T_HTTP == str_hub->src_conn_params.udp.type) {
+		conn_http = &str_hub->src_conn_params.http;
+		if (0 != sa_addr_port_to_str(&conn_http->origin[
+		    (str_hub->http_origin % conn_http->origin_count)],
+		    straddr, sizeof(straddr), NULL)) {
+			memcpy(straddr, "<unable to format>", 19);
+		}
+		io_buf_printf(buf,
+		    "  Source: http %s%s	[state: %s, origin: %zu/%zu, reconnects: %"PRIu64", rate: %"PRIu64"]\r\n",
+		    straddr, conn_http->path,
+		    ((STR_SRC_HTTP_ST_DATA == str_hub->http_state) ? "OK" :
+		    ((STR_SRC_HTTP_ST_WAIT == str_hub->http_state) ? "WAIT" : "CONNECTING")),
+		    ((str_hub->http_origin % conn_http->origin_count) + 1),
+		    conn_http->origin_count, str_hub->http_reconnects,
+		    str_hub->baud_rate_in);
+		goto src_done;
+	}
+	if (STR_SRC_CONN_T_FILE == str_hub->src_conn_params.udp.type &&
+	    0 == replay_stat_get(str_hub->replay, &rps)) {
+		io_buf_printf(buf,
+		    "  Source: file %s	[type: %s, state: %s, loops: %"PRIu64", datagrams: %"PRIu64", skipped: %"PRIu64", rate: %"PRIu64"]\r\n",
+		    str_hub->src_conn_params.file.path,
+		    ((0 != rps.pcap) ? "pcap" : "ts"),
+		    ((0 == rps.done) ? "PLAY" :
+		    ((0 == rps.last_error) ? "END" : "ERROR")),
+		    rps.loop_count, rps.pkt_count, rps.skipped_count,
+		    str_hub->baud_rate_in);
+		goto src_done;
+	}
+	if (NULL != str_hub->ring) {
+		IO_BUF_COPYIN_CSTR(buf, "  Source: multicast (packet ring)");
+	} else if (0 != (STR_HUB_F_UDP_GRO & str_hub->flags)) {
+		IO_BUF_COPYIN_CSTR(buf, "  Source: multicast (UDP GRO)");
+	} else {
+		IO_BUF_COPYIN_CSTR(buf, "  Source: multicast");
+	}
 	conn_mc = &str_hub->src_conn_params.mc;
 	if (0 != sa_addr_port_to_str(&conn_mc->udp.addr, straddr,
 	    sizeof(straddr), NULL)) {
 		memcpy(straddr, "<unable to format>", 19);
 	}
 	ifname[0] = 0;
-	if_indextoname(conn_mc->if_index, ifname);
-	io_buf_printf(buf, " %s@%s	",
-	    straddr, ifname);
+	if_table_name_get(conn_mc->if_index, ifname);
+	if (AF_UNSPEC != conn_mc->src.ss_family &&
+	    0 == sa_addr_to_str(&conn_mc->src, strsrc, sizeof(strsrc), NULL)) {
+		io_buf_printf(buf, " %s@%s@%s	",
+		    strsrc, straddr, ifname);
+	} else {
+		io_buf_printf(buf, " %s@%s	",
+		    straddr, ifname);
+	}
 
 	io_buf_printf(buf,
-	    "[state: OK, status: 0, rate: %"PRIu64"]\r\n",
+	    "[state: %s, status: 0, rate: %"PRIu64"]\r\n",
+	    ((0 != (STR_HUB_F_LINK_DOWN & str_hub->flags)) ? "LINK DOWN" : "OK"),
 	    str_hub->baud_rate_in);
+src_done:
+	io_buf_printf(buf, "  Profile: %s	[ring buf: %zu kb, precache: %zu kb]\r\n",
+	    ((0 != str_hub->prof->name_size) ? str_hub->prof->name : "<default>"),
+	    (str_hub->prof->hub.ring_buf_size / 1024),
+	    (str_hub->prof->hub.precache / 1024));
+	if (NULL != str_hub->arq &&
+	    0 == rtp_arq_stat_get(str_hub->arq, &ras)) {
+		io_buf_printf(buf, "  RTP ARQ: requested: %"PRIu64", recovered: %"PRIu64", late: %"PRIu64", lost: %"PRIu64", NACKs: %"PRIu64", resync: %"PRIu64"\r\n",
+		    ras.requested, ras.recovered, ras.late, ras.lost,
+		    ras.nack_count, ras.resync_count);
+	}
+	if (0 != (STR_HUB_F_RCV_TS & str_hub->flags)) {
+		io_buf_printf(buf, "  Receive to send latency: avg %"PRIu64" us, max (2s) %"PRIu64" us\r\n",
+		    (str_hub->rcv_lat_avg / 1000),
+		    (str_hub->rcv_lat_max_last / 1000));
+	}
+	if (0 != str_hub->rcv_trunc_count) {
+		io_buf_printf(buf, "  Truncated receives: %"PRIu64"\r\n",
+		    str_hub->rcv_trunc_count);
+	}
+	if (NULL != str_hub->hls) {
+		hls_cli_cnt = 0;
+		TAILQ_FOREACH(hls_cli, &str_hub->hls_cli_head, next) {
+			hls_cli_cnt ++;
+		}
+		io_buf_printf(buf, "  HLS: requests: %"PRIu64", sending segments: %zu, last request: %"PRIu64" s ago\r\n",
+		    str_hub->hls_req_count, hls_cli_cnt,
+		    (uint64_t)(cur_time - str_hub->hls_last_req));
+	}
+	if (NULL != str_hub->tshift &&
+	    0 == tshift_stat_get(str_hub->tshift, &tss)) {
+		io_buf_printf(buf, "  Time-shift: stored: %"PRIu64" s, PCR span: %"PRIu64" s, written: %"PRIu64" kb, dropped: %"PRIu64" kb\r\n",
+		    ((tss.time_last - tss.time_first) / 1000),
+		    ((0 != tss.pcr_first && tss.pcr_last > tss.pcr_first) ?
+		    ((tss.pcr_last - tss.pcr_first) / 27000000) : 0),
+		    (tss.written_size / 1024), (tss.dropped_size / 1024));
+	}
+	if (NULL != str_hub->rec &&
+	    0 == rec_stat_get(str_hub->rec, &rss)) {
+		io_buf_printf(buf, "  Recording: state: %s, rate: %"PRIu64" kb/s, written: %"PRIu64" kb, backlog: %zu kb, dropped: %"PRIu64" kb, files: %"PRIu32"\r\n",
+		    ((0 != rss.last_error) ? "ERROR" :
+		    ((0 != rss.overflow) ? "OVERFLOW" : "OK")),
+		    (rss.write_rate / 1024), (rss.written_size / 1024),
+		    (rss.backlog_size / 1024), (rss.dropped_size / 1024),
+		    rss.file_count);
+	}
+	/* Drop reasons. */
+	IO_BUF_COPYIN_CSTR(buf, "  Dropped:");
+	for (j = 1; j < STR_HUB_CLI_DROP_R__COUNT; j ++) {
+		io_buf_printf(buf, " %s: %"PRIu64",",
+		    str_hub_cli_drop_reason_str((uint32_t)j),
+		    str_hub->drop_reason_count[j]);
+	}
+	IO_BUF_COPYIN_CSTR(buf, "\r\n");
+	/* Clients lag histogram, last stat period. */
+	IO_BUF_COPYIN_CSTR(buf, "  Lag histogram (2s):");
+	for (j = 0; j < (STR_HUB_LAG_HIST_COUNT - 1); j ++) {
+		io_buf_printf(buf, " <%"PRIu64"ms: %"PRIu64",",
+		    str_hub_lag_hist_ms[j], str_hub->lag_hist_last[j]);
+	}
+	io_buf_printf(buf, " >=%"PRIu64"ms: %"PRIu64"\r\n",
+	    str_hub_lag_hist_ms[(STR_HUB_LAG_HIST_COUNT - 2)],
+	    str_hub->lag_hist_last[(STR_HUB_LAG_HIST_COUNT - 1)]);
 
 	/* Clients. */
 	TAILQ_FOREACH_SAFE(strh_cli, &str_hub->cli_head, next, strh_cli_temp) {
@@ -137,26 +255,47 @@ gen_hub_stat_text_entry_enum_cb(tpt_p tpt, str_hub_p str_hub, void *udata) {
 		//&cli_ud->xreal_addr
 		time_conn = (cur_time - strh_cli->conn_time);
 		fmt_as_uptime(&time_conn, str_time, sizeof(str_time));
-		
-		if (0 != skt_get_tcp_cc(strh_cli->skt,
-		    ifname, sizeof(ifname), NULL)) {
-			memcpy(ifname, "<unable to get>", 16);
-		}
-		if (0 != skt_get_tcp_maxseg(strh_cli->skt, (int*)&i)) {
-			i = 0;
-		}
+		/* Socket TCP stat: from cache, updated by timer. */
+		cti = &strh_cli->tcp_info;
 
 		io_buf_printf(buf,
-		    "	%s (%s)	[conn time: %s, flags: %u, cc: %s, maxseg: %"PRIu32"]	[user agent: %s]\r\n",
-		    straddr, straddr2, str_time, strh_cli->flags, ifname, i,
-		    (char*)strh_cli->user_agent
+		    "	%s (%s)	[conn time: %s, flags: %u, cc: %s, maxseg: %"PRIu32"]	[user agent: %s]\r\n"
+		    "	    [sended: %"PRIu64", lag: %zu bytes / %"PRIu64" ms, lag max: %zu bytes / %"PRIu64" ms, blocked: %"PRIu64", snd buf: %"PRIu32"]\r\n"
+		    "	    [rtt: %"PRIu32" us, rttvar: %"PRIu32" us, cwnd: %"PRIu32", retrans: %"PRIu64", delivery rate: %"PRIu64", notsent: %"PRIu32", age: %"PRIu64" s]\r\n",
+		    straddr, straddr2, str_time, strh_cli->flags,
+		    cti->cc_name, cti->maxseg,
+		    (char*)strh_cli->user_agent,
+		    strh_cli->sended_count,
+		    strh_cli->lag_size, strh_cli->lag_ms,
+		    strh_cli->lag_size_max, strh_cli->lag_ms_max,
+		    strh_cli->blocked_count, strh_cli->skt_snd_buf_real,
+		    cti->rtt, cti->rttvar, cti->cwnd, cti->retrans,
+		    cti->delivery_rate, cti->notsent,
+		    (uint64_t)((0 != cti->time) ? (cur_time - cti->time) : 0)
 		);
-		/* Add soscket TCP stat. */
-		if (0 == skt_tcp_stat_text(strh_cli->skt, "	    ",
-		    (char*)IO_BUF_FREE_GET(buf),
-		    IO_BUF_FREE_SIZE(buf), &stm)) {
-			IO_BUF_USED_INC(buf, stm);
+	}
+	/* UDP push outputs and multicast relays. */
+	TAILQ_FOREACH(strh_push, &str_hub->push_head, next) {
+		if (0 != udp_push_stat_get(strh_push->push, &ups))
+			continue;
+		upp = udp_push_params_get(strh_push->push);
+		if (0 != sa_addr_port_to_str(&upp->addr, straddr,
+		    sizeof(straddr), NULL)) {
+			memcpy(straddr, "<unable to format>", 19);
+		}
+		if (0 == upp->if_index ||
+		    NULL == if_indextoname(upp->if_index, ifname)) {
+			memcpy(ifname, "default", 8);
 		}
+		time_conn = (cur_time - strh_push->conn_time);
+		fmt_as_uptime(&time_conn, str_time, sizeof(str_time));
+		io_buf_printf(buf,
+		    "	%s://%s	[conn time: %s, if: %s, ttl: %"PRIu32", pacing: %"PRIu32" kbit/s]\r\n"
+		    "	    [sended: %"PRIu64", packets: %"PRIu64", dropped: %"PRIu64", errors: %"PRIu64", last error: %i]\r\n",
+		    ((0 != (UDP_PUSH_F_RTP & upp->flags)) ? "rtp" : "udp"),
+		    straddr, str_time, ifname, upp->ttl, upp->pacing_rate,
+		    ups.sended_size, ups.pkt_count, ups.dropped_size,
+		    ups.err_count, ups.last_error);
 	}
 }
 static void
@@ -194,6 +333,7 @@ gen_stat_text(const char *package_name, const char *package_version,
 	io_buf_p buf;
 	struct tm stime;
 	str_hubs_stat_t hstat, *stat;
+	access_log_stat_t alstat;
 	http_srv_stat_t http_srv_stat;
 
 
@@ -252,6 +392,8 @@ gen_stat_text(const char *package_name, const char *package_version,
 		    "Thread: %zu @ cpu %i\r\n"
 		    "Stream hub count: %zu\r\n"
 		    "Clients count: %zu\r\n"
+		    "Dropped clients: %"PRIu64"\r\n"
+		    "Clients send buf: %"PRIu64" kb\r\n"
 		    "Rate in: %"PRIu64" mbps\r\n"
 		    "Rate out: %"PRIu64" mbps\r\n"
 		    "Total rate: %"PRIu64" mbps\r\n"
@@ -259,6 +401,8 @@ gen_stat_text(const char *package_name, const char *package_version,
 		    i, tpt_get_cpu_id(tp_thread_get(tp, i)),
 		    stat->str_hub_count,
 		     stat->cli_count,
+		    stat->dropped_count,
+		    (stat->skt_snd_buf / 1024),
 		    ( stat->baud_rate_in / (1024 * 1024)),
 		    ( stat->baud_rate_out / (1024 * 1024)),
 		    (( stat->baud_rate_in +
@@ -269,15 +413,41 @@ gen_stat_text(const char *package_name, const char *package_version,
 	    "Summary\r\n"
 	    "Stream hub count: %zu\r\n"
 	    "Clients count: %zu\r\n"
+	    "Dropped clients: %"PRIu64"\r\n"
+	    "Clients send buf: %"PRIu64" kb\r\n"
 	    "Rate in: %"PRIu64" mbps\r\n"
 	    "Rate out: %"PRIu64" mbps\r\n"
 	    "Total rate: %"PRIu64" mbps\r\n"
 	    "\r\n\r\n",
 	    hstat.str_hub_count,
 	    hstat.cli_count,
+	    hstat.dropped_count,
+	    (hstat.skt_snd_buf / 1024),
 	    (hstat.baud_rate_in / (1024 * 1024)),
 	    (hstat.baud_rate_out / (1024 * 1024)),
 	    ((hstat.baud_rate_in + hstat.baud_rate_out) / (1024 * 1024)));
+	/* Admission control. */
+	io_buf_printf(buf, "Rejected requests\r\n");
+	for (i = 1; i < STR_HUBS_REJ_R__COUNT; i ++) {
+		io_buf_printf(buf, "%s: %"PRIu64"\r\n",
+		    str_hubs_reject_reason_str((uint32_t)i),
+		    (uint64_t)atomic_load_explicit(&shbskt->rejected_count[i],
+		    memory_order_relaxed));
+	}
+	io_buf_printf(buf, "Dead sources cached: %zu\r\n",
+	    (size_t)atomic_load_explicit(&shbskt->neg_count,
+	    memory_order_relaxed));
+	if (0 == access_log_stat_get(shbskt->alog, &alstat)) {
+		io_buf_printf(buf,
+		    "\r\n"
+		    "Access log\r\n"
+		    "Written: %"PRIu64"\r\n"
+		    "Dropped: %"PRIu64"\r\n"
+		    "Rotated: %"PRIu64"\r\n",
+		    alstat.written_count, alstat.dropped_count,
+		    alstat.rotate_count);
+	}
+	IO_BUF_COPYIN_CSTR(buf, "\r\n\r\n");
 
 	error = info_sysres(sysres, (char*)IO_BUF_FREE_GET(buf),
 	    IO_BUF_FREE_SIZE(buf), &tm);
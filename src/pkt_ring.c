@@ -0,0 +1,422 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <netinet/in.h>
+#ifdef __linux__ /* Linux specific code. */
+#	include <linux/if_packet.h>
+#	include <linux/if_ether.h>
+#	include <linux/filter.h>
+#endif
+
+#include <stdlib.h> /* malloc, exit */
+#include <unistd.h> /* close, write, sysconf */
+#include <inttypes.h>
+#include <string.h> /* bcopy, bzero, memcpy, memmove, memset, strerror... */
+#include <errno.h>
+#include <syslog.h>
+
+#include "utils/macro.h"
+#include "threadpool/threadpool.h"
+#include "threadpool/threadpool_task.h"
+#include "pkt_ring.h"
+
+
+void
+pkt_ring_settings_def(pkt_ring_settings_p p_ret) {
+
+	if (NULL == p_ret)
+		return;
+	memset(p_ret, 0x00, sizeof(pkt_ring_settings_t));
+	p_ret->block_size = PKT_RING_S_DEF_BLOCK_SIZE;
+	p_ret->block_count = PKT_RING_S_DEF_BLOCK_COUNT;
+	p_ret->block_timeout = PKT_RING_S_DEF_BLOCK_TIMEOUT;
+}
+
+
+#ifndef __linux__ /* Not Linux: stubs. */
+
+int
+pkt_ring_create(tpt_p tpt __unused, uint32_t if_index __unused,
+    pkt_ring_settings_p s __unused, pkt_ring_pkt_cb pkt_cb __unused,
+    pkt_ring_block_cb block_cb __unused, void *udata __unused,
+    pkt_ring_p *pkt_ring_ret __unused) {
+
+	return (EOPNOTSUPP);
+}
+
+void
+pkt_ring_destroy(pkt_ring_p pkt_ring __unused) {
+}
+
+int
+pkt_ring_filter_set(pkt_ring_p pkt_ring __unused,
+    const struct sockaddr_storage **addrs __unused, size_t count __unused) {
+
+	return (EOPNOTSUPP);
+}
+
+#else /* Linux specific code. */
+
+#define PKT_RING_FRAME_SIZE	2048
+#define PKT_RING_SNAP_LEN	0x0000ffff
+/* BPF instructions: header + per address + tail. */
+#define PKT_RING_BPF_HDR_MAX	16
+#define PKT_RING_BPF_PER_ADDR	5
+#define PKT_RING_BPF_MAX						\
+	((2 * PKT_RING_BPF_HDR_MAX) + (PKT_RING_FILTER_MAX * PKT_RING_BPF_PER_ADDR))
+
+typedef struct pkt_ring_s {
+	tp_task_p	tptask;		/* AF_PACKET socket. */
+	uint8_t		*map;		/* mmap()ed ring. */
+	size_t		map_size;
+	uint32_t	block_size;
+	uint32_t	block_count;
+	uint32_t	block_cur;	/* Next block to read. */
+	pkt_ring_pkt_cb	pkt_cb;
+	pkt_ring_block_cb block_cb;
+	void		*udata;
+} pkt_ring_t;
+
+
+static int	pkt_ring_bpf_set(uintptr_t skt, struct sock_filter *prog,
+		    size_t count);
+static void	pkt_ring_block_process(pkt_ring_p pkt_ring,
+		    struct tpacket_block_desc *bd);
+static int	pkt_ring_rcv_cb(tp_task_p tptask, int error, uint32_t eof,
+		    size_t data2transfer_size, void *arg);
+
+
+int
+pkt_ring_create(tpt_p tpt, uint32_t if_index, pkt_ring_settings_p s,
+    pkt_ring_pkt_cb pkt_cb, pkt_ring_block_cb block_cb, void *udata,
+    pkt_ring_p *pkt_ring_ret) {
+	int error, ival;
+	uintptr_t skt;
+	size_t page_size;
+	pkt_ring_p pkt_ring;
+	struct tpacket_req3 req;
+	struct sockaddr_ll sll;
+	struct sock_filter drop_all = BPF_STMT((BPF_RET | BPF_K), 0);
+
+	if (NULL == tpt || 0 == if_index || NULL == s || NULL == pkt_cb ||
+	    NULL == pkt_ring_ret)
+		return (EINVAL);
+	pkt_ring = calloc(1, sizeof(pkt_ring_t));
+	if (NULL == pkt_ring)
+		return (ENOMEM);
+	pkt_ring->map = MAP_FAILED;
+	pkt_ring->pkt_cb = pkt_cb;
+	pkt_ring->block_cb = block_cb;
+	pkt_ring->udata = udata;
+	/* Block size: multiple of page size. */
+	page_size = (size_t)sysconf(_SC_PAGESIZE);
+	pkt_ring->block_size = (uint32_t)MAX(page_size,
+	    (s->block_size - (s->block_size % page_size)));
+	pkt_ring->block_count = MAX(2, s->block_count);
+	pkt_ring->map_size = ((size_t)pkt_ring->block_size *
+	    pkt_ring->block_count);
+
+	skt = (uintptr_t)socket(AF_PACKET,
+	    (SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC), htons(ETH_P_ALL));
+	if ((uintptr_t)-1 == skt) {
+		error = errno;
+		goto err_out;
+	}
+	/* Nothing before filter set. */
+	error = pkt_ring_bpf_set(skt, &drop_all, 1);
+	if (0 != error)
+		goto err_out;
+	ival = TPACKET_V3;
+	if (0 != setsockopt((int)skt, SOL_PACKET, PACKET_VERSION, &ival,
+	    sizeof(ival))) {
+		error = errno;
+		goto err_out;
+	}
+	memset(&req, 0x00, sizeof(req));
+	req.tp_block_size = pkt_ring->block_size;
+	req.tp_block_nr = pkt_ring->block_count;
+	req.tp_frame_size = PKT_RING_FRAME_SIZE;
+	req.tp_frame_nr = ((pkt_ring->block_size / PKT_RING_FRAME_SIZE) *
+	    pkt_ring->block_count);
+	req.tp_retire_blk_tov = MAX(1, s->block_timeout);
+	if (0 != setsockopt((int)skt, SOL_PACKET, PACKET_RX_RING, &req,
+	    sizeof(req))) {
+		error = errno;
+		goto err_out;
+	}
+	pkt_ring->map = mmap(NULL, pkt_ring->map_size, (PROT_READ | PROT_WRITE),
+	    (MAP_SHARED | MAP_LOCKED), (int)skt, 0);
+	if (MAP_FAILED == pkt_ring->map) { /* Retry without lock. */
+		pkt_ring->map = mmap(NULL, pkt_ring->map_size,
+		    (PROT_READ | PROT_WRITE), MAP_SHARED, (int)skt, 0);
+	}
+	if (MAP_FAILED == pkt_ring->map) {
+		error = errno;
+		goto err_out;
+	}
+	memset(&sll, 0x00, sizeof(sll));
+	sll.sll_family = AF_PACKET;
+	sll.sll_protocol = htons(ETH_P_ALL);
+	sll.sll_ifindex = (int)if_index;
+	if (0 != bind((int)skt, (struct sockaddr*)&sll, sizeof(sll))) {
+		error = errno;
+		goto err_out;
+	}
+	error = tp_task_notify_create(tpt, skt, TP_TASK_F_CLOSE_ON_DESTROY,
+	    TP_EV_READ, 0, pkt_ring_rcv_cb, pkt_ring, &pkt_ring->tptask);
+	if (0 != error)
+		goto err_out;
+
+	(*pkt_ring_ret) = pkt_ring;
+	return (0);
+
+err_out:
+	if (MAP_FAILED != pkt_ring->map) {
+		munmap(pkt_ring->map, pkt_ring->map_size);
+	}
+	if ((uintptr_t)-1 != skt) {
+		close((int)skt);
+	}
+	free(pkt_ring);
+	return (error);
+}
+
+void
+pkt_ring_destroy(pkt_ring_p pkt_ring) {
+
+	if (NULL == pkt_ring)
+		return;
+	tp_task_destroy(pkt_ring->tptask);
+	munmap(pkt_ring->map, pkt_ring->map_size);
+	free(pkt_ring);
+}
+
+
+/*
+ * Offsets from network header (SOCK_DGRAM):
+ * IPv4: proto at 9, frag at 6, dst at 16, UDP dst port at IHL + 2.
+ * IPv6: next header at 6, dst low 32 bit at 36, UDP dst port at 42.
+ * IPv6 addresses compared by low 32 bit only, callback must check.
+ */
+int
+pkt_ring_filter_set(pkt_ring_p pkt_ring,
+    const struct sockaddr_storage **addrs, size_t count) {
+	int error;
+	size_t i, cnt = 0, v6_jmp;
+	struct sock_filter *prog;
+	const struct sockaddr_in *sain;
+	const struct sockaddr_in6 *sain6;
+	uint32_t addr;
+	int accept_all = (PKT_RING_FILTER_MAX < count);
+
+	if (NULL == pkt_ring || (NULL == addrs && 0 != count))
+		return (EINVAL);
+	prog = calloc(PKT_RING_BPF_MAX, sizeof(struct sock_filter));
+	if (NULL == prog)
+		return (ENOMEM);
+#define PKT_RING_BPF_ADD(__code, __jt, __jf, __k)			\
+	prog[cnt ++] = (struct sock_filter)BPF_JUMP((__code), (__k), (__jt), (__jf))
+	/* Only multicast in. */
+	PKT_RING_BPF_ADD((BPF_LD | BPF_W | BPF_ABS), 0, 0,
+	    (uint32_t)(SKF_AD_OFF + SKF_AD_PKTTYPE));
+	PKT_RING_BPF_ADD((BPF_JMP | BPF_JEQ | BPF_K), 1, 0, PACKET_MULTICAST);
+	PKT_RING_BPF_ADD((BPF_RET | BPF_K), 0, 0, 0);
+	PKT_RING_BPF_ADD((BPF_LD | BPF_W | BPF_ABS), 0, 0,
+	    (uint32_t)(SKF_AD_OFF + SKF_AD_PROTOCOL));
+	PKT_RING_BPF_ADD((BPF_JMP | BPF_JEQ | BPF_K), 1, 0, ETH_P_IP);
+	v6_jmp = cnt;
+	PKT_RING_BPF_ADD((BPF_JMP | BPF_JA), 0, 0, 0); /* Set later. */
+	/* IPv4: UDP, not fragmented. */
+	PKT_RING_BPF_ADD((BPF_LD | BPF_B | BPF_ABS), 0, 0, 9);
+	PKT_RING_BPF_ADD((BPF_JMP | BPF_JEQ | BPF_K), 1, 0, IPPROTO_UDP);
+	PKT_RING_BPF_ADD((BPF_RET | BPF_K), 0, 0, 0);
+	PKT_RING_BPF_ADD((BPF_LD | BPF_H | BPF_ABS), 0, 0, 6);
+	PKT_RING_BPF_ADD((BPF_JMP | BPF_JSET | BPF_K), 0, 1, 0x3fff);
+	PKT_RING_BPF_ADD((BPF_RET | BPF_K), 0, 0, 0);
+	if (0 != accept_all) {
+		PKT_RING_BPF_ADD((BPF_RET | BPF_K), 0, 0, PKT_RING_SNAP_LEN);
+	} else {
+		PKT_RING_BPF_ADD((BPF_LDX | BPF_B | BPF_MSH), 0, 0, 0);
+		for (i = 0; i < count; i ++) {
+			if (AF_INET != addrs[i]->ss_family)
+				continue;
+			sain = (const struct sockaddr_in*)(const void*)addrs[i];
+			PKT_RING_BPF_ADD((BPF_LD | BPF_W | BPF_ABS), 0, 0, 16);
+			PKT_RING_BPF_ADD((BPF_JMP | BPF_JEQ | BPF_K), 0, 3,
+			    ntohl(sain->sin_addr.s_addr));
+			PKT_RING_BPF_ADD((BPF_LD | BPF_H | BPF_IND), 0, 0, 2);
+			PKT_RING_BPF_ADD((BPF_JMP | BPF_JEQ | BPF_K), 0, 1,
+			    ntohs(sain->sin_port));
+			PKT_RING_BPF_ADD((BPF_RET | BPF_K), 0, 0, PKT_RING_SNAP_LEN);
+		}
+		PKT_RING_BPF_ADD((BPF_RET | BPF_K), 0, 0, 0);
+	}
+	/* IPv6: UDP without extension headers. */
+	prog[v6_jmp].k = (uint32_t)(cnt - (v6_jmp + 1));
+	PKT_RING_BPF_ADD((BPF_JMP | BPF_JEQ | BPF_K), 1, 0, ETH_P_IPV6);
+	PKT_RING_BPF_ADD((BPF_RET | BPF_K), 0, 0, 0);
+	PKT_RING_BPF_ADD((BPF_LD | BPF_B | BPF_ABS), 0, 0, 6);
+	PKT_RING_BPF_ADD((BPF_JMP | BPF_JEQ | BPF_K), 1, 0, IPPROTO_UDP);
+	PKT_RING_BPF_ADD((BPF_RET | BPF_K), 0, 0, 0);
+	if (0 != accept_all) {
+		PKT_RING_BPF_ADD((BPF_RET | BPF_K), 0, 0, PKT_RING_SNAP_LEN);
+	} else {
+		for (i = 0; i < count; i ++) {
+			if (AF_INET6 != addrs[i]->ss_family)
+				continue;
+			sain6 = (const struct sockaddr_in6*)(const void*)addrs[i];
+			memcpy(&addr, &sain6->sin6_addr.s6_addr[12], sizeof(addr));
+			PKT_RING_BPF_ADD((BPF_LD | BPF_W | BPF_ABS), 0, 0, 36);
+			PKT_RING_BPF_ADD((BPF_JMP | BPF_JEQ | BPF_K), 0, 3,
+			    ntohl(addr));
+			PKT_RING_BPF_ADD((BPF_LD | BPF_H | BPF_ABS), 0, 0, 42);
+			PKT_RING_BPF_ADD((BPF_JMP | BPF_JEQ | BPF_K), 0, 1,
+			    ntohs(sain6->sin6_port));
+			PKT_RING_BPF_ADD((BPF_RET | BPF_K), 0, 0, PKT_RING_SNAP_LEN);
+		}
+		PKT_RING_BPF_ADD((BPF_RET | BPF_K), 0, 0, 0);
+	}
+#undef PKT_RING_BPF_ADD
+	error = pkt_ring_bpf_set(tp_task_ident_get(pkt_ring->tptask),
+	    prog, cnt);
+	free(prog);
+
+	return (error);
+}
+
+static int
+pkt_ring_bpf_set(uintptr_t skt, struct sock_filter *prog, size_t count) {
+	struct sock_fprog fprog;
+
+	fprog.len = (unsigned short)count;
+	fprog.filter = prog;
+	if (0 != setsockopt((int)skt, SOL_SOCKET, SO_ATTACH_FILTER, &fprog,
+	    sizeof(fprog)))
+		return (errno);
+
+	return (0);
+}
+
+
+static void
+pkt_ring_block_process(pkt_ring_p pkt_ring, struct tpacket_block_desc *bd) {
+	struct tpacket3_hdr *hdr;
+	const uint8_t *l3, *l4;
+	size_t l3_size, ihl, len;
+	uint32_t i, num_pkts;
+	pkt_ring_pkt_t pkt;
+
+	num_pkts = bd->hdr.bh1.num_pkts;
+	hdr = (struct tpacket3_hdr*)(void*)(((uint8_t*)bd) +
+	    bd->hdr.bh1.offset_to_first_pkt);
+	for (i = 0; i < num_pkts; i ++,
+	    hdr = (struct tpacket3_hdr*)(void*)(((uint8_t*)hdr) + hdr->tp_next_offset)) {
+		if (hdr->tp_snaplen < hdr->tp_len)
+			continue; /* Truncated. */
+		l3 = (((const uint8_t*)hdr) + hdr->tp_net);
+		l3_size = hdr->tp_snaplen;
+		if (20 > l3_size)
+			continue;
+		switch ((l3[0] >> 4)) {
+		case 4:
+			ihl = ((size_t)(l3[0] & 0x0f) * 4);
+			len = ((((size_t)l3[2]) << 8) | l3[3]);
+			if (20 > ihl || len > l3_size ||
+			    (ihl + 8) > len || IPPROTO_UDP != l3[9])
+				continue;
+			pkt.family = AF_INET;
+			pkt.src = (l3 + 12);
+			pkt.dst = (l3 + 16);
+			l4 = (l3 + ihl);
+			len -= ihl;
+			break;
+		case 6:
+			len = ((((size_t)l3[4]) << 8) | l3[5]);
+			if (48 > l3_size || (40 + len) > l3_size ||
+			    8 > len || IPPROTO_UDP != l3[6])
+				continue;
+			pkt.family = AF_INET6;
+			pkt.src = (l3 + 8);
+			pkt.dst = (l3 + 24);
+			l4 = (l3 + 40);
+			break;
+		default:
+			continue;
+		}
+		/* UDP: length from UDP header, not bigger than IP payload. */
+		len = MIN(len, ((((size_t)l4[4]) << 8) | l4[5]));
+		if (8 > len)
+			continue;
+		memcpy(&pkt.dst_port, (l4 + 2), sizeof(uint16_t));
+		pkt.data = (l4 + 8);
+		pkt.data_size = (len - 8);
+		pkt.ts.tv_sec = (time_t)hdr->tp_sec;
+		pkt.ts.tv_nsec = (long)hdr->tp_nsec;
+		pkt_ring->pkt_cb(pkt_ring, &pkt, pkt_ring->udata);
+	}
+}
+
+static int
+pkt_ring_rcv_cb(tp_task_p tptask __unused, int error, uint32_t eof __unused,
+    size_t data2transfer_size __unused, void *arg) {
+	pkt_ring_p pkt_ring = arg;
+	struct tpacket_block_desc *bd;
+	uint32_t processed = 0;
+
+	if (0 != error) {
+		SYSLOG_ERR(LOG_NOTICE, error, "On packet ring.");
+		return (TP_TASK_CB_CONTINUE);
+	}
+	/* Do not spin forever: at most one ring turn per wakeup. */
+	while (processed < pkt_ring->block_count) {
+		bd = (struct tpacket_block_desc*)(void*)(pkt_ring->map +
+		    ((size_t)pkt_ring->block_cur * pkt_ring->block_size));
+		if (0 == (TP_STATUS_USER &
+		    __atomic_load_n(&bd->hdr.bh1.block_status, __ATOMIC_ACQUIRE)))
+			break;
+		pkt_ring_block_process(pkt_ring, bd);
+		__atomic_store_n(&bd->hdr.bh1.block_status, TP_STATUS_KERNEL,
+		    __ATOMIC_RELEASE);
+		pkt_ring->block_cur = ((pkt_ring->block_cur + 1) %
+		    pkt_ring->block_count);
+		processed ++;
+	}
+	if (0 != processed && NULL != pkt_ring->block_cb) {
+		pkt_ring->block_cb(pkt_ring, pkt_ring->udata);
+	}
+
+	return (TP_TASK_CB_CONTINUE);
+}
+
+#endif /* Linux specific code. */
@@ -0,0 +1,93 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+
+#ifndef __MSD_PKT_RING_H__
+#define __MSD_PKT_RING_H__
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <inttypes.h>
+
+#include "threadpool/threadpool.h"
+
+
+/*
+ * Packet ring receiver: one AF_PACKET TPACKET_V3 mmap ring per interface.
+ * Kernel filter (BPF) accept only UDP to listed group:port, packets
+ * delivered to callback by blocks, so one wakeup serve many groups.
+ * Multicast group membership is not managed here: keep joined socket.
+ * Linux only, on other OS pkt_ring_create() return EOPNOTSUPP.
+ */
+
+typedef struct pkt_ring_s	*pkt_ring_p;
+
+typedef struct pkt_ring_settings_s {
+	uint32_t	block_size;	/* Bytes, multiple of page size. */
+	uint32_t	block_count;
+	uint32_t	block_timeout;	/* ms, retire not filled block. */
+} pkt_ring_settings_t, *pkt_ring_settings_p;
+/* Default values. */
+#define PKT_RING_S_DEF_BLOCK_SIZE	(256)	/* kb */
+#define PKT_RING_S_DEF_BLOCK_COUNT	(16)
+#define PKT_RING_S_DEF_BLOCK_TIMEOUT	(8)	/* ms */
+
+#define PKT_RING_FILTER_MAX	768 /* Group:port pairs, more = accept all multicast UDP. */
+
+/* UDP datagram from ring, valid only in callback. */
+typedef struct pkt_ring_pkt_s {
+	sa_family_t	family;		/* AF_INET / AF_INET6. */
+	const uint8_t	*src;		/* Source address: 4 or 16 bytes. */
+	const uint8_t	*dst;		/* Group address: 4 or 16 bytes. */
+	uint16_t	dst_port;	/* Network byte order. */
+	const uint8_t	*data;		/* UDP payload. */
+	size_t		data_size;
+	struct timespec	ts;		/* Kernel rx time, CLOCK_REALTIME. */
+} pkt_ring_pkt_t, *pkt_ring_pkt_p;
+
+/* pkt_cb called for each packet in block, then block_cb once. */
+typedef void (*pkt_ring_pkt_cb)(pkt_ring_p pkt_ring, pkt_ring_pkt_p pkt,
+	    void *udata);
+typedef void (*pkt_ring_block_cb)(pkt_ring_p pkt_ring, void *udata);
+
+
+void	pkt_ring_settings_def(pkt_ring_settings_p p_ret);
+
+int	pkt_ring_create(tpt_p tpt, uint32_t if_index, pkt_ring_settings_p s,
+	    pkt_ring_pkt_cb pkt_cb, pkt_ring_block_cb block_cb, void *udata,
+	    pkt_ring_p *pkt_ring_ret);
+void	pkt_ring_destroy(pkt_ring_p pkt_ring);
+
+/* Replace kernel filter: accept only UDP to addrs (group + port). */
+int	pkt_ring_filter_set(pkt_ring_p pkt_ring,
+	    const struct sockaddr_storage **addrs, size_t count);
+
+
+#endif // __MSD_PKT_RING_H__
@@ -0,0 +1,446 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <sys/stat.h> /* For mode constants */
+#include <fcntl.h> /* For O_* constants */
+
+#include <stdlib.h> /* malloc, exit */
+#include <stdio.h> /* snprintf */
+#include <unistd.h> /* close, write, sysconf */
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <string.h> /* bcopy, bzero, memcpy, memmove, memset, strerror... */
+#include <time.h>
+#include <errno.h>
+#include <syslog.h>
+
+#include "utils/macro.h"
+#include "wr_queue.h"
+#include "rec.h"
+
+
+#define REC_MEM_ALIGN		4096 /* O_DIRECT buffer alignment. */
+#define REC_FILE_OPEN_TRYES	16 /* Add suffix if file exist. */
+
+typedef struct rec_chunk_s {
+	uint8_t		*data;
+	size_t		size;		/* 0 = free. */
+} rec_chunk_t, *rec_chunk_p;
+
+typedef struct rec_s {
+	wr_queue_t	q;		/* Chunks queue: hub thread -> I/O thread. */
+	atomic_uint_fast64_t written_size;
+	atomic_uint_fast64_t write_rate;
+	atomic_uint_fast64_t dropped_size;
+	atomic_uint_fast32_t file_count;
+	atomic_int	last_error;
+	rec_writer_p	rw;
+	rec_chunk_p	chunks;		/* Queue. */
+	int		overflow;	/* Producer: last write not fit. */
+	/* I/O thread only. */
+	int		fd;		/* Current file. */
+	uint64_t	file_size;
+	time_t		file_time;	/* Monotonic, s: file open time. */
+	uint64_t	rate_size;	/* Written in current rate window. */
+	uint64_t	rate_time;	/* Monotonic, ms: rate window start. */
+	size_t		name_size;
+	char		name[REC_NAME_MAX];
+} rec_t;
+
+typedef struct rec_writer_s {
+	rec_writer_settings_t s;	/* Settings, bytes. */
+	wr_thread_t	wt;		/* I/O thread. */
+} rec_writer_t;
+
+
+static size_t	rec_drain(wr_queue_p q, int dead, void *udata);
+static void	rec_free_cb(wr_queue_p q, void *udata);
+static int	rec_file_open(rec_writer_p rw, rec_p rec);
+static int	rec_write_all(int fd, const uint8_t *buf, size_t buf_size);
+static void	rec_free(rec_p rec);
+static inline uint64_t rec_time_ms(void);
+
+
+
+void
+rec_writer_settings_def(rec_writer_settings_p p_ret) {
+
+	if (NULL == p_ret)
+		return;
+	memset(p_ret, 0x00, sizeof(rec_writer_settings_t));
+	p_ret->flags = REC_W_S_DEF_FLAGS;
+	p_ret->write_interval = REC_W_S_DEF_WRITE_INTERVAL;
+	p_ret->chunk_size = REC_W_S_DEF_CHUNK_SIZE;
+	p_ret->queue_size = REC_W_S_DEF_QUEUE_SIZE;
+	p_ret->rotate_size = REC_W_S_DEF_ROTATE_SIZE;
+	p_ret->rotate_time = REC_W_S_DEF_ROTATE_TIME;
+	memcpy(p_ret->dir, REC_W_S_DEF_DIR, sizeof(REC_W_S_DEF_DIR));
+}
+
+int
+rec_writer_create(rec_writer_settings_p s, rec_writer_p *rw_ret) {
+	int error;
+	rec_writer_p rw;
+	size_t queue_size;
+
+	if (NULL == s || NULL == rw_ret || 0 == s->dir[0])
+		return (EINVAL);
+	rw = calloc(1, sizeof(rec_writer_t));
+	if (NULL == rw)
+		return (ENOMEM);
+	memcpy(&rw->s, s, sizeof(rec_writer_settings_t));
+	/* Correct values. */
+	if (0 == rw->s.write_interval) {
+		rw->s.write_interval = REC_W_S_DEF_WRITE_INTERVAL;
+	}
+	rw->s.chunk_size *= 1024; /* kb -> bytes */
+	rw->s.chunk_size = MAX(REC_CHUNK_ALIGN, (rw->s.chunk_size -
+	    (rw->s.chunk_size % REC_CHUNK_ALIGN)));
+	for (queue_size = 2; queue_size < rw->s.queue_size; queue_size <<= 1)
+		;
+	rw->s.queue_size = (uint32_t)queue_size;
+	rw->s.rotate_size *= 1024; /* kb -> bytes */
+	error = wr_thread_start(&rw->wt, rw->s.write_interval,
+	    WR_THREAD_F_SPIN, rec_drain, rec_free_cb, NULL, rw);
+	if (0 != error) {
+		free(rw);
+		return (error);
+	}
+
+	(*rw_ret) = rw;
+	return (0);
+}
+
+void
+rec_writer_destroy(rec_writer_p rw) {
+
+	if (NULL == rw)
+		return;
+	/* Not stopped recordings: data allready written on last drain. */
+	wr_thread_stop(&rw->wt);
+	free(rw);
+}
+
+
+int
+rec_create(rec_writer_p rw, const uint8_t *name, size_t name_size,
+    rec_p *rec_ret) {
+	rec_p rec;
+	size_t i;
+
+	if (NULL == rw || NULL == name || 0 == name_size ||
+	    REC_NAME_MAX <= name_size || NULL == rec_ret)
+		return (EINVAL);
+	rec = calloc(1, sizeof(rec_t));
+	if (NULL == rec)
+		return (ENOMEM);
+	rec->rw = rw;
+	rec->fd = -1;
+	wr_queue_init(&rec->q, rw->s.queue_size, 2);
+	rec->name_size = name_size;
+	memcpy(rec->name, name, name_size);
+	rec->name[name_size] = 0;
+	atomic_init(&rec->written_size, 0);
+	atomic_init(&rec->write_rate, 0);
+	atomic_init(&rec->dropped_size, 0);
+	atomic_init(&rec->file_count, 0);
+	atomic_init(&rec->last_error, 0);
+	rec->chunks = calloc(rw->s.queue_size, sizeof(rec_chunk_t));
+	if (NULL == rec->chunks)
+		goto err_out;
+	for (i = 0; i < rw->s.queue_size; i ++) {
+		if (0 != posix_memalign((void**)&rec->chunks[i].data,
+		    REC_MEM_ALIGN, rw->s.chunk_size))
+			goto err_out;
+	}
+	/* Pass to I/O thread. */
+	wr_thread_add(&rw->wt, &rec->q);
+
+	(*rec_ret) = rec;
+	return (0);
+
+err_out:
+	rec_free(rec);
+	return (ENOMEM);
+}
+
+void
+rec_destroy(rec_p rec) {
+	size_t wpos;
+
+	if (NULL == rec)
+		return;
+	/* Commit last not full chunk. */
+	if (0 == wr_queue_wpos(&rec->q, &wpos) &&
+	    0 != rec->chunks[(wpos & rec->q.mask)].size) {
+		wr_queue_commit(&rec->q);
+	}
+	wr_queue_dead_set(&rec->q);
+}
+
+/* Dead or not stopped on writer destroy. */
+static void
+rec_free_cb(wr_queue_p q, void *udata __unused) {
+	rec_p rec = (rec_p)q;
+
+	syslog(LOG_INFO, "Recording %s: stopped, %"PRIu64" bytes written.",
+	    rec->name, (uint64_t)atomic_load_explicit(&rec->written_size,
+	    memory_order_relaxed));
+	rec_free(rec);
+}
+
+static void
+rec_free(rec_p rec) {
+	size_t i;
+
+	if (NULL == rec)
+		return;
+	if (-1 != rec->fd) {
+		close(rec->fd);
+	}
+	if (NULL != rec->chunks) {
+		for (i = 0; i < rec->rw->s.queue_size; i ++) {
+			free(rec->chunks[i].data);
+		}
+		free(rec->chunks);
+	}
+	free(rec);
+}
+
+
+size_t
+rec_write(rec_p rec, const uint8_t *buf, size_t buf_size) {
+	rec_chunk_p chunk;
+	size_t wpos, tm, ret = 0;
+	size_t chunk_size = rec->rw->s.chunk_size;
+
+	while (0 != buf_size) {
+		if (0 != wr_queue_wpos(&rec->q, &wpos)) { /* Disk too slow. */
+			rec->overflow = 1;
+			return (ret);
+		}
+		chunk = &rec->chunks[(wpos & rec->q.mask)];
+		tm = MIN(buf_size, (chunk_size - chunk->size));
+		memcpy((chunk->data + chunk->size), buf, tm);
+		chunk->size += tm;
+		buf += tm;
+		buf_size -= tm;
+		ret += tm;
+		if (chunk_size == chunk->size) {
+			wr_queue_commit(&rec->q);
+		}
+	}
+	rec->overflow = 0;
+
+	return (ret);
+}
+
+void
+rec_drop(rec_p rec, size_t size) {
+
+	if (NULL == rec)
+		return;
+	rec->overflow = 1;
+	atomic_fetch_add_explicit(&rec->dropped_size, size,
+	    memory_order_relaxed);
+}
+
+int
+rec_stat_get(rec_p rec, rec_stat_p stat) {
+	size_t wpos;
+
+	if (NULL == rec || NULL == stat)
+		return (EINVAL);
+	memset(stat, 0x00, sizeof(rec_stat_t));
+	stat->backlog_size = (wr_queue_used(&rec->q) * rec->rw->s.chunk_size);
+	if (0 == wr_queue_wpos(&rec->q, &wpos)) {
+		stat->backlog_size += rec->chunks[(wpos & rec->q.mask)].size;
+	}
+	stat->written_size = atomic_load_explicit(&rec->written_size,
+	    memory_order_relaxed);
+	stat->write_rate = atomic_load_explicit(&rec->write_rate,
+	    memory_order_relaxed);
+	stat->dropped_size = atomic_load_explicit(&rec->dropped_size,
+	    memory_order_relaxed);
+	stat->file_count = (uint32_t)atomic_load_explicit(&rec->file_count,
+	    memory_order_relaxed);
+	stat->overflow = rec->overflow;
+	stat->last_error = atomic_load_explicit(&rec->last_error,
+	    memory_order_relaxed);
+
+	return (0);
+}
+
+
+static inline uint64_t
+rec_time_ms(void) {
+	struct timespec tp;
+
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return ((((uint64_t)tp.tv_sec * 1000) +
+	    ((uint64_t)tp.tv_nsec / 1000000)));
+}
+
+static size_t
+rec_drain(wr_queue_p q, int dead __unused, void *udata) {
+	rec_writer_p rw = udata;
+	rec_p rec = (rec_p)q;
+	rec_chunk_p chunk;
+	size_t rpos, wpos, count = 0;
+	uint64_t time_ms;
+	int error;
+
+	rpos = wr_queue_rpos(q, &wpos);
+	for (; rpos != wpos; rpos ++, count ++) {
+		chunk = &rec->chunks[(rpos & q->mask)];
+		/* Rotate: only on chunk boundary. */
+		if (-1 != rec->fd &&
+		    ((0 != rw->s.rotate_size && rw->s.rotate_size <= rec->file_size) ||
+		    (0 != rw->s.rotate_time &&
+		    (rec->file_time + (time_t)rw->s.rotate_time) <= (time_t)(rec_time_ms() / 1000)))) {
+			close(rec->fd);
+			rec->fd = -1;
+		}
+		error = 0;
+		if (-1 == rec->fd) {
+			error = rec_file_open(rw, rec);
+		}
+#ifdef O_DIRECT
+		/* Last chunk not aligned: write it via page cache. */
+		if (0 == error &&
+		    0 != (REC_W_S_F_O_DIRECT & rw->s.flags) &&
+		    0 != (chunk->size % REC_MEM_ALIGN)) {
+			fcntl(rec->fd, F_SETFL,
+			    (fcntl(rec->fd, F_GETFL) & ~O_DIRECT));
+		}
+#endif
+		if (0 == error) {
+			error = rec_write_all(rec->fd, chunk->data, chunk->size);
+		}
+		if (0 == error) {
+			rec->file_size += chunk->size;
+			rec->rate_size += chunk->size;
+			atomic_fetch_add_explicit(&rec->written_size,
+			    chunk->size, memory_order_relaxed);
+		} else {
+			if (atomic_load_explicit(&rec->last_error,
+			    memory_order_relaxed) != error) {
+				SYSLOG_ERR(LOG_ERR, error, "Recording %s: write().",
+				    rec->name);
+			}
+			atomic_fetch_add_explicit(&rec->dropped_size,
+			    chunk->size, memory_order_relaxed);
+		}
+		atomic_store_explicit(&rec->last_error, error,
+		    memory_order_relaxed);
+		chunk->size = 0;
+		wr_queue_release(q, (rpos + 1));
+	}
+	/* Throughput. */
+	time_ms = rec_time_ms();
+	if (0 == rec->rate_time) {
+		rec->rate_time = time_ms;
+	} else if ((rec->rate_time + 1000) <= time_ms) {
+		atomic_store_explicit(&rec->write_rate,
+		    ((rec->rate_size * 1000) / (time_ms - rec->rate_time)),
+		    memory_order_relaxed);
+		rec->rate_size = 0;
+		rec->rate_time = time_ms;
+	}
+
+	return (count);
+}
+
+/* dir/NAME-YYYYmmdd-HHMMSS[-N].ts, never overwrite. */
+static int
+rec_file_open(rec_writer_p rw, rec_p rec) {
+	int error, flags;
+	size_t i;
+	time_t now;
+	struct tm stm;
+	char str_time[32], file_name[1280];
+
+	now = time(NULL);
+	localtime_r(&now, &stm);
+	strftime(str_time, sizeof(str_time), "%Y%m%d-%H%M%S", &stm);
+	flags = (O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC);
+#ifdef O_DIRECT
+	if (0 != (REC_W_S_F_O_DIRECT & rw->s.flags)) {
+		flags |= O_DIRECT;
+	}
+#endif
+	for (i = 0; i < REC_FILE_OPEN_TRYES; i ++) {
+		if (0 == i) {
+			snprintf(file_name, sizeof(file_name), "%s/%s-%s.ts",
+			    rw->s.dir, rec->name, str_time);
+		} else {
+			snprintf(file_name, sizeof(file_name), "%s/%s-%s-%zu.ts",
+			    rw->s.dir, rec->name, str_time, i);
+		}
+		rec->fd = open(file_name, flags, 0644);
+		if (-1 != rec->fd || EEXIST != errno)
+			break;
+	}
+	if (-1 == rec->fd) {
+		error = errno;
+		if (atomic_load_explicit(&rec->last_error,
+		    memory_order_relaxed) != error) {
+			SYSLOG_ERR(LOG_ERR, error, "Recording %s: open(%s).",
+			    rec->name, file_name);
+		}
+		return (error);
+	}
+	rec->file_size = 0;
+	rec->file_time = (time_t)(rec_time_ms() / 1000);
+	atomic_fetch_add_explicit(&rec->file_count, 1, memory_order_relaxed);
+	syslog(LOG_INFO, "Recording %s: file %s.", rec->name, file_name);
+
+	return (0);
+}
+
+static int
+rec_write_all(int fd, const uint8_t *buf, size_t buf_size) {
+	ssize_t ios;
+
+	while (0 != buf_size) {
+		ios = write(fd, buf, buf_size);
+		if (-1 == ios) {
+			if (EINTR == errno)
+				continue;
+			return (errno);
+		}
+		buf += ios;
+		buf_size -= (size_t)ios;
+	}
+
+	return (0);
+}
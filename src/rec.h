@@ -0,0 +1,102 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+
+
+#ifndef __MSD_REC_H__
+#define __MSD_REC_H__
+
+#include <sys/types.h>
+#include <inttypes.h>
+
+
+/*
+ * Recorder: hub thread copy stream to chunks of per recording single
+ * producer / single consumer queue, I/O thread open, write and rotate
+ * files. Hub thread never touch files.
+ * Chunk size is multiple of REC_CHUNK_ALIGN: aligned for O_DIRECT and
+ * whole TS packets, so rotated files start from packet boundary.
+ * rec_* calls except rec_writer_* only from hub thread.
+ */
+
+typedef struct rec_writer_s	*rec_writer_p;
+typedef struct rec_s		*rec_p;
+
+typedef struct rec_writer_settings_s {
+	uint32_t	flags;
+	uint32_t	write_interval;	/* I/O thread wakeup interval if idle, ms. */
+	size_t		chunk_size;	/* Write batch, kb, rounded to REC_CHUNK_ALIGN. */
+	uint32_t	queue_size;	/* Chunks waiting for I/O thread, per recording. */
+	uint64_t	rotate_size;	/* Start new file at size, kb. 0 = never. */
+	uint32_t	rotate_time;	/* Start new file every X s. 0 = never. */
+	char		dir[1024];	/* Files: dir/NAME-YYYYmmdd-HHMMSS.ts */
+} rec_writer_settings_t, *rec_writer_settings_p;
+/* Flags. */
+#define REC_W_S_F_ENABLE		(((uint32_t)1) << 0)
+#define REC_W_S_F_O_DIRECT		(((uint32_t)1) << 1) /* Bypass page cache. */
+/* Default values. */
+#define REC_W_S_DEF_FLAGS		(0)
+#define REC_W_S_DEF_WRITE_INTERVAL	(20)	/* ms */
+#define REC_W_S_DEF_CHUNK_SIZE		(940)	/* kb */
+#define REC_W_S_DEF_QUEUE_SIZE		(16)
+#define REC_W_S_DEF_ROTATE_SIZE		(0)	/* kb */
+#define REC_W_S_DEF_ROTATE_TIME		(3600)	/* s */
+#define REC_W_S_DEF_DIR			"/var/tmp"
+#define REC_CHUNK_ALIGN			(188 * 1024) /* LCM(4096, 188). */
+#define REC_NAME_MAX			128
+
+typedef struct rec_stat_s {
+	uint64_t	written_size;	/* Bytes written to files. */
+	uint64_t	write_rate;	/* Bytes per second, last measure. */
+	size_t		backlog_size;	/* Bytes waiting for I/O thread. */
+	uint64_t	dropped_size;	/* Bytes lost: queue full or write error. */
+	uint32_t	file_count;	/* Files opened. */
+	int		overflow;	/* Queue is full: disk too slow. */
+	int		last_error;	/* Last I/O thread error, 0 = ok. */
+} rec_stat_t, *rec_stat_p;
+
+
+void	rec_writer_settings_def(rec_writer_settings_p p_ret);
+int	rec_writer_create(rec_writer_settings_p s, rec_writer_p *rw_ret);
+/* Call after all recordings destroyed, write all queued data. */
+void	rec_writer_destroy(rec_writer_p rw);
+
+int	rec_create(rec_writer_p rw, const uint8_t *name, size_t name_size,
+	    rec_p *rec_ret);
+/* I/O thread write queued data, close file and free it. */
+void	rec_destroy(rec_p rec);
+
+/* Return bytes taken, less than buf_size if queue is full. */
+size_t	rec_write(rec_p rec, const uint8_t *buf, size_t buf_size);
+/* Data lost before recorder: ring buf overrun. */
+void	rec_drop(rec_p rec, size_t size);
+int	rec_stat_get(rec_p rec, rec_stat_p stat);
+
+
+#endif /* __MSD_REC_H__ */
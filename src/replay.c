@@ -0,0 +1,549 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+
+
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include <stdlib.h> /* malloc, exit */
+#include <stdio.h> /* fopen, fread */
+#include <unistd.h> /* close, write, sysconf */
+#include <fcntl.h> /* For O_* constants */
+#include <poll.h>
+#include <pthread.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <string.h> /* bcopy, bzero, memcpy, memmove, memset, strerror... */
+#include <time.h>
+#include <errno.h>
+#include <syslog.h>
+
+#include "utils/macro.h"
+#include "replay.h"
+
+
+#define REPLAY_BUF_SIZE		(64 * 1024)	/* Max datagram. */
+#define REPLAY_FILE_BUF_SIZE	(1024 * 1024)	/* stdio buf. */
+#define REPLAY_SKT_SND_BUF	(4 * 1024 * 1024)
+#define REPLAY_WAIT_MAX		100000000ull	/* ns, sleep / poll slice: stop check. */
+#define REPLAY_TS_JUMP_MAX	10000000000ull	/* ns, 10 s: discontinuity. */
+/* pcap. */
+#define REPLAY_PCAP_MAGIC_US	0xa1b2c3d4
+#define REPLAY_PCAP_MAGIC_NS	0xa1b23c4d
+#define REPLAY_PCAP_HDR_SIZE	24
+#define REPLAY_PCAP_REC_HDR_SIZE 16
+
+typedef struct replay_s {
+	replay_params_t	p;
+	FILE		*fp;
+	uintptr_t	skt;		/* Socket pair send end. */
+	pthread_t	pt_id;
+	atomic_int	running;
+	/* pcap. */
+	int		pcap;
+	int		swap;		/* Other byte order. */
+	uint64_t	ts_mul;		/* Timestamp fraction to ns. */
+	uint32_t	linktype;
+	/* Pace. */
+	int		rebase;
+	uint64_t	base_time;	/* Monotonic ns. */
+	uint64_t	base_ts;	/* ns. */
+	uint64_t	last_ts;	/* ns. */
+	uint16_t	pcr_pid;	/* 0x1fff = not locked. */
+	uint8_t		buf[REPLAY_BUF_SIZE];
+	/* Stat. */
+	atomic_uint_fast64_t pkt_count;
+	atomic_uint_fast64_t sended_size;
+	atomic_uint_fast64_t skipped_count;
+	atomic_uint_fast64_t loop_count;
+	atomic_int	done;
+	atomic_int	last_error;
+} replay_t;
+
+
+static void	*replay_proc(void *arg);
+static int	replay_pcap_next(replay_p replay, size_t *off, size_t *size,
+		    uint64_t *ts);
+static int	replay_ts_next(replay_p replay, size_t *size, uint64_t *ts);
+static void	replay_pace(replay_p replay, uint64_t ts);
+static int	replay_send(replay_p replay, const uint8_t *buf, size_t size);
+static inline uint64_t replay_time_ns(void);
+
+
+static inline uint64_t
+replay_time_ns(void) {
+	struct timespec tp;
+
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return (((uint64_t)tp.tv_sec * 1000000000ull) + (uint64_t)tp.tv_nsec);
+}
+
+static inline uint32_t
+replay_u32(replay_p replay, const uint8_t *buf) {
+	uint32_t val;
+
+	memcpy(&val, buf, sizeof(val));
+	if (0 != replay->swap)
+		return (__builtin_bswap32(val));
+	return (val);
+}
+
+
+int
+replay_create(replay_params_p params, uintptr_t *skt_ret,
+    replay_p *replay_ret) {
+	int error, skts[2] = { -1, -1 }, val;
+	replay_p replay;
+	uint8_t hdr[REPLAY_PCAP_HDR_SIZE];
+	uint32_t magic = 0;
+
+	if (NULL == params || NULL == skt_ret || NULL == replay_ret ||
+	    0 == params->path[0])
+		return (EINVAL);
+	replay = calloc(1, sizeof(replay_t));
+	if (NULL == replay)
+		return (ENOMEM);
+	memcpy(&replay->p, params, sizeof(replay_params_t));
+	replay->p.path[(sizeof(replay->p.path) - 1)] = 0;
+	replay->skt = (uintptr_t)-1;
+	replay->rebase = 1;
+	replay->pcr_pid = 0x1fff;
+	atomic_init(&replay->running, 1);
+	atomic_init(&replay->pkt_count, 0);
+	atomic_init(&replay->sended_size, 0);
+	atomic_init(&replay->skipped_count, 0);
+	atomic_init(&replay->loop_count, 0);
+	atomic_init(&replay->done, 0);
+	atomic_init(&replay->last_error, 0);
+	replay->fp = fopen(replay->p.path, "rb");
+	if (NULL == replay->fp) {
+		error = errno;
+		goto err_out;
+	}
+	setvbuf(replay->fp, NULL, _IOFBF, REPLAY_FILE_BUF_SIZE);
+	/* Detect type: pcap by magic, else TS. */
+	if (sizeof(hdr) == fread(hdr, 1, sizeof(hdr), replay->fp)) {
+		memcpy(&magic, hdr, sizeof(magic));
+		switch (magic) {
+		case REPLAY_PCAP_MAGIC_US:
+		case REPLAY_PCAP_MAGIC_NS:
+			replay->pcap = 1;
+			break;
+		case __builtin_bswap32(REPLAY_PCAP_MAGIC_US):
+		case __builtin_bswap32(REPLAY_PCAP_MAGIC_NS):
+			replay->pcap = 1;
+			replay->swap = 1;
+			magic = __builtin_bswap32(magic);
+			break;
+		}
+	}
+	if (0 != replay->pcap) {
+		replay->ts_mul = ((REPLAY_PCAP_MAGIC_NS == magic) ? 1 : 1000);
+		replay->linktype = (replay_u32(replay, (hdr + 20)) & 0x0fffffff);
+		switch (replay->linktype) {
+		case REPLAY_DLT_NULL:
+		case REPLAY_DLT_EN10MB:
+		case REPLAY_DLT_RAW:
+		case REPLAY_DLT_RAW_BSD:
+		case REPLAY_DLT_LINUX_SLL:
+		case REPLAY_DLT_LINUX_SLL2:
+			break;
+		default:
+			error = EPROTONOSUPPORT;
+			goto err_out;
+		}
+	} else {
+		rewind(replay->fp);
+	}
+	if (0 != socketpair(AF_UNIX, SOCK_DGRAM, 0, skts)) {
+		error = errno;
+		goto err_out;
+	}
+	val = REPLAY_SKT_SND_BUF;
+	setsockopt(skts[1], SOL_SOCKET, SO_SNDBUF, &val, sizeof(val));
+	if (-1 == fcntl(skts[0], F_SETFL, (fcntl(skts[0], F_GETFL, 0) | O_NONBLOCK))) {
+		error = errno;
+		goto err_out;
+	}
+	replay->skt = (uintptr_t)skts[1];
+	error = pthread_create(&replay->pt_id, NULL, replay_proc, replay);
+	if (0 != error) {
+		SYSLOG_ERR(LOG_ERR, error, "pthread_create().");
+		goto err_out;
+	}
+
+	(*skt_ret) = (uintptr_t)skts[0];
+	(*replay_ret) = replay;
+	return (0);
+
+err_out:
+	if (-1 != skts[0]) {
+		close(skts[0]);
+		close(skts[1]);
+	}
+	if (NULL != replay->fp) {
+		fclose(replay->fp);
+	}
+	free(replay);
+	return (error);
+}
+
+void
+replay_destroy(replay_p replay) {
+
+	if (NULL == replay)
+		return;
+	atomic_store_explicit(&replay->running, 0, memory_order_release);
+	pthread_join(replay->pt_id, NULL);
+	close((int)replay->skt);
+	fclose(replay->fp);
+	free(replay);
+}
+
+int
+replay_stat_get(replay_p replay, replay_stat_p stat) {
+
+	if (NULL == replay || NULL == stat)
+		return (EINVAL);
+	stat->pkt_count = atomic_load_explicit(&replay->pkt_count,
+	    memory_order_relaxed);
+	stat->sended_size = atomic_load_explicit(&replay->sended_size,
+	    memory_order_relaxed);
+	stat->skipped_count = atomic_load_explicit(&replay->skipped_count,
+	    memory_order_relaxed);
+	stat->loop_count = atomic_load_explicit(&replay->loop_count,
+	    memory_order_relaxed);
+	stat->pcap = replay->pcap;
+	stat->done = atomic_load_explicit(&replay->done, memory_order_relaxed);
+	stat->last_error = atomic_load_explicit(&replay->last_error,
+	    memory_order_relaxed);
+
+	return (0);
+}
+
+
+/*
+ * pcap record to UDP payload: link layer by type, IPv4 or IPv6 without
+ * extension headers, no fragments.
+ */
+int
+replay_pcap_udp_get(uint32_t linktype, const uint8_t *pkt, size_t cap_size,
+    struct sockaddr_storage *dst, size_t *off) {
+	size_t l3_off, l4_off, ip_hdr_size;
+	uint16_t ether_type;
+	struct sockaddr_in *dst4 = (struct sockaddr_in*)(void*)dst;
+	struct sockaddr_in6 *dst6 = (struct sockaddr_in6*)(void*)dst;
+
+	if (NULL == pkt || NULL == dst || NULL == off)
+		return (EINVAL);
+	/* Link layer: find L3 and its type. */
+	switch (linktype) {
+	case REPLAY_DLT_NULL:
+		l3_off = 4;
+		if (l3_off >= cap_size)
+			return (EINVAL);
+		ether_type = ((6 == (pkt[l3_off] >> 4)) ? 0x86dd : 0x0800);
+		break;
+	case REPLAY_DLT_EN10MB:
+		l3_off = 14;
+		if (l3_off > cap_size)
+			return (EINVAL);
+		ether_type = (uint16_t)((pkt[12] << 8) | pkt[13]);
+		while ((0x8100 == ether_type || 0x88a8 == ether_type) &&
+		    (l3_off + 4) <= cap_size) { /* VLAN tags. */
+			ether_type = (uint16_t)((pkt[(l3_off + 2)] << 8) |
+			    pkt[(l3_off + 3)]);
+			l3_off += 4;
+		}
+		break;
+	case REPLAY_DLT_LINUX_SLL:
+		l3_off = 16;
+		if (l3_off > cap_size)
+			return (EINVAL);
+		ether_type = (uint16_t)((pkt[14] << 8) | pkt[15]);
+		break;
+	case REPLAY_DLT_LINUX_SLL2:
+		l3_off = 20;
+		if (l3_off > cap_size)
+			return (EINVAL);
+		ether_type = (uint16_t)((pkt[0] << 8) | pkt[1]);
+		break;
+	case REPLAY_DLT_RAW:
+	case REPLAY_DLT_RAW_BSD:
+		l3_off = 0;
+		ether_type = ((0 != cap_size && 6 == (pkt[0] >> 4)) ?
+		    0x86dd : 0x0800);
+		break;
+	default:
+		return (EPROTONOSUPPORT);
+	}
+	if (l3_off >= cap_size)
+		return (EINVAL);
+	memset(dst, 0x00, sizeof(struct sockaddr_storage));
+	switch (ether_type) {
+	case 0x0800:
+		if ((l3_off + 20) > cap_size || 4 != (pkt[l3_off] >> 4) ||
+		    17 != pkt[(l3_off + 9)])
+			return (EINVAL);
+		/* Fragments: MF or offset set. */
+		if (0 != (((pkt[(l3_off + 6)] << 8) | pkt[(l3_off + 7)]) & 0x3fff))
+			return (EINVAL);
+		ip_hdr_size = ((size_t)(pkt[l3_off] & 0x0f) * 4);
+		if (20 > ip_hdr_size)
+			return (EINVAL);
+		dst4->sin_family = AF_INET;
+		memcpy(&dst4->sin_addr, (pkt + l3_off + 16), 4);
+		break;
+	case 0x86dd:
+		if ((l3_off + 40) > cap_size || 6 != (pkt[l3_off] >> 4) ||
+		    17 != pkt[(l3_off + 6)])
+			return (EINVAL); /* No extension headers. */
+		ip_hdr_size = 40;
+		dst6->sin6_family = AF_INET6;
+		memcpy(&dst6->sin6_addr, (pkt + l3_off + 24), 16);
+		break;
+	default:
+		return (EINVAL);
+	}
+	l4_off = (l3_off + ip_hdr_size);
+	if ((l4_off + 8) > cap_size)
+		return (EINVAL);
+	if (AF_INET == dst->ss_family) {
+		memcpy(&dst4->sin_port, (pkt + l4_off + 2), 2);
+	} else {
+		memcpy(&dst6->sin6_port, (pkt + l4_off + 2), 2);
+	}
+	(*off) = (l4_off + 8);
+
+	return (0);
+}
+
+
+static void *
+replay_proc(void *arg) {
+	replay_p replay = arg;
+	int error = 0;
+	size_t off, size;
+	uint64_t ts;
+
+	while (0 != atomic_load_explicit(&replay->running,
+	    memory_order_acquire)) {
+		off = 0;
+		ts = 0;
+		if (0 != replay->pcap) {
+			error = replay_pcap_next(replay, &off, &size, &ts);
+		} else {
+			error = replay_ts_next(replay, &size, &ts);
+		}
+		if (0 != error)
+			break;
+		if (0 == size) { /* End of file. */
+			if (0 == (REPLAY_F_LOOP & replay->p.flags))
+				break;
+			if (0 != fseeko(replay->fp, ((0 != replay->pcap) ?
+			    REPLAY_PCAP_HDR_SIZE : 0), SEEK_SET)) {
+				error = errno;
+				break;
+			}
+			replay->rebase = 1;
+			atomic_fetch_add_explicit(&replay->loop_count, 1,
+			    memory_order_relaxed);
+			continue;
+		}
+		if (0 == (REPLAY_F_FAST & replay->p.flags) && 0 != ts) {
+			replay_pace(replay, ts);
+		}
+		error = replay_send(replay, (replay->buf + off), size);
+		if (0 != error)
+			break;
+	}
+	if (0 != error) {
+		atomic_store_explicit(&replay->last_error, error,
+		    memory_order_relaxed);
+	}
+	atomic_store_explicit(&replay->done, 1, memory_order_relaxed);
+
+	return (NULL);
+}
+
+/*
+ * Next UDP payload from capture: off and size in replay->buf,
+ * size = 0 on end of file. ts: capture time, ns.
+ */
+static int
+replay_pcap_next(replay_p replay, size_t *off, size_t *size, uint64_t *ts) {
+	uint8_t rec_hdr[REPLAY_PCAP_REC_HDR_SIZE];
+	size_t cap_size;
+	struct sockaddr_storage dst;
+
+	for (;;) {
+		if (sizeof(rec_hdr) != fread(rec_hdr, 1, sizeof(rec_hdr),
+		    replay->fp))
+			goto eof;
+		cap_size = replay_u32(replay, (rec_hdr + 8));
+		if (sizeof(replay->buf) < cap_size) { /* Not for us. */
+			if (0 != fseeko(replay->fp, (off_t)cap_size, SEEK_CUR))
+				goto eof;
+			continue;
+		}
+		if (cap_size != fread(replay->buf, 1, cap_size, replay->fp))
+			goto eof;
+		(*ts) = (((uint64_t)replay_u32(replay, rec_hdr) * 1000000000ull) +
+		    ((uint64_t)replay_u32(replay, (rec_hdr + 4)) * replay->ts_mul));
+		if (0 != replay_pcap_udp_get(replay->linktype, replay->buf,
+		    cap_size, &dst, off))
+			goto skip;
+		/* Filter: set or lock to first UDP stream. */
+		if (AF_UNSPEC == replay->p.filter.ss_family) {
+			memcpy(&replay->p.filter, &dst, sizeof(dst));
+		} else if (0 != memcmp(&replay->p.filter, &dst, sizeof(dst))) {
+			goto skip;
+		}
+		(*size) = (cap_size - (*off));
+		if (0 == (*size))
+			goto skip;
+		return (0);
+skip:
+		atomic_fetch_add_explicit(&replay->skipped_count, 1,
+		    memory_order_relaxed);
+	}
+eof:
+	(*size) = 0;
+	return (ferror(replay->fp) ? EIO : 0);
+}
+
+/*
+ * Next datagram of whole TS packets from file, size = 0 on end of file.
+ * ts: from first PCR in datagram, ns, 0 = no PCR.
+ */
+static int
+replay_ts_next(replay_p replay, size_t *size, uint64_t *ts) {
+	size_t i, rd;
+	uint8_t *pkt;
+	uint16_t pid;
+	uint64_t pcr;
+
+	rd = fread(replay->buf, 1, REPLAY_TS_DGRAM_SIZE, replay->fp);
+	/* Resync: skip to sync byte. */
+	while (0 != rd && 0x47 != replay->buf[0]) {
+		pkt = memchr(replay->buf, 0x47, rd);
+		if (NULL == pkt) {
+			rd = 0;
+		} else {
+			rd -= (size_t)(pkt - replay->buf);
+			memmove(replay->buf, pkt, rd);
+		}
+		rd += fread((replay->buf + rd), 1,
+		    (REPLAY_TS_DGRAM_SIZE - rd), replay->fp);
+		if (REPLAY_TS_DGRAM_SIZE != rd && 0 != feof(replay->fp))
+			break;
+	}
+	rd -= (rd % 188);
+	(*size) = rd;
+	if (0 == rd)
+		return (ferror(replay->fp) ? EIO : 0);
+	for (i = 0; i < rd; i += 188) {
+		pkt = (replay->buf + i);
+		/* Adaptation field with PCR. */
+		if (0x47 != pkt[0] || 0 == (0x20 & pkt[3]) ||
+		    7 > pkt[4] || 0 == (0x10 & pkt[5]))
+			continue;
+		pid = (uint16_t)(((pkt[1] & 0x1f) << 8) | pkt[2]);
+		if (0x1fff == replay->pcr_pid) {
+			replay->pcr_pid = pid;
+		} else if (pid != replay->pcr_pid) {
+			continue;
+		}
+		pcr = (((uint64_t)pkt[6] << 25) | ((uint64_t)pkt[7] << 17) |
+		    ((uint64_t)pkt[8] << 9) | ((uint64_t)pkt[9] << 1) |
+		    ((uint64_t)pkt[10] >> 7));
+		pcr = ((pcr * 300) + ((uint64_t)(pkt[10] & 0x01) << 8) + pkt[11]);
+		(*ts) = ((pcr * 1000) / 27); /* 27 MHz -> ns. */
+		if (0 == (*ts)) {
+			(*ts) = 1;
+		}
+		break;
+	}
+
+	return (0);
+}
+
+/* Sleep until stream time ts, rebase on start, loop and discontinuity. */
+static void
+replay_pace(replay_p replay, uint64_t ts) {
+	uint64_t now, target;
+	struct timespec tp;
+
+	now = replay_time_ns();
+	if (0 != replay->rebase || ts < replay->last_ts ||
+	    (ts - replay->last_ts) > REPLAY_TS_JUMP_MAX) {
+		replay->rebase = 0;
+		replay->base_time = now;
+		replay->base_ts = ts;
+	}
+	replay->last_ts = ts;
+	target = (replay->base_time + (ts - replay->base_ts));
+	while (target > now && 0 != atomic_load_explicit(&replay->running,
+	    memory_order_acquire)) {
+		now = MIN((target - now), REPLAY_WAIT_MAX);
+		tp.tv_sec = (time_t)(now / 1000000000ull);
+		tp.tv_nsec = (long)(now % 1000000000ull);
+		nanosleep(&tp, NULL);
+		now = replay_time_ns();
+	}
+}
+
+/* Wait for receiver: it read as fast as hub can. */
+static int
+replay_send(replay_p replay, const uint8_t *buf, size_t size) {
+	struct pollfd pfd;
+
+	pfd.fd = (int)replay->skt;
+	pfd.events = POLLOUT;
+	while (0 != atomic_load_explicit(&replay->running,
+	    memory_order_acquire)) {
+		if ((ssize_t)size == send((int)replay->skt, buf, size,
+		    (MSG_DONTWAIT | MSG_NOSIGNAL))) {
+			atomic_fetch_add_explicit(&replay->pkt_count, 1,
+			    memory_order_relaxed);
+			atomic_fetch_add_explicit(&replay->sended_size, size,
+			    memory_order_relaxed);
+			return (0);
+		}
+		if (EAGAIN != errno && EWOULDBLOCK != errno &&
+		    ENOBUFS != errno && EINTR != errno)
+			return (errno); /* Receiver closed. */
+		poll(&pfd, 1, (int)(REPLAY_WAIT_MAX / 1000000));
+	}
+	return (0);
+}
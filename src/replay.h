@@ -0,0 +1,102 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+
+
+
+#ifndef __MSD_REPLAY_H__
+#define __MSD_REPLAY_H__
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <inttypes.h>
+
+
+/*
+ * Replay source: MPEG2-TS file or pcap (UDP/RTP capture) played by own
+ * thread as datagrams to local socket pair, hub receive them with
+ * same code as multicast: packet classification, RTP strip, GRO off.
+ * Pace: pcap capture time or TS PCR, or as fast as hub read.
+ * File read and pacing never block hub thread.
+ */
+
+typedef struct replay_s	*replay_p;
+
+#define REPLAY_PATH_MAX		192
+
+typedef struct replay_params_s {
+	uint32_t	flags;
+	struct sockaddr_storage	filter;	/* pcap: UDP destination, AF_UNSPEC = first seen. */
+	char		path[REPLAY_PATH_MAX]; /* Zero terminated. */
+} replay_params_t, *replay_params_p;
+/* Flags. */
+#define REPLAY_F_LOOP		(((uint32_t)1) << 0) /* Rewind on end of file. */
+#define REPLAY_F_FAST		(((uint32_t)1) << 1) /* No pacing: as fast as receiver read. */
+
+#define REPLAY_TS_DGRAM_SIZE	(7 * 188) /* TS file: datagram size. */
+
+/* pcap link types. */
+#define REPLAY_DLT_NULL		0
+#define REPLAY_DLT_EN10MB	1
+#define REPLAY_DLT_RAW		101
+#define REPLAY_DLT_RAW_BSD	12
+#define REPLAY_DLT_LINUX_SLL	113
+#define REPLAY_DLT_LINUX_SLL2	276
+
+typedef struct replay_stat_s {
+	uint64_t	pkt_count;	/* Datagrams sended. */
+	uint64_t	sended_size;
+	uint64_t	skipped_count;	/* pcap: not UDP, filtered or fragmented. */
+	uint64_t	loop_count;	/* Rewinds. */
+	int		pcap;		/* File type. */
+	int		done;		/* End of file, no loop, or error. */
+	int		last_error;
+} replay_stat_t, *replay_stat_p;
+
+
+/*
+ * Open file, detect type and start thread.
+ * skt_ret: datagram socket to receive from, caller close it.
+ */
+int	replay_create(replay_params_p params, uintptr_t *skt_ret,
+	    replay_p *replay_ret);
+/* Stop thread and free, receive socket may be closed before. */
+void	replay_destroy(replay_p replay);
+int	replay_stat_get(replay_p replay, replay_stat_p stat);
+/*
+ * pcap record data to UDP payload: off - payload offset in pkt,
+ * dst - UDP destination.
+ * Return EINVAL if not UDP, fragment or truncated,
+ * EPROTONOSUPPORT on unknown link type.
+ */
+int	replay_pcap_udp_get(uint32_t linktype, const uint8_t *pkt,
+	    size_t cap_size, struct sockaddr_storage *dst, size_t *off);
+
+
+#endif /* __MSD_REPLAY_H__ */
@@ -0,0 +1,330 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+
+
+
+#include <sys/param.h>
+#include <sys/types.h>
+
+#include <stdlib.h> /* malloc, exit */
+#include <inttypes.h>
+#include <string.h> /* bcopy, bzero, memcpy, memmove, memset, strerror... */
+#include <time.h>
+#include <errno.h>
+
+#include "utils/macro.h"
+#include "rtp_arq.h"
+
+
+#define RTP_ARQ_WINDOW_MIN	16
+#define RTP_ARQ_WINDOW_MAX	16384	/* Less than half of sequence space. */
+#define RTP_ARQ_RTP_HDR_SIZE	12
+#define RTP_ARQ_RTCP_PT_RR	201
+#define RTP_ARQ_RTCP_PT_SDES	202
+#define RTP_ARQ_RTCP_PT_RTPFB	205
+#define RTP_ARQ_RTCP_FMT_NACK	1	/* RFC 4585 generic NACK. */
+#define RTP_ARQ_CNAME		"msd_lite"
+
+typedef struct rtp_arq_slot_s {
+	uint64_t	time;		/* ms: data - received, missing - detected. */
+	uint64_t	nack_time;	/* Missing: next NACK time, ms. */
+	uint32_t	flags;
+	uint16_t	seq;
+	uint16_t	retries;
+	size_t		size;
+	uint8_t		data[RTP_ARQ_PKT_SIZE_MAX];
+} rtp_arq_slot_t, *rtp_arq_slot_p;
+/* Flags. */
+#define RTP_ARQ_SLOT_F_DATA	(((uint32_t)1) << 0)
+#define RTP_ARQ_SLOT_F_MISS	(((uint32_t)1) << 1)
+#define RTP_ARQ_SLOT_F_NACKED	(((uint32_t)1) << 2)
+
+typedef struct rtp_arq_s {
+	rtp_arq_settings_t s;
+	rtp_arq_slot_p	slot;
+	uint16_t	mask;		/* Window - 1. */
+	uint16_t	head;		/* Next sequence to release. */
+	uint16_t	next;		/* Max received sequence + 1. */
+	int		started;
+	int		flush;		/* Release all held, then restart. */
+	size_t		miss_count;
+	uint32_t	ssrc;		/* Own, for RTCP. */
+	uint32_t	media_ssrc;	/* Sender, from last RTP packet. */
+	rtp_arq_stat_t	stat;
+} rtp_arq_t;
+
+
+static inline void
+rtp_arq_be16_set(uint8_t *buf, uint16_t val) {
+
+	buf[0] = (uint8_t)(val >> 8);
+	buf[1] = (uint8_t)val;
+}
+
+static inline void
+rtp_arq_be32_set(uint8_t *buf, uint32_t val) {
+
+	buf[0] = (uint8_t)(val >> 24);
+	buf[1] = (uint8_t)(val >> 16);
+	buf[2] = (uint8_t)(val >> 8);
+	buf[3] = (uint8_t)val;
+}
+
+
+void
+rtp_arq_settings_def(rtp_arq_settings_p p_ret) {
+
+	if (NULL == p_ret)
+		return;
+	memset(p_ret, 0x00, sizeof(rtp_arq_settings_t));
+	p_ret->window = RTP_ARQ_S_DEF_WINDOW;
+	p_ret->delay = RTP_ARQ_S_DEF_DELAY;
+	p_ret->reorder = RTP_ARQ_S_DEF_REORDER;
+	p_ret->nack_interval = RTP_ARQ_S_DEF_NACK_INTERVAL;
+	p_ret->retries = RTP_ARQ_S_DEF_RETRIES;
+}
+
+
+int
+rtp_arq_create(rtp_arq_settings_p s, rtp_arq_p *arq_ret) {
+	rtp_arq_p arq;
+	uint32_t window;
+	struct timespec tp;
+
+	if (NULL == s || NULL == arq_ret)
+		return (EINVAL);
+	for (window = RTP_ARQ_WINDOW_MIN;
+	    window < s->window && window < RTP_ARQ_WINDOW_MAX; window *= 2)
+		;
+	arq = calloc(1, sizeof(rtp_arq_t));
+	if (NULL == arq)
+		return (ENOMEM);
+	arq->slot = calloc(window, sizeof(rtp_arq_slot_t));
+	if (NULL == arq->slot) {
+		free(arq);
+		return (ENOMEM);
+	}
+	memcpy(&arq->s, s, sizeof(rtp_arq_settings_t));
+	arq->s.window = window;
+	arq->mask = (uint16_t)(window - 1);
+	/* RFC 3550: random SSRC. */
+	clock_gettime(CLOCK_REALTIME, &tp);
+	arq->ssrc = (uint32_t)(((uint64_t)tp.tv_nsec * 2654435761ULL) ^
+	    (uint64_t)tp.tv_sec ^ (uintptr_t)arq);
+
+	(*arq_ret) = arq;
+	return (0);
+}
+
+void
+rtp_arq_destroy(rtp_arq_p arq) {
+
+	if (NULL == arq)
+		return;
+	free(arq->slot);
+	free(arq);
+}
+
+int
+rtp_arq_put(rtp_arq_p arq, const uint8_t *buf, size_t buf_size,
+    uint64_t time) {
+	rtp_arq_slot_p slot;
+	uint16_t seq, s;
+
+	if (NULL == arq || NULL == buf)
+		return (EINVAL);
+	if (RTP_ARQ_RTP_HDR_SIZE > buf_size || 2 != (buf[0] >> 6))
+		return (EINVAL); /* Not RTP. */
+	if (RTP_ARQ_PKT_SIZE_MAX < buf_size)
+		return (EMSGSIZE);
+	if (0 != arq->flush)
+		return (EAGAIN);
+	seq = (uint16_t)((buf[2] << 8) | buf[3]);
+	arq->media_ssrc = (((uint32_t)buf[8] << 24) | ((uint32_t)buf[9] << 16) |
+	    ((uint32_t)buf[10] << 8) | (uint32_t)buf[11]);
+	if (0 == arq->started) {
+		arq->started = 1;
+		arq->head = seq;
+		arq->next = seq;
+	}
+	if (arq->s.window <= (uint16_t)(seq - arq->head)) {
+		if (arq->s.window >= (uint16_t)(arq->head - seq)) {
+			arq->stat.late ++; /* Allready released or skipped. */
+			return (0);
+		}
+		/* Sequence jump: sender restart or long outage. */
+		arq->flush = 1;
+		arq->stat.resync_count ++;
+		return (EAGAIN);
+	}
+	slot = &arq->slot[(seq & arq->mask)];
+	if ((uint16_t)(seq - arq->head) < (uint16_t)(arq->next - arq->head)) {
+		if (0 != (RTP_ARQ_SLOT_F_DATA & slot->flags)) {
+			arq->stat.late ++; /* Duplicate. */
+			return (0);
+		}
+		if (0 != (RTP_ARQ_SLOT_F_NACKED & slot->flags)) {
+			arq->stat.recovered ++;
+		}
+		arq->miss_count --;
+	} else {
+		/* Mark gap. */
+		for (s = arq->next; s != seq; s ++) {
+			arq->slot[(s & arq->mask)].flags = RTP_ARQ_SLOT_F_MISS;
+			arq->slot[(s & arq->mask)].seq = s;
+			arq->slot[(s & arq->mask)].time = time;
+			arq->slot[(s & arq->mask)].nack_time = (time + arq->s.reorder);
+			arq->slot[(s & arq->mask)].retries = 0;
+			arq->miss_count ++;
+		}
+		arq->next = (uint16_t)(seq + 1);
+	}
+	slot->flags = RTP_ARQ_SLOT_F_DATA;
+	slot->seq = seq;
+	slot->time = time;
+	slot->size = buf_size;
+	memcpy(slot->data, buf, buf_size);
+
+	return (0);
+}
+
+size_t
+rtp_arq_get(rtp_arq_p arq, uint64_t time, const uint8_t **buf) {
+	rtp_arq_slot_p slot;
+
+	if (NULL == arq || NULL == buf)
+		return (0);
+	for (;;) {
+		if (arq->head == arq->next) {
+			if (0 != arq->flush) {
+				arq->flush = 0;
+				arq->started = 0;
+			}
+			return (0);
+		}
+		slot = &arq->slot[(arq->head & arq->mask)];
+		if (0 != (RTP_ARQ_SLOT_F_DATA & slot->flags)) {
+			slot->flags = 0;
+			arq->head ++;
+			(*buf) = slot->data;
+			return (slot->size);
+		}
+		/* Missing: wait for retransmission. */
+		if (0 == arq->flush &&
+		    (slot->time + arq->s.delay) > time)
+			return (0);
+		slot->flags = 0;
+		arq->head ++;
+		arq->miss_count --;
+		arq->stat.lost ++;
+	}
+	return (0);
+}
+
+size_t
+rtp_arq_nack_make(rtp_arq_p arq, uint64_t time, uint8_t *buf,
+    size_t buf_size) {
+	rtp_arq_slot_p slot;
+	uint8_t *fci = NULL;
+	size_t off, fci_off, fci_max, fci_cnt = 0;
+	uint16_t s, pid = 0, blp = 0;
+
+	if (NULL == arq || NULL == buf ||
+	    0 == arq->miss_count || 0 == arq->s.retries)
+		return (0);
+	/* RR + SDES with CNAME, padded to 32 bit + RTPFB header. */
+	fci_off = (8 + (4 + (((4 + 2 + sizeof(RTP_ARQ_CNAME) - 1) + 4) & ~((size_t)3))) + 12);
+	if ((fci_off + 4) > buf_size)
+		return (0);
+	fci_max = ((buf_size - fci_off) / 4);
+	for (s = arq->head; s != arq->next; s ++) {
+		slot = &arq->slot[(s & arq->mask)];
+		if (0 == (RTP_ARQ_SLOT_F_MISS & slot->flags) ||
+		    slot->nack_time > time ||
+		    slot->retries >= arq->s.retries)
+			continue;
+		if (NULL != fci && 16 >= (uint16_t)(s - pid)) {
+			blp |= (uint16_t)(1 << ((uint16_t)(s - pid) - 1));
+			rtp_arq_be16_set((fci + 2), blp);
+		} else {
+			if (fci_cnt == fci_max)
+				break;
+			fci = (buf + fci_off + (fci_cnt * 4));
+			fci_cnt ++;
+			pid = s;
+			blp = 0;
+			rtp_arq_be16_set(fci, pid);
+			rtp_arq_be16_set((fci + 2), blp);
+		}
+		slot->flags |= RTP_ARQ_SLOT_F_NACKED;
+		slot->retries ++;
+		slot->nack_time = (time + arq->s.nack_interval);
+		arq->stat.requested ++;
+	}
+	if (0 == fci_cnt)
+		return (0);
+	/* Empty RR. */
+	buf[0] = 0x80;
+	buf[1] = RTP_ARQ_RTCP_PT_RR;
+	rtp_arq_be16_set((buf + 2), 1);
+	rtp_arq_be32_set((buf + 4), arq->ssrc);
+	off = 8;
+	/* SDES: one chunk with CNAME. */
+	buf[off] = 0x81;
+	buf[(off + 1)] = RTP_ARQ_RTCP_PT_SDES;
+	rtp_arq_be16_set((buf + off + 2), (uint16_t)(((fci_off - 12 - off) / 4) - 1));
+	rtp_arq_be32_set((buf + off + 4), arq->ssrc);
+	buf[(off + 8)] = 1; /* CNAME. */
+	buf[(off + 9)] = (sizeof(RTP_ARQ_CNAME) - 1);
+	memcpy((buf + off + 10), RTP_ARQ_CNAME, (sizeof(RTP_ARQ_CNAME) - 1));
+	off += (10 + (sizeof(RTP_ARQ_CNAME) - 1));
+	while (off < (fci_off - 12)) { /* END item and padding. */
+		buf[off ++] = 0;
+	}
+	/* Generic NACK. */
+	buf[off] = (0x80 | RTP_ARQ_RTCP_FMT_NACK);
+	buf[(off + 1)] = RTP_ARQ_RTCP_PT_RTPFB;
+	rtp_arq_be16_set((buf + off + 2), (uint16_t)(2 + fci_cnt));
+	rtp_arq_be32_set((buf + off + 4), arq->ssrc);
+	rtp_arq_be32_set((buf + off + 8), arq->media_ssrc);
+	arq->stat.nack_count ++;
+
+	return (fci_off + (fci_cnt * 4));
+}
+
+int
+rtp_arq_stat_get(rtp_arq_p arq, rtp_arq_stat_p stat) {
+
+	if (NULL == arq || NULL == stat)
+		return (EINVAL);
+	memcpy(stat, &arq->stat, sizeof(rtp_arq_stat_t));
+
+	return (0);
+}
@@ -0,0 +1,103 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+
+
+
+#ifndef __MSD_RTP_ARQ_H__
+#define __MSD_RTP_ARQ_H__
+
+#include <sys/types.h>
+#include <inttypes.h>
+
+
+/*
+ * RTP retransmission receiver (RIST simple profile compatible):
+ * packets held in reorder window indexed by RTP sequence number,
+ * gaps requested by RTCP generic NACK (RFC 4585), packets released
+ * in order: at once if no gap before, else after missing packet is
+ * recovered or its hold time expire.
+ * No transport here: caller receive, commit and send RTCP.
+ * All calls only from one (hub) thread.
+ */
+
+typedef struct rtp_arq_s	*rtp_arq_p;
+
+typedef struct rtp_arq_settings_s {
+	uint32_t	window;		/* Packets, rounded up to power of 2. */
+	uint32_t	delay;		/* Max hold time for missing packet, ms. */
+	uint32_t	reorder;	/* Wait before first NACK, ms. */
+	uint32_t	nack_interval;	/* Repeat NACK for same packet, ms. */
+	uint32_t	retries;	/* NACKs per missing packet. */
+} rtp_arq_settings_t, *rtp_arq_settings_p;
+/* Default values. */
+#define RTP_ARQ_S_DEF_WINDOW		(1024)	/* Packets. */
+#define RTP_ARQ_S_DEF_DELAY		(500)	/* ms */
+#define RTP_ARQ_S_DEF_REORDER		(10)	/* ms */
+#define RTP_ARQ_S_DEF_NACK_INTERVAL	(100)	/* ms */
+#define RTP_ARQ_S_DEF_RETRIES		(3)
+
+#define RTP_ARQ_PKT_SIZE_MAX		1500	/* Bigger packets dropped. */
+#define RTP_ARQ_RTCP_SIZE_MAX		1200	/* Compound RTCP with NACK. */
+
+typedef struct rtp_arq_stat_s {
+	uint64_t	requested;	/* Packets requested by NACK, with repeats. */
+	uint64_t	recovered;	/* Requested packets received in time. */
+	uint64_t	late;		/* Received after released or skipped, duplicates. */
+	uint64_t	lost;		/* Skipped: not received in hold time. */
+	uint64_t	nack_count;	/* RTCP NACK packets made. */
+	uint64_t	resync_count;	/* Sequence jump out of window. */
+} rtp_arq_stat_t, *rtp_arq_stat_p;
+
+
+void	rtp_arq_settings_def(rtp_arq_settings_p p_ret);
+
+int	rtp_arq_create(rtp_arq_settings_p s, rtp_arq_p *arq_ret);
+void	rtp_arq_destroy(rtp_arq_p arq);
+/*
+ * Put received packet, time: monotonic ms.
+ * Return EINVAL if not RTP: caller commit it as is.
+ */
+int	rtp_arq_put(rtp_arq_p arq, const uint8_t *buf, size_t buf_size,
+	    uint64_t time);
+/*
+ * Next packet ready to commit, 0 = none.
+ * Pointer valid until next rtp_arq_put() / rtp_arq_get().
+ */
+size_t	rtp_arq_get(rtp_arq_p arq, uint64_t time, const uint8_t **buf);
+/*
+ * All due NACKs in one compound RTCP: RR + SDES CNAME + RTPFB.
+ * Return size, 0 = nothing to request.
+ */
+size_t	rtp_arq_nack_make(rtp_arq_p arq, uint64_t time, uint8_t *buf,
+	    size_t buf_size);
+int	rtp_arq_stat_get(rtp_arq_p arq, rtp_arq_stat_p stat);
+
+
+#endif /* __MSD_RTP_ARQ_H__ */
@@ -0,0 +1,193 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+
+
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include <inttypes.h>
+#include <string.h> /* bcopy, bzero, memcpy, memmove, memset, strerror... */
+#include <errno.h>
+
+#include "utils/macro.h"
+#include "net/socket_address.h"
+#include "stream_sys.h"
+#include "replay.h"
+
+
+void
+str_src_conn_def(str_src_conn_params_p src_conn_params) {
+
+	if (NULL == src_conn_params)
+		return;
+	memset(src_conn_params, 0x00, sizeof(str_src_conn_params_t));
+	src_conn_params->mc.if_index = STR_SRC_CONN_DEF_IFINDEX;
+	src_conn_params->mc.rejoin_time = 0;
+}
+
+/* "[SOURCE@]GROUP[:PORT]": group with port and optional SSM source. */
+int
+str_src_conn_addr_from_str(str_src_conn_params_p src_conn_params,
+    const char *buf, size_t buf_size) {
+	const char *grp;
+
+	if (NULL == src_conn_params || NULL == buf || 0 == buf_size)
+		return (EINVAL);
+	grp = memchr(buf, '@', buf_size);
+	if (NULL == grp) {
+		grp = buf;
+		src_conn_params->mc.src.ss_family = AF_UNSPEC;
+	} else {
+		if (0 != sa_addr_from_str(&src_conn_params->mc.src, buf,
+		    (size_t)(grp - buf)))
+			return (EINVAL);
+		grp ++;
+	}
+	if (0 != sa_addr_port_from_str(&src_conn_params->udp.addr, grp,
+	    (size_t)((buf + buf_size) - grp)))
+		return (EINVAL);
+	if (AF_UNSPEC != src_conn_params->mc.src.ss_family &&
+	    src_conn_params->mc.src.ss_family != src_conn_params->udp.addr.ss_family)
+		return (EINVAL);
+	if (0 == sa_port_get(&src_conn_params->udp.addr)) { /* Def udp port. */
+		sa_port_set(&src_conn_params->udp.addr, STR_SRC_CONN_DEF_PORT);
+	}
+
+	return (0);
+}
+
+/*
+ * "ORIGIN[:PORT][,ORIGIN[:PORT]...][/PATH]": HTTP pull source,
+ * origins tried in order on failure.
+ */
+int
+str_src_conn_http_from_str(str_src_conn_params_p src_conn_params,
+    const char *buf, size_t buf_size) {
+	str_src_conn_http_p conn_http;
+	const char *cur, *end, *path, *next;
+
+	if (NULL == src_conn_params || NULL == buf || 0 == buf_size)
+		return (EINVAL);
+	conn_http = &src_conn_params->http;
+	path = memchr(buf, '/', buf_size);
+	if (NULL == path) {
+		path = (buf + buf_size);
+		conn_http->path[0] = '/';
+		conn_http->path_size = 1;
+	} else {
+		conn_http->path_size = (size_t)((buf + buf_size) - path);
+		if (sizeof(conn_http->path) <= conn_http->path_size)
+			return (EINVAL);
+		memcpy(conn_http->path, path, conn_http->path_size);
+		for (cur = path; cur < (buf + buf_size); cur ++) {
+			if (' ' >= (*cur)) /* No request line injection. */
+				return (EINVAL);
+		}
+	}
+	conn_http->path[conn_http->path_size] = 0;
+	conn_http->origin_count = 0;
+	for (cur = buf; cur < path; cur = (next + 1)) {
+		next = memchr(cur, ',', (size_t)(path - cur));
+		end = ((NULL == next) ? path : next);
+		if (STR_SRC_CONN_HTTP_ORIGIN_MAX == conn_http->origin_count ||
+		    0 != sa_addr_port_from_str(
+		    &conn_http->origin[conn_http->origin_count], cur,
+		    (size_t)(end - cur)))
+			return (EINVAL);
+		if (0 == sa_port_get(&conn_http->origin[conn_http->origin_count])) {
+			sa_port_set(&conn_http->origin[conn_http->origin_count],
+			    STR_SRC_CONN_DEF_HTTP_PORT);
+		}
+		conn_http->origin_count ++;
+		if (NULL == next)
+			break;
+	}
+	if (0 == conn_http->origin_count)
+		return (EINVAL);
+	sa_copy(&conn_http->origin[0], &conn_http->mc.udp.addr);
+	conn_http->mc.udp.type = STR_SRC_CONN_T_HTTP;
+	conn_http->mc.src.ss_family = AF_UNSPEC;
+
+	return (0);
+}
+
+/*
+ * "PATH[?OPT[&OPT...]]": file replay source, OPT: loop, fast,
+ * dst=ADDR:PORT - pcap UDP stream filter.
+ */
+int
+str_src_conn_file_from_str(str_src_conn_params_p src_conn_params,
+    const char *buf, size_t buf_size) {
+	str_src_conn_file_p conn_file;
+	const char *cur, *end, *opt, *next;
+
+	if (NULL == src_conn_params || NULL == buf || 0 == buf_size)
+		return (EINVAL);
+	conn_file = &src_conn_params->file;
+	opt = memchr(buf, '?', buf_size);
+	end = ((NULL == opt) ? (buf + buf_size) : opt);
+	conn_file->path_size = (size_t)(end - buf);
+	if (0 == conn_file->path_size ||
+	    sizeof(conn_file->path) <= conn_file->path_size)
+		return (EINVAL);
+	memcpy(conn_file->path, buf, conn_file->path_size);
+	conn_file->path[conn_file->path_size] = 0;
+	if (conn_file->path_size != strlen(conn_file->path))
+		return (EINVAL);
+	conn_file->flags = 0;
+	conn_file->mc.udp.addr.ss_family = AF_UNSPEC;
+	for (cur = opt; NULL != cur; cur = next) {
+		cur ++; /* Skip '?' / '&'. */
+		next = memchr(cur, '&', (size_t)((buf + buf_size) - cur));
+		end = ((NULL == next) ? (buf + buf_size) : next);
+		if (4 == (end - cur) && 0 == memcmp(cur, "loop", 4)) {
+			conn_file->flags |= REPLAY_F_LOOP;
+		} else if (4 == (end - cur) && 0 == memcmp(cur, "fast", 4)) {
+			conn_file->flags |= REPLAY_F_FAST;
+		} else if (4 < (end - cur) && 0 == memcmp(cur, "dst=", 4)) {
+			if (0 != sa_addr_port_from_str(&conn_file->mc.udp.addr,
+			    (cur + 4), (size_t)(end - (cur + 4))))
+				return (EINVAL);
+			if (0 == sa_port_get(&conn_file->mc.udp.addr)) {
+				sa_port_set(&conn_file->mc.udp.addr,
+				    STR_SRC_CONN_DEF_PORT);
+			}
+		} else {
+			return (EINVAL);
+		}
+	}
+	conn_file->mc.udp.type = STR_SRC_CONN_T_FILE;
+	conn_file->mc.src.ss_family = AF_UNSPEC;
+
+	return (0);
+}
@@ -34,12 +34,23 @@
 #include <sys/mman.h>
 #include <sys/stat.h> /* For mode constants */
 #include <sys/file.h> /* flock */
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <net/if.h> /* IFNAMSIZ */
+#include <netinet/tcp.h>
+#include <netinet/udp.h> /* UDP_GRO */
+#ifdef __linux__ /* Linux specific code. */
+#	include <linux/sockios.h> /* SIOCOUTQ */
+#endif
 
+#include <stddef.h> /* offsetof */
 #include <stdlib.h> /* malloc, exit */
 #include <pthread.h>
 #include <stdio.h> /* snprintf, fprintf */
 #include <unistd.h> /* close, write, sysconf */
 #include <fcntl.h> /* For O_* constants */
+#include <inttypes.h>
 #include <string.h> /* bcopy, bzero, memcpy, memmove, memset, strerror... */
 #include <time.h>
 #include <errno.h>
@@ -61,22 +72,119 @@
 #include "utils/mem_utils.h"
 #include "proto/http.h"
 #include "stream_sys.h"
+#include "stream_sys_pkt.h"
+#include "handoff.h"
+#include "if_table.h"
 
 /* Internal constants. */
 #define STR_HUB_CLI_RECV_BUF		4096
 #define STR_HUB_CLI_RECV_LOWAT		1
+#define STR_HUB_HLS_CLI_TIMEOUT		30 /* s, segment send and socket drain. */
 #define STR_SRC_UDP_PKT_SIZE_STD	1500
 #define STR_SRC_UDP_PKT_SIZE_MAX	65612 /* 349 * 188 */
+#define STR_SRC_UDP_GRO_SIZE_MAX	(64 * 1024) /* GRO super packet. */
+
+const uint64_t str_hub_lag_hist_ms[STR_HUB_LAG_HIST_COUNT] = {
+	50, 100, 250, 500, 1000, 2000, 5000, UINT64_MAX
+};
 
+static const char *str_hub_cli_drop_reason_names[STR_HUB_CLI_DROP_R__COUNT] = {
+	"none", "ring overrun", "socket error", "slow client", "admin",
+	"source lost"
+};
+
+static const char *str_hubs_reject_reason_names[STR_HUBS_REJ_R__COUNT] = {
+	"none", "hub clients limit", "hubs limit", "thread rate limit",
+	"rate limit", "dead source"
+};
 
 typedef struct str_hub_cli_attach_cb_data_s {
 	str_hubs_bckt_p	shbskt;
 	str_hub_cli_p	strh_cli;
 	uint8_t		*hub_name;
 	size_t		hub_name_size;
+	size_t		prof_name_size;
+	char		prof_name[STR_HUB_PROF_NAME_MAX];
 	str_src_conn_params_t src_conn_params;
 } str_hub_cli_attach_cb_data_t, *str_hub_cli_attach_cb_data_p;
 
+typedef struct str_hub_hls_req_cb_data_s {
+	str_hubs_bckt_p	shbskt;
+	http_srv_cli_p	cli;		/* Playlist: reply via HTTP server. */
+	uintptr_t	skt;		/* Segment: own socket. */
+	uint64_t	seq;		/* STR_HUB_HLS_PLAYLIST or segment. */
+	uint8_t		*hub_name;
+	size_t		hub_name_size;
+	uint8_t		*args;		/* Query string for segment URIs. */
+	size_t		args_size;
+	size_t		prof_name_size;
+	char		prof_name[STR_HUB_PROF_NAME_MAX];
+	str_src_conn_params_t src_conn_params;
+} str_hub_hls_req_cb_data_t, *str_hub_hls_req_cb_data_p;
+
+typedef struct str_hub_rec_ctl_cb_data_s {
+	str_hubs_bckt_p	shbskt;
+	http_srv_cli_p	cli;		/* NULL = no reply. */
+	int		start;
+	uint8_t		*hub_name;
+	size_t		hub_name_size;
+	size_t		prof_name_size;
+	char		prof_name[STR_HUB_PROF_NAME_MAX];
+	size_t		rec_name_size;
+	char		rec_name[REC_NAME_MAX];
+	str_src_conn_params_t src_conn_params;
+} str_hub_rec_ctl_cb_data_t, *str_hub_rec_ctl_cb_data_p;
+
+typedef struct str_hub_push_ctl_cb_data_s {
+	str_hubs_bckt_p	shbskt;
+	http_srv_cli_p	cli;		/* NULL = no reply. */
+	int		start;
+	udp_push_params_t push_params;
+	uint8_t		*hub_name;
+	size_t		hub_name_size;
+	size_t		prof_name_size;
+	char		prof_name[STR_HUB_PROF_NAME_MAX];
+	str_src_conn_params_t src_conn_params;
+} str_hub_push_ctl_cb_data_t, *str_hub_push_ctl_cb_data_p;
+
+typedef struct str_hubs_bckt_handoff_data_s { /* thread message sync data. */
+	str_hubs_bckt_p		shbskt;
+	uintptr_t		skt;	/* Unix socket to new process. */
+	tpt_msg_done_cb		done_cb;
+	void			*udata;
+	size_t			hub_count; /* Passed. */
+	size_t			cli_count; /* Passed. */
+	size_t			skip_count; /* Not passed: socket buf full. */
+	int			broken;	/* Stream out of sync, stop sending. */
+	handoff_rec_t		rec;
+} str_hubs_bckt_handoff_data_t, *str_hubs_bckt_handoff_data_p;
+
+typedef struct str_hubs_bckt_reload_data_s { /* thread message sync data. */
+	str_hubs_bckt_p		shbskt;
+	str_hubs_settings_p	settings_old; /* Free after all threads done. */
+} str_hubs_bckt_reload_data_t, *str_hubs_bckt_reload_data_p;
+
+typedef struct str_hub_import_data_s { /* thread message data. */
+	str_hubs_bckt_p		shbskt;
+	uintptr_t		skt;	/* Multicast socket. */
+	str_src_conn_params_t	src_conn_params;
+	size_t			prof_name_size;
+	char			prof_name[STR_HUB_PROF_NAME_MAX];
+	size_t			hub_name_size;
+	uint8_t			*hub_name;
+} str_hub_import_data_t, *str_hub_import_data_p;
+
+typedef struct str_hub_neg_inval_data_s { /* thread message data. */
+	str_hubs_bckt_p		shbskt;
+	struct sockaddr_storage	addr;
+} str_hub_neg_inval_data_t, *str_hub_neg_inval_data_p;
+
+typedef struct str_hubs_bckt_link_data_s { /* thread message data. */
+	str_hubs_bckt_p		shbskt;
+	uint32_t		if_index;
+	int			up;
+} str_hubs_bckt_link_data_t, *str_hubs_bckt_link_data_p;
+
 
 
 typedef struct str_hubs_bckt_enum_data_s { /* thread message sync data. */
@@ -96,23 +204,139 @@ static void	str_hubs_bckt_enum_msg_cb(tpt_p tpt, void *udata);
 static void	str_hubs_bckt_enum_done_cb(tpt_p tpt, size_t send_msg_cnt,
 		    size_t error_cnt, void *udata);
 
+static void	str_hubs_bckt_reload_msg_cb(tpt_p tpt, void *udata);
+static void	str_hubs_bckt_reload_done_cb(tpt_p tpt, size_t send_msg_cnt,
+		    size_t error_cnt, void *udata);
+
+static void	str_hubs_bckt_link_state_msg_cb(tpt_p tpt, void *udata);
+static void	str_hubs_bckt_link_state_done_cb(tpt_p tpt, size_t send_msg_cnt,
+		    size_t error_cnt, void *udata);
+
+static int	str_hub_cli_hdrs_keep(str_hub_p str_hub, str_hub_cli_p strh_cli);
+static void	str_hubs_bckt_handoff_msg_cb(tpt_p tpt, void *udata);
+static void	str_hubs_bckt_handoff_err(str_hubs_bckt_handoff_data_p ho_data,
+		    int error);
+static void	str_hubs_bckt_handoff_done_cb(tpt_p tpt, size_t send_msg_cnt,
+		    size_t error_cnt, void *udata);
+static size_t	str_hub_cli_tail_get(str_hub_p str_hub, str_hub_cli_p strh_cli,
+		    uint8_t *buf, size_t buf_size);
+static size_t	str_hub_cli_tshift_tail_get(str_hub_p str_hub,
+		    str_hub_cli_p strh_cli, uint8_t *buf, size_t buf_size);
+static void	str_hub_import_msg_cb(tpt_p tpt, void *udata);
+
 void		str_hubs_bckt_timer_service(str_hubs_bckt_p shbskt,
-		    str_hub_p str_hub, str_hubs_stat_p stat);
+		    str_hub_p str_hub, str_hubs_stat_p stat,
+		    uint32_t *tcp_info_budget);
 static void	str_hubs_bckt_timer_msg_cb(tpt_p tpt, void *udata);
 static void	str_hubs_bckt_timer_cb(tp_event_p ev, tp_udata_p tp_udata);
 
 int	str_hub_create_int(str_hubs_bckt_p shbskt, tpt_p tpt,
-	    uint8_t *name, size_t name_size,
-	    str_src_conn_params_p src_conn_params, str_hub_p *str_hub_ret);
-void	str_hub_destroy_int(str_hub_p str_hub);
+	    uint8_t *name, size_t name_size, str_hub_prof_p prof,
+	    str_src_conn_params_p src_conn_params, uintptr_t skt,
+	    size_t hubs_max, str_hub_p *str_hub_ret);
+static str_hub_prof_p str_hubs_prof_select(str_hubs_settings_p settings,
+	    const char *name, size_t name_size,
+	    const struct sockaddr_storage *addr);
+static const struct sockaddr_storage *str_src_conn_prof_addr(
+	    const str_src_conn_params_t *src_conn_params);
+void	str_hub_destroy_int(str_hub_p str_hub, uint32_t drop_reason);
+void	str_hub_cli_lag_update(str_hub_p str_hub, str_hub_cli_p strh_cli);
+int	str_hub_cli_tcp_info_sample(str_hub_cli_p strh_cli, time_t cur_time);
+int	str_hub_cli_snd_buf_autotune(str_hub_p str_hub, str_hub_cli_p strh_cli);
+void	str_hub_cli_snd_buf_read(str_hub_cli_p strh_cli);
+
+static void	str_hub_neg_add(str_hub_p str_hub);
+static void	str_hub_neg_del(str_hubs_bckt_p shbskt, str_hub_thrd_p thr_data,
+		    str_hub_neg_p neg);
+static void	str_hub_neg_expire(str_hubs_bckt_p shbskt, str_hub_thrd_p thr_data,
+		    time_t cur_time);
+static str_hub_neg_p str_hub_neg_find(str_hubs_bckt_p shbskt,
+		    str_hub_thrd_p thr_data, const uint8_t *name, size_t name_size);
+static void	str_hub_neg_invalidate(str_hub_p str_hub);
+static void	str_hub_neg_invalidate_msg_cb(tpt_p tpt, void *udata);
+static void	str_hub_neg_invalidate_done_cb(tpt_p tpt, size_t send_msg_cnt,
+		    size_t error_cnt, void *udata);
+static int	str_src_addr_is_eq(const struct sockaddr_storage *addr1,
+		    const struct sockaddr_storage *addr2);
 
 void	str_hub_cli_attach_msg_cb(tpt_p tpt, void *udata);
+static void str_hub_cli_reject(str_hubs_bckt_p shbskt, tpt_p tpt,
+	    const uint8_t *hub_name, size_t hub_name_size,
+	    str_hub_cli_p strh_cli, uint32_t reason);
+static void str_hub_access_log(str_hubs_bckt_p shbskt, tpt_p tpt,
+	    const uint8_t *hub_name, size_t hub_name_size,
+	    str_hub_p str_hub, str_hub_cli_p strh_cli,
+	    uint32_t event, const char *reason);
+static const char *str_hub_cli_addr_str(str_hub_cli_p strh_cli,
+	    char *buf, size_t buf_size);
 
 int	str_hub_send_to_client(str_hub_p str_hub, str_hub_cli_p strh_cli,
 	    size_t *transfered_size);
 int	str_hub_send_to_clients(str_hub_p str_hub);
+static inline void str_hub_hls_write(str_hub_p str_hub, const uint8_t *buf,
+		    size_t buf_size);
+static void	str_hub_hls_req_msg_cb(tpt_p tpt, void *udata);
+static void	str_hub_hls_reply(str_hubs_bckt_p shbskt, uintptr_t skt,
+		    const char *status, size_t status_size);
+static int	str_hub_hls_cli_send(str_hub_p str_hub, str_hls_cli_p hls_cli);
+static void	str_hub_hls_send_to_clients(str_hub_p str_hub);
+static void	str_hub_hls_cli_destroy(str_hub_p str_hub, str_hls_cli_p hls_cli);
+static size_t	str_hub_hls_cli_outq(str_hls_cli_p hls_cli);
+static uint32_t	str_hub_ctl_hub_get(str_hubs_bckt_p shbskt, tpt_p tpt,
+		    int create, uint8_t *hub_name, size_t hub_name_size,
+		    const char *prof_name, size_t prof_name_size,
+		    str_src_conn_params_p src_conn_params, str_hub_p *str_hub_ret);
+static void	str_hub_rec_ctl_msg_cb(tpt_p tpt, void *udata);
+static void	str_hub_rec_feed(str_hub_p str_hub);
+static void	str_hub_push_ctl_msg_cb(tpt_p tpt, void *udata);
+static void	str_hub_push_destroy(str_hub_p str_hub, str_hub_push_p strh_push);
+static void	str_hub_push_feed(str_hub_p str_hub);
+static inline void str_hub_tshift_write(str_hub_p str_hub, const uint8_t *buf,
+		    size_t buf_size);
+static void	str_hub_cli_tshift_seek(str_hub_p str_hub, str_hub_cli_p strh_cli);
+static int	str_hub_tshift_send_to_client(str_hub_p str_hub,
+		    str_hub_cli_p strh_cli, size_t *transfered_size);
+static void	str_hub_cli_tshift_to_live(str_hub_p str_hub,
+		    str_hub_cli_p strh_cli);
+static int	str_src_skt_is_join_only(uintptr_t skt,
+		    const struct sockaddr_storage *addr);
+static int	str_src_ring_hub_init(str_hub_p str_hub, uintptr_t skt);
+static int	str_src_ring_attach(str_hub_p str_hub);
+static void	str_src_ring_detach(str_hub_p str_hub);
+static int	str_src_ring_rebuild(str_src_ring_p ring, str_hub_p str_hub_new);
+static void	str_src_ring_pkt_cb(pkt_ring_p pkt_ring, pkt_ring_pkt_p pkt,
+		    void *udata);
+static void	str_src_ring_block_cb(pkt_ring_p pkt_ring, void *udata);
+static int	str_src_recv_drain_cb(tp_task_p tptask, int error, uint32_t eof,
+		    size_t data2transfer_size, void *arg);
+static void	str_src_pkt_commit(str_hub_p str_hub, uint8_t *buf,
+		    size_t buf_size);
+static int	str_src_skt_busy_poll(uintptr_t skt,
+		    str_src_settings_p src_params);
+static ssize_t	str_src_recvmsg(uintptr_t skt, uint8_t *buf, size_t buf_size,
+		    size_t *seg_size, int *trunc, struct timespec *ts);
+static void	str_src_pkt_commit_gro(str_hub_p str_hub, uint8_t *buf,
+		    size_t buf_size, size_t seg_size);
+static void	str_src_data_rcvd(str_hub_p str_hub, size_t transfered_size);
 static int str_src_recv_mc_cb(tp_task_p tptask, int error, uint32_t eof,
 	    size_t data2transfer_size, void *arg);
+static inline uint64_t str_src_arq_time(void);
+static int	str_src_arq_init(str_hub_p str_hub);
+static void	str_src_arq_destroy(str_hub_p str_hub);
+static int	str_src_arq_rtcp_cb(tp_task_p tptask, int error, uint32_t eof,
+		    size_t data2transfer_size, void *arg);
+static void	str_src_recv_arq(str_hub_p str_hub, uintptr_t skt,
+		    size_t data2transfer_size);
+static size_t	str_src_arq_commit(str_hub_p str_hub, uint64_t time);
+static int	str_src_http_connect(str_hub_p str_hub);
+static void	str_src_http_retry(str_hub_p str_hub, int error);
+static int	str_src_http_timer(str_hub_p str_hub, time_t cur_time);
+static int	str_src_http_conn_cb(tp_task_p tptask, int error, uint32_t eof,
+		    size_t data2transfer_size, void *arg);
+static int	str_src_http_resp_parse(str_hub_p str_hub);
+static int	str_src_http_recv_cb(tp_task_p tptask, int error, uint32_t eof,
+		    size_t data2transfer_size, void *arg);
+static int	str_src_file_init(str_hub_p str_hub, uintptr_t *skt_ret);
 int	str_src_r_buf_alloc(str_hub_p str_hub);
 void	str_src_r_buf_free(str_hub_p str_hub);
 
@@ -148,6 +372,15 @@ str_hub_settings_def(str_hub_settings_p p_ret) {
 	p_ret->precache = STR_HUB_S_DEF_PRECAHE;
 	p_ret->snd_block_min_size = STR_HUB_S_DEF_SND_BLOCK_MIN_SIZE;
 	p_ret->skt_snd_buf = STR_HUB_S_DEF_SKT_SND_BUF;
+	p_ret->skt_snd_buf_min = STR_HUB_S_DEF_SKT_SND_BUF_MIN;
+	p_ret->skt_snd_buf_max = STR_HUB_S_DEF_SKT_SND_BUF_MAX;
+	p_ret->skt_snd_buf_factor = STR_HUB_S_DEF_SKT_SND_BUF_FACTOR;
+	p_ret->cli_lag_max = STR_HUB_S_DEF_CLI_LAG_MAX;
+	p_ret->tcp_info_interval = STR_HUB_S_DEF_TCP_INFO_INTERVAL;
+	p_ret->tcp_info_per_tick = STR_HUB_S_DEF_TCP_INFO_PER_TICK;
+	hls_settings_def(&p_ret->hls);
+	p_ret->hls_idle_timeout = STR_HUB_S_DEF_HLS_IDLE_TIMEOUT;
+	tshift_settings_def(&p_ret->tshift);
 }
 
 void
@@ -159,88 +392,502 @@ str_src_settings_def(str_src_settings_p p_ret) {
 	p_ret->skt_rcv_buf = STR_SRC_S_DEF_SKT_RCV_BUF;
 	p_ret->skt_rcv_lowat = STR_SRC_S_DEF_SKT_RCV_LOWAT;
 	p_ret->rcv_timeout = STR_SRC_S_DEF_UDP_RCV_TIMEOUT;
+	p_ret->neg_cache_ttl = STR_SRC_S_DEF_NEG_CACHE_TTL;
+	p_ret->busy_poll = STR_SRC_S_DEF_BUSY_POLL;
+	p_ret->busy_poll_budget = STR_SRC_S_DEF_BUSY_POLL_BUDGET;
+	pkt_ring_settings_def(&p_ret->pkt_ring);
+	p_ret->http_conn_timeout = STR_SRC_S_DEF_HTTP_CONN_TIMEOUT;
+	p_ret->http_retry_max = STR_SRC_S_DEF_HTTP_RETRY_MAX;
+	p_ret->http_fail_timeout = STR_SRC_S_DEF_HTTP_FAIL_TIMEOUT;
+	p_ret->http_rcv_size = STR_SRC_S_DEF_HTTP_RCV_SIZE;
+	rtp_arq_settings_def(&p_ret->arq);
 }
 
 void
-str_src_conn_def(str_src_conn_params_p src_conn_params) {
+str_hubs_limits_def(str_hubs_limits_p p_ret) {
 
-	if (NULL == src_conn_params)
+	if (NULL == p_ret)
 		return;
-	memset(src_conn_params, 0x00, sizeof(str_src_conn_params_t));
-	src_conn_params->mc.if_index = STR_SRC_CONN_DEF_IFINDEX;
-	src_conn_params->mc.rejoin_time = 0;
+	memset(p_ret, 0x00, sizeof(str_hubs_limits_t));
+	p_ret->retry_after = STR_HUBS_LIMITS_DEF_RETRY_AFTER;
 }
 
+const char *
+str_hubs_reject_reason_str(uint32_t reason) {
 
-int
-str_hubs_bckt_create(tp_p tp, const char *app_ver, str_hub_settings_p hub_params,
-    str_src_settings_p src_params, str_hubs_bckt_p *shbskt_ret) {
-	int error;
-	str_hubs_bckt_p shbskt;
-	char osver[128];
-	size_t i, thread_count_max;
+	if (STR_HUBS_REJ_R__COUNT <= reason)
+		return ("unknown");
+	return (str_hubs_reject_reason_names[reason]);
+}
 
-	if (NULL == shbskt_ret)
-		return (EINVAL);
-	shbskt = calloc(1, sizeof(str_hubs_bckt_t) + hub_params->cust_http_hdrs_size + sizeof(void*));
-	if (NULL == shbskt)
-		return (ENOMEM);
-	thread_count_max = tp_thread_count_max_get(tp);
-	shbskt->thr_data = calloc(1, (sizeof(str_hub_thrd_t) * thread_count_max));
-	if (NULL == shbskt->thr_data) {
-		error = ENOMEM;
-		goto err_out;
-	}
-	for (i = 0; i < thread_count_max; i ++) {
-		TAILQ_INIT(&shbskt->thr_data[i].hub_head);
-	}
-	/* Stream Hub Params */
-	memcpy(&shbskt->hub_params, hub_params, sizeof(str_hub_settings_t));
+
+/* Copy profile settings to dst, convert units and correct values. */
+static uint8_t *
+str_hub_prof_copy(str_hub_prof_p dst, str_hub_prof_p src, uint8_t *buf) {
+	str_hub_settings_p hub_params = &dst->hub; /* Use short name. */
+	str_src_settings_p src_params = &dst->src; /* Use short name. */
+
+	memcpy(dst, src, sizeof(str_hub_prof_t));
+	dst->name_size = MIN(dst->name_size, (sizeof(dst->name) - 1));
+	dst->name[dst->name_size] = 0;
 	/* Copy custom HTTP headers to new buffer. */
-	shbskt->hub_params.cust_http_hdrs = (uint8_t*)(shbskt + 1);
-	if (NULL != hub_params->cust_http_hdrs &&
-	    0 != hub_params->cust_http_hdrs_size) {
+	hub_params->cust_http_hdrs = buf;
+	if (NULL != src->hub.cust_http_hdrs &&
+	    0 != src->hub.cust_http_hdrs_size) {
 		/* Custom headers body. */
-		memcpy(shbskt->hub_params.cust_http_hdrs,
-		    hub_params->cust_http_hdrs,
-		    hub_params->cust_http_hdrs_size);
-		if (0 != memcmp((shbskt->hub_params.cust_http_hdrs +
-		    (shbskt->hub_params.cust_http_hdrs_size - 2)), "\r\n", 2)) {
+		memcpy(hub_params->cust_http_hdrs, src->hub.cust_http_hdrs,
+		    src->hub.cust_http_hdrs_size);
+		if (0 != memcmp((hub_params->cust_http_hdrs +
+		    (hub_params->cust_http_hdrs_size - 2)), "\r\n", 2)) {
 			/* Add CRLF. */
-			memcpy((shbskt->hub_params.cust_http_hdrs +
-			    shbskt->hub_params.cust_http_hdrs_size), "\r\n", 2);
-			shbskt->hub_params.cust_http_hdrs_size += 2;
+			memcpy((hub_params->cust_http_hdrs +
+			    hub_params->cust_http_hdrs_size), "\r\n", 2);
+			hub_params->cust_http_hdrs_size += 2;
 		}
+	} else {
+		hub_params->cust_http_hdrs_size = 0;
 	}
 	/* Add final CRLF + zero. */
-	memcpy((shbskt->hub_params.cust_http_hdrs +
-	    shbskt->hub_params.cust_http_hdrs_size), "\r\n", 3);
-	shbskt->hub_params.cust_http_hdrs_size += 2;
+	memcpy((hub_params->cust_http_hdrs +
+	    hub_params->cust_http_hdrs_size), "\r\n", 3);
+	hub_params->cust_http_hdrs_size += 2;
+	buf += (hub_params->cust_http_hdrs_size + 1);
+
+	/* Stream Hub Params. */
 	/* sec->ms, kb -> bytes */
-	hub_params = &shbskt->hub_params; /* Use short name. */
 	hub_params->ring_buf_size *= 1024;
 	hub_params->precache *= 1024;
 	hub_params->snd_block_min_size *= 1024;
 	hub_params->skt_snd_buf *= 1024;
+	hub_params->skt_snd_buf_min *= 1024;
+	hub_params->skt_snd_buf_max *= 1024;
 	/* Correct values. */
 	if (hub_params->precache > hub_params->ring_buf_size) {
 		hub_params->precache = hub_params->ring_buf_size;
 	}
+	if (hub_params->skt_snd_buf_min < hub_params->snd_block_min_size) {
+		hub_params->skt_snd_buf_min = (uint32_t)hub_params->snd_block_min_size;
+	}
+	if (hub_params->skt_snd_buf_max < hub_params->skt_snd_buf_min) {
+		hub_params->skt_snd_buf_max = hub_params->skt_snd_buf_min;
+	}
 	if (hub_params->snd_block_min_size > hub_params->skt_snd_buf) {
 		hub_params->snd_block_min_size = hub_params->skt_snd_buf;
 	}
+	hub_params->hls.seg_count = MAX(hub_params->hls.seg_count,
+	    HLS_SEG_COUNT_MIN);
+	hub_params->hls.seg_duration = (MAX(hub_params->hls.seg_duration, 1) * 1000);
+	hub_params->hls.seg_size_max *= 1024;
+	hub_params->tshift.seg_size *= 1024;
+	hub_params->tshift.blk_size *= 1024;
 
 	/* Stream src Params */
-	memcpy(&shbskt->src_params, src_params, sizeof(str_src_settings_t));
-	/* Use short name. */
-	src_params = &shbskt->src_params;
 	/* Correct values. */
 	src_params->skt_rcv_lowat = MIN(src_params->skt_rcv_lowat, src_params->skt_rcv_buf);
 	/* sec->ms, kb -> bytes */
 	src_params->skt_rcv_buf *= 1024;
 	src_params->skt_rcv_lowat *= 1024;
+	src_params->pkt_ring.block_size *= 1024;
 	//src_params->rcv_timeout =; // In seconds!
-	
+
+	return (buf);
+}
+
+/* FNV-1a */
+static inline uint32_t
+str_hub_chan_hash(const uint8_t *name, size_t name_size) {
+	uint32_t hash = 2166136261U;
+
+	for (size_t i = 0; i < name_size; i ++) {
+		hash ^= name[i];
+		hash *= 16777619U;
+	}
+	return (hash);
+}
+
+/* Copy channel map, resolve profiles, prebuild hub names and hash. */
+static void
+str_hubs_settings_chan_init(str_hubs_settings_p settings, str_hub_chan_p chan,
+    size_t chan_count) {
+	size_t i;
+	str_hub_chan_p dst;
+
+	for (i = 0; i < settings->chan_hash_mask + 1; i ++) {
+		settings->chan_hash[i] = SIZE_MAX;
+	}
+	for (i = 0; i < chan_count; i ++) {
+		dst = &settings->chan[settings->chan_count];
+		memcpy(dst, &chan[i], sizeof(str_hub_chan_t));
+		dst->name_size = MIN(dst->name_size, (sizeof(dst->name) - 1));
+		dst->name[dst->name_size] = 0;
+		dst->title_size = MIN(dst->title_size, (sizeof(dst->title) - 1));
+		dst->title[dst->title_size] = 0;
+		if (0 == dst->name_size ||
+		    NULL != str_hubs_settings_chan_get(settings,
+		    (const uint8_t*)dst->name, dst->name_size)) {
+			syslog(LOG_WARNING, "Channel \"%s\": empty or duplicate name, skipped.",
+			    dst->name);
+			continue;
+		}
+		dst->prof = str_hubs_settings_prof_get(settings, dst->prof_name,
+		    dst->prof_name_size,
+		    str_src_conn_prof_addr(&dst->src_conn_params));
+		if (NULL == dst->prof) {
+			syslog(LOG_WARNING, "Channel \"%s\": profile \"%.*s\" not found, use auto.",
+			    dst->name, (int)dst->prof_name_size, dst->prof_name);
+			dst->prof = str_hubs_settings_prof_get(settings, NULL, 0,
+			    str_src_conn_prof_addr(&dst->src_conn_params));
+		}
+		/* Not set in channel: from profile. */
+		if (0 == (STR_HUB_CHAN_F_IFINDEX & dst->flags)) {
+			dst->src_conn_params.mc.if_index = dst->prof->src_conn.mc.if_index;
+		}
+		if (0 == (STR_HUB_CHAN_F_REJOIN_TIME & dst->flags)) {
+			dst->src_conn_params.mc.rejoin_time = dst->prof->src_conn.mc.rejoin_time;
+		}
+		if (0 != str_hub_name_make(&dst->src_conn_params, dst->hub_name,
+		    sizeof(dst->hub_name), &dst->hub_name_size)) {
+			syslog(LOG_WARNING, "Channel \"%s\": bad source address, skipped.",
+			    dst->name);
+			continue;
+		}
+		dst->hash = str_hub_chan_hash((const uint8_t*)dst->name, dst->name_size);
+		dst->hnext = settings->chan_hash[(dst->hash & settings->chan_hash_mask)];
+		settings->chan_hash[(dst->hash & settings->chan_hash_mask)] = settings->chan_count;
+		settings->chan_count ++;
+	}
+}
+
+/* Copy settings to one memory block. */
+static int
+str_hubs_settings_alloc(str_hub_prof_p prof, size_t prof_count,
+    str_hub_chan_p chan, size_t chan_count,
+    str_hubs_limits_p limits, str_hubs_settings_p *settings_ret) {
+	str_hubs_settings_p settings;
+	str_hub_prof_range_p ranges;
+	uint8_t *buf;
+	size_t i, ranges_count = 0, buf_size = 0, hash_size = 1;
+
+	if (NULL == prof || 0 == prof_count || NULL == settings_ret ||
+	    (NULL == chan && 0 != chan_count))
+		return (EINVAL);
+	for (i = 0; i < prof_count; i ++) {
+		ranges_count += prof[i].ranges_count;
+		buf_size += (prof[i].hub.cust_http_hdrs_size + 8); /* CRLF CRLF 0. */
+	}
+	while (hash_size < (chan_count * 2)) { /* Load factor <= 0.5. */
+		hash_size <<= 1;
+	}
+	settings = calloc(1, (sizeof(str_hubs_settings_t) +
+	    (sizeof(str_hub_prof_t) * prof_count) +
+	    (sizeof(str_hub_chan_t) * chan_count) +
+	    (sizeof(size_t) * hash_size) +
+	    (sizeof(str_hub_prof_range_t) * ranges_count) + buf_size));
+	if (NULL == settings)
+		return (ENOMEM);
+	settings->prof = (str_hub_prof_p)(settings + 1);
+	settings->prof_count = prof_count;
+	settings->chan = (str_hub_chan_p)(settings->prof + prof_count);
+	settings->chan_hash = (size_t*)(settings->chan + chan_count);
+	settings->chan_hash_mask = (hash_size - 1);
+	ranges = (str_hub_prof_range_p)(settings->chan_hash + hash_size);
+	buf = (uint8_t*)(ranges + ranges_count);
+	for (i = 0; i < prof_count; i ++) {
+		buf = str_hub_prof_copy(&settings->prof[i], &prof[i], buf);
+		settings->prof[i].num = i;
+		if (0 == prof[i].ranges_count)
+			continue;
+		memcpy(ranges, prof[i].ranges,
+		    (sizeof(str_hub_prof_range_t) * prof[i].ranges_count));
+		settings->prof[i].ranges = ranges;
+		ranges += prof[i].ranges_count;
+	}
+	/* After profiles: channels point to them. */
+	str_hubs_settings_chan_init(settings, chan, chan_count);
+
+	/* Admission control. */
+	if (NULL != limits) {
+		memcpy(&settings->limits, limits, sizeof(str_hubs_limits_t));
+	} else {
+		str_hubs_limits_def(&settings->limits);
+	}
+	/* megabit per sec -> bit per sec, same as baud_rate_out. */
+	settings->limits.thread_rate_out_max *= (1024 * 1024);
+	settings->limits.rate_out_max *= (1024 * 1024);
+	settings->retry_after_hdr_size = (size_t)snprintf((char*)settings->retry_after_hdr,
+	    sizeof(settings->retry_after_hdr), "Retry-After: %"PRIu32,
+	    settings->limits.retry_after);
+
+	(*settings_ret) = settings;
+
+	return (0);
+}
+
+/* Any source: skt_mc_join(), else MCAST_(JOIN|LEAVE)_SOURCE_GROUP. */
+int
+str_src_conn_mc_join(uintptr_t skt, int join, str_src_conn_mc_p mc) {
+	struct group_source_req gsr;
+	int level;
+
+	if ((uintptr_t)-1 == skt || NULL == mc)
+		return (EINVAL);
+	if (AF_UNSPEC == mc->src.ss_family)
+		return (skt_mc_join(skt, join, mc->if_index, &mc->udp.addr));
+	if (mc->src.ss_family != mc->udp.addr.ss_family)
+		return (EAFNOSUPPORT);
+	switch (mc->udp.addr.ss_family) {
+	case AF_INET:
+		level = IPPROTO_IP;
+		break;
+	case AF_INET6:
+		level = IPPROTO_IPV6;
+		break;
+	default:
+		return (EAFNOSUPPORT);
+	}
+	memset(&gsr, 0x00, sizeof(gsr));
+	gsr.gsr_interface = ((STR_SRC_CONN_DEF_IFINDEX == mc->if_index) ?
+	    0 : mc->if_index);
+	sa_copy(&mc->udp.addr, &gsr.gsr_group);
+	sa_copy(&mc->src, &gsr.gsr_source);
+	sa_port_set(&gsr.gsr_group, 0);
+	sa_port_set(&gsr.gsr_source, 0);
+	if (0 != setsockopt((int)skt, level,
+	    ((0 != join) ? MCAST_JOIN_SOURCE_GROUP : MCAST_LEAVE_SOURCE_GROUP),
+	    &gsr, sizeof(gsr)))
+		return (errno);
+
+	return (0);
+}
+
+/*
+ * Auto generated hub name: /udp/ADDR:PORT@IF_NAME
+ * or for SSM: /udp/SOURCE@ADDR:PORT@IF_NAME
+ * or for HTTP: /http/ORIGIN:PORT[,ORIGIN:PORT...]/PATH
+ * or for file: /file/PATH[?loop][&fast][&dst=ADDR:PORT]
+ */
+int
+str_hub_name_make(str_src_conn_params_p src_conn_params, uint8_t *buf,
+    size_t buf_size, size_t *buf_size_ret) {
+	char straddr[STR_ADDR_LEN], strsrc[STR_ADDR_LEN];
+	char ifname[(IFNAMSIZ + 1)];
+	size_t i;
+	int ret;
+
+	if (NULL == src_conn_params || NULL == buf || 0 == buf_size)
+		return (EINVAL);
+	if (STR_SRC_CONN_T_HTTP == src_conn_params->udp.type) {
+		ret = snprintf((char*)buf, buf_size, "/http/");
+		for (i = 0; i < src_conn_params->http.origin_count; i ++) {
+			if (0 != sa_addr_port_to_str(&src_conn_params->http.origin[i],
+			    straddr, sizeof(straddr), NULL))
+				return (EINVAL);
+			ret += snprintf((char*)(buf + ret), (buf_size - (size_t)ret),
+			    "%s%s", ((0 != i) ? "," : ""), straddr);
+			if (buf_size <= (size_t)ret)
+				return (ENOBUFS);
+		}
+		ret += snprintf((char*)(buf + ret), (buf_size - (size_t)ret),
+		    "%s", src_conn_params->http.path);
+		goto done;
+	}
+	if (STR_SRC_CONN_T_FILE == src_conn_params->udp.type) {
+		straddr[0] = 0;
+		if (AF_UNSPEC != src_conn_params->udp.addr.ss_family &&
+		    0 != sa_addr_port_to_str(&src_conn_params->udp.addr,
+		    straddr, sizeof(straddr), NULL))
+			return (EINVAL);
+		ret = snprintf((char*)buf, buf_size, "/file%s%s%s%s%s%s%s",
+		    (('/' == src_conn_params->file.path[0]) ? "" : "/"),
+		    src_conn_params->file.path,
+		    ((0 != src_conn_params->file.flags || 0 != straddr[0]) ? "?" : ""),
+		    ((0 != (REPLAY_F_LOOP & src_conn_params->file.flags)) ? "loop&" : ""),
+		    ((0 != (REPLAY_F_FAST & src_conn_params->file.flags)) ? "fast&" : ""),
+		    ((0 != straddr[0]) ? "dst=" : ""), straddr);
+		if (0 < ret && '&' == buf[(ret - 1)] && buf_size > (size_t)ret) {
+			buf[(ret - 1)] = 0; /* Trailing separator. */
+			ret --;
+		}
+		goto done;
+	}
+	if (0 != sa_addr_port_to_str(&src_conn_params->udp.addr, straddr,
+	    sizeof(straddr), NULL))
+		return (EINVAL);
+	ifname[0] = 0;
+	if_table_name_get(src_conn_params->mc.if_index, ifname);
+	if (AF_UNSPEC == src_conn_params->mc.src.ss_family) {
+		ret = snprintf((char*)buf, buf_size, "/udp/%s@%s",
+		    straddr, ifname);
+	} else {
+		if (0 != sa_addr_to_str(&src_conn_params->mc.src, strsrc,
+		    sizeof(strsrc), NULL))
+			return (EINVAL);
+		ret = snprintf((char*)buf, buf_size, "/udp/%s@%s@%s",
+		    strsrc, straddr, ifname);
+	}
+done:
+	if (0 > ret || buf_size <= (size_t)ret)
+		return (ENOBUFS);
+	if (NULL != buf_size_ret) {
+		(*buf_size_ret) = (size_t)ret;
+	}
+	return (0);
+}
+
+/* Compare only address, port ignored. */
+static int
+str_src_addr_cmp(const struct sockaddr_storage *addr1,
+    const struct sockaddr_storage *addr2) {
+	uint32_t a1, a2;
+
+	switch (addr1->ss_family) {
+	case AF_INET:
+		a1 = ntohl(((const struct sockaddr_in*)(const void*)addr1)->sin_addr.s_addr);
+		a2 = ntohl(((const struct sockaddr_in*)(const void*)addr2)->sin_addr.s_addr);
+		return ((a1 < a2) ? -1 : ((a1 > a2) ? 1 : 0));
+	case AF_INET6:
+		return (memcmp(&((const struct sockaddr_in6*)(const void*)addr1)->sin6_addr,
+		    &((const struct sockaddr_in6*)(const void*)addr2)->sin6_addr,
+		    sizeof(struct in6_addr)));
+	}
+	return (0);
+}
+
+/*
+ * Select profile: by name if set, NULL if not found;
+ * otherwise by address range, default if no range match.
+ */
+str_hub_prof_p
+str_hubs_settings_prof_get(str_hubs_settings_p settings, const char *name,
+    size_t name_size, const struct sockaddr_storage *addr) {
+	size_t i, j;
+	str_hub_prof_p prof;
+
+	if (NULL == settings)
+		return (NULL);
+	if (NULL != name && 0 != name_size) {
+		for (i = 0; i < settings->prof_count; i ++) {
+			prof = &settings->prof[i];
+			if (prof->name_size == name_size &&
+			    0 == memcmp(prof->name, name, name_size))
+				return (prof);
+		}
+		return (NULL);
+	}
+	if (NULL == addr)
+		return (&settings->prof[0]);
+	if (AF_INET != addr->ss_family && AF_INET6 != addr->ss_family)
+		return (&settings->prof[0]);
+	for (i = 0; i < settings->prof_count; i ++) {
+		prof = &settings->prof[i];
+		for (j = 0; j < prof->ranges_count; j ++) {
+			/* Both ends: range may come not from config parser. */
+			if (addr->ss_family != prof->ranges[j].first.ss_family ||
+			    addr->ss_family != prof->ranges[j].last.ss_family ||
+			    0 < str_src_addr_cmp(&prof->ranges[j].first, addr) ||
+			    0 > str_src_addr_cmp(&prof->ranges[j].last, addr))
+				continue;
+			return (prof);
+		}
+	}
+	return (&settings->prof[0]);
+}
+str_hub_chan_p
+str_hubs_settings_chan_get(str_hubs_settings_p settings, const uint8_t *name,
+    size_t name_size) {
+	uint32_t hash;
+	size_t idx;
+	str_hub_chan_p chan;
+
+	if (NULL == settings || NULL == name || 0 == name_size)
+		return (NULL);
+	hash = str_hub_chan_hash(name, name_size);
+	for (idx = settings->chan_hash[(hash & settings->chan_hash_mask)];
+	    SIZE_MAX != idx; idx = chan->hnext) {
+		chan = &settings->chan[idx];
+		if (chan->hash == hash && chan->name_size == name_size &&
+		    0 == memcmp(chan->name, name, name_size))
+			return (chan);
+	}
+	return (NULL);
+}
+
+/* Same as str_hubs_settings_prof_get(), but unknown name also fall to address. */
+static str_hub_prof_p
+str_hubs_prof_select(str_hubs_settings_p settings, const char *name,
+    size_t name_size, const struct sockaddr_storage *addr) {
+	str_hub_prof_p prof;
+
+	prof = str_hubs_settings_prof_get(settings, name, name_size, addr);
+	if (NULL != prof)
+		return (prof);
+	return (str_hubs_settings_prof_get(settings, NULL, 0, addr));
+}
+
+/* Source address for profile ranges match. */
+static const struct sockaddr_storage *
+str_src_conn_prof_addr(const str_src_conn_params_t *src_conn_params) {
+
+	switch (src_conn_params->udp.type) {
+	case STR_SRC_CONN_T_HTTP:
+		return (&src_conn_params->http.origin[0]);
+	case STR_SRC_CONN_T_FILE: /* pcap filter, AF_UNSPEC = default. */
+		return (&src_conn_params->file.mc.udp.addr);
+	}
+	return (&src_conn_params->mc.udp.addr);
+}
+
+int
+str_hubs_bckt_create(tp_p tp, const char *app_ver, str_hub_prof_p prof,
+    size_t prof_count, str_hub_chan_p chan, size_t chan_count,
+    str_hubs_limits_p limits, access_log_p alog, tshift_writer_p tsw,
+    rec_writer_p rw, udp_push_settings_p push_settings,
+    str_hubs_bckt_p *shbskt_ret) {
+	int error;
+	str_hubs_bckt_p shbskt;
+	str_hubs_settings_p settings;
+	char osver[128];
+	size_t i, j, thread_count_max;
+
+	if (NULL == shbskt_ret)
+		return (EINVAL);
+	shbskt = calloc(1, sizeof(str_hubs_bckt_t));
+	if (NULL == shbskt)
+		return (ENOMEM);
+	thread_count_max = tp_thread_count_max_get(tp);
+	shbskt->thr_data = calloc(1, (sizeof(str_hub_thrd_t) * thread_count_max));
+	if (NULL == shbskt->thr_data) {
+		error = ENOMEM;
+		goto err_out;
+	}
+	for (i = 0; i < thread_count_max; i ++) {
+		TAILQ_INIT(&shbskt->thr_data[i].hub_head);
+		TAILQ_INIT(&shbskt->thr_data[i].neg_head);
+		for (j = 0; j < STR_HUB_NEG_HASH_SIZE; j ++) {
+			TAILQ_INIT(&shbskt->thr_data[i].neg_hash[j]);
+		}
+		TAILQ_INIT(&shbskt->thr_data[i].ring_head);
+		TAILQ_INIT(&shbskt->thr_data[i].rtcp_head);
+	}
+	error = str_hubs_settings_alloc(prof, prof_count, chan, chan_count,
+	    limits, &settings);
+	if (0 != error)
+		goto err_out;
+	atomic_init(&shbskt->settings, settings);
+	atomic_init(&shbskt->hub_count, 0);
+	atomic_init(&shbskt->neg_count, 0);
+	for (i = 0; i < STR_HUBS_REJ_R__COUNT; i ++) {
+		atomic_init(&shbskt->rejected_count[i], 0);
+	}
+
+	shbskt->alog = alog;
+	shbskt->tsw = tsw;
+	shbskt->rw = rw;
+	if (NULL != push_settings) {
+		memcpy(&shbskt->push_settings, push_settings,
+		    sizeof(udp_push_settings_t));
+	}
+
 	/* Base HTTP headers. */
 	if (0 != info_get_os_ver("/", 1, osver,
 	    (sizeof(osver) - 1), NULL))
@@ -266,6 +913,7 @@ str_hubs_bckt_create(tp_p tp, const char *app_ver, str_hub_settings_p hub_params
 	return (0);
 
 err_out:
+	free(atomic_load_explicit(&shbskt->settings, memory_order_relaxed));
 	free(shbskt->thr_data);
 	free(shbskt);
 	return (error);
@@ -282,6 +930,7 @@ str_hubs_bckt_destroy(str_hubs_bckt_p shbskt) {
 	    (TP_MSG_F_SELF_DIRECT | TP_MSG_F_FORCE | TP_MSG_F_FAIL_DIRECT | TP_BMSG_F_SYNC),
 	    str_hubs_bckt_destroy_msg_cb, shbskt);
 
+	free(atomic_load_explicit(&shbskt->settings, memory_order_relaxed));
 	free(shbskt->thr_data);
 	free(shbskt);
 }
@@ -296,8 +945,18 @@ str_hubs_bckt_destroy_msg_cb(tpt_p tpt, void *udata) {
 
 	TAILQ_FOREACH_SAFE(str_hub, &shbskt->thr_data[thread_num].hub_head, next,
 	    str_hub_temp) {
-		str_hub_destroy_int(str_hub);
+		str_hub_destroy_int(str_hub, STR_HUB_CLI_DROP_R_ADMIN);
+	}
+	/* Negative cache. */
+	while (NULL != TAILQ_FIRST(&shbskt->thr_data[thread_num].neg_head)) {
+		str_hub_neg_del(shbskt, &shbskt->thr_data[thread_num],
+		    TAILQ_FIRST(&shbskt->thr_data[thread_num].neg_head));
 	}
+	udp_push_sender_destroy(shbskt->thr_data[thread_num].push_sender);
+	shbskt->thr_data[thread_num].push_sender = NULL;
+	free(shbskt->thr_data[thread_num].tcp_info_budget);
+	shbskt->thr_data[thread_num].tcp_info_budget = NULL;
+	shbskt->thr_data[thread_num].tcp_info_budget_count = 0;
 }
 
 
@@ -352,101 +1011,698 @@ str_hubs_bckt_enum_done_cb(tpt_p tpt, size_t send_msg_cnt, size_t error_cnt,
 }
 
 
+/*
+ * Replace settings without touching hubs and clients.
+ * New hubs and clients use new settings at once, existing one get socket
+ * options updated by per thread message.
+ * Ring buffer size and precache apply only to new hubs / clients.
+ */
 int
-str_hubs_bckt_stat_summary(str_hubs_bckt_p shbskt, str_hubs_stat_p stat) {
-	size_t i, thread_cnt;
+str_hubs_bckt_reload(str_hubs_bckt_p shbskt, str_hub_prof_p prof,
+    size_t prof_count, str_hub_chan_p chan, size_t chan_count,
+    str_hubs_limits_p limits) {
+	int error;
+	str_hubs_settings_p settings;
+	str_hubs_bckt_reload_data_p rld_data;
 
-	if (NULL == shbskt || NULL == stat)
+	if (NULL == shbskt)
 		return (EINVAL);
-	thread_cnt = tp_thread_count_max_get(shbskt->tp);
-	memset(stat, 0x00, sizeof(str_hubs_stat_t));
-	for (i = 0; i < thread_cnt; i ++) {
-		stat->str_hub_count += shbskt->thr_data[i].stat.str_hub_count;
-		stat->cli_count += shbskt->thr_data[i].stat.cli_count;
-		stat->baud_rate_in += shbskt->thr_data[i].stat.baud_rate_in;
-		stat->baud_rate_out += shbskt->thr_data[i].stat.baud_rate_out;
+	rld_data = malloc(sizeof(str_hubs_bckt_reload_data_t));
+	if (NULL == rld_data)
+		return (ENOMEM);
+	error = str_hubs_settings_alloc(prof, prof_count, chan, chan_count,
+	    limits, &settings);
+	if (0 != error) {
+		free(rld_data);
+		return (error);
 	}
-	return (0);
-}
-
-
-void
-str_hubs_bckt_timer_service(str_hubs_bckt_p shbskt, str_hub_p str_hub,
-    str_hubs_stat_p stat) {
-	int error;
-	str_src_settings_p src_params = &shbskt->src_params;
-	struct timespec *tp = &shbskt->tp_last_tmr_next;
-	uint64_t tm64;
-	time_t tmt;
-
+	rld_data->shbskt = shbskt;
+	rld_data->settings_old = atomic_exchange_explicit(&shbskt->settings,
+	    settings, memory_order_acq_rel);
 
-	/* Stat update. */
-	/* Update stream hub clients baud rate. */
-	if (0 == (tp->tv_sec & 1)) { /* every 2 second */
-		tm64 = (1000000000 * ((uint64_t)tp->tv_sec - (uint64_t)shbskt->tp_last_tmr.tv_sec));
-		tm64 += ((uint64_t)tp->tv_nsec - (uint64_t)shbskt->tp_last_tmr.tv_nsec);
-		if (0 == tm64) /* Prevent division by zero. */
-			tm64 ++;
-		str_hub->baud_rate_out = ((str_hub->sended_count * 4000000000) / tm64);
-		str_hub->baud_rate_in = ((str_hub->received_count * 4000000000) / tm64);
-		str_hub->sended_count = 0;
-		str_hub->received_count = 0;
+	error = tpt_msg_cbsend(shbskt->tp, NULL,
+	    (TP_CBMSG_F_ONE_BY_ONE), str_hubs_bckt_reload_msg_cb,
+	    rld_data, str_hubs_bckt_reload_done_cb);
+	if (0 != error) {
+		/* Can not know is some thread still use old settings: leak it. */
+		SYSLOG_ERR(LOG_ERR, error, "tpt_msg_cbsend().");
+		free(rld_data);
+		return (error);
 	}
-	/* Per Thread stat. */
-	stat->str_hub_count ++;
-	stat->cli_count += str_hub->cli_count;
-	stat->baud_rate_out += str_hub->baud_rate_out;
-	stat->baud_rate_in += str_hub->baud_rate_in;
 
-	/* Check hub. */
-	if (0 == str_hub->cli_count) {
-		syslog(LOG_INFO, "%s: No more clients, selfdestroy.",
-		    str_hub->name);
-		str_hub_destroy_int(str_hub);
-		return;
-	}
-	/* No traffic check. */
-	if (0 != src_params->rcv_timeout) {
-		tmt = (str_hub->tp_last_recv.tv_sec + (time_t)src_params->rcv_timeout);
-		if (tmt < tp->tv_sec ||
-		    (tmt == tp->tv_sec && str_hub->tp_last_recv.tv_nsec < tp->tv_nsec)) {
-			str_hub_destroy_int(str_hub);
-			return;
-		}
-	}
-	/* Re join multicast group timer. */
-	if (0 != str_hub->src_conn_params.mc.rejoin_time &&
-	    str_hub->next_rejoin_time < tp->tv_sec) {
-		str_hub->next_rejoin_time = (tp->tv_sec + (time_t)str_hub->src_conn_params.mc.rejoin_time);
-		for (int join = 0; join < 2; join ++) {
-		    error = skt_mc_join(tp_task_ident_get(str_hub->tptask), join,
-			str_hub->src_conn_params.mc.if_index,
-			&str_hub->src_conn_params.mc.udp.addr);
-		    SYSLOG_ERR(LOG_ERR, error, "skt_mc_join().");
-		}
-	}
+	return (0);
 }
 static void
-str_hubs_bckt_timer_msg_cb(tpt_p tpt, void *udata) {
-	str_hubs_bckt_p shbskt = (str_hubs_bckt_p)udata;
-	str_hub_p str_hub, str_hub_temp;
-	str_hubs_stat_t stat;
+str_hubs_bckt_reload_msg_cb(tpt_p tpt, void *udata) {
+	str_hubs_bckt_reload_data_p rld_data = udata;
+	str_hubs_bckt_p shbskt = rld_data->shbskt;
+	str_hubs_settings_p settings = STR_HUBS_BCKT_SETTINGS(shbskt);
+	str_hub_settings_p hub_params;
+	str_hub_prof_p prof, prof_old;
+	str_hub_p str_hub;
+	str_hub_cli_p strh_cli, strh_cli_temp;
 	size_t thread_num;
+	int error;
 
 	//SYSLOGD_EX(LOG_DEBUG, "...");
 	thread_num = tpt_get_num(tpt);
-	memset(&stat, 0x00, sizeof(str_hubs_stat_t));
 
-	/* Enum all Stream Hubs associated with this thread. */
-	TAILQ_FOREACH_SAFE(str_hub, &shbskt->thr_data[thread_num].hub_head, next,
-	    str_hub_temp) {
-		str_hubs_bckt_timer_service(shbskt, str_hub, &stat);
+	TAILQ_FOREACH(str_hub, &shbskt->thr_data[thread_num].hub_head, next) {
+		/* Old profile still valid here: find same by name. */
+		prof = str_hubs_prof_select(settings, str_hub->prof->name,
+		    str_hub->prof->name_size,
+		    str_src_conn_prof_addr(&str_hub->src_conn_params));
+		/* Old headers freed after reload: keep partially sended. */
+		TAILQ_FOREACH_SAFE(strh_cli, &str_hub->cli_head, next,
+		    strh_cli_temp) {
+			if (0 != (STR_HUB_CLI_STATE_F_HTTP_HDRS_SENDED & strh_cli->flags) ||
+			    0 == strh_cli->offset ||
+			    NULL != strh_cli->hdrs_keep)
+				continue;
+			if (0 != str_hub_cli_hdrs_keep(str_hub, strh_cli)) {
+				strh_cli->drop_reason = STR_HUB_CLI_DROP_R_ADMIN;
+				str_hub_cli_destroy(str_hub, strh_cli);
+			}
+		}
+		prof_old = str_hub->prof;
+		str_hub->prof = prof;
+		hub_params = &prof->hub;
+		/* Only own multicast socket: HTTP TCP socket not tuned. */
+		if (STR_SRC_CONN_T_MC == str_hub->src_conn_params.udp.type &&
+		    NULL != str_hub->tptask) {
+			error = skt_rcv_tune(tp_task_ident_get(str_hub->tptask),
+			    prof->src.skt_rcv_buf, prof->src.skt_rcv_lowat);
+			SYSLOG_ERR(LOG_NOTICE, error, "%s: skt_rcv_tune().",
+			    str_hub->name);
+			if (NULL == str_hub->ring &&
+			    (0 != prof->src.busy_poll ||
+			    0 != prof_old->src.busy_poll)) {
+				error = str_src_skt_busy_poll(
+				    tp_task_ident_get(str_hub->tptask), &prof->src);
+				SYSLOG_ERR(LOG_NOTICE, error,
+				    "%s: str_src_skt_busy_poll().", str_hub->name);
+			}
+		}
+		TAILQ_FOREACH(strh_cli, &str_hub->cli_head, next) {
+			if (0 == (STR_HUB_S_F_SKT_SND_BUF_AUTO & hub_params->flags)) {
+				strh_cli->skt_snd_buf = hub_params->skt_snd_buf;
+			} else { /* Keep autotuned value, only apply new bounds. */
+				strh_cli->skt_snd_buf = MAX(strh_cli->skt_snd_buf,
+				    hub_params->skt_snd_buf_min);
+				strh_cli->skt_snd_buf = MIN(strh_cli->skt_snd_buf,
+				    hub_params->skt_snd_buf_max);
+			}
+			skt_snd_tune(strh_cli->skt, strh_cli->skt_snd_buf, 1);
+			str_hub_cli_snd_buf_read(strh_cli);
+			skt_set_tcp_nodelay(strh_cli->skt,
+			    (STR_HUB_S_F_SKT_TCP_NODELAY & hub_params->flags));
+			skt_set_tcp_nopush(strh_cli->skt,
+			    (STR_HUB_S_F_SKT_TCP_NOPUSH & hub_params->flags));
+		}
 	}
-	/* Update stat. */
-	memcpy(&shbskt->thr_data[thread_num].stat, &stat, sizeof(str_hubs_stat_t));
 }
 static void
-str_hubs_bckt_timer_cb(tp_event_p ev __unused, tp_udata_p tp_udata) {
+str_hubs_bckt_reload_done_cb(tpt_p tpt __unused, size_t send_msg_cnt __unused,
+    size_t error_cnt __unused, void *udata) {
+	str_hubs_bckt_reload_data_p rld_data = udata;
+
+	/* All threads passed reload message: no one hold old settings. */
+	free(rld_data->settings_old);
+	free(rld_data);
+}
+
+/* Copy HTTP headers from current profile, client offset stay valid. */
+static int
+str_hub_cli_hdrs_keep(str_hub_p str_hub, str_hub_cli_p strh_cli) {
+	str_hub_settings_p hub_params = &str_hub->prof->hub;
+	uint8_t *buf;
+	size_t buf_size;
+
+	buf_size = (17 + str_hub->shbskt->base_http_hdrs_size +
+	    hub_params->cust_http_hdrs_size);
+	buf = malloc(buf_size);
+	if (NULL == buf)
+		return (ENOMEM);
+	memcpy(buf, "HTTP/1.1 200 OK\r\n", 17);
+	memcpy((buf + 17), str_hub->shbskt->base_http_hdrs,
+	    str_hub->shbskt->base_http_hdrs_size);
+	memcpy((buf + 17 + str_hub->shbskt->base_http_hdrs_size),
+	    hub_params->cust_http_hdrs, hub_params->cust_http_hdrs_size);
+	strh_cli->hdrs_keep = buf;
+	strh_cli->hdrs_keep_size = buf_size;
+	return (0);
+}
+
+
+/*
+ * Pass all hubs and clients to other process via skt, then destroy them.
+ * Called once, after HTTP server stop accept new clients.
+ * Threads processed one by one, so skt used without locking.
+ */
+int
+str_hubs_bckt_handoff_send(str_hubs_bckt_p shbskt, uintptr_t skt,
+    tpt_msg_done_cb done_cb, void *udata) {
+	int error;
+	str_hubs_bckt_handoff_data_p ho_data;
+
+	if (NULL == shbskt || (uintptr_t)-1 == skt)
+		return (EINVAL);
+	ho_data = calloc(1, sizeof(str_hubs_bckt_handoff_data_t));
+	if (NULL == ho_data)
+		return (ENOMEM);
+	ho_data->shbskt = shbskt;
+	ho_data->skt = skt;
+	ho_data->done_cb = done_cb;
+	ho_data->udata = udata;
+
+	error = tpt_msg_cbsend(shbskt->tp, NULL,
+	    (TP_CBMSG_F_ONE_BY_ONE), str_hubs_bckt_handoff_msg_cb,
+	    ho_data, str_hubs_bckt_handoff_done_cb);
+	if (0 != error) {
+		free(ho_data);
+	}
+
+	return (error);
+}
+/*
+ * Interface link state changed: on down stop no traffic check for hubs
+ * on it, on up re join multicast groups instead of destroy hubs.
+ */
+int
+str_hubs_bckt_link_state(str_hubs_bckt_p shbskt, uint32_t if_index,
+    int up) {
+	int error;
+	str_hubs_bckt_link_data_p link_data;
+
+	if (NULL == shbskt || 0 == if_index)
+		return (EINVAL);
+	link_data = malloc(sizeof(str_hubs_bckt_link_data_t));
+	if (NULL == link_data)
+		return (ENOMEM);
+	link_data->shbskt = shbskt;
+	link_data->if_index = if_index;
+	link_data->up = up;
+	error = tpt_msg_cbsend(shbskt->tp, NULL,
+	    (TP_CBMSG_F_ONE_BY_ONE), str_hubs_bckt_link_state_msg_cb,
+	    link_data, str_hubs_bckt_link_state_done_cb);
+	if (0 != error) {
+		SYSLOG_ERR(LOG_ERR, error, "tpt_msg_cbsend().");
+		free(link_data);
+	}
+
+	return (error);
+}
+static void
+str_hubs_bckt_link_state_msg_cb(tpt_p tpt, void *udata) {
+	str_hubs_bckt_link_data_p link_data = udata;
+	str_hubs_bckt_p shbskt = link_data->shbskt;
+	str_hub_p str_hub;
+	int error;
+
+	TAILQ_FOREACH(str_hub, &shbskt->thr_data[tpt_get_num(tpt)].hub_head, next) {
+		/* Only multicast hubs with own socket. */
+		if (STR_SRC_CONN_T_MC != str_hub->src_conn_params.udp.type ||
+		    NULL == str_hub->tptask ||
+		    link_data->if_index != str_hub->src_conn_params.mc.if_index)
+			continue;
+		if (0 == link_data->up) {
+			str_hub->flags |= STR_HUB_F_LINK_DOWN;
+			continue;
+		}
+		if (0 == (STR_HUB_F_LINK_DOWN & str_hub->flags))
+			continue;
+		str_hub->flags &= ~STR_HUB_F_LINK_DOWN;
+		syslog(LOG_INFO, "%s: Link up, re join.", str_hub->name);
+		for (int join = 0; join < 2; join ++) {
+			error = str_src_conn_mc_join(tp_task_ident_get(str_hub->tptask),
+			    join, &str_hub->src_conn_params.mc);
+			SYSLOG_ERR(LOG_ERR, error, "str_src_conn_mc_join().");
+		}
+		/* Give source full rcv_timeout to come back. */
+		clock_gettime(CLOCK_MONOTONIC_FAST, &str_hub->tp_last_recv);
+	}
+}
+static void
+str_hubs_bckt_link_state_done_cb(tpt_p tpt __unused, size_t send_msg_cnt __unused,
+    size_t error_cnt __unused, void *udata) {
+
+	free(udata);
+}
+
+static void
+str_hubs_bckt_handoff_msg_cb(tpt_p tpt, void *udata) {
+	str_hubs_bckt_handoff_data_p ho_data = udata;
+	str_hubs_bckt_p shbskt = ho_data->shbskt;
+	handoff_rec_p rec = &ho_data->rec;
+	str_hub_p str_hub, str_hub_temp;
+	str_hub_cli_p strh_cli, strh_cli_temp;
+	size_t thread_num;
+	int error;
+
+	thread_num = tpt_get_num(tpt);
+
+	/*
+	 * Non blocking send: on full socket buf after short wait record is
+	 * skipped, hub destroyed / client dropped; client reconnect to new
+	 * process. On broken stream rest is destroyed without send.
+	 */
+	TAILQ_FOREACH_SAFE(str_hub, &shbskt->thr_data[thread_num].hub_head, next,
+	    str_hub_temp) {
+		if (0 != ho_data->broken)
+			goto hub_destroy;
+		/* HTTP and file sources: new process start own by first client. */
+		if (STR_SRC_CONN_T_MC != str_hub->src_conn_params.udp.type)
+			goto cli_pass;
+		handoff_rec_init(rec, HANDOFF_REC_HUB);
+		rec->hub_name_size = (uint32_t)MIN(str_hub->name_size,
+		    sizeof(rec->hub_name));
+		memcpy(rec->hub_name, str_hub->name, rec->hub_name_size);
+		rec->prof_name_size = (uint32_t)MIN(str_hub->prof->name_size,
+		    sizeof(rec->prof_name));
+		memcpy(rec->prof_name, str_hub->prof->name, rec->prof_name_size);
+		error = handoff_src_set(&rec->src, &str_hub->src_conn_params);
+		if (0 == error) {
+			/* Multicast socket: new process keep group membership. */
+			error = handoff_rec_send_nb(ho_data->skt, rec,
+			    tp_task_ident_get(str_hub->tptask));
+		}
+		if (0 != error) {
+			SYSLOG_ERR(LOG_ERR, error, "%s: handoff_rec_send_nb().",
+			    str_hub->name);
+			str_hubs_bckt_handoff_err(ho_data, error);
+			goto hub_destroy;
+		}
+		ho_data->hub_count ++;
+cli_pass:
+		TAILQ_FOREACH_SAFE(strh_cli, &str_hub->cli_head, next, strh_cli_temp) {
+			if (0 != ho_data->broken)
+				break;
+			/* Clients without HTTP headers will be dropped with hub. */
+			if (0 == (STR_HUB_CLI_STATE_F_HTTP_HDRS_SENDED & strh_cli->flags))
+				continue;
+			handoff_rec_init(rec, HANDOFF_REC_CLI);
+			rec->hub_name_size = (uint32_t)MIN(str_hub->name_size,
+			    sizeof(rec->hub_name));
+			memcpy(rec->hub_name, str_hub->name, rec->hub_name_size);
+			rec->prof_name_size = (uint32_t)MIN(str_hub->prof->name_size,
+			    sizeof(rec->prof_name));
+			memcpy(rec->prof_name, str_hub->prof->name, rec->prof_name_size);
+			if (0 != handoff_src_set(&rec->src, &str_hub->src_conn_params))
+				continue;
+			rec->flags = strh_cli->flags;
+			rec->conn_time = (int64_t)strh_cli->conn_time;
+			memcpy(&rec->remonte_addr, &strh_cli->remonte_addr,
+			    sizeof(struct sockaddr_storage));
+			memcpy(&rec->xreal_addr, &strh_cli->xreal_addr,
+			    sizeof(struct sockaddr_storage));
+			rec->user_agent_size = (uint32_t)MIN(strh_cli->user_agent_size,
+			    sizeof(rec->user_agent));
+			memcpy(rec->user_agent, strh_cli->user_agent,
+			    rec->user_agent_size);
+			rec->tail_size = (uint32_t)str_hub_cli_tail_get(str_hub,
+			    strh_cli, rec->tail, sizeof(rec->tail));
+			rec->sended_count = strh_cli->sended_count;
+			error = handoff_rec_send_nb(ho_data->skt, rec, strh_cli->skt);
+			if (0 != error) {
+				str_hubs_bckt_handoff_err(ho_data, error);
+				continue;
+			}
+			ho_data->cli_count ++;
+			/* New process own connection now: just forget it. */
+			close((int)strh_cli->skt);
+			strh_cli->skt = (uintptr_t)-1;
+			str_hub_cli_destroy(str_hub, strh_cli);
+		}
+hub_destroy:
+		str_hub_destroy_int(str_hub, STR_HUB_CLI_DROP_R_ADMIN);
+	}
+}
+static void
+str_hubs_bckt_handoff_err(str_hubs_bckt_handoff_data_p ho_data, int error) {
+
+	if (EAGAIN == error) { /* Record not sended, stream in sync. */
+		ho_data->skip_count ++;
+		return;
+	}
+	if (0 == ho_data->broken) {
+		SYSLOG_ERR(LOG_ERR, error, "Handoff: stream broken, rest dropped.");
+	}
+	ho_data->broken = 1;
+}
+static void
+str_hubs_bckt_handoff_done_cb(tpt_p tpt, size_t send_msg_cnt, size_t error_cnt,
+    void *udata) {
+	str_hubs_bckt_handoff_data_p ho_data = udata;
+
+	syslog(LOG_NOTICE, "Handoff: passed %zu hubs, %zu clients, skipped %zu.",
+	    ho_data->hub_count, ho_data->cli_count, ho_data->skip_count);
+	if (NULL != ho_data->done_cb)
+		ho_data->done_cb(tpt, send_msg_cnt, error_cnt, ho_data->udata);
+	free(ho_data);
+}
+
+/*
+ * Bytes to complete TS packet partially sended to client.
+ * New process send it first and add to sended_count, so it stay aligned.
+ */
+static size_t
+str_hub_cli_tail_get(str_hub_p str_hub, str_hub_cli_p strh_cli,
+    uint8_t *buf, size_t buf_size) {
+	r_buf_rpos_t rpos;
+	struct iovec iov[4];
+	size_t i, iov_cnt, drop_size, tail_size, ret = 0;
+
+	if (0 != strh_cli->tail_size) { /* Previous handoff tail not sended yet. */
+		ret = MIN((strh_cli->tail_size - strh_cli->offset), buf_size);
+		memcpy(buf, (strh_cli->tail + strh_cli->offset), ret);
+		return (ret);
+	}
+	if (0 != (STR_HUB_CLI_STATE_F_TSHIFT & strh_cli->flags))
+		return (str_hub_cli_tshift_tail_get(str_hub, strh_cli, buf,
+		    buf_size));
+	if (NULL == str_hub->r_buf ||
+	    0 == (STR_HUB_CLI_STATE_F_RPOS_INITIALIZED & strh_cli->flags))
+		return (0);
+	tail_size = (size_t)(strh_cli->sended_count % STR_HUB_CLI_TAIL_MAX);
+	if (0 == tail_size)
+		return (0);
+	tail_size = MIN((STR_HUB_CLI_TAIL_MAX - tail_size), buf_size);
+	memcpy(&rpos, &strh_cli->rpos, sizeof(r_buf_rpos_t));
+	iov_cnt = r_buf_data_get(str_hub->r_buf, &rpos, tail_size,
+	    (iovec_p)iov, 4, &drop_size, NULL);
+	for (i = 0; i < iov_cnt && ret < tail_size; i ++) {
+		memcpy((buf + ret), iov[i].iov_base,
+		    MIN(iov[i].iov_len, (tail_size - ret)));
+		ret += MIN(iov[i].iov_len, (tail_size - ret));
+	}
+	return (ret);
+}
+
+/* Same for client sending from time-shift store. */
+static size_t
+str_hub_cli_tshift_tail_get(str_hub_p str_hub, str_hub_cli_p strh_cli,
+    uint8_t *buf, size_t buf_size) {
+	uintptr_t fd;
+	off_t off;
+	size_t size, tail_size;
+	ssize_t ios;
+
+	tail_size = (size_t)(strh_cli->sended_count % STR_HUB_CLI_TAIL_MAX);
+	if (0 == tail_size)
+		return (0);
+	if (0 != tshift_blk_get(str_hub->tshift, strh_cli->tshift_blk, &fd,
+	    &off, &size, NULL) ||
+	    size <= strh_cli->tshift_off)
+		return (0);
+	tail_size = MIN((STR_HUB_CLI_TAIL_MAX - tail_size), buf_size);
+	tail_size = MIN(tail_size, (size - strh_cli->tshift_off));
+	ios = pread((int)fd, buf, tail_size, (off + (off_t)strh_cli->tshift_off));
+	if (0 >= ios)
+		return (0);
+	return ((size_t)ios);
+}
+
+
+/* Handoff: re create hub with passed multicast socket. */
+int
+str_hub_import(str_hubs_bckt_p shbskt, uint8_t *hub_name, size_t hub_name_size,
+    const char *prof_name, size_t prof_name_size,
+    str_src_conn_params_p src_conn_params, uintptr_t skt) {
+	int error;
+	tpt_p tpt;
+	str_hub_import_data_p imp_data;
+
+	if (NULL == shbskt || NULL == hub_name || 0 == hub_name_size ||
+	    NULL == src_conn_params || (uintptr_t)-1 == skt)
+		return (EINVAL);
+	imp_data = calloc(1, sizeof(str_hub_import_data_t) + hub_name_size + sizeof(void*));
+	if (NULL == imp_data)
+		return (ENOMEM);
+	imp_data->shbskt = shbskt;
+	imp_data->skt = skt;
+	memcpy(&imp_data->src_conn_params, src_conn_params, sizeof(str_src_conn_params_t));
+	if (NULL != prof_name) {
+		imp_data->prof_name_size = MIN(prof_name_size,
+		    (sizeof(imp_data->prof_name) - 1));
+		memcpy(imp_data->prof_name, prof_name, imp_data->prof_name_size);
+	}
+	imp_data->hub_name = (uint8_t*)(imp_data + 1);
+	memcpy(imp_data->hub_name, hub_name, hub_name_size);
+	imp_data->hub_name[hub_name_size] = 0;
+	imp_data->hub_name_size = hub_name_size;
+
+	/* Same thread as clients attach, so hub created before them. */
+	tpt = str_hub_tpt_get_by_name(shbskt->tp, hub_name, hub_name_size);
+	error = tpt_msg_send(tpt, NULL, TP_MSG_F_SELF_DIRECT,
+	    str_hub_import_msg_cb, imp_data);
+	if (0 != error) {
+		free(imp_data);
+	}
+
+	return (error);
+}
+static void
+str_hub_import_msg_cb(tpt_p tpt, void *udata) {
+	str_hub_import_data_p imp_data = udata;
+	str_hub_p str_hub;
+	int error;
+
+	TAILQ_FOREACH(str_hub, &imp_data->shbskt->thr_data[tpt_get_num(tpt)].hub_head, next) {
+		if (str_hub->name_size == imp_data->hub_name_size &&
+		    0 == memcmp(str_hub->name, imp_data->hub_name,
+		    imp_data->hub_name_size)) {
+			/* Allready created by new client: use own socket. */
+			close((int)imp_data->skt);
+			free(imp_data);
+			return;
+		}
+	}
+	error = str_hub_create_int(imp_data->shbskt, tpt,
+	    imp_data->hub_name, imp_data->hub_name_size,
+	    str_hubs_prof_select(STR_HUBS_BCKT_SETTINGS(imp_data->shbskt),
+	    imp_data->prof_name, imp_data->prof_name_size,
+	    str_src_conn_prof_addr(&imp_data->src_conn_params)),
+	    &imp_data->src_conn_params, imp_data->skt, 0, &str_hub);
+	SYSLOG_ERR(LOG_ERR, error, "%s: str_hub_create_int().",
+	    imp_data->hub_name);
+	free(imp_data);
+}
+
+
+int
+str_hubs_bckt_stat_summary(str_hubs_bckt_p shbskt, str_hubs_stat_p stat) {
+	size_t i, thread_cnt;
+
+	if (NULL == shbskt || NULL == stat)
+		return (EINVAL);
+	thread_cnt = tp_thread_count_max_get(shbskt->tp);
+	memset(stat, 0x00, sizeof(str_hubs_stat_t));
+	for (i = 0; i < thread_cnt; i ++) {
+		stat->str_hub_count += shbskt->thr_data[i].stat.str_hub_count;
+		stat->cli_count += shbskt->thr_data[i].stat.cli_count;
+		stat->push_count += shbskt->thr_data[i].stat.push_count;
+		stat->dropped_count += shbskt->thr_data[i].stat.dropped_count;
+		stat->skt_snd_buf += shbskt->thr_data[i].stat.skt_snd_buf;
+		stat->baud_rate_in += shbskt->thr_data[i].stat.baud_rate_in;
+		stat->baud_rate_out += shbskt->thr_data[i].stat.baud_rate_out;
+	}
+	return (0);
+}
+
+/*
+ * Called from HTTP request handler, before any hub lookup.
+ * Stat updated by timer, so rate checks are up to 2 seconds late.
+ */
+uint32_t
+str_hubs_bckt_admit(str_hubs_bckt_p shbskt, const uint8_t *hub_name,
+    size_t hub_name_size) {
+	uint32_t reason = STR_HUBS_REJ_R_NONE;
+	str_hubs_limits_p limits;
+	str_hubs_stat_t hstat;
+	tpt_p tpt;
+
+	if (NULL == shbskt || NULL == hub_name)
+		return (STR_HUBS_REJ_R_NONE);
+	limits = &STR_HUBS_BCKT_SETTINGS(shbskt)->limits;
+	if (0 != limits->thread_rate_out_max) {
+		tpt = str_hub_tpt_get_by_name(shbskt->tp, hub_name, hub_name_size);
+		if (limits->thread_rate_out_max <=
+		    shbskt->thr_data[tpt_get_num(tpt)].stat.baud_rate_out) {
+			reason = STR_HUBS_REJ_R_THREAD_RATE;
+			goto rejected;
+		}
+	}
+	if (0 != limits->rate_out_max) {
+		str_hubs_bckt_stat_summary(shbskt, &hstat);
+		if (limits->rate_out_max <= hstat.baud_rate_out) {
+			reason = STR_HUBS_REJ_R_RATE;
+			goto rejected;
+		}
+	}
+	return (STR_HUBS_REJ_R_NONE);
+
+rejected:
+	atomic_fetch_add_explicit(&shbskt->rejected_count[reason], 1,
+	    memory_order_relaxed);
+	return (reason);
+}
+
+
+void
+str_hubs_bckt_timer_service(str_hubs_bckt_p shbskt, str_hub_p str_hub,
+    str_hubs_stat_p stat, uint32_t *tcp_info_budget) {
+	int error;
+	str_hub_prof_p prof = str_hub->prof;
+	str_src_settings_p src_params = &prof->src;
+	struct timespec *tp = &shbskt->tp_last_tmr_next;
+	str_hub_cli_p strh_cli, strh_cli_temp;
+	str_hls_cli_p hls_cli, hls_cli_temp;
+	uint64_t tm64;
+	time_t tmt;
+
+
+	/* Stat update. */
+	/* Update stream hub clients baud rate. */
+	if (0 == (tp->tv_sec & 1)) { /* every 2 second */
+		tm64 = (1000000000 * ((uint64_t)tp->tv_sec - (uint64_t)shbskt->tp_last_tmr.tv_sec));
+		tm64 += ((uint64_t)tp->tv_nsec - (uint64_t)shbskt->tp_last_tmr.tv_nsec);
+		if (0 == tm64) /* Prevent division by zero. */
+			tm64 ++;
+		str_hub->baud_rate_out = ((str_hub->sended_count * 4000000000) / tm64);
+		str_hub->baud_rate_in = ((str_hub->received_count * 4000000000) / tm64);
+		str_hub->sended_count = 0;
+		str_hub->received_count = 0;
+		/* Lag histogram: publish last period and start new one. */
+		memcpy(str_hub->lag_hist_last, str_hub->lag_hist,
+		    sizeof(str_hub->lag_hist_last));
+		memset(str_hub->lag_hist, 0x00, sizeof(str_hub->lag_hist));
+		str_hub->rcv_lat_max_last = str_hub->rcv_lat_max;
+		str_hub->rcv_lat_max = 0;
+	}
+	/* Per Thread stat. */
+	stat->str_hub_count ++;
+	stat->cli_count += str_hub->cli_count;
+	stat->push_count += str_hub->push_count;
+	stat->baud_rate_out += str_hub->baud_rate_out;
+	stat->baud_rate_in += str_hub->baud_rate_in;
+
+	/* Check hub. */
+	if (0 == str_hub->cli_count && NULL == str_hub->rec &&
+	    0 == str_hub->push_count &&
+	    (NULL == str_hub->hls ||
+	    (TAILQ_EMPTY(&str_hub->hls_cli_head) &&
+	    (str_hub->hls_last_req + (time_t)prof->hub.hls_idle_timeout) < tp->tv_sec))) {
+		syslog(LOG_INFO, "%s: No more clients, selfdestroy.",
+		    str_hub->name);
+		str_hub_destroy_int(str_hub, STR_HUB_CLI_DROP_R_NONE);
+		return;
+	}
+	/* HTTP source: reconnect on no traffic, destroy only if all origins fail. */
+	if (STR_SRC_CONN_T_HTTP == str_hub->src_conn_params.udp.type) {
+		if (0 != str_src_http_timer(str_hub, tp->tv_sec))
+			return;
+	} else if (0 != src_params->rcv_timeout &&
+	    0 == (STR_HUB_F_LINK_DOWN & str_hub->flags)) {
+		/* No traffic check: not while link down, wait for it back. */
+		tmt = (str_hub->tp_last_recv.tv_sec + (time_t)src_params->rcv_timeout);
+		if (tmt < tp->tv_sec ||
+		    (tmt == tp->tv_sec && str_hub->tp_last_recv.tv_nsec < tp->tv_nsec)) {
+			/* No data ever: cache timeouts only, not receive errors. */
+			if (NULL == str_hub->r_buf &&
+			    STR_SRC_CONN_T_MC == str_hub->src_conn_params.udp.type) {
+				str_hub_neg_add(str_hub);
+			}
+			str_hub_destroy_int(str_hub, STR_HUB_CLI_DROP_R_SRC_LOST);
+			return;
+		}
+	}
+	/* Clients lag and TCP info. */
+	TAILQ_FOREACH_SAFE(strh_cli, &str_hub->cli_head, next, strh_cli_temp) {
+		if (0 != (*tcp_info_budget) &&
+		    (strh_cli->tcp_info.time + (time_t)prof->hub.tcp_info_interval) <= tp->tv_sec) {
+			(*tcp_info_budget) --;
+			if (0 == str_hub_cli_tcp_info_sample(strh_cli, tp->tv_sec) &&
+			    0 != (STR_HUB_S_F_SKT_SND_BUF_AUTO & prof->hub.flags)) {
+				str_hub_cli_snd_buf_autotune(str_hub, strh_cli);
+			}
+		}
+		stat->skt_snd_buf += strh_cli->skt_snd_buf_real;
+		str_hub_cli_lag_update(str_hub, strh_cli);
+		if (0 == prof->hub.cli_lag_max ||
+		    prof->hub.cli_lag_max > strh_cli->lag_ms)
+			continue;
+		strh_cli->drop_reason = STR_HUB_CLI_DROP_R_SLOW_CLI;
+		str_hub_cli_destroy(str_hub, strh_cli);
+	}
+	/* HLS: service slow clients without source data, drop stuck. */
+	TAILQ_FOREACH_SAFE(hls_cli, &str_hub->hls_cli_head, next, hls_cli_temp) {
+		if ((hls_cli->start_time + STR_HUB_HLS_CLI_TIMEOUT) >= tp->tv_sec &&
+		    -1 == str_hub_hls_cli_send(str_hub, hls_cli))
+			continue;
+		str_hub_hls_cli_destroy(str_hub, hls_cli);
+	}
+	/* RTP ARQ: release held packets if source stopped. */
+	if (NULL != str_hub->arq && NULL != str_hub->r_buf &&
+	    0 != str_src_arq_commit(str_hub, str_src_arq_time())) {
+		str_hub_send_to_clients(str_hub);
+	}
+	/* Re join multicast group timer. */
+	if (STR_SRC_CONN_T_MC == str_hub->src_conn_params.udp.type &&
+	    NULL != str_hub->tptask &&
+	    0 != str_hub->src_conn_params.mc.rejoin_time &&
+	    str_hub->next_rejoin_time < tp->tv_sec) {
+		str_hub->next_rejoin_time = (tp->tv_sec + (time_t)str_hub->src_conn_params.mc.rejoin_time);
+		for (int join = 0; join < 2; join ++) {
+		    error = str_src_conn_mc_join(tp_task_ident_get(str_hub->tptask),
+			join, &str_hub->src_conn_params.mc);
+		    SYSLOG_ERR(LOG_ERR, error, "str_src_conn_mc_join().");
+		}
+	}
+}
+static void
+str_hubs_bckt_timer_msg_cb(tpt_p tpt, void *udata) {
+	str_hubs_bckt_p shbskt = (str_hubs_bckt_p)udata;
+	str_hubs_settings_p settings = STR_HUBS_BCKT_SETTINGS(shbskt);
+	str_hub_thrd_p thr_data;
+	str_hub_p str_hub, str_hub_temp;
+	str_hubs_stat_t stat;
+	size_t i, thread_num;
+	uint32_t *budget, budget_none;
+
+	//SYSLOGD_EX(LOG_DEBUG, "...");
+	thread_num = tpt_get_num(tpt);
+	thr_data = &shbskt->thr_data[thread_num];
+	memset(&stat, 0x00, sizeof(str_hubs_stat_t));
+	/* TCP_INFO sampler budget: per profile. */
+	if (thr_data->tcp_info_budget_count < settings->prof_count) {
+		budget = reallocarray(thr_data->tcp_info_budget,
+		    settings->prof_count, sizeof(uint32_t));
+		if (NULL != budget) {
+			thr_data->tcp_info_budget = budget;
+			thr_data->tcp_info_budget_count = settings->prof_count;
+		}
+	}
+	for (i = 0; i < thr_data->tcp_info_budget_count; i ++) {
+		thr_data->tcp_info_budget[i] = ((i < settings->prof_count) ?
+		    settings->prof[i].hub.tcp_info_per_tick : 0);
+	}
+
+	/* Enum all Stream Hubs associated with this thread. */
+	TAILQ_FOREACH_SAFE(str_hub, &thr_data->hub_head, next, str_hub_temp) {
+		/* Until reload message hub may use old settings profile. */
+		budget_none = 0;
+		budget = ((str_hub->prof->num < thr_data->tcp_info_budget_count) ?
+		    &thr_data->tcp_info_budget[str_hub->prof->num] : &budget_none);
+		str_hubs_bckt_timer_service(shbskt, str_hub, &stat, budget);
+	}
+	str_hub_neg_expire(shbskt, &shbskt->thr_data[thread_num],
+	    gettime_monotonic());
+	/* Update stat. */
+	stat.dropped_count = shbskt->thr_data[thread_num].dropped_count;
+	memcpy(&shbskt->thr_data[thread_num].stat, &stat, sizeof(str_hubs_stat_t));
+}
+static void
+str_hubs_bckt_timer_cb(tp_event_p ev __unused, tp_udata_p tp_udata) {
 	str_hubs_bckt_p shbskt = (str_hubs_bckt_p)tp_udata->ident;
 
 	//SYSLOGD_EX(LOG_DEBUG, "...");
@@ -462,33 +1718,97 @@ str_hubs_bckt_timer_cb(tp_event_p ev __unused, tp_udata_p tp_udata) {
 
 int
 str_hub_create_int(str_hubs_bckt_p shbskt, tpt_p tpt, uint8_t *name, size_t name_size,
-    str_src_conn_params_p src_conn_params, str_hub_p *str_hub_ret) {
+    str_hub_prof_p prof, str_src_conn_params_p src_conn_params, uintptr_t skt,
+    size_t hubs_max, str_hub_p *str_hub_ret) {
 	int error;
+	size_t hub_count;
 	str_hub_p str_hub;
-	uintptr_t skt;
 	str_src_settings_p src_params;
 	str_src_conn_udp_p conn_udp;
+	uintptr_t join_skt = (uintptr_t)-1;
+	int on = 1;
 
 	SYSLOGD_EX(LOG_DEBUG, "...");
 
-	if (NULL == shbskt || NULL == name || 0 == name_size || NULL == str_hub_ret)
+	if (NULL == shbskt || NULL == name || 0 == name_size || NULL == prof ||
+	    NULL == str_hub_ret)
 		return (EINVAL);
+	/* Reserve hub slot first: threads can not race over the limit. */
+	hub_count = atomic_fetch_add_explicit(&shbskt->hub_count, 1,
+	    memory_order_relaxed);
+	if (0 != hubs_max && hubs_max <= hub_count) {
+		error = ENOSPC;
+		goto err_out_unreserve;
+	}
 	str_hub = calloc(1, (sizeof(str_hub_t) + name_size + sizeof(void*)));
-	if (NULL == str_hub)
-		return (ENOMEM);
+	if (NULL == str_hub) {
+		error = ENOMEM;
+		goto err_out_unreserve;
+	}
 
 	str_hub->shbskt = shbskt;
 	str_hub->name = (uint8_t*)(str_hub + 1);
 	str_hub->name_size = name_size;
 	memcpy(str_hub->name, name, name_size);
 	TAILQ_INIT(&str_hub->cli_head);
+	TAILQ_INIT(&str_hub->hls_cli_head);
+	TAILQ_INIT(&str_hub->push_head);
 	str_hub->tpt = tpt;
 	clock_gettime(CLOCK_MONOTONIC_FAST, &str_hub->tp_last_recv);
 	str_hub->r_buf_fd = (uintptr_t)-1;
 
-	src_params = &shbskt->src_params;
+	str_hub->prof = prof;
+	src_params = &prof->src;
 	memcpy(&str_hub->src_conn_params, src_conn_params, sizeof(str_src_conn_params_t));
 	conn_udp = &src_conn_params->udp;
+	if (STR_SRC_CONN_T_HTTP == conn_udp->type) {
+		if ((uintptr_t)-1 != skt) { /* Nothing to take over. */
+			close((int)skt);
+			skt = (uintptr_t)-1;
+		}
+		/* Fail: retry from timer. */
+		error = str_src_http_connect(str_hub);
+		if (0 != error) {
+			str_src_http_retry(str_hub, error);
+		}
+		goto hub_add;
+	}
+	if (STR_SRC_CONN_T_FILE == conn_udp->type) {
+		if ((uintptr_t)-1 != skt) { /* Nothing to take over. */
+			close((int)skt);
+			skt = (uintptr_t)-1;
+		}
+		error = str_src_file_init(str_hub, &skt);
+		if (0 != error) {
+			SYSLOG_ERR(LOG_ERR, error, "%s: replay_create().",
+			    str_hub->name);
+			goto err_out;
+		}
+		error = skt_rcv_tune(skt, src_params->skt_rcv_buf,
+		    src_params->skt_rcv_lowat);
+		SYSLOG_ERR(LOG_NOTICE, error, "%s: skt_rcv_tune().",
+		    str_hub->name);
+		goto task_create;
+	}
+	if ((uintptr_t)-1 != skt) { /* Handoff: allready bound and joined. */
+		if (0 == str_src_skt_is_join_only(skt, &conn_udp->addr))
+			goto skt_tune;
+		/* From packet ring hub: socket only keep group membership. */
+		join_skt = skt;
+		skt = (uintptr_t)-1;
+	}
+	if (0 != (STR_SRC_S_F_PKT_RING & src_params->flags) &&
+	    0 == (STR_SRC_S_F_RTP_ARQ & src_params->flags)) {
+		error = str_src_ring_hub_init(str_hub, join_skt);
+		if (0 == error) {
+			if (0 != (STR_SRC_S_F_RCV_TIMESTAMP & src_params->flags)) {
+				str_hub->flags |= STR_HUB_F_RCV_TS;
+			}
+			goto hub_add;
+		}
+		SYSLOG_ERR(LOG_NOTICE, error, "%s: packet ring not used.",
+		    str_hub->name);
+	}
 	error = skt_bind(&conn_udp->addr, SOCK_DGRAM, IPPROTO_UDP,
 	    (SO_F_NONBLOCK | SO_F_REUSEADDR | SO_F_REUSEPORT),
 	    &skt);
@@ -504,18 +1824,57 @@ str_hub_create_int(str_hubs_bckt_p shbskt, tpt_p tpt, uint8_t *name, size_t name
 		goto err_out;
 	}
 	/* Join to multicast group. */
-	error = skt_mc_join(skt, 1, src_conn_params->mc.if_index,
-	    &conn_udp->addr);
+	error = str_src_conn_mc_join(skt, 1, &src_conn_params->mc);
 	if (0 != error) {
-		SYSLOG_ERR(LOG_ERR, error, "skt_mc_join().");
+		SYSLOG_ERR(LOG_ERR, error, "str_src_conn_mc_join().");
 		goto err_out;
 	}
+	if ((uintptr_t)-1 != join_skt) { /* Own join done: no membership gap. */
+		close((int)join_skt);
+		join_skt = (uintptr_t)-1;
+	}
+skt_tune:
 	/* Tune socket. */
 	error = skt_rcv_tune(skt, src_params->skt_rcv_buf, src_params->skt_rcv_lowat);
 	if (0 != error) {
 		SYSLOG_ERR(LOG_ERR, error, "skt_rcv_tune().");
 		goto err_out;
 	}
+#ifdef UDP_GRO
+	if (0 != (STR_SRC_S_F_UDP_GRO & src_params->flags) &&
+	    0 == (STR_SRC_S_F_RTP_ARQ & src_params->flags)) {
+		if (0 == setsockopt((int)skt, IPPROTO_UDP, UDP_GRO,
+		    &on, sizeof(on))) {
+			str_hub->flags |= STR_HUB_F_UDP_GRO;
+		} else {
+			SYSLOG_ERR(LOG_NOTICE, errno,
+			    "%s: setsockopt(UDP_GRO), not used.",
+			    str_hub->name);
+		}
+	}
+#endif
+#ifdef SO_TIMESTAMPNS
+	if (0 != (STR_SRC_S_F_RCV_TIMESTAMP & src_params->flags)) {
+		if (0 == setsockopt((int)skt, SOL_SOCKET, SO_TIMESTAMPNS,
+		    &on, sizeof(on))) {
+			str_hub->flags |= STR_HUB_F_RCV_TS;
+		} else {
+			SYSLOG_ERR(LOG_NOTICE, errno,
+			    "%s: setsockopt(SO_TIMESTAMPNS).", str_hub->name);
+		}
+	}
+#endif
+	if (0 != src_params->busy_poll) {
+		error = str_src_skt_busy_poll(skt, src_params);
+		SYSLOG_ERR(LOG_NOTICE, error, "%s: str_src_skt_busy_poll().",
+		    str_hub->name);
+	}
+	if (0 != (STR_SRC_S_F_RTP_ARQ & src_params->flags)) {
+		error = str_src_arq_init(str_hub);
+		SYSLOG_ERR(LOG_NOTICE, error, "%s: RTP ARQ not used.",
+		    str_hub->name);
+	}
+task_create:
 	/* Create IO task for socket. */
 	error = tp_task_notify_create(str_hub->tpt, skt,
 	    TP_TASK_F_CLOSE_ON_DESTROY, TP_EV_READ, 0, str_src_recv_mc_cb,
@@ -525,26 +1884,56 @@ str_hub_create_int(str_hubs_bckt_p shbskt, tpt_p tpt, uint8_t *name, size_t name
 		goto err_out;
 	}
 
+hub_add:
 	TAILQ_INSERT_HEAD(&shbskt->thr_data[tpt_get_num(tpt)].hub_head,
 	    str_hub, next);
 
-	syslog(LOG_INFO, "%s: Created. (fd: %zu)", str_hub->name, skt);
+	if (NULL != shbskt->alog) {
+		str_hub_access_log(shbskt, tpt, str_hub->name, str_hub->name_size,
+		    str_hub, NULL, ACCESS_LOG_EV_HUB_CREATE, NULL);
+	} else if (STR_SRC_CONN_T_HTTP == conn_udp->type) {
+		syslog(LOG_INFO, "%s: Created. (HTTP source)", str_hub->name);
+	} else if (STR_SRC_CONN_T_FILE == conn_udp->type) {
+		syslog(LOG_INFO, "%s: Created. (file source)", str_hub->name);
+	} else {
+		syslog(LOG_INFO, "%s: Created. (fd: %zu%s)", str_hub->name,
+		    tp_task_ident_get(str_hub->tptask),
+		    ((NULL != str_hub->ring) ? ", packet ring" : ""));
+	}
 
 	(*str_hub_ret) = str_hub;
 	return (0);
 
 err_out:
 	/* Error. */
-	close((int)skt);
+	if ((uintptr_t)-1 != skt) {
+		close((int)skt);
+	}
+	if ((uintptr_t)-1 != join_skt) {
+		close((int)join_skt);
+	}
+	str_src_arq_destroy(str_hub);
+	replay_destroy(str_hub->replay);
 	free(str_hub);
+	atomic_fetch_sub_explicit(&shbskt->hub_count, 1, memory_order_relaxed);
 	(*str_hub_ret) = NULL;
 	SYSLOG_ERR_EX(LOG_ERR, error, "...");
 	return (error);
+
+err_out_unreserve:
+	atomic_fetch_sub_explicit(&shbskt->hub_count, 1, memory_order_relaxed);
+	if ((uintptr_t)-1 != skt) {
+		close((int)skt);
+	}
+	(*str_hub_ret) = NULL;
+	return (error);
 }
 
 void
-str_hub_destroy_int(str_hub_p str_hub) {
+str_hub_destroy_int(str_hub_p str_hub, uint32_t drop_reason) {
 	str_hub_cli_p strh_cli, strh_cli_temp;
+	str_hls_cli_p hls_cli, hls_cli_temp;
+	str_hub_push_p strh_push, strh_push_temp;
 
 	SYSLOGD_EX(LOG_DEBUG, "...");
 
@@ -552,19 +1941,48 @@ str_hub_destroy_int(str_hub_p str_hub) {
 		return;
 	/* Leave multicast group. */
 	tp_task_destroy(str_hub->tptask);
+	str_src_ring_detach(str_hub);
+	str_src_arq_destroy(str_hub);
+	replay_destroy(str_hub->replay);
 
 	if (TAILQ_PREV_PTR(str_hub, next)) {
 		TAILQ_REMOVE(&str_hub->shbskt->thr_data[tpt_get_num(str_hub->tpt)].hub_head,
 		    str_hub, next);
+		atomic_fetch_sub_explicit(&str_hub->shbskt->hub_count, 1,
+		    memory_order_relaxed);
 	}
 	/* Destroy all connected clients. */
 	TAILQ_FOREACH_SAFE(strh_cli, &str_hub->cli_head, next, strh_cli_temp) {
+		strh_cli->drop_reason = drop_reason;
 		str_hub_cli_destroy(str_hub, strh_cli);
 	}
+	TAILQ_FOREACH_SAFE(hls_cli, &str_hub->hls_cli_head, next, hls_cli_temp) {
+		str_hub_hls_cli_destroy(str_hub, hls_cli);
+	}
+	hls_destroy(str_hub->hls);
+	tshift_destroy(str_hub->tshift);
+	if (NULL != str_hub->rec) {
+		syslog(LOG_NOTICE, "%s: recording stopped: hub destroyed.",
+		    str_hub->name);
+		rec_destroy(str_hub->rec);
+	}
+	TAILQ_FOREACH_SAFE(strh_push, &str_hub->push_head, next,
+	    strh_push_temp) {
+		str_hub_push_destroy(str_hub, strh_push);
+	}
 
-	syslog(LOG_INFO, "%s: Destroyed.", str_hub->name);
+	if (NULL != str_hub->shbskt->alog) {
+		str_hub_access_log(str_hub->shbskt, str_hub->tpt,
+		    str_hub->name, str_hub->name_size, str_hub, NULL,
+		    ACCESS_LOG_EV_HUB_DESTROY,
+		    ((STR_HUB_CLI_DROP_R_NONE != drop_reason) ?
+		    str_hub_cli_drop_reason_str(drop_reason) : NULL));
+	} else {
+		syslog(LOG_INFO, "%s: Destroyed.", str_hub->name);
+	}
 
 	str_src_r_buf_free(str_hub);
+	free(str_hub->http_buf);
 	free(str_hub);
 }
 
@@ -592,6 +2010,14 @@ str_hub_cli_alloc(uintptr_t skt, const char *ua, size_t ua_size) {
 	return (strh_cli);
 }
 
+const char *
+str_hub_cli_drop_reason_str(uint32_t reason) {
+
+	if (STR_HUB_CLI_DROP_R__COUNT <= reason)
+		return ("unknown");
+	return (str_hub_cli_drop_reason_names[reason]);
+}
+
 void
 str_hub_cli_destroy(str_hub_p str_hub, str_hub_cli_p strh_cli) {
 	char straddr[STR_ADDR_LEN];
@@ -603,13 +2029,30 @@ str_hub_cli_destroy(str_hub_p str_hub, str_hub_cli_p strh_cli) {
 	if (NULL == strh_cli)
 		return;
 	if (NULL != str_hub) {
-		sa_addr_port_to_str(&strh_cli->remonte_addr, straddr,
-		    sizeof(straddr), NULL);
-		syslog(LOG_INFO, "%s - %s: deattached, cli_count = %zu",
-		    str_hub->name, straddr, (str_hub->cli_count - 1));
+		if (STR_HUB_CLI_DROP_R_NONE != strh_cli->drop_reason &&
+		    STR_HUB_CLI_DROP_R__COUNT > strh_cli->drop_reason) {
+			str_hub->dropped_count ++;
+			str_hub->drop_reason_count[strh_cli->drop_reason] ++;
+			str_hub->shbskt->thr_data[tpt_get_num(str_hub->tpt)].dropped_count ++;
+		}
 		/* Remove from stream hub. */
 		TAILQ_REMOVE(&str_hub->cli_head, strh_cli, next);
 		str_hub->cli_count --;
+		if (NULL != str_hub->shbskt->alog) {
+			str_hub_access_log(str_hub->shbskt, str_hub->tpt,
+			    str_hub->name, str_hub->name_size, str_hub, strh_cli,
+			    ACCESS_LOG_EV_DETACH,
+			    str_hub_cli_drop_reason_str(strh_cli->drop_reason));
+		} else {
+			syslog(LOG_INFO, "%s - %s: deattached, cli_count = %zu, "
+			    "reason: %s, sended: %"PRIu64", lag max: %zu bytes / %"PRIu64" ms, blocked: %"PRIu64,
+			    str_hub->name,
+			    str_hub_cli_addr_str(strh_cli, straddr, sizeof(straddr)),
+			    str_hub->cli_count,
+			    str_hub_cli_drop_reason_str(strh_cli->drop_reason),
+			    strh_cli->sended_count, strh_cli->lag_size_max,
+			    strh_cli->lag_ms_max, strh_cli->blocked_count);
+		}
 	}
 
 	/* Send HTTP headers if needed. */
@@ -633,13 +2076,16 @@ str_hub_cli_destroy(str_hub_p str_hub, str_hub_cli_p strh_cli) {
 	}
 
 	close((int)strh_cli->skt);
+	free(strh_cli->hdrs_keep);
 	free(strh_cli);
 }
 
 
 int
 str_hub_cli_attach(str_hubs_bckt_p shbskt, str_hub_cli_p strh_cli,
-    uint8_t *hub_name, size_t hub_name_size, str_src_conn_params_p src_conn_params) {
+    uint8_t *hub_name, size_t hub_name_size,
+    const char *prof_name, size_t prof_name_size,
+    str_src_conn_params_p src_conn_params) {
 	int error;
 	tpt_p tpt;
 	str_hub_cli_attach_cb_data_p cli_data;
@@ -657,7 +2103,12 @@ str_hub_cli_attach(str_hubs_bckt_p shbskt, str_hub_cli_p strh_cli,
 	cli_data->hub_name[hub_name_size] = 0;
 	cli_data->hub_name_size = hub_name_size;
 	memcpy(&cli_data->src_conn_params, src_conn_params, sizeof(str_src_conn_params_t));
-	
+	if (NULL != prof_name) {
+		cli_data->prof_name_size = MIN(prof_name_size,
+		    (sizeof(cli_data->prof_name) - 1));
+		memcpy(cli_data->prof_name, prof_name, cli_data->prof_name_size);
+	}
+
 	tpt = str_hub_tpt_get_by_name(shbskt->tp, hub_name, hub_name_size);
 	error = tpt_msg_send(tpt, NULL, TP_MSG_F_SELF_DIRECT,
 	    str_hub_cli_attach_msg_cb, cli_data);
@@ -672,7 +2123,9 @@ str_hub_cli_attach_msg_cb(tpt_p tpt, void *udata) {
 	str_hub_cli_attach_cb_data_p cli_data = udata;
 	str_hub_p str_hub, str_hub_temp;
 	str_hub_cli_p strh_cli;
+	str_hubs_settings_p settings;
 	str_hub_settings_p hub_params;
+	str_hubs_limits_p limits;
 	char straddr[STR_ADDR_LEN];
 	size_t thread_num;
 	int error = -1;
@@ -689,262 +2142,2606 @@ str_hub_cli_attach_msg_cb(tpt_p tpt, void *udata) {
 			break;
 		}
 	}
-	if (0 != error) { /* Create new... */
-		error = str_hub_create_int(cli_data->shbskt, tpt,
-		    cli_data->hub_name, cli_data->hub_name_size,
-		    &cli_data->src_conn_params, &str_hub);
-		if (0 != error) {
-			str_hub_cli_destroy(NULL, cli_data->strh_cli);
-			close((int)cli_data->strh_cli->skt);
-			free(cli_data);
-			SYSLOG_ERR(LOG_ERR, error, "str_hub_create().");
-			return;
-		}
-	}
-
-	strh_cli = cli_data->strh_cli;
-	hub_params = &cli_data->shbskt->hub_params;
+	strh_cli = cli_data->strh_cli;
+	settings = STR_HUBS_BCKT_SETTINGS(cli_data->shbskt);
+	limits = &settings->limits;
+	if (0 != error) { /* Create new... */
+		if (NULL != str_hub_neg_find(cli_data->shbskt,
+		    &cli_data->shbskt->thr_data[thread_num],
+		    cli_data->hub_name, cli_data->hub_name_size)) {
+			/* No IGMP/MLD join for source that recently had no data. */
+			str_hub_cli_reject(cli_data->shbskt, tpt,
+			    cli_data->hub_name, cli_data->hub_name_size, strh_cli,
+			    STR_HUBS_REJ_R_NEG_CACHE);
+			free(cli_data);
+			return;
+		}
+		error = str_hub_create_int(cli_data->shbskt, tpt,
+		    cli_data->hub_name, cli_data->hub_name_size,
+		    str_hubs_prof_select(settings, cli_data->prof_name,
+		    cli_data->prof_name_size,
+		    str_src_conn_prof_addr(&cli_data->src_conn_params)),
+		    &cli_data->src_conn_params, (uintptr_t)-1, limits->hubs_max,
+		    &str_hub);
+		if (ENOSPC == error) {
+			str_hub_cli_reject(cli_data->shbskt, tpt,
+			    cli_data->hub_name, cli_data->hub_name_size, strh_cli,
+			    STR_HUBS_REJ_R_HUBS);
+			free(cli_data);
+			return;
+		}
+		if (0 != error) {
+			str_hub_cli_destroy(NULL, strh_cli);
+			free(cli_data);
+			SYSLOG_ERR(LOG_ERR, error, "str_hub_create().");
+			return;
+		}
+	} else if (0 != limits->hub_cli_max &&
+	    limits->hub_cli_max <= str_hub->cli_count) {
+		str_hub_cli_reject(cli_data->shbskt, tpt,
+		    cli_data->hub_name, cli_data->hub_name_size, strh_cli,
+		    STR_HUBS_REJ_R_HUB_CLI);
+		free(cli_data);
+		return;
+	}
+
+	hub_params = &str_hub->prof->hub;
+
+	/* Set. */
+	if (0 == strh_cli->conn_time) { /* Keep time for handoff clients. */
+		strh_cli->conn_time = gettime_monotonic();
+	}
+	/* Tune socket. */
+	/* Reduce kernel memory usage. */
+	error = skt_rcv_tune(strh_cli->skt, STR_HUB_CLI_RECV_BUF, STR_HUB_CLI_RECV_LOWAT);
+	SYSLOG_ERR(LOG_NOTICE, error, "%s - %s: skt_rcv_tune().",
+	    str_hub->name, str_hub_cli_addr_str(strh_cli, straddr, sizeof(straddr)));
+	strh_cli->skt_snd_buf = hub_params->skt_snd_buf;
+	if (0 != (STR_HUB_S_F_SKT_SND_BUF_AUTO & hub_params->flags)) {
+		/* Start from configured value, timer retune it later. */
+		strh_cli->skt_snd_buf = MAX(strh_cli->skt_snd_buf, hub_params->skt_snd_buf_min);
+		strh_cli->skt_snd_buf = MIN(strh_cli->skt_snd_buf, hub_params->skt_snd_buf_max);
+	}
+	error = skt_snd_tune(strh_cli->skt, strh_cli->skt_snd_buf, 1);
+	SYSLOG_ERR(LOG_NOTICE, error, "%s - %s: skt_snd_tune().",
+	    str_hub->name, str_hub_cli_addr_str(strh_cli, straddr, sizeof(straddr)));
+	str_hub_cli_snd_buf_read(strh_cli);
+	if (0 != (STR_HUB_S_F_SKT_HALFCLOSED & hub_params->flags)) {
+		if (0 != shutdown((int)strh_cli->skt, SHUT_RD)) {
+			error = errno;
+			SYSLOG_ERR(LOG_NOTICE, error, "%s - %s: shutdown(..., SHUT_RD).",
+			    str_hub->name, str_hub_cli_addr_str(strh_cli, straddr, sizeof(straddr)));
+		}
+	}
+	error = skt_set_tcp_nodelay(strh_cli->skt, (STR_HUB_S_F_SKT_TCP_NODELAY & hub_params->flags));
+	SYSLOG_ERR(LOG_NOTICE, error, "%s - %s: skt_set_tcp_nodelay().",
+	    str_hub->name, str_hub_cli_addr_str(strh_cli, straddr, sizeof(straddr)));
+	error = skt_set_tcp_nopush(strh_cli->skt, (STR_HUB_S_F_SKT_TCP_NOPUSH & hub_params->flags));
+	SYSLOG_ERR(LOG_NOTICE, error, "%s - %s: skt_set_tcp_nopush().",
+	    str_hub->name, str_hub_cli_addr_str(strh_cli, straddr, sizeof(straddr)));
+	if (0 != hub_params->cc_name_size) {
+		error = skt_set_tcp_cc(strh_cli->skt, hub_params->cc_name,
+	            hub_params->cc_name_size);
+		SYSLOG_ERR(LOG_NOTICE, error, "%s - %s: skt_set_tcp_cc().",
+		    str_hub->name, str_hub_cli_addr_str(strh_cli, straddr, sizeof(straddr)));
+	}
+	/* Does not changed later, cache it for stat. */
+	if (0 != skt_get_tcp_cc(strh_cli->skt, strh_cli->tcp_info.cc_name,
+	    sizeof(strh_cli->tcp_info.cc_name), NULL)) {
+		memcpy(strh_cli->tcp_info.cc_name, "<unable to get>", 16);
+	}
+
+	str_hub_cli_tshift_seek(str_hub, strh_cli);
+
+	TAILQ_INSERT_HEAD(&str_hub->cli_head, strh_cli, next);
+	str_hub->cli_count ++;
+	if (NULL != cli_data->shbskt->alog) {
+		str_hub_access_log(cli_data->shbskt, tpt, str_hub->name,
+		    str_hub->name_size, str_hub, strh_cli,
+		    ACCESS_LOG_EV_ATTACH, NULL);
+	} else {
+		syslog(LOG_INFO, "%s - %s: attached, cli_count = %zu",
+		    str_hub->name,
+		    str_hub_cli_addr_str(strh_cli, straddr, sizeof(straddr)),
+		    str_hub->cli_count);
+	}
+	free(cli_data);
+}
+
+static void
+str_hub_neg_add(str_hub_p str_hub) {
+	str_hubs_bckt_p shbskt = str_hub->shbskt;
+	str_hub_thrd_p thr_data = &shbskt->thr_data[tpt_get_num(str_hub->tpt)];
+	str_src_settings_p src_params = &str_hub->prof->src;
+	str_hub_neg_p neg;
+
+	if (0 == src_params->neg_cache_ttl)
+		return;
+	if (STR_HUB_NEG_CACHE_MAX <= thr_data->neg_count) { /* Evict oldest. */
+		str_hub_neg_del(shbskt, thr_data, TAILQ_FIRST(&thr_data->neg_head));
+	}
+	neg = malloc(sizeof(str_hub_neg_t) + str_hub->name_size + sizeof(void*));
+	if (NULL == neg)
+		return;
+	/* TTL is same for all, so list stay sorted by expire time. */
+	neg->expire_time = (gettime_monotonic() +
+	    (time_t)src_params->neg_cache_ttl);
+	memcpy(&neg->addr, &str_hub->src_conn_params.udp.addr,
+	    sizeof(struct sockaddr_storage));
+	neg->name = (uint8_t*)(neg + 1);
+	neg->name_size = str_hub->name_size;
+	memcpy(neg->name, str_hub->name, str_hub->name_size);
+	neg->name[neg->name_size] = 0;
+	neg->hash = str_hub_chan_hash(neg->name, neg->name_size);
+	TAILQ_INSERT_TAIL(&thr_data->neg_head, neg, next);
+	TAILQ_INSERT_HEAD(&thr_data->neg_hash[(neg->hash &
+	    (STR_HUB_NEG_HASH_SIZE - 1))], neg, hnext);
+	thr_data->neg_count ++;
+	atomic_fetch_add_explicit(&shbskt->neg_count, 1, memory_order_relaxed);
+
+	syslog(LOG_INFO, "%s: No data from source, reject requests for %"PRIu32" s.",
+	    str_hub->name, src_params->neg_cache_ttl);
+}
+
+static void
+str_hub_neg_del(str_hubs_bckt_p shbskt, str_hub_thrd_p thr_data,
+    str_hub_neg_p neg) {
+
+	if (NULL == neg)
+		return;
+	TAILQ_REMOVE(&thr_data->neg_head, neg, next);
+	TAILQ_REMOVE(&thr_data->neg_hash[(neg->hash &
+	    (STR_HUB_NEG_HASH_SIZE - 1))], neg, hnext);
+	thr_data->neg_count --;
+	atomic_fetch_sub_explicit(&shbskt->neg_count, 1, memory_order_relaxed);
+	free(neg);
+}
+
+static void
+str_hub_neg_expire(str_hubs_bckt_p shbskt, str_hub_thrd_p thr_data,
+    time_t cur_time) {
+	str_hub_neg_p neg;
+
+	while (NULL != (neg = TAILQ_FIRST(&thr_data->neg_head)) &&
+	    neg->expire_time <= cur_time) {
+		str_hub_neg_del(shbskt, thr_data, neg);
+	}
+}
+
+static str_hub_neg_p
+str_hub_neg_find(str_hubs_bckt_p shbskt, str_hub_thrd_p thr_data,
+    const uint8_t *name, size_t name_size) {
+	str_hub_neg_p neg;
+	uint32_t hash;
+
+	if (0 == thr_data->neg_count)
+		return (NULL);
+	str_hub_neg_expire(shbskt, thr_data, gettime_monotonic());
+	hash = str_hub_chan_hash(name, name_size);
+	TAILQ_FOREACH(neg, &thr_data->neg_hash[(hash &
+	    (STR_HUB_NEG_HASH_SIZE - 1))], hnext) {
+		if (neg->hash == hash && neg->name_size == name_size &&
+		    0 == memcmp(neg->name, name, name_size))
+			return (neg);
+	}
+	return (NULL);
+}
+
+/*
+ * Source have data: remove it from all threads negative cache.
+ * Hubs with other names (interface) for same group may live on other thread.
+ */
+static void
+str_hub_neg_invalidate(str_hub_p str_hub) {
+	int error;
+	str_hub_neg_inval_data_p inval_data;
+
+	if (0 == atomic_load_explicit(&str_hub->shbskt->neg_count,
+	    memory_order_relaxed))
+		return;
+	inval_data = malloc(sizeof(str_hub_neg_inval_data_t));
+	if (NULL == inval_data)
+		return;
+	inval_data->shbskt = str_hub->shbskt;
+	memcpy(&inval_data->addr, &str_hub->src_conn_params.udp.addr,
+	    sizeof(struct sockaddr_storage));
+	error = tpt_msg_cbsend(str_hub->shbskt->tp, str_hub->tpt,
+	    (TP_CBMSG_F_ONE_BY_ONE), str_hub_neg_invalidate_msg_cb,
+	    inval_data, str_hub_neg_invalidate_done_cb);
+	if (0 != error) {
+		SYSLOG_ERR(LOG_ERR, error, "tpt_msg_cbsend().");
+		free(inval_data);
+	}
+}
+static void
+str_hub_neg_invalidate_msg_cb(tpt_p tpt, void *udata) {
+	str_hub_neg_inval_data_p inval_data = udata;
+	str_hubs_bckt_p shbskt = inval_data->shbskt;
+	str_hub_thrd_p thr_data = &shbskt->thr_data[tpt_get_num(tpt)];
+	str_hub_neg_p neg, neg_temp;
+
+	TAILQ_FOREACH_SAFE(neg, &thr_data->neg_head, next, neg_temp) {
+		if (0 == str_src_addr_is_eq(&neg->addr, &inval_data->addr))
+			continue;
+		syslog(LOG_INFO, "%s: Source have data, removed from negative cache.",
+		    neg->name);
+		str_hub_neg_del(shbskt, thr_data, neg);
+	}
+}
+static void
+str_hub_neg_invalidate_done_cb(tpt_p tpt __unused, size_t send_msg_cnt __unused,
+    size_t error_cnt __unused, void *udata) {
+
+	free(udata);
+}
+
+/* Compare address and port. */
+static int
+str_src_addr_is_eq(const struct sockaddr_storage *addr1,
+    const struct sockaddr_storage *addr2) {
+
+	if (addr1->ss_family != addr2->ss_family)
+		return (0);
+	switch (addr1->ss_family) {
+	case AF_INET:
+		return (((const struct sockaddr_in*)(const void*)addr1)->sin_port ==
+		    ((const struct sockaddr_in*)(const void*)addr2)->sin_port &&
+		    0 == memcmp(&((const struct sockaddr_in*)(const void*)addr1)->sin_addr,
+		    &((const struct sockaddr_in*)(const void*)addr2)->sin_addr,
+		    sizeof(struct in_addr)));
+	case AF_INET6:
+		return (((const struct sockaddr_in6*)(const void*)addr1)->sin6_port ==
+		    ((const struct sockaddr_in6*)(const void*)addr2)->sin6_port &&
+		    0 == memcmp(&((const struct sockaddr_in6*)(const void*)addr1)->sin6_addr,
+		    &((const struct sockaddr_in6*)(const void*)addr2)->sin6_addr,
+		    sizeof(struct in6_addr)));
+	}
+	return (0);
+}
+
+int
+str_hub_hls_req(str_hubs_bckt_p shbskt, http_srv_cli_p cli,
+    uint8_t *hub_name, size_t hub_name_size,
+    const char *prof_name, size_t prof_name_size,
+    str_src_conn_params_p src_conn_params, uint64_t seq) {
+	int error;
+	tpt_p tpt;
+	http_srv_req_p req;
+	size_t args_size = 0;
+	str_hub_hls_req_cb_data_p req_data;
+
+	if (NULL == shbskt || NULL == cli || NULL == hub_name ||
+	    0 == hub_name_size || NULL == src_conn_params)
+		return (EINVAL);
+	req = http_srv_cli_get_req(cli);
+	if (STR_HUB_HLS_PLAYLIST == seq) { /* Keep args in segment URIs. */
+		args_size = req->line.query_size;
+	}
+	req_data = calloc(1, (sizeof(str_hub_hls_req_cb_data_t) +
+	    hub_name_size + args_size + (2 * sizeof(void*))));
+	if (NULL == req_data)
+		return (ENOMEM);
+	req_data->shbskt = shbskt;
+	req_data->seq = seq;
+	if (STR_HUB_HLS_PLAYLIST == seq) {
+		req_data->cli = cli;
+		req_data->skt = (uintptr_t)-1;
+	} else {
+		req_data->skt = tp_task_ident_get(http_srv_cli_get_tptask(cli));
+	}
+	req_data->hub_name = (uint8_t*)(req_data + 1);
+	memcpy(req_data->hub_name, hub_name, hub_name_size);
+	req_data->hub_name[hub_name_size] = 0;
+	req_data->hub_name_size = hub_name_size;
+	req_data->args = (req_data->hub_name + hub_name_size + sizeof(void*));
+	memcpy(req_data->args, req->line.query, args_size);
+	req_data->args_size = args_size;
+	memcpy(&req_data->src_conn_params, src_conn_params,
+	    sizeof(str_src_conn_params_t));
+	if (NULL != prof_name) {
+		req_data->prof_name_size = MIN(prof_name_size,
+		    (sizeof(req_data->prof_name) - 1));
+		memcpy(req_data->prof_name, prof_name, req_data->prof_name_size);
+	}
+
+	tpt = str_hub_tpt_get_by_name(shbskt->tp, hub_name, hub_name_size);
+	/* Not direct: playlist reply must be after HTTP callback return. */
+	error = tpt_msg_send(tpt, NULL, 0, str_hub_hls_req_msg_cb, req_data);
+	if (0 != error) {
+		free(req_data);
+	}
+
+	return (error);
+}
+static void
+str_hub_hls_req_msg_cb(tpt_p tpt, void *udata) {
+	str_hub_hls_req_cb_data_p req_data = udata;
+	str_hubs_bckt_p shbskt = req_data->shbskt;
+	str_hubs_settings_p settings = STR_HUBS_BCKT_SETTINGS(shbskt);
+	str_hub_thrd_p thr_data = &shbskt->thr_data[tpt_get_num(tpt)];
+	str_hub_p str_hub;
+	str_hls_cli_p hls_cli;
+	http_srv_resp_p resp;
+	size_t seg_size;
+	uint32_t slot;
+	int error;
+	static const char m3u8_hdrs[] =	"Content-Type: application/vnd.apple.mpegurl\r\n"
+					"Pragma: no-cache";
+	static const char retry_hdr[] =	"Retry-After: 1";
+
+	SYSLOGD_EX(LOG_DEBUG, "...");
+
+	TAILQ_FOREACH(str_hub, &thr_data->hub_head, next) {
+		if (str_hub->name_size == req_data->hub_name_size &&
+		    0 == memcmp(str_hub->name, req_data->hub_name,
+		    req_data->hub_name_size))
+			break;
+	}
+	if (STR_HUB_HLS_PLAYLIST != req_data->seq) { /* Segment. */
+		if (NULL == str_hub ||
+		    0 != hls_seg_pin(str_hub->hls, req_data->seq, &slot,
+		    &seg_size)) {
+			str_hub_hls_reply(shbskt, req_data->skt,
+			    "HTTP/1.1 404 Not Found\r\n", 24);
+			goto out;
+		}
+		hls_cli = calloc(1, sizeof(str_hls_cli_t));
+		if (NULL == hls_cli) {
+			hls_slot_unpin(str_hub->hls, slot);
+			close((int)req_data->skt);
+			goto out;
+		}
+		hls_cli->skt = req_data->skt;
+		hls_cli->seq = req_data->seq;
+		hls_cli->slot = slot;
+		hls_cli->seg_size = seg_size;
+		hls_cli->start_time = gettime_monotonic();
+		hls_cli->hdr_size = (size_t)snprintf((char*)hls_cli->hdr,
+		    sizeof(hls_cli->hdr),
+		    "HTTP/1.1 200 OK\r\n"
+		    "%.*s"
+		    "Content-Type: video/mp2t\r\n"
+		    "Content-Length: %zu\r\n"
+		    "\r\n",
+		    (int)shbskt->base_http_hdrs_size,
+		    (const char*)shbskt->base_http_hdrs, seg_size);
+		TAILQ_INSERT_TAIL(&str_hub->hls_cli_head, hls_cli, next);
+		str_hub->hls_last_req = hls_cli->start_time;
+		str_hub->hls_req_count ++;
+		if (-1 != str_hub_hls_cli_send(str_hub, hls_cli)) {
+			str_hub_hls_cli_destroy(str_hub, hls_cli);
+		}
+		goto out;
+	}
+
+	/* Playlist. */
+	resp = http_srv_cli_get_resp(req_data->cli);
+	if (NULL == str_hub) { /* Create new... */
+		if (NULL == str_hub_neg_find(shbskt, thr_data,
+		    req_data->hub_name, req_data->hub_name_size)) {
+			error = str_hub_create_int(shbskt, tpt,
+			    req_data->hub_name, req_data->hub_name_size,
+			    str_hubs_prof_select(settings, req_data->prof_name,
+			    req_data->prof_name_size,
+			    str_src_conn_prof_addr(&req_data->src_conn_params)),
+			    &req_data->src_conn_params, (uintptr_t)-1,
+			    settings->limits.hubs_max, &str_hub);
+		} else {
+			error = ENOSPC;
+		}
+		if (ENOSPC == error) {
+			resp->status_code = 503;
+			resp->hdrs_count = 1;
+			resp->hdrs[0].iov_base = settings->retry_after_hdr;
+			resp->hdrs[0].iov_len = settings->retry_after_hdr_size;
+			goto reply;
+		}
+		if (0 != error) {
+			SYSLOG_ERR(LOG_ERR, error, "str_hub_create().");
+			resp->status_code = 500;
+			goto reply;
+		}
+	}
+	if (NULL == str_hub->hls) {
+		error = hls_create(&str_hub->prof->hub.hls, &str_hub->hls);
+		if (0 != error) {
+			SYSLOG_ERR(LOG_ERR, error, "%s: hls_create().",
+			    str_hub->name);
+			resp->status_code = 500;
+			goto reply;
+		}
+	}
+	str_hub->hls_last_req = gettime_monotonic();
+	str_hub->hls_req_count ++;
+	error = hls_playlist_gen(str_hub->hls, req_data->args,
+	    req_data->args_size, http_srv_cli_get_buf(req_data->cli));
+	if (0 != error) { /* First segment not ready yet. */
+		resp->status_code = 503;
+		resp->hdrs_count = 1;
+		resp->hdrs[0].iov_base = MK_RW_PTR(retry_hdr);
+		resp->hdrs[0].iov_len = (sizeof(retry_hdr) - 1);
+		goto reply;
+	}
+	resp->status_code = 200;
+	resp->p_flags |= HTTP_SRV_RESP_P_F_CONTENT_LEN;
+	resp->hdrs_count = 1;
+	resp->hdrs[0].iov_base = MK_RW_PTR(m3u8_hdrs);
+	resp->hdrs[0].iov_len = (sizeof(m3u8_hdrs) - 1);
+
+reply:
+	http_srv_resume_responce(req_data->cli);
+out:
+	free(req_data);
+}
+
+/* Reply without body and close. */
+static void
+str_hub_hls_reply(str_hubs_bckt_p shbskt, uintptr_t skt,
+    const char *status, size_t status_size) {
+	struct msghdr mhdr;
+	struct iovec iov[3];
+
+	memset(&mhdr, 0x00, sizeof(mhdr));
+	mhdr.msg_iov = (struct iovec*)iov;
+	mhdr.msg_iovlen = 3;
+	iov[0].iov_base = MK_RW_PTR(status);
+	iov[0].iov_len = status_size;
+	iov[1].iov_base = shbskt->base_http_hdrs;
+	iov[1].iov_len = shbskt->base_http_hdrs_size;
+	iov[2].iov_base = MK_RW_PTR("Content-Length: 0\r\n\r\n");
+	iov[2].iov_len = 21;
+	sendmsg((int)skt, &mhdr, (MSG_DONTWAIT | MSG_NOSIGNAL));
+	close((int)skt);
+}
+
+/* Return: 0 = done, -1 = socket buf full, try later, else error. */
+static int
+str_hub_hls_cli_send(str_hub_p str_hub, str_hls_cli_p hls_cli) {
+	int error = 0;
+	ssize_t ios;
+	uintptr_t fd;
+	off_t off, sbytes;
+	size_t seg_off;
+
+	if (hls_cli->hdr_size > hls_cli->offset) {
+		ios = send((int)hls_cli->skt, (hls_cli->hdr + hls_cli->offset),
+		    (hls_cli->hdr_size - hls_cli->offset),
+		    (MSG_DONTWAIT | MSG_NOSIGNAL));
+		if (-1 == ios) {
+			error = SKT_ERR_FILTER(errno);
+			return ((0 == error) ? -1 : error);
+		}
+		hls_cli->offset += (size_t)ios;
+		if (hls_cli->hdr_size > hls_cli->offset)
+			return (-1);
+	}
+	/* Slot pinned: not reused while client is slow. */
+	error = hls_slot_get(str_hub->hls, hls_cli->slot, &fd, &off);
+	if (0 != error)
+		return (error);
+	seg_off = (hls_cli->offset - hls_cli->hdr_size);
+	while (seg_off < hls_cli->seg_size) {
+		sbytes = 0;
+		error = skt_sendfile(fd, hls_cli->skt, (off + (off_t)seg_off),
+		    (hls_cli->seg_size - seg_off), (SKT_SF_F_NODISKIO), &sbytes);
+		seg_off += (size_t)sbytes;
+		hls_cli->offset += (size_t)sbytes;
+		str_hub->sended_count += (size_t)sbytes;
+		if (0 != error) {
+			error = SKT_ERR_FILTER(error);
+			return ((0 == error) ? -1 : error);
+		}
+		if (0 == sbytes)
+			return (-1);
+	}
+	/* sendfile() pages stay referenced until acked: keep slot pinned. */
+	if (0 != str_hub_hls_cli_outq(hls_cli))
+		return (-1);
+
+	return (0);
+}
+
+/* Bytes in socket send queue: not sent + not acked. */
+static size_t
+str_hub_hls_cli_outq(str_hls_cli_p hls_cli) {
+	int val = 0;
+
+#if defined(SIOCOUTQ) /* Linux. */
+	if (0 != ioctl((int)hls_cli->skt, SIOCOUTQ, &val))
+		return (0);
+#elif defined(FIONWRITE) /* FreeBSD. */
+	if (0 != ioctl((int)hls_cli->skt, FIONWRITE, &val))
+		return (0);
+#endif
+	return ((0 < val) ? (size_t)val : 0);
+}
+
+/* Called on each data receive, like stream clients, and from timer. */
+static void
+str_hub_hls_send_to_clients(str_hub_p str_hub) {
+	str_hls_cli_p hls_cli, hls_cli_temp;
+
+	TAILQ_FOREACH_SAFE(hls_cli, &str_hub->hls_cli_head, next, hls_cli_temp) {
+		if (-1 == str_hub_hls_cli_send(str_hub, hls_cli))
+			continue;
+		str_hub_hls_cli_destroy(str_hub, hls_cli);
+	}
+}
+
+static void
+str_hub_hls_cli_destroy(str_hub_p str_hub, str_hls_cli_p hls_cli) {
+	struct linger lng;
+
+	TAILQ_REMOVE(&str_hub->hls_cli_head, hls_cli, next);
+	if (hls_cli->offset < (hls_cli->hdr_size + hls_cli->seg_size) ||
+	    0 != str_hub_hls_cli_outq(hls_cli)) {
+		/* Not finished: reset, queued pages must not be sent later. */
+		lng.l_onoff = 1;
+		lng.l_linger = 0;
+		setsockopt((int)hls_cli->skt, SOL_SOCKET, SO_LINGER,
+		    &lng, sizeof(lng));
+	}
+	close((int)hls_cli->skt);
+	hls_slot_unpin(str_hub->hls, hls_cli->slot);
+	free(hls_cli);
+}
+
+static inline void
+str_hub_hls_write(str_hub_p str_hub, const uint8_t *buf, size_t buf_size) {
+
+	if (NULL == str_hub->hls)
+		return;
+	/* Arrival time: last receive batch, precise enough for segments. */
+	hls_write(str_hub->hls, buf, buf_size,
+	    (((uint64_t)str_hub->tp_last_recv.tv_sec * 1000) +
+	    ((uint64_t)str_hub->tp_last_recv.tv_nsec / 1000000)));
+}
+
+static inline void
+str_hub_tshift_write(str_hub_p str_hub, const uint8_t *buf, size_t buf_size) {
+
+	if (NULL != str_hub->tshift) {
+		tshift_write(str_hub->tshift, buf, buf_size, str_hub->live_pos,
+		    (((uint64_t)str_hub->tp_last_recv.tv_sec * 1000) +
+		    ((uint64_t)str_hub->tp_last_recv.tv_nsec / 1000000)));
+	}
+	str_hub->live_pos += buf_size;
+}
+
+/* Start client from store at requested time, else it get live stream. */
+static void
+str_hub_cli_tshift_seek(str_hub_p str_hub, str_hub_cli_p strh_cli) {
+	struct timespec tp;
+	uint64_t time_ms;
+
+	if (NULL == str_hub->tshift || 0 == strh_cli->tshift_offset)
+		return;
+	clock_gettime(CLOCK_REALTIME, &tp);
+	time_ms = (((uint64_t)tp.tv_sec * 1000) +
+	    ((uint64_t)tp.tv_nsec / 1000000));
+	time_ms -= MIN(time_ms, ((uint64_t)strh_cli->tshift_offset * 1000));
+	if (0 != tshift_seek(str_hub->tshift, time_ms, &strh_cli->tshift_blk))
+		return;
+	strh_cli->tshift_off = 0;
+	/* Updated from store index, used as is if store is empty. */
+	strh_cli->tshift_pos = (str_hub->live_pos -
+	    MIN(str_hub->live_pos, str_hub->prof->hub.precache));
+	strh_cli->flags |= STR_HUB_CLI_STATE_F_TSHIFT;
+	tshift_blk_prefetch(str_hub->tshift, strh_cli->tshift_blk);
+}
+
+/*
+ * Send from time-shift store, on store live edge switch client to ring buf.
+ * Return -1 if store overwrite unsended data, client continue from oldest.
+ */
+static int
+str_hub_tshift_send_to_client(str_hub_p str_hub, str_hub_cli_p strh_cli,
+    size_t *transfered_size) {
+	int error = 0;
+	uintptr_t fd;
+	off_t off, sbytes;
+	size_t size, data2send, tr_size = 0;
+	uint64_t live_pos;
+
+	while (tr_size < strh_cli->skt_snd_buf) {
+		error = tshift_blk_get(str_hub->tshift, strh_cli->tshift_blk,
+		    &fd, &off, &size, &live_pos);
+		if (EAGAIN == error) { /* Live edge. */
+			error = 0;
+			str_hub_cli_tshift_to_live(str_hub, strh_cli);
+			break;
+		}
+		if (ENOENT == error) { /* Too slow client. */
+			error = -1;
+			strh_cli->tshift_off = 0;
+			if (0 != tshift_seek(str_hub->tshift, 0,
+			    &strh_cli->tshift_blk)) {
+				str_hub_cli_tshift_to_live(str_hub, strh_cli);
+			}
+			break;
+		}
+		if (0 != error)
+			break;
+		if (0 == strh_cli->tshift_off) {
+			strh_cli->tshift_pos = live_pos;
+			tshift_blk_prefetch(str_hub->tshift,
+			    (strh_cli->tshift_blk + 1));
+		}
+		if (size > strh_cli->tshift_off) {
+			data2send = MIN((size - strh_cli->tshift_off),
+			    (strh_cli->skt_snd_buf - tr_size));
+			sbytes = 0;
+			error = skt_sendfile(fd, strh_cli->skt,
+			    (off + (off_t)strh_cli->tshift_off), data2send,
+			    (SKT_SF_F_NODISKIO), &sbytes);
+			tr_size += (size_t)sbytes;
+			strh_cli->tshift_off += (size_t)sbytes;
+			strh_cli->tshift_pos += (uint64_t)sbytes;
+			if (0 != error)
+				break;
+			if (data2send > (size_t)sbytes) {
+				strh_cli->blocked_count ++; /* Socket send buffer is full. */
+				break;
+			}
+			if (size > strh_cli->tshift_off)
+				break; /* Send limit. */
+		}
+		strh_cli->tshift_blk ++;
+		strh_cli->tshift_off = 0;
+	}
+	/* Supress some errors. */
+	error = SKT_ERR_FILTER(error);
+	strh_cli->sended_count += tr_size;
+	(*transfered_size) = tr_size;
+
+	return (error);
+}
+
+/* Continue from ring buf at same stream pos, if ring buf still have it. */
+static void
+str_hub_cli_tshift_to_live(str_hub_p str_hub, str_hub_cli_p strh_cli) {
+	size_t gap, avail, drop_size;
+
+	strh_cli->flags &= ~STR_HUB_CLI_STATE_F_TSHIFT;
+	strh_cli->flags |= STR_HUB_CLI_STATE_F_RPOS_INITIALIZED;
+	gap = (size_t)MIN((str_hub->live_pos - strh_cli->tshift_pos),
+	    str_hub->prof->hub.ring_buf_size);
+	r_buf_rpos_init(str_hub->r_buf, &strh_cli->rpos, gap);
+	/* Position is block aligned: skip allready sended. */
+	avail = r_buf_data_avail_size(str_hub->r_buf, &strh_cli->rpos,
+	    &drop_size);
+	if (avail > gap) {
+		r_buf_rpos_inc(str_hub->r_buf, &strh_cli->rpos, (avail - gap));
+	}
+}
+
+
+int
+str_hub_rec_ctl(str_hubs_bckt_p shbskt, http_srv_cli_p cli,
+    int start, uint8_t *hub_name, size_t hub_name_size,
+    const char *prof_name, size_t prof_name_size,
+    str_src_conn_params_p src_conn_params,
+    const char *rec_name, size_t rec_name_size) {
+	int error;
+	tpt_p tpt;
+	str_hub_rec_ctl_cb_data_p ctl_data;
+
+	if (NULL == shbskt || NULL == hub_name || 0 == hub_name_size ||
+	    NULL == src_conn_params || NULL == rec_name ||
+	    0 == rec_name_size || REC_NAME_MAX <= rec_name_size)
+		return (EINVAL);
+	if (NULL == shbskt->rw)
+		return (ENOTSUP);
+	ctl_data = calloc(1, (sizeof(str_hub_rec_ctl_cb_data_t) +
+	    hub_name_size + sizeof(void*)));
+	if (NULL == ctl_data)
+		return (ENOMEM);
+	ctl_data->shbskt = shbskt;
+	ctl_data->cli = cli;
+	ctl_data->start = start;
+	ctl_data->hub_name = (uint8_t*)(ctl_data + 1);
+	memcpy(ctl_data->hub_name, hub_name, hub_name_size);
+	ctl_data->hub_name[hub_name_size] = 0;
+	ctl_data->hub_name_size = hub_name_size;
+	memcpy(&ctl_data->src_conn_params, src_conn_params,
+	    sizeof(str_src_conn_params_t));
+	if (NULL != prof_name) {
+		ctl_data->prof_name_size = MIN(prof_name_size,
+		    (sizeof(ctl_data->prof_name) - 1));
+		memcpy(ctl_data->prof_name, prof_name, ctl_data->prof_name_size);
+	}
+	memcpy(ctl_data->rec_name, rec_name, rec_name_size);
+	ctl_data->rec_name_size = rec_name_size;
+
+	tpt = str_hub_tpt_get_by_name(shbskt->tp, hub_name, hub_name_size);
+	/* Not direct: reply must be after HTTP callback return. */
+	error = tpt_msg_send(tpt, NULL, 0, str_hub_rec_ctl_msg_cb, ctl_data);
+	if (0 != error) {
+		free(ctl_data);
+	}
+
+	return (error);
+}
+
+/*
+ * Find hub for control message, create = 1: create if not exist.
+ * Return HTTP status code: 200 - ok.
+ */
+static uint32_t
+str_hub_ctl_hub_get(str_hubs_bckt_p shbskt, tpt_p tpt, int create,
+    uint8_t *hub_name, size_t hub_name_size,
+    const char *prof_name, size_t prof_name_size,
+    str_src_conn_params_p src_conn_params, str_hub_p *str_hub_ret) {
+	int error;
+	str_hubs_settings_p settings = STR_HUBS_BCKT_SETTINGS(shbskt);
+	str_hub_thrd_p thr_data = &shbskt->thr_data[tpt_get_num(tpt)];
+	str_hub_p str_hub;
+
+	TAILQ_FOREACH(str_hub, &thr_data->hub_head, next) {
+		if (str_hub->name_size == hub_name_size &&
+		    0 == memcmp(str_hub->name, hub_name, hub_name_size)) {
+			(*str_hub_ret) = str_hub;
+			return (200);
+		}
+	}
+	if (0 == create)
+		return (404);
+	/* Ignore negative cache: source may come back. */
+	error = str_hub_create_int(shbskt, tpt, hub_name, hub_name_size,
+	    str_hubs_prof_select(settings, prof_name, prof_name_size,
+	    str_src_conn_prof_addr(src_conn_params)),
+	    src_conn_params, (uintptr_t)-1, settings->limits.hubs_max,
+	    str_hub_ret);
+	if (ENOSPC == error)
+		return (503);
+	if (0 != error) {
+		SYSLOG_ERR(LOG_ERR, error, "str_hub_create().");
+		return (500);
+	}
+
+	return (200);
+}
+
+static void
+str_hub_rec_ctl_msg_cb(tpt_p tpt, void *udata) {
+	str_hub_rec_ctl_cb_data_p ctl_data = udata;
+	str_hubs_bckt_p shbskt = ctl_data->shbskt;
+	str_hub_p str_hub = NULL;
+	uint32_t status_code;
+	int error;
+
+	SYSLOGD_EX(LOG_DEBUG, "...");
+
+	status_code = str_hub_ctl_hub_get(shbskt, tpt, ctl_data->start,
+	    ctl_data->hub_name, ctl_data->hub_name_size,
+	    ctl_data->prof_name, ctl_data->prof_name_size,
+	    &ctl_data->src_conn_params, &str_hub);
+	if (200 != status_code)
+		goto reply;
+	if (0 == ctl_data->start) { /* Stop. */
+		if (NULL == str_hub->rec) {
+			status_code = 404;
+			goto reply;
+		}
+		rec_destroy(str_hub->rec);
+		str_hub->rec = NULL;
+		str_hub->flags &= ~STR_HUB_F_REC_RPOS;
+		syslog(LOG_NOTICE, "%s: recording stopped.", str_hub->name);
+		goto reply; /* Hub without clients destroyed by timer. */
+	}
+	/* Start. */
+	if (NULL != str_hub->rec) {
+		status_code = 409;
+		goto reply;
+	}
+	error = rec_create(shbskt->rw, (const uint8_t*)ctl_data->rec_name,
+	    ctl_data->rec_name_size, &str_hub->rec);
+	if (0 != error) {
+		SYSLOG_ERR(LOG_ERR, error, "%s: rec_create().", str_hub->name);
+		status_code = 500;
+		goto reply;
+	}
+	syslog(LOG_NOTICE, "%s: recording started as %s.", str_hub->name,
+	    ctl_data->rec_name);
+
+reply:
+	if (NULL != ctl_data->cli) {
+		http_srv_cli_get_resp(ctl_data->cli)->status_code = status_code;
+		http_srv_resume_responce(ctl_data->cli);
+	} else if (200 != status_code) {
+		syslog(LOG_ERR, "%s: recording %s: %s failed: %"PRIu32".",
+		    ctl_data->hub_name, ctl_data->rec_name,
+		    ((0 != ctl_data->start) ? "start" : "stop"), status_code);
+	}
+	free(ctl_data);
+}
+
+/* Recording: virtual client, copy ring buf data to recorder queue. */
+static void
+str_hub_rec_feed(str_hub_p str_hub) {
+	size_t i, iov_cnt, drop_size, data_size, tr_size, wr_size;
+	struct iovec iov[4];
+
+	if (NULL == str_hub->rec || NULL == str_hub->r_buf)
+		return;
+	if (0 == (STR_HUB_F_REC_RPOS & str_hub->flags)) {
+		str_hub->flags |= STR_HUB_F_REC_RPOS;
+		r_buf_rpos_init(str_hub->r_buf, &str_hub->rec_rpos, 0);
+	}
+	data_size = r_buf_data_avail_size(str_hub->r_buf, &str_hub->rec_rpos,
+	    &drop_size);
+	if (0 == data_size)
+		return;
+	iov_cnt = r_buf_data_get(str_hub->r_buf, &str_hub->rec_rpos,
+	    data_size, (iovec_p)iov, 4, &drop_size, NULL);
+	if (0 != drop_size) { /* Disk too slow: ring buf overwrite data. */
+		rec_drop(str_hub->rec, drop_size);
+	}
+	tr_size = 0;
+	for (i = 0; i < iov_cnt; i ++) {
+		wr_size = rec_write(str_hub->rec, iov[i].iov_base,
+		    iov[i].iov_len);
+		tr_size += wr_size;
+		if (wr_size < iov[i].iov_len)
+			break; /* Queue full, rest stay in ring buf. */
+	}
+	r_buf_rpos_inc(str_hub->r_buf, &str_hub->rec_rpos, tr_size);
+}
+
+
+int
+str_hub_push_ctl(str_hubs_bckt_p shbskt, http_srv_cli_p cli,
+    int start, uint8_t *hub_name, size_t hub_name_size,
+    const char *prof_name, size_t prof_name_size,
+    str_src_conn_params_p src_conn_params,
+    udp_push_params_p push_params) {
+	int error;
+	tpt_p tpt;
+	str_hub_push_ctl_cb_data_p ctl_data;
+
+	if (NULL == shbskt || NULL == hub_name || 0 == hub_name_size ||
+	    NULL == src_conn_params || NULL == push_params)
+		return (EINVAL);
+	if (0 == (UDP_PUSH_S_F_ENABLE & shbskt->push_settings.flags))
+		return (ENOTSUP);
+	ctl_data = calloc(1, (sizeof(str_hub_push_ctl_cb_data_t) +
+	    hub_name_size + sizeof(void*)));
+	if (NULL == ctl_data)
+		return (ENOMEM);
+	ctl_data->shbskt = shbskt;
+	ctl_data->cli = cli;
+	ctl_data->start = start;
+	memcpy(&ctl_data->push_params, push_params, sizeof(udp_push_params_t));
+	ctl_data->hub_name = (uint8_t*)(ctl_data + 1);
+	memcpy(ctl_data->hub_name, hub_name, hub_name_size);
+	ctl_data->hub_name[hub_name_size] = 0;
+	ctl_data->hub_name_size = hub_name_size;
+	memcpy(&ctl_data->src_conn_params, src_conn_params,
+	    sizeof(str_src_conn_params_t));
+	if (NULL != prof_name) {
+		ctl_data->prof_name_size = MIN(prof_name_size,
+		    (sizeof(ctl_data->prof_name) - 1));
+		memcpy(ctl_data->prof_name, prof_name, ctl_data->prof_name_size);
+	}
+
+	tpt = str_hub_tpt_get_by_name(shbskt->tp, hub_name, hub_name_size);
+	/* Not direct: reply must be after HTTP callback return. */
+	error = tpt_msg_send(tpt, NULL, 0, str_hub_push_ctl_msg_cb, ctl_data);
+	if (0 != error) {
+		free(ctl_data);
+	}
+
+	return (error);
+}
+
+static void
+str_hub_push_ctl_msg_cb(tpt_p tpt, void *udata) {
+	str_hub_push_ctl_cb_data_p ctl_data = udata;
+	str_hubs_bckt_p shbskt = ctl_data->shbskt;
+	str_hub_thrd_p thr_data = &shbskt->thr_data[tpt_get_num(tpt)];
+	str_hub_p str_hub = NULL;
+	str_hub_push_p strh_push;
+	uint32_t status_code;
+	int error;
+	char straddr[STR_ADDR_LEN];
+
+	SYSLOGD_EX(LOG_DEBUG, "...");
+
+	if (0 != sa_addr_port_to_str(&ctl_data->push_params.addr, straddr,
+	    sizeof(straddr), NULL)) {
+		straddr[0] = 0;
+	}
+	status_code = str_hub_ctl_hub_get(shbskt, tpt, ctl_data->start,
+	    ctl_data->hub_name, ctl_data->hub_name_size,
+	    ctl_data->prof_name, ctl_data->prof_name_size,
+	    &ctl_data->src_conn_params, &str_hub);
+	if (200 != status_code)
+		goto reply;
+	TAILQ_FOREACH(strh_push, &str_hub->push_head, next) {
+		if (0 != sa_addr_port_is_eq(&ctl_data->push_params.addr,
+		    &udp_push_params_get(strh_push->push)->addr))
+			break;
+	}
+	if (0 == ctl_data->start) { /* Stop. */
+		if (NULL == strh_push) {
+			status_code = 404;
+			goto reply;
+		}
+		str_hub_push_destroy(str_hub, strh_push);
+		goto reply; /* Hub without clients destroyed by timer. */
+	}
+	/* Start. */
+	if (NULL != strh_push) {
+		status_code = 409;
+		goto reply;
+	}
+	if (NULL == thr_data->push_sender) {
+		error = udp_push_sender_create(&shbskt->push_settings,
+		    &thr_data->push_sender);
+		if (0 != error) {
+			SYSLOG_ERR(LOG_ERR, error, "udp_push_sender_create().");
+			status_code = 500;
+			goto reply;
+		}
+	}
+	strh_push = calloc(1, sizeof(str_hub_push_t));
+	if (NULL == strh_push) {
+		status_code = 500;
+		goto reply;
+	}
+	error = udp_push_create(&shbskt->push_settings,
+	    &ctl_data->push_params, &strh_push->push);
+	if (0 != error) {
+		SYSLOG_ERR(LOG_ERR, error, "%s: udp_push_create().",
+		    str_hub->name);
+		free(strh_push);
+		status_code = ((EAFNOSUPPORT == error || EINVAL == error ||
+		    ENXIO == error || EADDRNOTAVAIL == error) ? 400 : 500);
+		goto reply;
+	}
+	strh_push->conn_time = gettime_monotonic();
+	TAILQ_INSERT_TAIL(&str_hub->push_head, strh_push, next);
+	str_hub->push_count ++;
+	syslog(LOG_NOTICE, "%s: push to %s%s started.", str_hub->name,
+	    ((0 != (UDP_PUSH_F_RTP & ctl_data->push_params.flags)) ?
+	    "rtp://" : ""),
+	    straddr);
+
+reply:
+	if (NULL != ctl_data->cli) {
+		http_srv_cli_get_resp(ctl_data->cli)->status_code = status_code;
+		http_srv_resume_responce(ctl_data->cli);
+	} else if (200 != status_code) {
+		syslog(LOG_ERR, "%s: push to %s: %s failed: %"PRIu32".",
+		    ctl_data->hub_name, straddr,
+		    ((0 != ctl_data->start) ? "start" : "stop"), status_code);
+	}
+	free(ctl_data);
+}
+
+static void
+str_hub_push_destroy(str_hub_p str_hub, str_hub_push_p strh_push) {
+	str_hub_thrd_p thr_data;
+	char straddr[STR_ADDR_LEN];
+
+	thr_data = &str_hub->shbskt->thr_data[tpt_get_num(str_hub->tpt)];
+	/* Sender may hold iovecs of this output. */
+	udp_push_sender_flush(thr_data->push_sender);
+	if (0 != sa_addr_port_to_str(&udp_push_params_get(strh_push->push)->addr,
+	    straddr, sizeof(straddr), NULL)) {
+		straddr[0] = 0;
+	}
+	syslog(LOG_NOTICE, "%s: push to %s stopped.", str_hub->name, straddr);
+	TAILQ_REMOVE(&str_hub->push_head, strh_push, next);
+	str_hub->push_count --;
+	if (0 == str_hub->push_count) { /* Next output start from live. */
+		str_hub->flags &= ~STR_HUB_F_PUSH_RPOS;
+	}
+	udp_push_destroy(strh_push->push);
+	free(strh_push);
+}
+
+/*
+ * UDP push: one virtual client for all outputs, ring buf data passed to
+ * per thread sender without copy. Only whole datagrams taken, rest wait
+ * for next data. Sender flushed once per hub: all outputs in few
+ * sendmmsg() calls.
+ */
+static void
+str_hub_push_feed(str_hub_p str_hub) {
+	size_t iov_cnt, drop_size, data_size;
+	str_hub_push_p strh_push;
+	udp_push_sender_p sender;
+	struct iovec iov[4];
+
+	if (0 == str_hub->push_count || NULL == str_hub->r_buf)
+		return;
+	if (0 == (STR_HUB_F_PUSH_RPOS & str_hub->flags)) {
+		str_hub->flags |= STR_HUB_F_PUSH_RPOS;
+		r_buf_rpos_init(str_hub->r_buf, &str_hub->push_rpos, 0);
+	}
+	data_size = r_buf_data_avail_size(str_hub->r_buf, &str_hub->push_rpos,
+	    &drop_size);
+	data_size = MIN(((size_t)str_hub->shbskt->push_settings.burst *
+	    UDP_PUSH_PKT_SIZE), (data_size - (data_size % UDP_PUSH_PKT_SIZE)));
+	if (0 == data_size)
+		return;
+	iov_cnt = r_buf_data_get(str_hub->r_buf, &str_hub->push_rpos,
+	    data_size, (iovec_p)iov, 4, &drop_size, NULL);
+	if (0 != drop_size) { /* Ring buf overwrite data. */
+		TAILQ_FOREACH(strh_push, &str_hub->push_head, next) {
+			udp_push_drop(strh_push->push, drop_size);
+		}
+	}
+	if (0 == iov_cnt)
+		return;
+	data_size = iovec_calc_size(iov, iov_cnt);
+	data_size -= (data_size % UDP_PUSH_PKT_SIZE);
+	sender = str_hub->shbskt->thr_data[tpt_get_num(str_hub->tpt)].push_sender;
+	TAILQ_FOREACH(strh_push, &str_hub->push_head, next) {
+		udp_push_sender_add(sender, strh_push->push, iov, iov_cnt,
+		    data_size);
+		str_hub->sended_count += data_size;
+	}
+	/* Data stay in ring buf until flush. */
+	udp_push_sender_flush(sender);
+	r_buf_rpos_inc(str_hub->r_buf, &str_hub->push_rpos, data_size);
+}
+
+
+/* Over limit: reply 503 with Retry-After and close. */
+static void
+str_hub_cli_reject(str_hubs_bckt_p shbskt, tpt_p tpt,
+    const uint8_t *hub_name, size_t hub_name_size,
+    str_hub_cli_p strh_cli, uint32_t reason) {
+	str_hubs_settings_p settings = STR_HUBS_BCKT_SETTINGS(shbskt);
+	struct msghdr mhdr;
+	struct iovec iov[5];
+	ssize_t ios;
+	char straddr[STR_ADDR_LEN];
+
+	atomic_fetch_add_explicit(&shbskt->rejected_count[reason], 1,
+	    memory_order_relaxed);
+	str_hub_access_log(shbskt, tpt, hub_name, hub_name_size, NULL,
+	    strh_cli, ACCESS_LOG_EV_REJECT, str_hubs_reject_reason_str(reason));
+	memset(&mhdr, 0x00, sizeof(mhdr));
+	mhdr.msg_iov = (struct iovec*)iov;
+	mhdr.msg_iovlen = 5;
+	iov[0].iov_base = MK_RW_PTR("HTTP/1.1 503 Service Unavailable\r\n");
+	iov[0].iov_len = 34;
+	iov[1].iov_base = shbskt->base_http_hdrs;
+	iov[1].iov_len = shbskt->base_http_hdrs_size;
+	iov[2].iov_base = settings->retry_after_hdr;
+	iov[2].iov_len = settings->retry_after_hdr_size;
+	iov[3].iov_base = MK_RW_PTR("\r\n");
+	iov[3].iov_len = 2;
+	iov[4].iov_base = MK_RW_PTR("\r\n");
+	iov[4].iov_len = 2;
+	ios = sendmsg((int)strh_cli->skt, &mhdr, (MSG_DONTWAIT | MSG_NOSIGNAL));
+	if (-1 == ios) {
+		SYSLOG_ERR(LOG_DEBUG, errno, "%.*s - %s: sendmsg(503).",
+		    (int)hub_name_size, hub_name, str_hub_cli_addr_str(strh_cli, straddr,
+		    sizeof(straddr)));
+	} else if ((size_t)ios != iovec_calc_size(iov, 5)) {
+		syslog(LOG_DEBUG, "%.*s - %s: 503 reply truncated: %zd bytes.",
+		    (int)hub_name_size, hub_name, str_hub_cli_addr_str(strh_cli, straddr,
+		    sizeof(straddr)), ios);
+	}
+	/* Nothing more to send, just close. */
+	strh_cli->flags |= STR_HUB_CLI_STATE_F_HTTP_HDRS_SENDED;
+	str_hub_cli_destroy(NULL, strh_cli);
+}
+
+/*
+ * Copy event to access log ring of current thread.
+ * All formatting done later by logger thread.
+ */
+static void
+str_hub_access_log(str_hubs_bckt_p shbskt, tpt_p tpt,
+    const uint8_t *hub_name, size_t hub_name_size,
+    str_hub_p str_hub, str_hub_cli_p strh_cli,
+    uint32_t event, const char *reason) {
+	access_log_rec_p rec;
+	size_t thread_num;
+
+	if (NULL == shbskt->alog)
+		return;
+	thread_num = tpt_get_num(tpt);
+	rec = access_log_rec_get(shbskt->alog, thread_num);
+	if (NULL == rec) /* Ring full, counted as dropped. */
+		return;
+	rec->event = event;
+	rec->reason = reason;
+	rec->time = time(NULL);
+	rec->cli_count = ((NULL != str_hub) ? str_hub->cli_count : 0);
+	rec->hub_name_size = MIN(hub_name_size, (sizeof(rec->hub_name) - 1));
+	memcpy(rec->hub_name, hub_name, rec->hub_name_size);
+	if (NULL != strh_cli) {
+		rec->duration = ((0 != strh_cli->conn_time) ?
+		    (gettime_monotonic() - strh_cli->conn_time) : 0);
+		rec->sended = strh_cli->sended_count;
+		memcpy(&rec->addr, &strh_cli->remonte_addr,
+		    sizeof(struct sockaddr_storage));
+		memcpy(&rec->xreal_addr, &strh_cli->xreal_addr,
+		    sizeof(struct sockaddr_storage));
+		rec->user_agent_size = MIN(strh_cli->user_agent_size,
+		    sizeof(rec->user_agent));
+		memcpy(rec->user_agent, strh_cli->user_agent,
+		    rec->user_agent_size);
+	} else {
+		rec->duration = 0;
+		rec->sended = 0;
+		rec->addr.ss_family = AF_UNSPEC;
+		rec->xreal_addr.ss_family = AF_UNSPEC;
+		rec->user_agent_size = 0;
+	}
+	access_log_rec_commit(shbskt->alog, thread_num);
+}
+
+/* For lazy formatting: only if message will be logged. */
+static const char *
+str_hub_cli_addr_str(str_hub_cli_p strh_cli, char *buf, size_t buf_size) {
+
+	if (0 != sa_addr_port_to_str(&strh_cli->remonte_addr, buf, buf_size, NULL)) {
+		buf[0] = 0;
+	}
+	return (buf);
+}
+
+
+
+int
+str_hub_send_to_client(str_hub_p str_hub, str_hub_cli_p strh_cli,
+    size_t *transfered_size) {
+	int error = 0;
+	off_t sbytes = 0;
+	size_t data2send, i, iov_cnt, drop_size, tr_size = 0;
+	size_t snd_block_min_size = str_hub->prof->hub.snd_block_min_size;
+	struct iovec iov[4];
+
+	/* Get data avail for client. */
+	data2send = r_buf_data_avail_size(str_hub->r_buf, &strh_cli->rpos, &drop_size);
+	strh_cli->lag_size = data2send;
+	if (snd_block_min_size > data2send)
+		return (0); /* Not enough data for this client. */
+	if (strh_cli->lag_size_max < data2send) {
+		strh_cli->lag_size_max = data2send;
+	}
+	if (data2send > strh_cli->skt_snd_buf) {
+		data2send = MAX(strh_cli->skt_snd_buf, snd_block_min_size);
+	}
+	iov_cnt = r_buf_data_get(str_hub->r_buf, &strh_cli->rpos, data2send,
+	    (iovec_p)iov, 4, &drop_size, NULL);
+	if (0 == iov_cnt) { /* Nothink to send? */
+		if (0 != drop_size)
+			error = -1;
+		goto err_out;
+	}
+	/* Send. */
+	r_buf_data_get_conv2off(str_hub->r_buf, (iovec_p)iov, iov_cnt);
+	for (i = 0; i < iov_cnt; i ++) {
+		error = skt_sendfile(str_hub->r_buf_fd, strh_cli->skt,
+		    (off_t)iov[i].iov_base, iov[i].iov_len,
+		    (SKT_SF_F_NODISKIO), &sbytes);
+		tr_size += (size_t)sbytes;
+		if (0 != error)
+			break;
+	}
+	/* Supress some errors. */
+	error = SKT_ERR_FILTER(error);
+	/* Update client read pos. */
+	r_buf_rpos_inc(str_hub->r_buf, &strh_cli->rpos, tr_size);
+	/* Update client stat. */
+	strh_cli->sended_count += tr_size;
+	strh_cli->lag_size -= MIN(tr_size, strh_cli->lag_size);
+	if (0 == error && tr_size < iovec_calc_size(iov, iov_cnt)) {
+		strh_cli->blocked_count ++; /* Socket send buffer is full. */
+	}
+
+err_out:
+	if (NULL != transfered_size) {
+		(*transfered_size) = tr_size;
+	}
+
+	return (error);
+}
+
+int
+str_hub_send_to_clients(str_hub_p str_hub) {
+	int error;
+	str_hub_settings_p hub_params = &str_hub->prof->hub;
+	str_hub_cli_p strh_cli, strh_cli_temp;
+	struct msghdr mhdr;
+	struct iovec iov[4];
+	ssize_t ios;
+	size_t transfered_size;
+	char straddr[STR_ADDR_LEN];
+
+	TAILQ_FOREACH_SAFE(strh_cli, &str_hub->cli_head, next, strh_cli_temp) {
+		transfered_size = 0;
+		/* Send HTTP headers if needed. */
+		if (0 == (STR_HUB_CLI_STATE_F_HTTP_HDRS_SENDED & strh_cli->flags)) {
+			memset(&mhdr, 0x00, sizeof(mhdr));
+			mhdr.msg_iov = (struct iovec*)iov;
+			if (NULL != strh_cli->hdrs_keep) { /* Started before reload. */
+				mhdr.msg_iovlen = 1;
+				iov[0].iov_base = strh_cli->hdrs_keep;
+				iov[0].iov_len = strh_cli->hdrs_keep_size;
+			} else {
+				mhdr.msg_iovlen = 3;
+				iov[0].iov_base = MK_RW_PTR("HTTP/1.1 200 OK\r\n");
+				iov[0].iov_len = 17;
+				iov[1].iov_base = str_hub->shbskt->base_http_hdrs;
+				iov[1].iov_len = str_hub->shbskt->base_http_hdrs_size;
+				iov[2].iov_base = hub_params->cust_http_hdrs;
+				iov[2].iov_len = hub_params->cust_http_hdrs_size;
+			}
+			/* Skip allready sended data. */
+			iovec_set_offset(mhdr.msg_iov, (size_t)mhdr.msg_iovlen, strh_cli->offset);
+			ios = sendmsg((int)strh_cli->skt, &mhdr, (MSG_DONTWAIT | MSG_NOSIGNAL));
+			if (-1 == ios) { /* Error happen. */
+				/* Supress some errors. */
+				error = SKT_ERR_FILTER(errno);
+				goto error_on_send;
+			}
+			SYSLOGD_EX(LOG_DEBUG, "HTTP hdr: %zu", ios);
+			strh_cli->offset += (size_t)ios;
+			if (iovec_calc_size(mhdr.msg_iov, (size_t)mhdr.msg_iovlen) >
+			    (size_t)ios) /* Not all HTTP headers sended. */
+				continue; /* Try to send next headers part later. */
+			strh_cli->offset = 0;
+			strh_cli->flags |= STR_HUB_CLI_STATE_F_HTTP_HDRS_SENDED;
+			free(strh_cli->hdrs_keep);
+			strh_cli->hdrs_keep = NULL;
+		}
+		/* Handoff: finish TS packet started by previous process. */
+		if (0 != strh_cli->tail_size) {
+			ios = send((int)strh_cli->skt,
+			    (strh_cli->tail + strh_cli->offset),
+			    (strh_cli->tail_size - strh_cli->offset),
+			    (MSG_DONTWAIT | MSG_NOSIGNAL));
+			if (-1 == ios) { /* Error happen. */
+				/* Supress some errors. */
+				error = SKT_ERR_FILTER(errno);
+				goto error_on_send;
+			}
+			strh_cli->offset += (size_t)ios;
+			strh_cli->sended_count += (size_t)ios;
+			if (strh_cli->tail_size > strh_cli->offset)
+				continue; /* Try to send rest later. */
+			strh_cli->offset = 0;
+			strh_cli->tail_size = 0;
+		}
+		/* Time-shift: send from store until live edge. */
+		if (0 != (STR_HUB_CLI_STATE_F_TSHIFT & strh_cli->flags)) {
+			error = str_hub_tshift_send_to_client(str_hub,
+			    strh_cli, &transfered_size);
+			if (0 != error ||
+			    0 != (STR_HUB_CLI_STATE_F_TSHIFT & strh_cli->flags))
+				goto error_on_send;
+			str_hub->sended_count += transfered_size;
+			transfered_size = 0;
+		}
+		/* Init uninitialized client rpos. */
+		if (0 == (STR_HUB_CLI_STATE_F_RPOS_INITIALIZED & strh_cli->flags)) {
+			strh_cli->flags |= STR_HUB_CLI_STATE_F_RPOS_INITIALIZED;
+			r_buf_rpos_init(str_hub->r_buf, &strh_cli->rpos,
+			    hub_params->precache);
+		}
+		error = str_hub_send_to_client(str_hub, strh_cli, &transfered_size);
+error_on_send:
+		if (0 != error) {
+			if (-1 != error) {
+				strh_cli->drop_reason = STR_HUB_CLI_DROP_R_SKT_ERR;
+			} else if (0 != (STR_HUB_S_F_DROP_SLOW_CLI & hub_params->flags)) {
+				strh_cli->drop_reason = STR_HUB_CLI_DROP_R_RING_OVERRUN;
+			} else {
+				continue; /* Keep client, some data lost. */
+			}
+			if (NULL == str_hub->shbskt->alog) { /* Else logged on detach. */
+				SYSLOG_ERR(LOG_ERR, error, "%s - %s: disconnected.",
+				    str_hub->name,
+				    str_hub_cli_addr_str(strh_cli, straddr, sizeof(straddr)));
+			}
+			str_hub_cli_destroy(str_hub, strh_cli);
+			continue;
+		}
+		str_hub->sended_count += transfered_size;
+	}
+	str_hub_hls_send_to_clients(str_hub);
+	str_hub_rec_feed(str_hub);
+	str_hub_push_feed(str_hub);
+
+	return (0);
+}
+
+/* Called from timer: convert lag to ms and update hub lag histogram. */
+void
+str_hub_cli_lag_update(str_hub_p str_hub, str_hub_cli_p strh_cli) {
+	size_t i;
+
+	if (0 == (STR_HUB_CLI_STATE_F_RPOS_INITIALIZED & strh_cli->flags))
+		return;
+	if (0 != str_hub->baud_rate_in) { /* bits/s -> ms. */
+		strh_cli->lag_ms = ((((uint64_t)strh_cli->lag_size) * 8000) /
+		    str_hub->baud_rate_in);
+	}
+	if (strh_cli->lag_ms_max < strh_cli->lag_ms) {
+		strh_cli->lag_ms_max = strh_cli->lag_ms;
+	}
+	for (i = 0; i < (STR_HUB_LAG_HIST_COUNT - 1); i ++) {
+		if (str_hub_lag_hist_ms[i] > strh_cli->lag_ms)
+			break;
+	}
+	str_hub->lag_hist[i] ++;
+}
+
+
+/*
+ * Called from timer for limited number of clients per tick.
+ * Stat page and clients policy read cached values, without syscalls.
+ */
+#ifdef __linux__ /* Linux specific code. */
+/* Kernel struct tcp_info tail, not in libc headers. */
+typedef struct str_tcp_info_linux_s {
+	struct tcp_info	ti;
+	uint64_t	tcpi_pacing_rate;
+	uint64_t	tcpi_max_pacing_rate;
+	uint64_t	tcpi_bytes_acked;
+	uint64_t	tcpi_bytes_received;
+	uint32_t	tcpi_segs_out;
+	uint32_t	tcpi_segs_in;
+	uint32_t	tcpi_notsent_bytes;
+	uint32_t	tcpi_min_rtt;
+	uint32_t	tcpi_data_segs_in;
+	uint32_t	tcpi_data_segs_out;
+	uint64_t	tcpi_delivery_rate;
+} str_tcp_info_linux_t;
+#endif /* Linux specific code. */
+
+int
+str_hub_cli_tcp_info_sample(str_hub_cli_p strh_cli, time_t cur_time) {
+	str_hub_cli_tcp_info_p cti = &strh_cli->tcp_info;
+#ifdef __linux__ /* Linux specific code. */
+	str_tcp_info_linux_t ti;
+	socklen_t optlen = sizeof(ti);
+
+	cti->time = cur_time;
+	memset(&ti, 0x00, sizeof(ti));
+	if (0 != getsockopt((int)strh_cli->skt, IPPROTO_TCP, TCP_INFO,
+	    &ti, &optlen))
+		return (errno);
+	cti->rtt = ti.ti.tcpi_rtt;
+	cti->rttvar = ti.ti.tcpi_rttvar;
+	cti->maxseg = ti.ti.tcpi_snd_mss;
+	cti->cwnd = (ti.ti.tcpi_snd_cwnd * ti.ti.tcpi_snd_mss);
+	cti->retrans = ti.ti.tcpi_total_retrans;
+	/* Older kernels return short struct. */
+	if (offsetof(str_tcp_info_linux_t, tcpi_min_rtt) <= optlen) {
+		cti->notsent = ti.tcpi_notsent_bytes;
+	}
+	if (sizeof(ti) <= optlen) {
+		cti->delivery_rate = ti.tcpi_delivery_rate;
+	}
+#elif defined(TCP_INFO) /* FreeBSD and others. */
+	struct tcp_info ti;
+	socklen_t optlen = sizeof(ti);
+
+	cti->time = cur_time;
+	memset(&ti, 0x00, sizeof(ti));
+	if (0 != getsockopt((int)strh_cli->skt, IPPROTO_TCP, TCP_INFO,
+	    &ti, &optlen))
+		return (errno);
+	cti->rtt = ti.tcpi_rtt;
+	cti->rttvar = ti.tcpi_rttvar;
+	cti->maxseg = ti.tcpi_snd_mss;
+	cti->cwnd = ti.tcpi_snd_cwnd;
+	cti->retrans = ti.tcpi_snd_rexmitpack;
+#else
+	cti->time = cur_time;
+	return (EOPNOTSUPP);
+#endif
+	return (0);
+}
+
+/*
+ * Size client socket send buf to: bitrate * RTT * factor.
+ * Healthy clients need only few kb, so most kernel memory is not wasted.
+ */
+int
+str_hub_cli_snd_buf_autotune(str_hub_p str_hub, str_hub_cli_p strh_cli) {
+	int error = 0;
+	str_hub_settings_p hub_params = &str_hub->prof->hub;
+	uint64_t tm64;
+	uint32_t snd_buf;
+	int val;
+#ifdef TCP_NOTSENT_LOWAT
+	int lowat;
+#endif
+
+	if (0 == strh_cli->tcp_info.rtt || 0 == str_hub->baud_rate_in)
+		return (0); /* Not enough data. */
+	/* bits/s * usec -> bytes. */
+	tm64 = ((str_hub->baud_rate_in * strh_cli->tcp_info.rtt) / 8000000);
+	tm64 = ((tm64 * hub_params->skt_snd_buf_factor) / 100);
+	tm64 = MAX(tm64, hub_params->skt_snd_buf_min);
+	tm64 = MIN(tm64, hub_params->skt_snd_buf_max);
+	snd_buf = (uint32_t)((tm64 + 4095) & ~((uint64_t)4095)); /* Page align. */
+	/* Hysteresis: ignore changes less than 25%. */
+	if (snd_buf <= (strh_cli->skt_snd_buf + (strh_cli->skt_snd_buf / 4)) &&
+	    snd_buf >= (strh_cli->skt_snd_buf - (strh_cli->skt_snd_buf / 4)))
+		return (0);
+	val = (int)snd_buf;
+	if (0 != setsockopt((int)strh_cli->skt, SOL_SOCKET, SO_SNDBUF,
+	    &val, sizeof(val))) {
+		error = errno;
+		SYSLOG_ERR(LOG_DEBUG, error, "%s: setsockopt(SO_SNDBUF).",
+		    str_hub->name);
+		return (error);
+	}
+	strh_cli->skt_snd_buf = snd_buf;
+	str_hub_cli_snd_buf_read(strh_cli);
+#ifdef TCP_NOTSENT_LOWAT
+	/* Keep not sended data in shared ring buf, not in socket. */
+	lowat = (int)MAX((snd_buf / 2), hub_params->snd_block_min_size);
+	if (0 != setsockopt((int)strh_cli->skt, IPPROTO_TCP, TCP_NOTSENT_LOWAT,
+	    &lowat, sizeof(lowat))) {
+		error = errno;
+		SYSLOG_ERR(LOG_DEBUG, error, "%s: setsockopt(TCP_NOTSENT_LOWAT).",
+		    str_hub->name);
+	}
+#endif
+	return (error);
+}
+
+/*
+ * Kernel may round or double (Linux) requested SO_SNDBUF,
+ * read back real value for memory usage stat.
+ */
+void
+str_hub_cli_snd_buf_read(str_hub_cli_p strh_cli) {
+	int val = 0;
+	socklen_t optlen = sizeof(val);
+
+	if (0 != getsockopt((int)strh_cli->skt, SOL_SOCKET, SO_SNDBUF,
+	    &val, &optlen) ||
+	    0 >= val) {
+		strh_cli->skt_snd_buf_real = strh_cli->skt_snd_buf;
+		return;
+	}
+	strh_cli->skt_snd_buf_real = (uint32_t)val;
+}
+
+
+static int
+str_src_recv_mc_cb(tp_task_p tptask, int error, uint32_t eof __unused,
+    size_t data2transfer_size, void *arg) {
+	str_hub_p str_hub = arg;
+	uintptr_t ident;
+	ssize_t ios;
+	uint8_t *buf;
+	size_t transfered_size = 0, req_buf_size, buf_size, seg_size;
+	int trunc;
+	struct timespec ts;
+
+	if (0 != error) {
+err_out:
+		SYSLOG_ERR(LOG_DEBUG, error, "On receive.");
+		str_hub_destroy_int(str_hub, STR_HUB_CLI_DROP_R_SRC_LOST);
+		return (TP_TASK_CB_NONE); /* Receiver destroyed. */
+	}
+	if (NULL == str_hub->r_buf) { /* Delay ring buf allocation. */
+		str_hub_neg_invalidate(str_hub);
+		error = str_src_r_buf_alloc(str_hub);
+		if (0 != error)
+			goto err_out;
+	}
+
+	ident = tp_task_ident_get(tptask);
+	if (NULL != str_hub->arq) {
+		str_src_recv_arq(str_hub, ident, data2transfer_size);
+		return (TP_TASK_CB_CONTINUE);
+	}
+	req_buf_size = STR_SRC_UDP_PKT_SIZE_STD;
+	if (0 != (STR_HUB_F_UDP_GRO & str_hub->flags)) {
+		/* Coalesced: at least one full GRO super packet. */
+		req_buf_size = MAX(STR_SRC_UDP_PKT_SIZE_MAX, STR_SRC_UDP_GRO_SIZE_MAX);
+	}
+	while (transfered_size < data2transfer_size) { /* recv loop. */
+		buf_size = r_buf_wbuf_get(str_hub->r_buf, req_buf_size, &buf);
+		if (0 != ((STR_HUB_F_UDP_GRO | STR_HUB_F_RCV_TS) & str_hub->flags)) {
+			ios = str_src_recvmsg(ident, buf, buf_size, &seg_size,
+			    &trunc, &ts);
+			if (0 < ios && 0 == str_hub->rcv_ts.tv_sec) {
+				str_hub->rcv_ts = ts; /* Oldest not sent. */
+			}
+			if (0 < ios && 0 != trunc) {
+				/* Tail discarded: keep only whole segments. */
+				str_hub->rcv_trunc_count ++;
+				req_buf_size = MAX(req_buf_size, STR_SRC_UDP_PKT_SIZE_MAX);
+				transfered_size += (size_t)ios;
+				if (0 != seg_size) {
+					str_src_pkt_commit_gro(str_hub, buf,
+					    ((size_t)ios - ((size_t)ios % seg_size)),
+					    seg_size);
+				}
+				continue; /* Single datagram: drop. */
+			}
+			if (0 < ios && 0 != seg_size && (size_t)ios > seg_size) {
+				transfered_size += (size_t)ios;
+				str_src_pkt_commit_gro(str_hub, buf,
+				    (size_t)ios, seg_size);
+				continue;
+			}
+		} else {
+			ios = recv((int)ident, buf, buf_size, MSG_DONTWAIT);
+		}
+		if (-1 == ios) {
+			error = errno;
+			if (0 == error)
+				error = EINVAL;
+			error = SKT_ERR_FILTER(error);
+			if (0 == error && STR_SRC_UDP_PKT_SIZE_MAX > buf_size) {
+				/* Possible not enough buf space. */
+				req_buf_size = STR_SRC_UDP_PKT_SIZE_MAX;
+				continue; /* Retry! */
+			}
+			break;
+		}
+		if (0 == ios)
+			break;
+		transfered_size += (size_t)ios;
+		str_src_pkt_commit(str_hub, buf, (size_t)ios);
+	} /* end recv while */
+	if (0 != error) {
+		SYSLOG_ERR(LOG_NOTICE, error, "recv().");
+		if (0 == transfered_size)
+			goto rcv_next;
+	}
+	str_src_data_rcvd(str_hub, transfered_size);
+
+rcv_next:
+	return (TP_TASK_CB_CONTINUE);
+}
+
+/* Packet in ring buf write space: strip RTP header and commit. */
+static void
+str_src_pkt_commit(str_hub_p str_hub, uint8_t *buf, size_t buf_size) {
+	size_t off = 0;
+
+	buf_size = str_src_pkt_payload(buf, buf_size, &off);
+	if (0 == buf_size)
+		return;
+	/* Prevent fragmentation, zero move: buf += off; */
+	if (0 != off) {
+		memmove(buf, (buf + off), buf_size);
+	}
+	r_buf_wbuf_set2(str_hub->r_buf, buf, buf_size, NULL);
+	str_hub_hls_write(str_hub, buf, buf_size);
+	str_hub_tshift_write(str_hub, buf, buf_size);
+}
+
+/*
+ * recv() with control messages.
+ * seg_size: UDP_GRO segment size, 0 if buf hold single datagram.
+ * trunc: set if buf was too small and tail discarded (MSG_TRUNC).
+ * ts: kernel rx time, zero if not available.
+ */
+static ssize_t
+str_src_recvmsg(uintptr_t skt, uint8_t *buf, size_t buf_size,
+    size_t *seg_size, int *trunc, struct timespec *ts) {
+	ssize_t ios;
+	struct iovec iov;
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	union {
+		struct cmsghdr	hdr;
+		uint8_t		buf[(CMSG_SPACE(sizeof(int)) +
+				    CMSG_SPACE(sizeof(struct timespec)))];
+	} cmsg_buf;
+	int gso_size;
+
+	(*seg_size) = 0;
+	(*trunc) = 0;
+	memset(ts, 0x00, sizeof(struct timespec));
+	iov.iov_base = buf;
+	iov.iov_len = buf_size;
+	memset(&msg, 0x00, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = &cmsg_buf;
+	msg.msg_controllen = sizeof(cmsg_buf);
+	ios = recvmsg((int)skt, &msg, MSG_DONTWAIT);
+	if (0 >= ios)
+		return (ios);
+	if (0 != (MSG_TRUNC & msg.msg_flags)) {
+		(*trunc) = 1;
+	}
+	for (cmsg = CMSG_FIRSTHDR(&msg); NULL != cmsg;
+	    cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+#ifdef UDP_GRO
+		if (IPPROTO_UDP == cmsg->cmsg_level &&
+		    UDP_GRO == cmsg->cmsg_type) {
+			memcpy(&gso_size, CMSG_DATA(cmsg), sizeof(gso_size));
+			if (0 < gso_size) {
+				(*seg_size) = (size_t)gso_size;
+			}
+			continue;
+		}
+#endif
+#ifdef SO_TIMESTAMPNS
+		if (SOL_SOCKET == cmsg->cmsg_level &&
+		    SCM_TIMESTAMPNS == cmsg->cmsg_type) {
+			memcpy(ts, CMSG_DATA(cmsg), sizeof(struct timespec));
+			continue;
+		}
+#endif
+	}
+
+	return (ios);
+}
+
+/*
+ * Coalesced datagrams in ring buf write space: all have seg_size,
+ * except last. Validate each, move payloads together and commit once.
+ */
+static void
+str_src_pkt_commit_gro(str_hub_p str_hub, uint8_t *buf, size_t buf_size,
+    size_t seg_size) {
+	size_t seg_off, off, data_size, wr_size = 0;
+
+	for (seg_off = 0; seg_off < buf_size; seg_off += seg_size) {
+		off = 0;
+		data_size = str_src_pkt_payload((buf + seg_off),
+		    MIN(seg_size, (buf_size - seg_off)), &off);
+		if (0 == data_size)
+			continue; /* Drop. */
+		off += seg_off;
+		if (wr_size != off) { /* Plain MPEG2-TS stream: no move. */
+			memmove((buf + wr_size), (buf + off), data_size);
+		}
+		wr_size += data_size;
+	}
+	if (0 == wr_size)
+		return;
+	r_buf_wbuf_set2(str_hub->r_buf, buf, wr_size, NULL);
+	str_hub_hls_write(str_hub, buf, wr_size);
+	str_hub_tshift_write(str_hub, buf, wr_size);
+}
+
+/* Data received: update stat and send to clients. */
+static void
+str_src_data_rcvd(str_hub_p str_hub, size_t transfered_size) {
+	struct timespec tp;
+	uint64_t lat;
+
+	/* Calc speed. */
+	str_hub->received_count += transfered_size;
+	clock_gettime(CLOCK_MONOTONIC_FAST, &str_hub->tp_last_recv);
+#ifdef __linux__ /* Linux specific code. */
+	/* Ring buf LOWAT emulator. */
+	str_hub->r_buf_rcvd += transfered_size;
+	if (str_hub->r_buf_rcvd < str_hub->prof->src.skt_rcv_lowat)
+		return;
+	str_hub->r_buf_rcvd = 0;
+#endif /* Linux specific code. */
+	str_hub_send_to_clients(str_hub);
+	if (0 != str_hub->rcv_ts.tv_sec) { /* Receive to send latency. */
+		clock_gettime(CLOCK_REALTIME, &tp);
+		lat = ((uint64_t)(tp.tv_sec - str_hub->rcv_ts.tv_sec) * 1000000000);
+		lat += (uint64_t)tp.tv_nsec;
+		lat -= (uint64_t)str_hub->rcv_ts.tv_nsec;
+		if ((1000000000ull * 60) > lat) { /* Skip clock steps. */
+			str_hub->rcv_lat_avg -= (str_hub->rcv_lat_avg / 8);
+			str_hub->rcv_lat_avg += (lat / 8);
+			str_hub->rcv_lat_max = MAX(str_hub->rcv_lat_max, lat);
+		}
+		str_hub->rcv_ts.tv_sec = 0;
+	}
+}
+
+/* SO_BUSY_POLL, SO_PREFER_BUSY_POLL and SO_BUSY_POLL_BUDGET. */
+static int
+str_src_skt_busy_poll(uintptr_t skt, str_src_settings_p src_params) {
+#ifdef SO_BUSY_POLL
+	int val;
+
+	if ((uintptr_t)-1 == skt || NULL == src_params)
+		return (EINVAL);
+	val = (int)src_params->busy_poll;
+	if (0 != setsockopt((int)skt, SOL_SOCKET, SO_BUSY_POLL,
+	    &val, sizeof(val)))
+		return (errno);
+#ifdef SO_PREFER_BUSY_POLL
+	val = ((0 != src_params->busy_poll &&
+	    0 != (STR_SRC_S_F_BUSY_POLL_PREFER & src_params->flags)) ? 1 : 0);
+	if (0 != setsockopt((int)skt, SOL_SOCKET, SO_PREFER_BUSY_POLL,
+	    &val, sizeof(val)))
+		return (errno);
+#endif
+#ifdef SO_BUSY_POLL_BUDGET
+	if (0 != src_params->busy_poll) {
+		val = (int)src_params->busy_poll_budget;
+		if (0 != setsockopt((int)skt, SOL_SOCKET, SO_BUSY_POLL_BUDGET,
+		    &val, sizeof(val)))
+			return (errno);
+	}
+#endif
+	return (0);
+#else
+	if (NULL == src_params || 0 == src_params->busy_poll)
+		return (0);
+	return (EOPNOTSUPP);
+#endif
+}
+
+
+/* Handoff socket bound not to group port: packet ring join only socket. */
+static int
+str_src_skt_is_join_only(uintptr_t skt, const struct sockaddr_storage *addr) {
+	struct sockaddr_storage ssaddr;
+	socklen_t addrlen = sizeof(ssaddr);
+
+	if (0 != getsockname((int)skt, (struct sockaddr*)&ssaddr, &addrlen))
+		return (0);
+	return (sa_port_get(&ssaddr) != sa_port_get(addr));
+}
+
+/*
+ * Hub receive from shared packet ring, own socket only for group
+ * membership: bound to ephemeral port, so kernel never queue data to it.
+ * skt: join only socket from handoff or -1, on error caller still own it.
+ */
+static int
+str_src_ring_hub_init(str_hub_p str_hub, uintptr_t skt) {
+	int error;
+	str_src_conn_mc_p conn_mc = &str_hub->src_conn_params.mc;
+	uintptr_t own_skt = (uintptr_t)-1;
+
+	if (STR_SRC_CONN_DEF_IFINDEX == conn_mc->if_index ||
+	    0 == conn_mc->if_index)
+		return (EDESTADDRREQ); /* Ring bound to interface. */
+	if ((uintptr_t)-1 == skt) {
+		error = skt_bind_ap(conn_mc->udp.addr.ss_family, NULL, 0,
+		    SOCK_DGRAM, IPPROTO_UDP, SO_F_NONBLOCK, &own_skt);
+		if (0 != error)
+			return (error);
+		error = str_src_conn_mc_join(own_skt, 1, conn_mc);
+		if (0 != error)
+			goto err_out;
+		skt = own_skt;
+	}
+	error = tp_task_notify_create(str_hub->tpt, skt,
+	    TP_TASK_F_CLOSE_ON_DESTROY, TP_EV_READ, 0, str_src_recv_drain_cb,
+	    str_hub, &str_hub->tptask);
+	if (0 != error)
+		goto err_out;
+	error = str_src_ring_attach(str_hub);
+	if (0 != error) {
+		if ((uintptr_t)-1 == own_skt) { /* Caller close it. */
+			tp_task_flags_del(str_hub->tptask,
+			    TP_TASK_F_CLOSE_ON_DESTROY);
+		}
+		tp_task_destroy(str_hub->tptask);
+		str_hub->tptask = NULL;
+		return (error);
+	}
+
+	return (0);
+
+err_out:
+	if ((uintptr_t)-1 != own_skt) {
+		close((int)own_skt);
+	}
+	return (error);
+}
+
+static int
+str_src_ring_attach(str_hub_p str_hub) {
+	int error;
+	str_hubs_bckt_p shbskt = str_hub->shbskt;
+	size_t thread_num = tpt_get_num(str_hub->tpt);
+	str_src_ring_p ring;
+
+	TAILQ_FOREACH(ring, &shbskt->thr_data[thread_num].ring_head, next) {
+		if (ring->if_index == str_hub->src_conn_params.mc.if_index)
+			break;
+	}
+	if (NULL == ring) {
+		ring = calloc(1, sizeof(str_src_ring_t));
+		if (NULL == ring)
+			return (ENOMEM);
+		ring->shbskt = shbskt;
+		ring->thread_num = thread_num;
+		ring->if_index = str_hub->src_conn_params.mc.if_index;
+		error = pkt_ring_create(str_hub->tpt, ring->if_index,
+		    &str_hub->prof->src.pkt_ring, str_src_ring_pkt_cb,
+		    str_src_ring_block_cb, ring, &ring->pkt_ring);
+		if (0 != error) {
+			free(ring);
+			return (error);
+		}
+		TAILQ_INSERT_HEAD(&shbskt->thr_data[thread_num].ring_head,
+		    ring, next);
+	}
+	str_hub->ring = ring;
+	ring->hub_count ++;
+	error = str_src_ring_rebuild(ring, str_hub);
+	if (0 != error) {
+		str_src_ring_detach(str_hub);
+		return (error);
+	}
+
+	return (0);
+}
+
+static void
+str_src_ring_detach(str_hub_p str_hub) {
+	str_src_ring_p ring;
+
+	if (NULL == str_hub || NULL == str_hub->ring)
+		return;
+	ring = str_hub->ring;
+	str_hub->ring = NULL;
+	ring->hub_count --;
+	/* Keep slot busy for probing, but never match: rebuild may fail. */
+	for (size_t i = 0; NULL != ring->ht && i <= ring->ht_mask; i ++) {
+		if (str_hub != ring->ht[i].str_hub)
+			continue;
+		ring->ht[i].family = AF_UNSPEC;
+	}
+	if (0 != ring->hub_count) {
+		str_src_ring_rebuild(ring, NULL);
+		return;
+	}
+	TAILQ_REMOVE(&ring->shbskt->thr_data[ring->thread_num].ring_head,
+	    ring, next);
+	pkt_ring_destroy(ring->pkt_ring);
+	free(ring->ht);
+	free(ring->dirty);
+	free(ring);
+}
+
+static size_t
+str_src_ring_hash(sa_family_t family, const uint8_t *grp, uint16_t port) {
+	uint32_t h;
+
+	memcpy(&h, ((AF_INET == family) ? grp : (grp + 12)), sizeof(h));
+	h = ((h ^ port) * 2654435761U);
+
+	return ((size_t)(h ^ (h >> 16)));
+}
+
+/* Add hub to hash table, return group address or NULL if not supported. */
+static const struct sockaddr_storage *
+str_src_ring_ht_add(str_src_ring_ent_p ht, size_t ht_mask, str_hub_p str_hub) {
+	size_t i;
+	str_src_ring_ent_t key;
+	const struct sockaddr_storage *addr, *src;
+
+	addr = &str_hub->src_conn_params.mc.udp.addr;
+	src = &str_hub->src_conn_params.mc.src;
+	memset(&key, 0x00, sizeof(key));
+	key.str_hub = str_hub;
+	key.family = addr->ss_family;
+	switch (addr->ss_family) {
+	case AF_INET:
+		key.port = ((const struct sockaddr_in*)(const void*)addr)->sin_port;
+		memcpy(key.grp, &((const struct sockaddr_in*)(const void*)addr)->sin_addr, 4);
+		if (AF_INET == src->ss_family) {
+			memcpy(key.src, &((const struct sockaddr_in*)(const void*)src)->sin_addr, 4);
+			key.ssm = 1;
+		}
+		break;
+	case AF_INET6:
+		key.port = ((const struct sockaddr_in6*)(const void*)addr)->sin6_port;
+		memcpy(key.grp, &((const struct sockaddr_in6*)(const void*)addr)->sin6_addr, 16);
+		if (AF_INET6 == src->ss_family) {
+			memcpy(key.src, &((const struct sockaddr_in6*)(const void*)src)->sin6_addr, 16);
+			key.ssm = 1;
+		}
+		break;
+	default:
+		return (NULL);
+	}
+	/* Linear probing, same group + port always in one cluster. */
+	i = (str_src_ring_hash(key.family, key.grp, key.port) & ht_mask);
+	while (NULL != ht[i].str_hub) {
+		i = ((i + 1) & ht_mask);
+	}
+	memcpy(&ht[i], &key, sizeof(str_src_ring_ent_t));
+
+	return (addr);
+}
+
+/*
+ * Rebuild hash table and kernel filter from hubs on ring.
+ * str_hub_new: not in thread hubs list yet, may be NULL.
+ */
+static int
+str_src_ring_rebuild(str_src_ring_p ring, str_hub_p str_hub_new) {
+	int error;
+	size_t ht_size = 16, addrs_count = 0;
+	str_src_ring_ent_p ht;
+	str_hub_p str_hub, *dirty;
+	const struct sockaddr_storage **addrs;
+
+	while (ht_size < (2 * ring->hub_count)) {
+		ht_size *= 2;
+	}
+	ht = calloc(ht_size, sizeof(str_src_ring_ent_t));
+	dirty = calloc((ring->hub_count + 1), sizeof(str_hub_p));
+	addrs = calloc((ring->hub_count + 1), sizeof(struct sockaddr_storage*));
+	if (NULL == ht || NULL == dirty || NULL == addrs) {
+		error = ENOMEM;
+		goto err_out;
+	}
+	TAILQ_FOREACH(str_hub, &ring->shbskt->thr_data[ring->thread_num].hub_head, next) {
+		if (ring != str_hub->ring || addrs_count >= ring->hub_count)
+			continue;
+		addrs[addrs_count] = str_src_ring_ht_add(ht, (ht_size - 1),
+		    str_hub);
+		if (NULL != addrs[addrs_count]) {
+			addrs_count ++;
+		}
+	}
+	if (NULL != str_hub_new && addrs_count < ring->hub_count) {
+		addrs[addrs_count] = str_src_ring_ht_add(ht, (ht_size - 1),
+		    str_hub_new);
+		if (NULL != addrs[addrs_count]) {
+			addrs_count ++;
+		}
+	}
+	error = pkt_ring_filter_set(ring->pkt_ring, addrs, addrs_count);
+	if (0 != error)
+		goto err_out;
+	free(addrs);
+	for (size_t i = 0; i < ring->dirty_count; i ++) {
+		ring->dirty[i]->flags &= ~STR_HUB_F_RING_DIRTY;
+		ring->dirty[i]->ring_rcvd = 0;
+	}
+	free(ring->ht);
+	free(ring->dirty);
+	ring->ht = ht;
+	ring->ht_mask = (ht_size - 1);
+	ring->dirty = dirty;
+	ring->dirty_count = 0;
+
+	return (0);
+
+err_out:
+	SYSLOG_ERR(LOG_ERR, error, "Packet ring %"PRIu32" rebuild.",
+	    ring->if_index);
+	free(ht);
+	free(dirty);
+	free(addrs);
+	return (error);
+}
+
+/* Deliver datagram to all hubs with same group + port (and source). */
+static void
+str_src_ring_pkt_cb(pkt_ring_p pkt_ring __unused, pkt_ring_pkt_p pkt,
+    void *udata) {
+	str_src_ring_p ring = udata;
+	str_src_ring_ent_p ent;
+	str_hub_p str_hub;
+	size_t i, addr_size, buf_size;
+	uint8_t *buf;
+
+	if (NULL == ring->ht ||
+	    MPEG2_TS_PKT_SIZE_MIN > pkt->data_size) /* Empty / short datagram. */
+		return;
+	addr_size = ((AF_INET == pkt->family) ? 4 : 16);
+	i = (str_src_ring_hash(pkt->family, pkt->dst, pkt->dst_port) &
+	    ring->ht_mask);
+	for (; NULL != ring->ht[i].str_hub; i = ((i + 1) & ring->ht_mask)) {
+		ent = &ring->ht[i];
+		if (ent->family != pkt->family ||
+		    ent->port != pkt->dst_port ||
+		    0 != memcmp(ent->grp, pkt->dst, addr_size) ||
+		    (0 != ent->ssm && 0 != memcmp(ent->src, pkt->src, addr_size)))
+			continue;
+		str_hub = ent->str_hub;
+		if (NULL == str_hub->r_buf) { /* Delay ring buf allocation. */
+			str_hub_neg_invalidate(str_hub);
+			if (0 != str_src_r_buf_alloc(str_hub))
+				continue; /* Timer destroy it on rcv_timeout. */
+		}
+		buf_size = r_buf_wbuf_get(str_hub->r_buf, pkt->data_size, &buf);
+		if (buf_size < pkt->data_size)
+			continue;
+		memcpy(buf, pkt->data, pkt->data_size);
+		str_src_pkt_commit(str_hub, buf, pkt->data_size);
+		if (0 != (STR_HUB_F_RCV_TS & str_hub->flags) &&
+		    0 == str_hub->rcv_ts.tv_sec) {
+			str_hub->rcv_ts = pkt->ts;
+		}
+		if (0 == (STR_HUB_F_RING_DIRTY & str_hub->flags)) {
+			str_hub->flags |= STR_HUB_F_RING_DIRTY;
+			ring->dirty[ring->dirty_count ++] = str_hub;
+		}
+		str_hub->ring_rcvd += pkt->data_size;
+	}
+}
+
+/* Blocks done: send to clients once per hub. */
+static void
+str_src_ring_block_cb(pkt_ring_p pkt_ring __unused, void *udata) {
+	str_src_ring_p ring = udata;
+	str_hub_p str_hub;
+
+	for (size_t i = 0; i < ring->dirty_count; i ++) {
+		str_hub = ring->dirty[i];
+		str_hub->flags &= ~STR_HUB_F_RING_DIRTY;
+		str_src_data_rcvd(str_hub, str_hub->ring_rcvd);
+		str_hub->ring_rcvd = 0;
+	}
+	ring->dirty_count = 0;
+}
+
+/* Join only socket: must not get data, drop if any. */
+static int
+str_src_recv_drain_cb(tp_task_p tptask, int error, uint32_t eof __unused,
+    size_t data2transfer_size __unused, void *arg __unused) {
+	uint8_t buf[STR_SRC_UDP_PKT_SIZE_STD];
+
+	if (0 != error)
+		return (TP_TASK_CB_CONTINUE);
+	while (0 < recv((int)tp_task_ident_get(tptask), buf, sizeof(buf),
+	    MSG_DONTWAIT))
+		;
+	return (TP_TASK_CB_CONTINUE);
+}
+
+
+/* RTP ARQ clock: monotonic, ms. */
+static inline uint64_t
+str_src_arq_time(void) {
+	struct timespec tp;
+
+	clock_gettime(CLOCK_MONOTONIC_FAST, &tp);
+	return (((uint64_t)tp.tv_sec * 1000) + ((uint64_t)tp.tv_nsec / 1000000));
+}
+
+/*
+ * RIST simple profile: RTCP on source port + 1 both ways.
+ * NACK destination guessed as RTP sender address and port + 1,
+ * replaced by real one on first RTCP from sender.
+ * One RTCP socket per port per thread: without REUSEPORT unicast
+ * RTCP is not balanced to other hub socket.
+ */
+static int
+str_src_arq_init(str_hub_p str_hub) {
+	int error;
+	str_hubs_bckt_p shbskt = str_hub->shbskt;
+	size_t thread_num = tpt_get_num(str_hub->tpt);
+	str_src_conn_udp_p conn_udp = &str_hub->src_conn_params.udp;
+	uint16_t port = (uint16_t)(sa_port_get(&conn_udp->addr) + 1);
+	str_src_rtcp_p rtcp;
+	uintptr_t skt;
+
+	error = rtp_arq_create(&str_hub->prof->src.arq, &str_hub->arq);
+	if (0 != error)
+		return (error);
+	TAILQ_FOREACH(rtcp, &shbskt->thr_data[thread_num].rtcp_head, next) {
+		if (rtcp->family == conn_udp->addr.ss_family &&
+		    rtcp->port == port)
+			break;
+	}
+	if (NULL == rtcp) {
+		rtcp = calloc(1, sizeof(str_src_rtcp_t));
+		if (NULL == rtcp) {
+			error = ENOMEM;
+			goto err_out;
+		}
+		rtcp->shbskt = shbskt;
+		rtcp->thread_num = thread_num;
+		rtcp->family = conn_udp->addr.ss_family;
+		rtcp->port = port;
+		error = skt_bind_ap(rtcp->family, NULL, port, SOCK_DGRAM,
+		    IPPROTO_UDP, (SO_F_NONBLOCK | SO_F_REUSEADDR), &skt);
+		if (0 != error) {
+			free(rtcp);
+			goto err_out;
+		}
+		error = tp_task_notify_create(str_hub->tpt, skt,
+		    TP_TASK_F_CLOSE_ON_DESTROY, TP_EV_READ, 0,
+		    str_src_arq_rtcp_cb, rtcp, &rtcp->tptask);
+		if (0 != error) {
+			close((int)skt);
+			free(rtcp);
+			goto err_out;
+		}
+		TAILQ_INSERT_HEAD(&shbskt->thr_data[thread_num].rtcp_head,
+		    rtcp, next);
+	}
+	str_hub->arq_rtcp = rtcp;
+	rtcp->hub_count ++;
+	return (0);
+
+err_out:
+	rtp_arq_destroy(str_hub->arq);
+	str_hub->arq = NULL;
+	return (error);
+}
+
+static void
+str_src_arq_destroy(str_hub_p str_hub) {
+	str_src_rtcp_p rtcp;
+
+	if (NULL == str_hub)
+		return;
+	rtp_arq_destroy(str_hub->arq);
+	str_hub->arq = NULL;
+	rtcp = str_hub->arq_rtcp;
+	if (NULL == rtcp)
+		return;
+	str_hub->arq_rtcp = NULL;
+	rtcp->hub_count --;
+	if (0 != rtcp->hub_count)
+		return;
+	TAILQ_REMOVE(&rtcp->shbskt->thr_data[rtcp->thread_num].rtcp_head,
+	    rtcp, next);
+	tp_task_destroy(rtcp->tptask);
+	free(rtcp);
+}
+
+/*
+ * Sender reports not parsed: only sender RTCP address taken.
+ * Demux by sender address: hubs on this port with guessed address match.
+ */
+static int
+str_src_arq_rtcp_cb(tp_task_p tptask, int error, uint32_t eof __unused,
+    size_t data2transfer_size __unused, void *arg) {
+	str_src_rtcp_p rtcp = arg;
+	str_hub_p str_hub;
+	uint8_t buf[RTP_ARQ_RTCP_SIZE_MAX];
+	struct sockaddr_storage addr;
+	socklen_t addrlen;
+
+	if (0 != error)
+		return (TP_TASK_CB_CONTINUE);
+	for (;;) {
+		addrlen = sizeof(addr);
+		if (0 >= recvfrom((int)tp_task_ident_get(tptask), buf,
+		    sizeof(buf), MSG_DONTWAIT, (struct sockaddr*)&addr,
+		    &addrlen))
+			break;
+		TAILQ_FOREACH(str_hub,
+		    &rtcp->shbskt->thr_data[rtcp->thread_num].hub_head, next) {
+			if (rtcp != str_hub->arq_rtcp ||
+			    0 != (STR_HUB_F_ARQ_DST & str_hub->flags) ||
+			    addr.ss_family != str_hub->arq_dst.ss_family ||
+			    0 != str_src_addr_cmp(&addr, &str_hub->arq_dst))
+				continue;
+			sa_copy(&addr, &str_hub->arq_dst);
+			str_hub->flags |= STR_HUB_F_ARQ_DST;
+		}
+	}
+	return (TP_TASK_CB_CONTINUE);
+}
 
-	sa_addr_port_to_str(&strh_cli->remonte_addr, straddr, sizeof(straddr), NULL);
+/*
+ * RTP with retransmission: recv to stack buf, pass via reorder window,
+ * commit released packets, all NACKs of this callback in one RTCP.
+ */
+static void
+str_src_recv_arq(str_hub_p str_hub, uintptr_t skt,
+    size_t data2transfer_size) {
+	int error = 0;
+	uint8_t buf[RTP_ARQ_PKT_SIZE_MAX], *wbuf;
+	struct sockaddr_storage addr;
+	socklen_t addrlen;
+	ssize_t ios;
+	size_t transfered_size = 0;
+	uint64_t time;
 
-	/* Set. */
-	strh_cli->conn_time = gettime_monotonic();
-	/* Tune socket. */
-	/* Reduce kernel memory usage. */
-	error = skt_rcv_tune(strh_cli->skt, STR_HUB_CLI_RECV_BUF, STR_HUB_CLI_RECV_LOWAT);
-	SYSLOG_ERR(LOG_NOTICE, error, "%s - %s: skt_rcv_tune().",
-	    str_hub->name, straddr);
-	error = skt_snd_tune(strh_cli->skt, hub_params->skt_snd_buf, 1);
-	SYSLOG_ERR(LOG_NOTICE, error, "%s - %s: skt_snd_tune().",
-	    str_hub->name, straddr);
-	if (0 != (STR_HUB_S_F_SKT_HALFCLOSED & hub_params->flags)) {
-		if (0 != shutdown((int)strh_cli->skt, SHUT_RD)) {
-			error = errno;
-			SYSLOG_ERR(LOG_NOTICE, error, "%s - %s: shutdown(..., SHUT_RD).",
-			    str_hub->name, straddr);
+	time = str_src_arq_time();
+	while (transfered_size < data2transfer_size) { /* recv loop. */
+		addrlen = sizeof(addr);
+		ios = recvfrom((int)skt, buf, sizeof(buf), MSG_DONTWAIT,
+		    (struct sockaddr*)&addr, &addrlen);
+		if (-1 == ios) {
+			error = SKT_ERR_FILTER(errno);
+			break;
+		}
+		if (0 == ios)
+			break;
+		transfered_size += (size_t)ios;
+		error = rtp_arq_put(str_hub->arq, buf, (size_t)ios, time);
+		if (EAGAIN == error) { /* Resync: release all held first. */
+			str_src_arq_commit(str_hub, time);
+			error = rtp_arq_put(str_hub->arq, buf, (size_t)ios, time);
 		}
+		if (0 != error) { /* Not RTP: as is. */
+			r_buf_wbuf_get(str_hub->r_buf, (size_t)ios, &wbuf);
+			memcpy(wbuf, buf, (size_t)ios);
+			str_src_pkt_commit(str_hub, wbuf, (size_t)ios);
+			error = 0;
+			continue;
+		}
+		if (0 == (STR_HUB_F_ARQ_DST & str_hub->flags)) {
+			sa_copy(&addr, &str_hub->arq_dst);
+			sa_port_set(&str_hub->arq_dst, (uint16_t)
+			    (sa_port_get(&str_hub->src_conn_params.udp.addr) + 1));
+		}
+		str_src_arq_commit(str_hub, time);
 	}
-	error = skt_set_tcp_nodelay(strh_cli->skt, (STR_HUB_S_F_SKT_TCP_NODELAY & hub_params->flags));
-	SYSLOG_ERR(LOG_NOTICE, error, "%s - %s: skt_set_tcp_nodelay().",
-	    str_hub->name, straddr);
-	error = skt_set_tcp_nopush(strh_cli->skt, (STR_HUB_S_F_SKT_TCP_NOPUSH & hub_params->flags));
-	SYSLOG_ERR(LOG_NOTICE, error, "%s - %s: skt_set_tcp_nopush().",
-	    str_hub->name, straddr);
-	if (0 != hub_params->cc_name_size) {
-		error = skt_set_tcp_cc(strh_cli->skt, hub_params->cc_name,
-	            hub_params->cc_name_size);
-		SYSLOG_ERR(LOG_NOTICE, error, "%s - %s: skt_set_tcp_cc().",
-		    str_hub->name, straddr);
+	SYSLOG_ERR(LOG_NOTICE, error, "recvfrom().");
+	ios = (ssize_t)rtp_arq_nack_make(str_hub->arq, time, buf, sizeof(buf));
+	if (0 < ios && AF_UNSPEC != str_hub->arq_dst.ss_family) {
+		sendto((int)tp_task_ident_get(str_hub->arq_rtcp->tptask), buf,
+		    (size_t)ios, MSG_DONTWAIT, (struct sockaddr*)&str_hub->arq_dst,
+		    sa_type2size(&str_hub->arq_dst));
 	}
+	if (0 != transfered_size) {
+		str_src_data_rcvd(str_hub, transfered_size);
+	}
+}
 
-	syslog(LOG_INFO, "%s - %s: attached, cli_count = %zu",
-	    str_hub->name, straddr, (str_hub->cli_count + 1));
+/* Commit all packets released by reorder window, return count. */
+static size_t
+str_src_arq_commit(str_hub_p str_hub, uint64_t time) {
+	const uint8_t *pkt;
+	uint8_t *buf;
+	size_t pkt_size, ret = 0;
 
-	TAILQ_INSERT_HEAD(&str_hub->cli_head, strh_cli, next);
-	str_hub->cli_count ++;
-	free(cli_data);
+	while (0 != (pkt_size = rtp_arq_get(str_hub->arq, time, &pkt))) {
+		r_buf_wbuf_get(str_hub->r_buf, pkt_size, &buf);
+		memcpy(buf, pkt, pkt_size);
+		str_src_pkt_commit(str_hub, buf, pkt_size);
+		ret ++;
+	}
+	return (ret);
 }
 
 
+/*
+ * HTTP pull source: MPEG2-TS from other node over HTTP.
+ * One non blocking TCP connection per hub, origins tried in order,
+ * reconnect delay doubled on each fail, reset on data.
+ */
+static int
+str_src_http_connect(str_hub_p str_hub) {
+	int error;
+	str_src_conn_http_p conn_http = &str_hub->src_conn_params.http;
+	str_src_settings_p src_params = &str_hub->prof->src;
+	struct sockaddr_storage *addr;
+	uintptr_t skt;
 
-int
-str_hub_send_to_client(str_hub_p str_hub, str_hub_cli_p strh_cli,
-    size_t *transfered_size) {
-	int error = 0;
-	off_t sbytes = 0;
-	size_t data2send, i, iov_cnt, drop_size, tr_size = 0;
-	struct iovec iov[4];
-
-	/* Get data avail for client. */
-	data2send = r_buf_data_avail_size(str_hub->r_buf, &strh_cli->rpos, &drop_size);
-	if (str_hub->shbskt->hub_params.snd_block_min_size > data2send)
-		return (0); /* Not enough data for this client. */
-	if (data2send > str_hub->shbskt->hub_params.skt_snd_buf) {
-		data2send = str_hub->shbskt->hub_params.skt_snd_buf;
+	if (NULL == str_hub->http_buf) {
+		str_hub->http_buf = malloc(STR_SRC_HTTP_BUF_SIZE);
+		if (NULL == str_hub->http_buf)
+			return (ENOMEM);
 	}
-	iov_cnt = r_buf_data_get(str_hub->r_buf, &strh_cli->rpos, data2send,
-	    (iovec_p)iov, 4, &drop_size, NULL);
-	if (0 == iov_cnt) { /* Nothink to send? */
-		if (0 != drop_size)
-			error = -1;
+	str_hub->http_buf_size = 0;
+	addr = &conn_http->origin[(str_hub->http_origin % conn_http->origin_count)];
+	skt = (uintptr_t)socket(addr->ss_family, SOCK_STREAM, IPPROTO_TCP);
+	if ((uintptr_t)-1 == skt)
+		return (errno);
+	if (-1 == fcntl((int)skt, F_SETFL,
+	    (fcntl((int)skt, F_GETFL, 0) | O_NONBLOCK))) {
+		error = errno;
 		goto err_out;
 	}
-	/* Send. */
-	r_buf_data_get_conv2off(str_hub->r_buf, (iovec_p)iov, iov_cnt);
-	for (i = 0; i < iov_cnt; i ++) {
-		error = skt_sendfile(str_hub->r_buf_fd, strh_cli->skt,
-		    (off_t)iov[i].iov_base, iov[i].iov_len,
-		    (SKT_SF_F_NODISKIO), &sbytes);
-		tr_size += (size_t)sbytes;
-		if (0 != error)
-			break;
+	error = skt_rcv_tune(skt, src_params->skt_rcv_buf, 0);
+	SYSLOG_ERR(LOG_NOTICE, error, "%s: skt_rcv_tune().", str_hub->name);
+	if (0 != connect((int)skt, (const struct sockaddr*)addr,
+	    sa_type2size(addr)) &&
+	    EINPROGRESS != errno) {
+		error = errno;
+		goto err_out;
 	}
-	/* Supress some errors. */
-	error = SKT_ERR_FILTER(error);
-	/* Update client read pos. */
-	r_buf_rpos_inc(str_hub->r_buf, &strh_cli->rpos, tr_size);
+	/* Writable on connect done. */
+	error = tp_task_notify_create(str_hub->tpt, skt,
+	    TP_TASK_F_CLOSE_ON_DESTROY, TP_EV_WRITE, 0, str_src_http_conn_cb,
+	    str_hub, &str_hub->tptask);
+	if (0 != error)
+		goto err_out;
+	str_hub->http_state = STR_SRC_HTTP_ST_CONN;
+	str_hub->http_next_time = (gettime_monotonic() +
+	    (time_t)src_params->http_conn_timeout);
 
-err_out:
-	if (NULL != transfered_size) {
-		(*transfered_size) = tr_size;
-	}
+	return (0);
 
+err_out:
+	close((int)skt);
 	return (error);
 }
 
-int
-str_hub_send_to_clients(str_hub_p str_hub) {
-	int error;
-	str_hub_cli_p strh_cli, strh_cli_temp;
-	struct msghdr mhdr;
-	struct iovec iov[4];
-	ssize_t ios;
-	size_t transfered_size;
+/* Drop connection, switch to next origin and wait. */
+static void
+str_src_http_retry(str_hub_p str_hub, int error) {
 	char straddr[STR_ADDR_LEN];
+	str_src_conn_http_p conn_http = &str_hub->src_conn_params.http;
+	size_t origin = (str_hub->http_origin % conn_http->origin_count);
 
-	TAILQ_FOREACH_SAFE(strh_cli, &str_hub->cli_head, next, strh_cli_temp) {
-		transfered_size = 0;
-		/* Send HTTP headers if needed. */
-		if (0 == (STR_HUB_CLI_STATE_F_HTTP_HDRS_SENDED & strh_cli->flags)) {
-			memset(&mhdr, 0x00, sizeof(mhdr));
-			mhdr.msg_iov = (struct iovec*)iov;
-			mhdr.msg_iovlen = 3;
-			iov[0].iov_base = MK_RW_PTR("HTTP/1.1 200 OK\r\n");
-			iov[0].iov_len = 17;
-			iov[1].iov_base = str_hub->shbskt->base_http_hdrs;
-			iov[1].iov_len = str_hub->shbskt->base_http_hdrs_size;
-			iov[2].iov_base = str_hub->shbskt->hub_params.cust_http_hdrs;
-			iov[2].iov_len = str_hub->shbskt->hub_params.cust_http_hdrs_size;
-			/* Skip allready sended data. */
-			iovec_set_offset(mhdr.msg_iov, (size_t)mhdr.msg_iovlen, strh_cli->offset);
-			ios = sendmsg((int)strh_cli->skt, &mhdr, (MSG_DONTWAIT | MSG_NOSIGNAL));
-			if (-1 == ios) { /* Error happen. */
-				/* Supress some errors. */
-				error = SKT_ERR_FILTER(errno);
-				goto error_on_send;
-			}
-			SYSLOGD_EX(LOG_DEBUG, "HTTP hdr: %zu", ios);
-			strh_cli->offset += (size_t)ios;
-			if (iovec_calc_size(mhdr.msg_iov, (size_t)mhdr.msg_iovlen) >
-			    (size_t)ios) /* Not all HTTP headers sended. */
-				continue; /* Try to send next headers part later. */
-			strh_cli->offset = 0;
-			strh_cli->flags |= STR_HUB_CLI_STATE_F_HTTP_HDRS_SENDED;
+	tp_task_destroy(str_hub->tptask);
+	str_hub->tptask = NULL;
+	straddr[0] = 0;
+	sa_addr_port_to_str(&conn_http->origin[origin], straddr,
+	    sizeof(straddr), NULL);
+	syslog(LOG_NOTICE, "%s: origin %s: %i - %s, reconnect in %"PRIu32"s.",
+	    str_hub->name, straddr, error, strerror(error), str_hub->http_retry);
+	str_hub->http_state = STR_SRC_HTTP_ST_WAIT;
+	str_hub->http_buf_size = 0;
+	str_hub->http_origin ++;
+	str_hub->http_next_time = (gettime_monotonic() +
+	    (time_t)str_hub->http_retry);
+	/* First retry immediately: next origin. */
+	if (0 == str_hub->http_retry) {
+		str_hub->http_retry = 1;
+	} else {
+		str_hub->http_retry = MIN((str_hub->http_retry * 2),
+		    MAX(1, str_hub->prof->src.http_retry_max));
+	}
+}
+
+/* Called every second. Return non zero if hub destroyed. */
+static int
+str_src_http_timer(str_hub_p str_hub, time_t cur_time) {
+	int error;
+	str_src_settings_p src_params = &str_hub->prof->src;
+	time_t tmt;
+
+	/* No data from any origin: give up. */
+	if (0 != src_params->http_fail_timeout &&
+	    (str_hub->tp_last_recv.tv_sec + (time_t)src_params->http_fail_timeout) < cur_time) {
+		str_hub_destroy_int(str_hub, STR_HUB_CLI_DROP_R_SRC_LOST);
+		return (1);
+	}
+	switch (str_hub->http_state) {
+	case STR_SRC_HTTP_ST_WAIT:
+		if (str_hub->http_next_time > cur_time)
+			break;
+		str_hub->http_reconnects ++;
+		error = str_src_http_connect(str_hub);
+		if (0 != error) {
+			str_src_http_retry(str_hub, error);
 		}
-		/* Init uninitialized client rpos. */
-		if (0 == (STR_HUB_CLI_STATE_F_RPOS_INITIALIZED & strh_cli->flags)) {
-			strh_cli->flags |= STR_HUB_CLI_STATE_F_RPOS_INITIALIZED;
-			r_buf_rpos_init(str_hub->r_buf, &strh_cli->rpos,
-			    str_hub->shbskt->hub_params.precache);
+		break;
+	case STR_SRC_HTTP_ST_CONN:
+	case STR_SRC_HTTP_ST_HDRS:
+		if (str_hub->http_next_time > cur_time)
+			break;
+		str_src_http_retry(str_hub, ETIMEDOUT);
+		break;
+	case STR_SRC_HTTP_ST_DATA:
+		/* Stalled origin: http_next_time is stream start time. */
+		if (0 == src_params->rcv_timeout)
+			break;
+		tmt = (MAX(str_hub->tp_last_recv.tv_sec, str_hub->http_next_time) +
+		    (time_t)src_params->rcv_timeout);
+		if (tmt < cur_time) {
+			str_src_http_retry(str_hub, ETIMEDOUT);
 		}
-		error = str_hub_send_to_client(str_hub, strh_cli, &transfered_size);
-error_on_send:
-		if (0 != error) {
-			sa_addr_port_to_str(&strh_cli->remonte_addr, straddr, sizeof(straddr), NULL);
-			SYSLOG_ERR(LOG_ERR, error, "%s - %s: disconnected.",
-			    str_hub->name, straddr);
-			if (-1 != error ||
-			    0 != (STR_HUB_S_F_DROP_SLOW_CLI & str_hub->shbskt->hub_params.flags))
-				str_hub_cli_destroy(str_hub, strh_cli);
-			continue;
+		break;
+	}
+	return (0);
+}
+
+static int
+str_src_http_conn_cb(tp_task_p tptask, int error, uint32_t eof __unused,
+    size_t data2transfer_size __unused, void *arg) {
+	str_hub_p str_hub = arg;
+	str_src_conn_http_p conn_http = &str_hub->src_conn_params.http;
+	uintptr_t skt = tp_task_ident_get(tptask);
+	socklen_t optlen;
+	char straddr[STR_ADDR_LEN];
+	int ret;
+	ssize_t ios;
+
+	if (0 == error) {
+		optlen = sizeof(error);
+		if (0 != getsockopt((int)skt, SOL_SOCKET, SO_ERROR, &error,
+		    &optlen)) {
+			error = errno;
 		}
-		str_hub->sended_count += transfered_size;
 	}
+	if (0 != error)
+		goto err_out;
+	/* HTTP/1.0: no chunked encoding, stream until close. */
+	straddr[0] = 0;
+	sa_addr_port_to_str(&conn_http->origin[(str_hub->http_origin %
+	    conn_http->origin_count)], straddr, sizeof(straddr), NULL);
+	ret = snprintf((char*)str_hub->http_buf, STR_SRC_HTTP_BUF_SIZE,
+	    "GET %s HTTP/1.0\r\n"
+	    "Host: %s\r\n"
+	    "User-Agent: msd_lite\r\n"
+	    "Accept: */*\r\n"
+	    "\r\n",
+	    conn_http->path, straddr);
+	if (0 > ret || STR_SRC_HTTP_BUF_SIZE <= ret) {
+		error = ENOBUFS;
+		goto err_out;
+	}
+	/* Empty socket buf: whole request fit. */
+	ios = send((int)skt, str_hub->http_buf, (size_t)ret,
+	    (MSG_DONTWAIT | MSG_NOSIGNAL));
+	if (-1 == ios) {
+		error = errno;
+		goto err_out;
+	}
+	if ((ssize_t)ret != ios) { /* Short write. */
+		error = EIO;
+		goto err_out;
+	}
+	/* Same socket, now wait for response. */
+	tp_task_flags_del(tptask, TP_TASK_F_CLOSE_ON_DESTROY);
+	tp_task_destroy(tptask);
+	str_hub->tptask = NULL;
+	error = tp_task_notify_create(str_hub->tpt, skt,
+	    TP_TASK_F_CLOSE_ON_DESTROY, TP_EV_READ, 0, str_src_http_recv_cb,
+	    str_hub, &str_hub->tptask);
+	if (0 != error) {
+		close((int)skt);
+		goto err_out;
+	}
+	str_hub->http_state = STR_SRC_HTTP_ST_HDRS;
 
-	return (0);
+	return (TP_TASK_CB_NONE);
+
+err_out:
+	str_src_http_retry(str_hub, error);
+	return (TP_TASK_CB_NONE); /* Task destroyed. */
 }
 
+/*
+ * Check response headers in http_buf.
+ * Return 0 and move body start to http_buf begin if done,
+ * EAGAIN if need more data.
+ */
+static int
+str_src_http_resp_parse(str_hub_p str_hub) {
+	uint8_t *ptm;
+	size_t tm;
+
+	ptm = mem_find(0, str_hub->http_buf, str_hub->http_buf_size,
+	    "\r\n\r\n", 4);
+	if (NULL == ptm) {
+		if (STR_SRC_HTTP_BUF_SIZE == str_hub->http_buf_size)
+			return (EMSGSIZE);
+		return (EAGAIN);
+	}
+	/* "HTTP/1.x 200 ..." */
+	if (12 > str_hub->http_buf_size ||
+	    0 != memcmp(str_hub->http_buf, "HTTP/1.", 7) ||
+	    0 != memcmp((str_hub->http_buf + 8), " 200", 4))
+		return (EPROTO);
+	ptm += 4;
+	tm = (size_t)((str_hub->http_buf + str_hub->http_buf_size) - ptm);
+	memmove(str_hub->http_buf, ptm, tm);
+	str_hub->http_buf_size = tm;
 
-/* MPEG payload-type constants - adopted from VLC 0.8.6 */
-#define P_MPGA		0x0E /* MPEG audio */
-#define P_MPGV		0x20 /* MPEG video */
+	return (0);
+}
 
+/*
+ * Big recv() straight into ring buf write space, commit only whole
+ * TS packets, tail kept in http_buf and put before next recv data.
+ */
 static int
-str_src_recv_mc_cb(tp_task_p tptask, int error, uint32_t eof __unused,
-    size_t data2transfer_size, void *arg) {
+str_src_http_recv_cb(tp_task_p tptask, int error, uint32_t eof __unused,
+    size_t data2transfer_size __unused, void *arg) {
 	str_hub_p str_hub = arg;
-	uintptr_t ident;
+	uintptr_t skt = tp_task_ident_get(tptask);
 	ssize_t ios;
 	uint8_t *buf;
-	size_t transfered_size = 0, req_buf_size, buf_size, start_off = 0, end_off = 0;
+	size_t i, req_buf_size, buf_size, tail_size, off, data_size;
+	size_t transfered_size = 0;
 
-	if (0 != error) {
-err_out:
-		SYSLOG_ERR(LOG_DEBUG, error, "On receive.");
-		str_hub_destroy_int(str_hub);
-		return (TP_TASK_CB_NONE); /* Receiver destroyed. */
+	if (0 != error)
+		goto err_out;
+	if (STR_SRC_HTTP_ST_HDRS == str_hub->http_state) {
+		ios = recv((int)skt, (str_hub->http_buf + str_hub->http_buf_size),
+		    (STR_SRC_HTTP_BUF_SIZE - str_hub->http_buf_size),
+		    MSG_DONTWAIT);
+		if (-1 == ios) {
+			error = SKT_ERR_FILTER(errno);
+			if (0 == error)
+				return (TP_TASK_CB_CONTINUE);
+			goto err_out;
+		}
+		if (0 == ios) {
+			error = ECONNRESET;
+			goto err_out;
+		}
+		str_hub->http_buf_size += (size_t)ios;
+		error = str_src_http_resp_parse(str_hub);
+		if (EAGAIN == error)
+			return (TP_TASK_CB_CONTINUE);
+		if (0 != error)
+			goto err_out;
+		str_hub->http_state = STR_SRC_HTTP_ST_DATA;
+		str_hub->http_next_time = gettime_monotonic();
 	}
 	if (NULL == str_hub->r_buf) { /* Delay ring buf allocation. */
+		str_hub_neg_invalidate(str_hub);
 		error = str_src_r_buf_alloc(str_hub);
-		if (0 != error)
-			goto err_out;
+		if (0 != error) {
+			str_hub_destroy_int(str_hub, STR_HUB_CLI_DROP_R_SRC_LOST);
+			return (TP_TASK_CB_NONE); /* Receiver destroyed. */
+		}
 	}
 
-	ident = tp_task_ident_get(tptask);
-	req_buf_size = STR_SRC_UDP_PKT_SIZE_STD;
-	while (transfered_size < data2transfer_size) { /* recv loop. */
+	req_buf_size = MAX((str_hub->prof->src.http_rcv_size * 1024),
+	    (2 * STR_SRC_HTTP_BUF_SIZE));
+	for (i = 0; i < 4; i ++) { /* recv loop, limited for fairness. */
 		buf_size = r_buf_wbuf_get(str_hub->r_buf, req_buf_size, &buf);
-		ios = recv((int)ident, buf, buf_size, MSG_DONTWAIT);
+		tail_size = str_hub->http_buf_size;
+		memcpy(buf, str_hub->http_buf, tail_size);
+		ios = recv((int)skt, (buf + tail_size), (buf_size - tail_size),
+		    MSG_DONTWAIT);
 		if (-1 == ios) {
-			error = errno;
-			if (0 == error)
-				error = EINVAL;
-			error = SKT_ERR_FILTER(error);
-			if (0 == error && STR_SRC_UDP_PKT_SIZE_MAX > buf_size) {
-				/* Possible not enough buf space. */
-				req_buf_size = STR_SRC_UDP_PKT_SIZE_MAX;
-				continue; /* Retry! */
-			}
+			error = SKT_ERR_FILTER(errno);
 			break;
 		}
-		if (0 == ios)
+		if (0 == ios) {
+			error = ECONNRESET;
 			break;
-		transfered_size += (size_t)ios;
-		if (MPEG2_TS_PKT_SIZE_MIN > (size_t)ios)
-			continue; /* Packet to small, drop. */
-		if (MPEG2_TS_HDR_IS_VALID((mpeg2_ts_hdr_p)buf)) { /* Test_ for RTP. */
-			buf_size = (size_t)ios;
-		} else if (0 == rtp_payload_get(buf, (size_t)ios, &start_off, &end_off)) {
-			/* XXX skip payload bulk data. */
-			if (P_MPGA == ((rtp_hdr_p)buf)->pt ||
-			    P_MPGV == ((rtp_hdr_p)buf)->pt)
-				start_off += 4;
-			buf_size = ((size_t)ios - (start_off + end_off));
-			if (MPEG2_TS_PKT_SIZE_MIN > buf_size)
-				continue; /* Packet to small, drop. */
-			/* Prevent fragmentation, zero move: buf += start_off; */
-			memmove(buf, (buf + start_off), buf_size);
-		} else {
-			continue; /* Packet unknown, drop. */
 		}
-		r_buf_wbuf_set2(str_hub->r_buf, buf, buf_size, NULL);
-	} /* end recv while */
-	if (0 != error) {
-		SYSLOG_ERR(LOG_NOTICE, error, "recv().");
-		if (0 == transfered_size)
-			goto rcv_next;
+		data_size = (tail_size + (size_t)ios);
+		/* Sync to TS packet start. */
+		for (off = 0; off < data_size; off ++) {
+			if (0x47 == buf[off] &&
+			    ((off + MPEG2_TS_PKT_SIZE_188) >= data_size ||
+			    0x47 == buf[(off + MPEG2_TS_PKT_SIZE_188)]))
+				break;
+		}
+		data_size -= off;
+		str_hub->http_buf_size = (data_size % MPEG2_TS_PKT_SIZE_188);
+		data_size -= str_hub->http_buf_size;
+		memcpy(str_hub->http_buf, (buf + off + data_size),
+		    str_hub->http_buf_size);
+		if (0 != data_size) {
+			if (0 != off) {
+				memmove(buf, (buf + off), data_size);
+			}
+			r_buf_wbuf_set2(str_hub->r_buf, buf, data_size, NULL);
+			str_hub_hls_write(str_hub, buf, data_size);
+			str_hub_tshift_write(str_hub, buf, data_size);
+			transfered_size += data_size;
+		}
+		if ((size_t)ios < (buf_size - tail_size))
+			break; /* Socket buf drained. */
 	}
-	/* Calc speed. */
-	str_hub->received_count += transfered_size;
-	clock_gettime(CLOCK_MONOTONIC_FAST, &str_hub->tp_last_recv);
-	
-#ifdef __linux__ /* Linux specific code. */
-	/* Ring buf LOWAT emulator. */
-	str_hub->r_buf_rcvd += transfered_size;
-	if (str_hub->r_buf_rcvd < str_hub->shbskt->src_params.skt_rcv_lowat)
-		goto rcv_next;
-	str_hub->r_buf_rcvd = 0;
-#endif /* Linux specific code. */
-	str_hub_send_to_clients(str_hub);
+	if (0 != transfered_size) {
+		str_hub->http_retry = 0;
+		str_src_data_rcvd(str_hub, transfered_size);
+	}
+	if (0 != error)
+		goto err_out;
 
-rcv_next:
 	return (TP_TASK_CB_CONTINUE);
+
+err_out:
+	str_src_http_retry(str_hub, error);
+	return (TP_TASK_CB_NONE); /* Task destroyed. */
+}
+
+/*
+ * File source: reader thread send datagrams to local socket,
+ * received by str_src_recv_mc_cb() like multicast.
+ */
+static int
+str_src_file_init(str_hub_p str_hub, uintptr_t *skt_ret) {
+	str_src_conn_file_p conn_file = &str_hub->src_conn_params.file;
+	replay_params_t params;
+
+	memset(&params, 0x00, sizeof(params));
+	params.flags = conn_file->flags;
+	memcpy(&params.filter, &conn_file->mc.udp.addr,
+	    sizeof(struct sockaddr_storage));
+	memcpy(params.path, conn_file->path, sizeof(params.path));
+
+	return (replay_create(&params, skt_ret, &str_hub->replay));
 }
 
 
 int
 str_src_r_buf_alloc(str_hub_p str_hub) {
 	int error;
+	size_t ring_buf_size = str_hub->prof->hub.ring_buf_size;
 	char hash[(MD5_HASH_STR_SIZE + 1)], filename[128];
 	struct timespec tv_now;
 
@@ -964,13 +4761,12 @@ str_src_r_buf_alloc(str_hub_p str_hub) {
 	}
 
 	/* Truncate it to the correct size */
-	if (0 != ftruncate((int)str_hub->r_buf_fd, (off_t)str_hub->shbskt->hub_params.ring_buf_size)) {
+	if (0 != ftruncate((int)str_hub->r_buf_fd, (off_t)ring_buf_size)) {
 		error = errno;
 		SYSLOG_ERR(LOG_ERR, error, "ftruncate(%s).", filename);
 		goto err_out;
 	}
-	str_hub->r_buf = r_buf_alloc(str_hub->r_buf_fd,
-	    str_hub->shbskt->hub_params.ring_buf_size,
+	str_hub->r_buf = r_buf_alloc(str_hub->r_buf_fd, ring_buf_size,
 	    MPEG2_TS_PKT_SIZE_188, 0);
 	if (NULL == str_hub->r_buf) {
 		error = errno;
@@ -978,6 +4774,13 @@ str_src_r_buf_alloc(str_hub_p str_hub) {
 		goto err_out;
 	}
 	unlink(filename);
+	/* Time-shift store: optional, hub work without it. */
+	if (0 != (STR_HUB_S_F_TSHIFT & str_hub->prof->hub.flags) &&
+	    NULL != str_hub->shbskt->tsw) {
+		error = tshift_create(str_hub->shbskt->tsw,
+		    &str_hub->prof->hub.tshift, &str_hub->tshift);
+		SYSLOG_ERR(LOG_ERR, error, "%s: tshift_create().", str_hub->name);
+	}
 	
 	return (0);
 
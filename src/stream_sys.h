@@ -34,20 +34,47 @@
 
 #include <sys/queue.h>
 #include <time.h>
+#include <stdatomic.h>
 
 #include "utils/macro.h"
 #include "threadpool/threadpool.h"
 #include "utils/io_buf.h"
 #include "threadpool/threadpool_task.h"
 #include "utils/ring_buffer.h"
+#include "proto/http_server.h"
+#include "access_log.h"
+#include "pkt_ring.h"
+#include "hls.h"
+#include "tshift.h"
+#include "rec.h"
+#include "udp_push.h"
+#include "rtp_arq.h"
+#include "replay.h"
 
 
 typedef struct str_hub_s	*str_hub_p;
 typedef struct str_hubs_bckt_s	*str_hubs_bckt_p;
 typedef struct str_src_s	*str_src_p;
+typedef struct str_src_ring_s	*str_src_ring_p;
+typedef struct str_src_rtcp_s	*str_src_rtcp_p;
 
 
 
+/* TCP_INFO cache, updated by sampler from timer. */
+typedef struct str_hub_cli_tcp_info_s {
+	time_t		time;		/* Last sample time, 0 = never. */
+	uint32_t	rtt;		/* Smoothed RTT, usec. */
+	uint32_t	rttvar;		/* RTT variance, usec. */
+	uint32_t	maxseg;		/* Send MSS. */
+	uint32_t	cwnd;		/* Congestion window, bytes. */
+	uint64_t	retrans;	/* Total retransmitted segments. */
+	uint64_t	delivery_rate;	/* bytes/s, 0 = not supported. */
+	uint32_t	notsent;	/* Not sended yet bytes in socket buf. */
+	char		cc_name[TCP_CA_NAME_MAX]; /* Congestion control. */
+} str_hub_cli_tcp_info_t, *str_hub_cli_tcp_info_p;
+
+#define STR_HUB_CLI_TAIL_MAX	188 /* One TS packet. */
+
 typedef struct str_hub_cli_s {
 	TAILQ_ENTRY(str_hub_cli_s) next; /* For list. */
 	uintptr_t	skt;		/* socket */
@@ -55,7 +82,26 @@ typedef struct str_hub_cli_s {
 	time_t		conn_time;	/* Connection start time. */
 	size_t		offset;		/* For HTTP headers. */
 	uint32_t	flags;		/* Flags. */
+	/* Stat. */
+	uint64_t	sended_count;	/* Total bytes sended to client. */
+	size_t		lag_size;	/* Lag behind ring buf write pos, bytes. */
+	size_t		lag_size_max;	/* Peak lag, bytes. */
+	uint64_t	lag_ms;		/* Lag behind ring buf write pos, ms. */
+	uint64_t	lag_ms_max;	/* Peak lag, ms. */
+	uint64_t	blocked_count;	/* Socket send buffer full count. */
+	uint32_t	drop_reason;	/* Why server disconnect client. */
+	uint32_t	skt_snd_buf;	/* Current socket send buf size. */
+	uint32_t	skt_snd_buf_real; /* Send buf size from kernel, Linux doubles it. */
+	str_hub_cli_tcp_info_t tcp_info; /* Cached TCP info. */
+	uint32_t	tshift_offset;	/* Requested time-shift, s back from live. */
+	uint64_t	tshift_blk;	/* Time-shift store block to send. */
+	size_t		tshift_off;	/* Sended from block. */
+	uint64_t	tshift_pos;	/* Hub live pos of next byte. */
+	size_t		tail_size;	/* Handoff: rest of TS packet, send before ring data. */
+	uint8_t		tail[STR_HUB_CLI_TAIL_MAX];
 	/* HTTP specific data. */
+	uint8_t		*hdrs_keep;	/* Reload: copy of partially sended headers. */
+	size_t		hdrs_keep_size;
 	uint8_t		*user_agent;
 	size_t		user_agent_size;
 	struct sockaddr_storage remonte_addr; /* Client address. */
@@ -65,9 +111,20 @@ TAILQ_HEAD(str_hub_cli_head, str_hub_cli_s);
 
 /* Flags. */
 #define STR_HUB_CLI_STATE_F_RPOS_INITIALIZED	(((uint32_t)1) << 0)
+#define STR_HUB_CLI_STATE_F_TSHIFT		(((uint32_t)1) << 1) /* Sending from time-shift store. */
 #define STR_HUB_CLI_STATE_F_HTTP_HDRS_SENDED	(((uint32_t)1) << 8)
 /* Limit for User-Agent len. */
 #define STR_HUB_CLI_USER_AGENT_MAX_SIZE	256
+/* Drop reasons. */
+#define STR_HUB_CLI_DROP_R_NONE		0 /* Not dropped by server. */
+#define STR_HUB_CLI_DROP_R_RING_OVERRUN	1 /* Ring buf overwrite unsended data. */
+#define STR_HUB_CLI_DROP_R_SKT_ERR	2 /* Socket error on send. */
+#define STR_HUB_CLI_DROP_R_SLOW_CLI	3 /* Slow client policy: lag too big. */
+#define STR_HUB_CLI_DROP_R_ADMIN	4 /* Server shutdown or admin request. */
+#define STR_HUB_CLI_DROP_R_SRC_LOST	5 /* No data from source. */
+#define STR_HUB_CLI_DROP_R__COUNT	6
+
+const char *str_hub_cli_drop_reason_str(uint32_t reason);
 
 /*
  * 1. Client connect via http, create/find mc receiver, ref_count ++;
@@ -81,6 +138,9 @@ TAILQ_HEAD(str_hub_cli_head, str_hub_cli_s);
 typedef struct str_hub_settings_s {
 	uint32_t	flags;
 	uint32_t	skt_snd_buf;	/* For receiver clients. */
+	uint32_t	skt_snd_buf_min; /* Autotune: low bound. */
+	uint32_t	skt_snd_buf_max; /* Autotune: high bound. */
+	uint32_t	skt_snd_buf_factor; /* Autotune: bitrate * RTT * factor / 100. */
 	/* Client settings and defaults. */
 	size_t		cc_name_size;
 	char		cc_name[TCP_CA_NAME_MAX];/* tcp congestion control forced for client. */
@@ -88,62 +148,220 @@ typedef struct str_hub_settings_s {
 	size_t		ring_buf_size;	/* Size of ring buf. */
 	size_t		precache;
 	size_t		snd_block_min_size;
+	uint64_t	cli_lag_max;	/* Disconnect client if lag more than, ms. */
+	uint32_t	tcp_info_interval; /* Client TCP_INFO sample interval, s. */
+	uint32_t	tcp_info_per_tick; /* Max profile clients sampled per thread per second. */
 	uint8_t		*cust_http_hdrs;
 	size_t		cust_http_hdrs_size;
+	hls_settings_t	hls;		/* HLS segmenter for new hubs. */
+	uint32_t	hls_idle_timeout; /* Keep hub without clients after last HLS request, s. */
+	tshift_settings_t tshift;	/* Time-shift store for new hubs. */
 } str_hub_settings_t, *str_hub_settings_p;
 /* Flags. */
 #define STR_HUB_S_F_DROP_SLOW_CLI		(((uint32_t)1) <<  5) /* Disconnect lagged clients. */
 #define STR_HUB_S_F_SKT_HALFCLOSED		(((uint32_t)1) << 10) /* Enable shutdown(SHUT_RD) for clients. */
 #define STR_HUB_S_F_SKT_TCP_NODELAY		(((uint32_t)1) << 11) /* Enable TCP_NODELAY for clients. */
 #define STR_HUB_S_F_SKT_TCP_NOPUSH		(((uint32_t)1) << 12) /* Enable TCP_NOPUSH for clients. */
+#define STR_HUB_S_F_SKT_SND_BUF_AUTO		(((uint32_t)1) << 13) /* Autotune clients send buf size. */
+#define STR_HUB_S_F_HLS				(((uint32_t)1) << 14) /* Enable HLS output. */
+#define STR_HUB_S_F_TSHIFT			(((uint32_t)1) << 15) /* Enable time-shift store. */
 /* Default values. */
 #define STR_HUB_S_DEF_FLAGS		(0)
 #define STR_HUB_S_DEF_RING_BUF_SIZE	(1 * 1024) /* kb */
 #define STR_HUB_S_DEF_PRECAHE		(1 * 1024) /* kb */
 #define STR_HUB_S_DEF_SND_BLOCK_MIN_SIZE (64) /* kb */
 #define STR_HUB_S_DEF_SKT_SND_BUF	(256)	/* kb */
+#define STR_HUB_S_DEF_SKT_SND_BUF_MIN	(64)	/* kb */
+#define STR_HUB_S_DEF_SKT_SND_BUF_MAX	(2048)	/* kb */
+#define STR_HUB_S_DEF_SKT_SND_BUF_FACTOR (200)	/* % */
+#define STR_HUB_S_DEF_CLI_LAG_MAX	(0)	/* ms, 0 = no limit. */
+#define STR_HUB_S_DEF_TCP_INFO_INTERVAL	(5)	/* s */
+#define STR_HUB_S_DEF_TCP_INFO_PER_TICK	(256)
+#define STR_HUB_S_DEF_HLS_IDLE_TIMEOUT	(30)	/* s */
 
 
 /* Connection info */
 /* UDP source */
 typedef struct str_src_conn_udp_s {
 	struct sockaddr_storage	addr;
+	uint32_t	type;		/* STR_SRC_CONN_T_*. */
 } str_src_conn_udp_t, *str_src_conn_udp_p;
+/* Source types. */
+#define STR_SRC_CONN_T_MC		0 /* Multicast/UDP [rtp]. */
+#define STR_SRC_CONN_T_HTTP		1 /* HTTP pull from other node. */
+#define STR_SRC_CONN_T_FILE		2 /* TS file or pcap replay. */
 
 /* Multicast [rtp] source */
 typedef struct str_src_conn_mc_s {
 	str_src_conn_udp_t udp;
 	uint32_t	if_index;
 	uint32_t	rejoin_time;
+	struct sockaddr_storage	src; /* SSM source, AF_UNSPEC = any source. */
 } str_src_conn_mc_t, *str_src_conn_mc_p;
 #define STR_SRC_CONN_DEF_IFINDEX	((uint32_t)-1)
+#define STR_SRC_CONN_DEF_PORT		1234
+
+/*
+ * HTTP pull source: MPEG2-TS over HTTP from other node.
+ * mc part left default, so multicast code paths see no interface
+ * and no rejoin. udp.addr is first origin, rest used on failover.
+ */
+#define STR_SRC_CONN_HTTP_ORIGIN_MAX	4
+#define STR_SRC_CONN_HTTP_PATH_MAX	128
+#define STR_SRC_CONN_DEF_HTTP_PORT	80
+
+typedef struct str_src_conn_http_s {
+	str_src_conn_mc_t mc;
+	struct sockaddr_storage	origin[STR_SRC_CONN_HTTP_ORIGIN_MAX];
+	size_t		origin_count;
+	size_t		path_size;
+	char		path[STR_SRC_CONN_HTTP_PATH_MAX]; /* Zero terminated. */
+} str_src_conn_http_t, *str_src_conn_http_p;
+
+/*
+ * File replay source: TS file or pcap, channel map only.
+ * udp.addr is pcap filter, AF_UNSPEC = first UDP stream in capture.
+ */
+typedef struct str_src_conn_file_s {
+	str_src_conn_mc_t mc;
+	uint32_t	flags;		/* REPLAY_F_*. */
+	size_t		path_size;
+	char		path[REPLAY_PATH_MAX]; /* Zero terminated. */
+} str_src_conn_file_t, *str_src_conn_file_p;
 
 typedef union str_src_conn_params_s {
 	str_src_conn_udp_t	udp;
 	str_src_conn_mc_t	mc;
+	str_src_conn_http_t	http;
+	str_src_conn_file_t	file;
 } str_src_conn_params_t, *str_src_conn_params_p;
 
 typedef struct str_src_settings_s {
+	uint32_t	flags;		/* Flags. */
 	uint32_t	skt_rcv_buf;	/* For receiver. */
 	uint32_t	skt_rcv_lowat;	/* For receiver. */
 	uint64_t	rcv_timeout;	/* No multicast time to self destroy. */
+	uint32_t	neg_cache_ttl;	/* Reject requests to dead source for, s. */
+	uint32_t	busy_poll;	/* SO_BUSY_POLL, us, 0 = disabled. */
+	uint32_t	busy_poll_budget; /* SO_BUSY_POLL_BUDGET, packets. */
+	pkt_ring_settings_t pkt_ring;	/* Ring for new interface, first hub set. */
+	uint32_t	http_conn_timeout; /* HTTP source: connect and response headers, s. */
+	uint32_t	http_retry_max;	/* HTTP source: reconnect delay limit, s. */
+	uint32_t	http_fail_timeout; /* HTTP source: no data from any origin to self destroy, s. */
+	uint32_t	http_rcv_size;	/* HTTP source: recv() batch, kb. */
+	rtp_arq_settings_t arq;		/* RTP retransmission requests. */
 } str_src_settings_t, *str_src_settings_p;
+/* Flags. */
+#define STR_SRC_S_F_PKT_RING		(((uint32_t)1) << 0) /* Receive with shared packet ring, need ifName. */
+#define STR_SRC_S_F_UDP_GRO		(((uint32_t)1) << 1) /* Linux: UDP_GRO, recv coalesced datagrams. */
+#define STR_SRC_S_F_BUSY_POLL_PREFER	(((uint32_t)1) << 2) /* Linux: SO_PREFER_BUSY_POLL. */
+#define STR_SRC_S_F_RCV_TIMESTAMP	(((uint32_t)1) << 3) /* Kernel rx timestamp: receive to send latency stat. */
+#define STR_SRC_S_F_HTTP_URL		(((uint32_t)1) << 4) /* Allow /http/ URLs, else HTTP sources from channel map only. */
+#define STR_SRC_S_F_RTP_ARQ		(((uint32_t)1) << 5) /* RTP NACK, RIST simple profile, no packet ring and UDP_GRO. */
 /* Default values. */
 #define STR_SRC_S_DEF_SKT_RCV_BUF	(512)	/* kb */
 #define STR_SRC_S_DEF_SKT_RCV_LOWAT	(48)	/* kb */
 #define STR_SRC_S_DEF_UDP_RCV_TIMEOUT	(2)	/* s */
+#define STR_SRC_S_DEF_NEG_CACHE_TTL	(10)	/* s, 0 = disabled. */
+#define STR_SRC_S_DEF_BUSY_POLL		(0)	/* us, 0 = disabled. */
+#define STR_SRC_S_DEF_BUSY_POLL_BUDGET	(8)	/* Packets, kernel default. */
+#define STR_SRC_S_DEF_HTTP_CONN_TIMEOUT	(5)	/* s */
+#define STR_SRC_S_DEF_HTTP_RETRY_MAX	(16)	/* s */
+#define STR_SRC_S_DEF_HTTP_FAIL_TIMEOUT	(60)	/* s */
+#define STR_SRC_S_DEF_HTTP_RCV_SIZE	(64)	/* kb */
+
+
+/*
+ * Named profile: hub + source settings selected per channel by name
+ * (URL "profile" arg) or by source group address range.
+ * Profile 0 is default, used if nothing match.
+ */
+#define STR_HUB_PROF_NAME_MAX	32
+
+typedef struct str_hub_prof_range_s {
+	struct sockaddr_storage	first;	/* Port ignored. */
+	struct sockaddr_storage	last;	/* Port ignored. */
+} str_hub_prof_range_t, *str_hub_prof_range_p;
+
+typedef struct str_hub_prof_s {
+	char		name[STR_HUB_PROF_NAME_MAX]; /* Zero terminated. */
+	size_t		name_size;	/* 0 for default. */
+	size_t		num;		/* Position in settings, set on alloc. */
+	str_hub_settings_t hub;		/* Stream hubs. */
+	str_src_settings_t src;		/* Stream sources. */
+	str_src_conn_params_t src_conn;	/* Defaults for new sources. */
+	str_hub_prof_range_p ranges;	/* Source addresses ranges. */
+	size_t		ranges_count;
+} str_hub_prof_t, *str_hub_prof_p;
+
+
+/* Clients lag histogram: upper bounds of buckets, ms. */
+#define STR_HUB_LAG_HIST_COUNT	8
+extern const uint64_t str_hub_lag_hist_ms[STR_HUB_LAG_HIST_COUNT];
 
 
 /*
  * Auto generated channel name:
  * /udp/IPv4MC:PORT@IF_NAME
+ * File replay names carry path, so longer.
+ */
+#define STR_HUB_NAME_MAX	256
+
+/*
+ * Channel map: short name -> source, profile and prebuilt hub name.
+ * Request to /ch/NAME resolved by one hash lookup.
  */
+#define STR_HUB_CHAN_NAME_MAX	64
+#define STR_HUB_CHAN_TITLE_MAX	128
+
+typedef struct str_hub_chan_s {
+	uint32_t	flags;
+	uint32_t	hash;		/* Name hash. */
+	size_t		hnext;		/* Next index in hash chain. */
+	char		name[STR_HUB_CHAN_NAME_MAX]; /* Zero terminated. */
+	size_t		name_size;
+	char		title[STR_HUB_CHAN_TITLE_MAX]; /* For playlist. */
+	size_t		title_size;
+	char		prof_name[STR_HUB_PROF_NAME_MAX]; /* Empty = auto. */
+	size_t		prof_name_size;
+	str_src_conn_params_t src_conn_params;
+	/* Set by str_hubs_bckt_create() / str_hubs_bckt_reload(). */
+	str_hub_prof_p	prof;
+	uint8_t		hub_name[STR_HUB_NAME_MAX];
+	size_t		hub_name_size;
+} str_hub_chan_t, *str_hub_chan_p;
+/* Flags. */
+#define STR_HUB_CHAN_F_IFINDEX		(((uint32_t)1) <<  0) /* if_index set, else from profile. */
+#define STR_HUB_CHAN_F_REJOIN_TIME	(((uint32_t)1) <<  1) /* rejoin_time set, else from profile. */
+
+/* UDP/RTP push output or multicast relay, all share hub push_rpos. */
+typedef struct str_hub_push_s {
+	TAILQ_ENTRY(str_hub_push_s) next;
+	udp_push_p	push;
+	time_t		conn_time;	/* Monotonic, s. */
+} str_hub_push_t, *str_hub_push_p;
+TAILQ_HEAD(str_hub_push_head, str_hub_push_s);
+
+/* HLS segment request: socket taken from HTTP server, closed after send. */
+typedef struct str_hls_cli_s {
+	TAILQ_ENTRY(str_hls_cli_s) next;
+	uintptr_t	skt;
+	uint64_t	seq;		/* Segment sequence number. */
+	uint32_t	slot;		/* Pinned HLS slot. */
+	size_t		seg_size;
+	time_t		start_time;	/* Monotonic, s. */
+	size_t		offset;		/* Sended: HTTP headers + segment. */
+	size_t		hdr_size;
+	uint8_t		hdr[1024];	/* HTTP headers. */
+} str_hls_cli_t, *str_hls_cli_p;
+TAILQ_HEAD(str_hls_cli_head, str_hls_cli_s);
 
 typedef struct str_hub_s {
 	TAILQ_ENTRY(str_hub_s) next;
 	str_hubs_bckt_p	shbskt;
 	uint8_t		*name;		/* Stream hub unique name. */
 	size_t		name_size;	/* Name size. */
+	uint32_t	flags;		/* STR_HUB_F_*. */
 	struct str_hub_cli_head cli_head; /* List with clients. */
 	size_t		cli_count;	/* Count clients. */
 	/* For stat */
@@ -151,9 +369,17 @@ typedef struct str_hub_s {
 	struct timespec tp_last_recv;	/* For baud rate calculation and status. */
 	uint64_t	received_count;	/* Accumulator for baud rate calculation. */
 	uint64_t	sended_count;	/* Accumulator for baud rate calculation. */
-	uint64_t	baud_rate_in;	/* Total rate in (megabit per sec). */
-	uint64_t	baud_rate_out;	/* Total rate out (megabit per sec). */
+	uint64_t	baud_rate_in;	/* Total rate in (bit per sec). */
+	uint64_t	baud_rate_out;	/* Total rate out (bit per sec). */
 	uint64_t	dropped_count;	/* Dropped clients count. */
+	uint64_t	drop_reason_count[STR_HUB_CLI_DROP_R__COUNT]; /* Dropped clients per reason. */
+	uint64_t	lag_hist[STR_HUB_LAG_HIST_COUNT]; /* Clients lag samples, current period. */
+	uint64_t	lag_hist_last[STR_HUB_LAG_HIST_COUNT]; /* Clients lag samples, last stat period. */
+	struct timespec	rcv_ts;		/* Kernel rx time of oldest not sent data. */
+	uint64_t	rcv_lat_avg;	/* Receive to send latency, ns, avg. */
+	uint64_t	rcv_lat_max;	/* Receive to send latency, ns, max, current period. */
+	uint64_t	rcv_lat_max_last; /* Receive to send latency, ns, max, last stat period. */
+	uint64_t	rcv_trunc_count; /* Truncated receives (MSG_TRUNC). */
 	/* -- stat */
 	tp_task_p	tptask;		/* Data/Packets receiver. */
 	uintptr_t	r_buf_fd;	/* r_buf shared memory file descriptor */
@@ -163,27 +389,183 @@ typedef struct str_hub_s {
 #endif /* Linux specific code. */
 	time_t		next_rejoin_time; /* Next time to send leave+join. */
 
+	uint32_t	http_state;	/* HTTP source: STR_SRC_HTTP_ST_*. */
+	size_t		http_origin;	/* Current origin index. */
+	time_t		http_next_time;	/* Monotonic, s: connect timeout or reconnect time. */
+	uint32_t	http_retry;	/* Current reconnect delay, s. */
+	uint64_t	http_reconnects; /* Stat: connection attempts after first. */
+	uint8_t		*http_buf;	/* Response headers, then TS packet tail. */
+	size_t		http_buf_size;
+
+	rtp_arq_p	arq;		/* RTP retransmission, NULL = off. */
+	str_src_rtcp_p	arq_rtcp;	/* RTCP socket, port + 1: send NACK, receive SR. */
+	struct sockaddr_storage arq_dst; /* Sender RTCP address. */
+
+	replay_p	replay;		/* File source: reader thread. */
+
+	str_src_ring_p	ring;		/* Packet ring receiver, NULL = own socket. */
+	size_t		ring_rcvd;	/* Received from ring in current blocks. */
+
+	hls_p		hls;		/* HLS segmenter, created by first playlist request. */
+	time_t		hls_last_req;	/* Monotonic, s: hub kept while HLS viewers. */
+	struct str_hls_cli_head hls_cli_head; /* Segment sends in progress. */
+	uint64_t	hls_req_count;	/* Stat: playlist + segment requests. */
+
+	tshift_p	tshift;		/* Time-shift store, NULL = disabled. */
+	uint64_t	live_pos;	/* Bytes writed to ring buf since hub create. */
+
+	rec_p		rec;		/* Recording sink, keep hub without clients. */
+	r_buf_rpos_t	rec_rpos;	/* Recording ring buf read pos. */
+
+	struct str_hub_push_head push_head; /* UDP/RTP push outputs, keep hub without clients. */
+	size_t		push_count;
+	r_buf_rpos_t	push_rpos;	/* One ring buf read for all outputs. */
+
 	tpt_p		tpt;		/* Thread data for all IO operations. */
+	str_hub_prof_p	prof;		/* Settings, updated on reload. */
 	str_src_conn_params_t src_conn_params;	/* Point to str_src_conn_XXX */
 } str_hub_t;
 TAILQ_HEAD(str_hub_head, str_hub_s);
+/* Flags. */
+#define STR_HUB_F_LINK_DOWN	(((uint32_t)1) <<  0) /* Source interface down: no rcv_timeout. */
+#define STR_HUB_F_UDP_GRO	(((uint32_t)1) <<  1) /* UDP_GRO enabled on source socket. */
+#define STR_HUB_F_RCV_TS	(((uint32_t)1) <<  2) /* Kernel rx timestamps enabled. */
+#define STR_HUB_F_REC_RPOS	(((uint32_t)1) <<  3) /* rec_rpos initialized. */
+#define STR_HUB_F_PUSH_RPOS	(((uint32_t)1) <<  4) /* push_rpos initialized. */
+#define STR_HUB_F_ARQ_DST	(((uint32_t)1) <<  5) /* arq_dst from sender RTCP, not guessed. */
+#define STR_HUB_F_RING_DIRTY	(((uint32_t)1) <<  6) /* In ring dirty list. */
+/* HTTP source states. */
+#define STR_SRC_HTTP_ST_WAIT	0 /* Wait before reconnect. */
+#define STR_SRC_HTTP_ST_CONN	1 /* Connecting. */
+#define STR_SRC_HTTP_ST_HDRS	2 /* Request sended, read response headers. */
+#define STR_SRC_HTTP_ST_DATA	3 /* Receive stream. */
+#define STR_SRC_HTTP_BUF_SIZE	2048 /* Response headers limit. */
 
 
 /* Per thread and summary stats. */
 typedef struct str_hubs_stat_s {
 	size_t		str_hub_count;	/* Stream hubs count. */
 	size_t		cli_count;	/* Total clients count. */
-	uint64_t	baud_rate_in;	/* Total rate in (megabit per sec). */
-	uint64_t	baud_rate_out;	/* Total rate out (megabit per sec). */
+	size_t		push_count;	/* Total UDP push outputs count. */
+	uint64_t	dropped_count;	/* Total dropped clients count. */
+	uint64_t	skt_snd_buf;	/* Total clients socket send buf size. */
+	uint64_t	baud_rate_in;	/* Total rate in (bit per sec). */
+	uint64_t	baud_rate_out;	/* Total rate out (bit per sec). */
 } str_hubs_stat_t, *str_hubs_stat_p;
 
+/*
+ * Negative cache: hubs destroyed by receive timeout without any data.
+ * Hub always lives on thread selected by name, so per thread cache is enough.
+ */
+typedef struct str_hub_neg_s {
+	TAILQ_ENTRY(str_hub_neg_s) next; /* Expire order. */
+	TAILQ_ENTRY(str_hub_neg_s) hnext; /* Hash chain. */
+	uint32_t	hash;		/* Name hash. */
+	time_t		expire_time;	/* Monotonic, s. */
+	struct sockaddr_storage addr;	/* Source address, for invalidate. */
+	uint8_t		*name;		/* Hub name. */
+	size_t		name_size;	/* Name size. */
+} str_hub_neg_t, *str_hub_neg_p;
+TAILQ_HEAD(str_hub_neg_head, str_hub_neg_s);
+#define STR_HUB_NEG_CACHE_MAX	1024 /* Per thread, oldest evicted. */
+#define STR_HUB_NEG_HASH_SIZE	1024 /* Hash chains per thread, power of 2. */
+
+/*
+ * Packet ring receiver: one per interface per thread, shared by hubs.
+ * Hubs are pinned to thread by name, so each thread ring filter accept
+ * only own hubs groups, no kernel fanout needed.
+ */
+typedef struct str_src_ring_ent_s {
+	str_hub_p	str_hub;	/* NULL = empty slot. */
+	sa_family_t	family;
+	uint16_t	port;		/* Network byte order. */
+	uint8_t		grp[16];	/* Group address. */
+	uint8_t		src[16];	/* SSM source address. */
+	int		ssm;		/* src valid. */
+} str_src_ring_ent_t, *str_src_ring_ent_p;
+
+typedef struct str_src_ring_s {
+	TAILQ_ENTRY(str_src_ring_s) next;
+	str_hubs_bckt_p	shbskt;
+	pkt_ring_p	pkt_ring;
+	size_t		thread_num;
+	uint32_t	if_index;
+	size_t		hub_count;
+	str_src_ring_ent_p ht;		/* Open addressing, key: group + port. */
+	size_t		ht_mask;	/* Size - 1, size is power of 2. */
+	str_hub_p	*dirty;		/* Hubs with data in current blocks. */
+	size_t		dirty_count;
+} str_src_ring_t;
+TAILQ_HEAD(str_src_ring_head, str_src_ring_s);
+
+/* RTP ARQ RTCP socket, shared by thread hubs with same port. */
+typedef struct str_src_rtcp_s {
+	TAILQ_ENTRY(str_src_rtcp_s) next;
+	str_hubs_bckt_p	shbskt;
+	tp_task_p	tptask;
+	size_t		thread_num;
+	sa_family_t	family;
+	uint16_t	port;		/* Source port + 1. */
+	size_t		hub_count;
+} str_src_rtcp_t;
+TAILQ_HEAD(str_src_rtcp_head, str_src_rtcp_s);
+
 /* Per thread data */
 typedef struct str_hub_thread_data_s {
 	struct str_hub_head	hub_head;	/* List with stream hubs per thread. */
+	struct str_src_ring_head ring_head;	/* Packet ring receivers. */
+	struct str_src_rtcp_head rtcp_head;	/* RTP ARQ RTCP sockets. */
+	struct str_hub_neg_head	neg_head;	/* Negative cache, sorted by expire time. */
+	struct str_hub_neg_head	neg_hash[STR_HUB_NEG_HASH_SIZE]; /* Negative cache by name. */
+	size_t			neg_count;	/* Negative cache entries count. */
+	uint32_t		*tcp_info_budget; /* Per profile, current tick. */
+	size_t			tcp_info_budget_count;
+	udp_push_sender_p	push_sender;	/* Created by first push output. */
+	uint64_t		dropped_count;	/* Dropped clients, from start. */
 	str_hubs_stat_t		stat;
 } str_hub_thrd_t, *str_hub_thrd_p;
 
 
+/* Admission control. */
+typedef struct str_hubs_limits_s {
+	uint32_t	hub_cli_max;	/* Max clients per hub. */
+	uint32_t	hubs_max;	/* Max hubs per node. */
+	uint64_t	thread_rate_out_max; /* Max rate out per thread (megabit per sec). */
+	uint64_t	rate_out_max;	/* Max rate out per node (megabit per sec). */
+	uint32_t	retry_after;	/* Retry-After value for rejected, s. */
+} str_hubs_limits_t, *str_hubs_limits_p;
+/* Default values. */
+#define STR_HUBS_LIMITS_DEF_RETRY_AFTER	(10) /* s */
+/* Reject reasons. */
+#define STR_HUBS_REJ_R_NONE		0 /* Accepted. */
+#define STR_HUBS_REJ_R_HUB_CLI		1 /* Too many clients on hub. */
+#define STR_HUBS_REJ_R_HUBS		2 /* Too many hubs. */
+#define STR_HUBS_REJ_R_THREAD_RATE	3 /* Thread rate out limit. */
+#define STR_HUBS_REJ_R_RATE		4 /* Node rate out limit. */
+#define STR_HUBS_REJ_R_NEG_CACHE	5 /* Source recently had no data. */
+#define STR_HUBS_REJ_R__COUNT		6
+
+const char *str_hubs_reject_reason_str(uint32_t reason);
+
+
+/*
+ * All settings, replaced as whole on reload.
+ * Pointer is valid until callback return control to thread pool:
+ * old settings freed after all threads process reload message.
+ */
+typedef struct str_hubs_settings_s {
+	str_hub_prof_p	prof;		/* Profiles, first is default. */
+	size_t		prof_count;
+	str_hub_chan_p	chan;		/* Channel map, config order. */
+	size_t		chan_count;
+	size_t		*chan_hash;	/* Heads of hash chains. */
+	size_t		chan_hash_mask;
+	str_hubs_limits_t limits;	/* Admission control. */
+	size_t		retry_after_hdr_size;
+	uint8_t		retry_after_hdr[32]; /* "Retry-After: X", no CRLF. */
+} str_hubs_settings_t, *str_hubs_settings_p;
+
+
 typedef struct str_hubs_bckt_s {
 	tp_p		tp;
 	struct timespec	tp_last_tmr;	/* For baud rate calculation. */
@@ -192,25 +574,61 @@ typedef struct str_hubs_bckt_s {
 	str_hub_thrd_p	thr_data;	/* Per thread hubs + stat. */
 	size_t		base_http_hdrs_size;
 	uint8_t		base_http_hdrs[512];
-	str_hub_settings_t hub_params;	/* Settings. */
-	str_src_settings_t src_params;	/* Settings. */
+	_Atomic(str_hubs_settings_p) settings; /* Use STR_HUBS_BCKT_SETTINGS(). */
+	access_log_p	alog;		/* Access log, NULL = syslog. */
+	tshift_writer_p	tsw;		/* Time-shift writer, NULL = disabled. */
+	rec_writer_p	rw;		/* Recordings I/O thread, NULL = disabled. */
+	udp_push_settings_t push_settings; /* UDP push senders, no ENABLE flag = disabled. */
+	atomic_size_t	hub_count;	/* Stream hubs count, all threads. */
+	atomic_size_t	neg_count;	/* Negative cache entries, all threads. */
+	atomic_uint_fast64_t rejected_count[STR_HUBS_REJ_R__COUNT]; /* Rejected requests per reason. */
 } str_hubs_bckt_t;
 
+#define STR_HUBS_BCKT_SETTINGS(__shbskt)				\
+	atomic_load_explicit(&(__shbskt)->settings, memory_order_acquire)
+
 
 void	str_hub_settings_def(str_hub_settings_p p_ret);
 void	str_src_settings_def(str_src_settings_p p_ret);
+/* str_src_conn.c: source address parsers. */
 void	str_src_conn_def(str_src_conn_params_p src_conn_params);
+int	str_src_conn_addr_from_str(str_src_conn_params_p src_conn_params,
+	    const char *buf, size_t buf_size);
+int	str_src_conn_http_from_str(str_src_conn_params_p src_conn_params,
+	    const char *buf, size_t buf_size);
+int	str_src_conn_file_from_str(str_src_conn_params_p src_conn_params,
+	    const char *buf, size_t buf_size);
+void	str_hubs_limits_def(str_hubs_limits_p p_ret);
+str_hub_prof_p str_hubs_settings_prof_get(str_hubs_settings_p settings,
+	    const char *name, size_t name_size,
+	    const struct sockaddr_storage *addr);
+str_hub_chan_p str_hubs_settings_chan_get(str_hubs_settings_p settings,
+	    const uint8_t *name, size_t name_size);
+int	str_hub_name_make(str_src_conn_params_p src_conn_params,
+	    uint8_t *buf, size_t buf_size, size_t *buf_size_ret);
 
 
 int	str_hubs_bckt_create(tp_p tp, const char *app_ver,
-	    str_hub_settings_p hub_params, str_src_settings_p src_params,
+	    str_hub_prof_p prof, size_t prof_count,
+	    str_hub_chan_p chan, size_t chan_count,
+	    str_hubs_limits_p limits, access_log_p alog, tshift_writer_p tsw,
+	    rec_writer_p rw, udp_push_settings_p push_settings,
 	    str_hubs_bckt_p *shbskt_ret);
 void	str_hubs_bckt_destroy(str_hubs_bckt_p shbskt);
+int	str_hubs_bckt_reload(str_hubs_bckt_p shbskt,
+	    str_hub_prof_p prof, size_t prof_count,
+	    str_hub_chan_p chan, size_t chan_count, str_hubs_limits_p limits);
 
 typedef void (*str_hubs_bckt_enum_cb)(tpt_p tpt, str_hub_p str_hub, void *udata);
 int	str_hubs_bckt_enum(str_hubs_bckt_p shbskt, str_hubs_bckt_enum_cb enum_cb,
 	    void *udata, tpt_msg_done_cb done_cb);
 int	str_hubs_bckt_stat_summary(str_hubs_bckt_p shbskt, str_hubs_stat_p stat);
+uint32_t str_hubs_bckt_admit(str_hubs_bckt_p shbskt,
+	    const uint8_t *hub_name, size_t hub_name_size);
+int	str_hubs_bckt_link_state(str_hubs_bckt_p shbskt, uint32_t if_index,
+	    int up);
+
+int	str_src_conn_mc_join(uintptr_t skt, int join, str_src_conn_mc_p mc);
 
 
 str_hub_cli_p str_hub_cli_alloc(uintptr_t skt, const char *ua, size_t ua_size);
@@ -218,8 +636,50 @@ void	str_hub_cli_destroy(str_hub_p str_hub, str_hub_cli_p strh_cli);
 
 int	str_hub_cli_attach(str_hubs_bckt_p shbskt, str_hub_cli_p strh_cli,
 	    uint8_t *hub_name, size_t hub_name_size,
+	    const char *prof_name, size_t prof_name_size,
 	    str_src_conn_params_p src_conn_params);
 
+/*
+ * HLS: seq = 0 - playlist, reply later via http_srv_resume_responce(),
+ * cli buf must have hls_playlist_size_max() free space.
+ * Else segment: on success hub thread own cli socket, caller must
+ * detach it from http server.
+ */
+#define STR_HUB_HLS_PLAYLIST	((uint64_t)0)
+int	str_hub_hls_req(str_hubs_bckt_p shbskt, http_srv_cli_p cli,
+	    uint8_t *hub_name, size_t hub_name_size,
+	    const char *prof_name, size_t prof_name_size,
+	    str_src_conn_params_p src_conn_params, uint64_t seq);
+
+/*
+ * Start/stop hub recording, rec_name used for file names.
+ * cli: reply via http_srv_resume_responce(), NULL = no reply.
+ */
+int	str_hub_rec_ctl(str_hubs_bckt_p shbskt, http_srv_cli_p cli,
+	    int start, uint8_t *hub_name, size_t hub_name_size,
+	    const char *prof_name, size_t prof_name_size,
+	    str_src_conn_params_p src_conn_params,
+	    const char *rec_name, size_t rec_name_size);
+
+/*
+ * Add/remove hub UDP/RTP push output or multicast relay, stop match
+ * only destination address.
+ * cli: reply via http_srv_resume_responce(), NULL = no reply.
+ */
+int	str_hub_push_ctl(str_hubs_bckt_p shbskt, http_srv_cli_p cli,
+	    int start, uint8_t *hub_name, size_t hub_name_size,
+	    const char *prof_name, size_t prof_name_size,
+	    str_src_conn_params_p src_conn_params,
+	    udp_push_params_p push_params);
+
+/* Handoff: pass hubs and clients to other process. */
+int	str_hubs_bckt_handoff_send(str_hubs_bckt_p shbskt, uintptr_t skt,
+	    tpt_msg_done_cb done_cb, void *udata);
+int	str_hub_import(str_hubs_bckt_p shbskt,
+	    uint8_t *hub_name, size_t hub_name_size,
+	    const char *prof_name, size_t prof_name_size,
+	    str_src_conn_params_p src_conn_params, uintptr_t skt);
+
 
 
 #endif // __CORE_STREAM_SYS_H__
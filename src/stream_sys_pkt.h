@@ -0,0 +1,77 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+
+
+#ifndef __CORE_STREAM_SYS_PKT_H__
+#define __CORE_STREAM_SYS_PKT_H__
+
+#include <sys/types.h>
+#include <inttypes.h>
+
+#include "proto/rtp.h"
+#include "proto/mpeg2ts.h"
+
+
+/* Per packet receive path, inline: shared with microbenchmarks. */
+
+/* MPEG payload-type constants - adopted from VLC 0.8.6 */
+#define P_MPGA		0x0E /* MPEG audio */
+#define P_MPGV		0x20 /* MPEG video */
+
+/*
+ * Validate packet: plain MPEG2-TS or RTP with MPEG2-TS payload.
+ * Return payload size and offset, 0 = drop.
+ */
+static inline size_t
+str_src_pkt_payload(uint8_t *buf, size_t buf_size, size_t *off) {
+	size_t start_off = 0, end_off = 0;
+
+	if (MPEG2_TS_PKT_SIZE_MIN > buf_size)
+		return (0); /* Packet to small, drop. */
+	if (MPEG2_TS_HDR_IS_VALID((mpeg2_ts_hdr_p)buf)) { /* Test_ for RTP. */
+		/* Plain MPEG2-TS. */
+	} else if (0 == rtp_payload_get(buf, buf_size, &start_off, &end_off)) {
+		/* XXX skip payload bulk data. */
+		if (P_MPGA == ((rtp_hdr_p)buf)->pt ||
+		    P_MPGV == ((rtp_hdr_p)buf)->pt)
+			start_off += 4;
+		if ((start_off + end_off + MPEG2_TS_PKT_SIZE_MIN) > buf_size)
+			return (0); /* Packet to small, drop. */
+		buf_size -= (start_off + end_off);
+	} else {
+		return (0); /* Packet unknown, drop. */
+	}
+	(*off) = start_off;
+
+	return (buf_size);
+}
+
+
+#endif /* __CORE_STREAM_SYS_PKT_H__ */
@@ -0,0 +1,507 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <sys/stat.h> /* For mode constants */
+#include <fcntl.h> /* For O_* constants */
+
+#include <stdlib.h> /* malloc, exit */
+#include <stdio.h> /* snprintf */
+#include <unistd.h> /* close, write, sysconf */
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <string.h> /* bcopy, bzero, memcpy, memmove, memset, strerror... */
+#include <time.h>
+#include <errno.h>
+#include <syslog.h>
+
+#include "utils/macro.h"
+#include "proto/mpeg2ts.h"
+#include "wr_queue.h"
+#include "tshift.h"
+
+
+#define TSHIFT_PCR_NONE		((uint64_t)~0)
+
+typedef struct tshift_idx_s {
+	uint64_t	live_pos;	/* Hub stream pos of first byte. */
+	uint64_t	time;		/* Wall clock, ms. */
+	uint64_t	pcr;		/* First PCR in block, 27 MHz. */
+	size_t		size;
+} tshift_idx_t, *tshift_idx_p;
+
+typedef struct tshift_blk_s {
+	uint8_t		*data;
+	size_t		size;		/* 0 = free. */
+	uint64_t	num;		/* Block number, disk slot: num % blk_count. */
+} tshift_blk_t, *tshift_blk_p;
+
+typedef struct tshift_s {
+	wr_queue_t	q;		/* Blocks queue: hub thread -> writer. */
+	atomic_uint_fast64_t blk_written; /* Blocks before it are on disk. */
+	atomic_uint_fast64_t written_size;
+	atomic_uint_fast64_t dropped_size;
+	tshift_settings_t s;
+	size_t		seg_blk_count;	/* Blocks per segment file. */
+	uint64_t	blk_count;	/* Blocks in all segment files. */
+	uintptr_t	*fd;		/* Segment files. */
+	tshift_idx_p	idx;		/* Per disk slot. */
+	tshift_blk_p	blks;		/* Queue. */
+	uint64_t	blk_next;	/* Producer: next block number. */
+	uint64_t	blk_start;	/* Producer: filling block start, monotonic ms. */
+} tshift_t;
+
+typedef struct tshift_writer_s {
+	tshift_writer_settings_t s;
+	wr_thread_t	wt;		/* Writer thread. */
+	int		last_error;	/* Do not flood syslog. */
+} tshift_writer_t;
+
+
+static size_t	tshift_drain(wr_queue_p q, int dead, void *udata);
+static void	tshift_free_cb(wr_queue_p q, void *udata);
+static void	tshift_free(tshift_p ts);
+static int	tshift_seg_open(const char *dir, uintptr_t *fd_ret);
+static void	tshift_blk_commit(tshift_p ts, tshift_blk_p blk);
+static uint64_t	tshift_blk_oldest(tshift_p ts);
+static uint64_t	tshift_pcr_find(const uint8_t *buf, size_t buf_size);
+static inline void tshift_blk_loc(tshift_p ts, uint64_t num, uintptr_t *fd,
+		    off_t *off);
+
+
+
+void
+tshift_writer_settings_def(tshift_writer_settings_p p_ret) {
+
+	if (NULL == p_ret)
+		return;
+	memset(p_ret, 0x00, sizeof(tshift_writer_settings_t));
+	p_ret->flags = TSHIFT_W_S_DEF_FLAGS;
+	p_ret->write_interval = TSHIFT_W_S_DEF_WRITE_INTERVAL;
+	memcpy(p_ret->dir, TSHIFT_W_S_DEF_DIR, sizeof(TSHIFT_W_S_DEF_DIR));
+}
+
+int
+tshift_writer_create(tshift_writer_settings_p s, tshift_writer_p *tsw_ret) {
+	int error;
+	tshift_writer_p tsw;
+
+	if (NULL == s || NULL == tsw_ret || 0 == s->dir[0])
+		return (EINVAL);
+	tsw = calloc(1, sizeof(tshift_writer_t));
+	if (NULL == tsw)
+		return (ENOMEM);
+	memcpy(&tsw->s, s, sizeof(tshift_writer_settings_t));
+	if (0 == tsw->s.write_interval) {
+		tsw->s.write_interval = TSHIFT_W_S_DEF_WRITE_INTERVAL;
+	}
+	error = wr_thread_start(&tsw->wt, tsw->s.write_interval,
+	    WR_THREAD_F_SPIN, tshift_drain, tshift_free_cb, NULL, tsw);
+	if (0 != error) {
+		free(tsw);
+		return (error);
+	}
+
+	(*tsw_ret) = tsw;
+	return (0);
+}
+
+void
+tshift_writer_destroy(tshift_writer_p tsw) {
+
+	if (NULL == tsw)
+		return;
+	wr_thread_stop(&tsw->wt);
+	free(tsw);
+}
+
+
+void
+tshift_settings_def(tshift_settings_p p_ret) {
+
+	if (NULL == p_ret)
+		return;
+	memset(p_ret, 0x00, sizeof(tshift_settings_t));
+	p_ret->seg_size = TSHIFT_S_DEF_SEG_SIZE;
+	p_ret->seg_count = TSHIFT_S_DEF_SEG_COUNT;
+	p_ret->blk_size = TSHIFT_S_DEF_BLK_SIZE;
+	p_ret->queue_size = TSHIFT_S_DEF_QUEUE_SIZE;
+}
+
+int
+tshift_create(tshift_writer_p tsw, tshift_settings_p s, tshift_p *ts_ret) {
+	int error;
+	tshift_p ts;
+	size_t i, queue_size;
+
+	if (NULL == tsw || NULL == s || NULL == ts_ret)
+		return (EINVAL);
+	ts = calloc(1, sizeof(tshift_t));
+	if (NULL == ts)
+		return (ENOMEM);
+	memcpy(&ts->s, s, sizeof(tshift_settings_t));
+	/* Correct values. */
+	ts->s.blk_size = MAX(ts->s.blk_size, (TSHIFT_BLK_SIZE_MIN * 1024));
+	ts->s.seg_size = MAX(ts->s.seg_size, ts->s.blk_size);
+	ts->seg_blk_count = (ts->s.seg_size / ts->s.blk_size);
+	ts->s.seg_size = (ts->seg_blk_count * ts->s.blk_size);
+	queue_size = wr_queue_init(&ts->q, ts->s.queue_size, 2);
+	ts->s.queue_size = (uint32_t)queue_size;
+	/* Keep at least one segment readable while queue is full. */
+	ts->s.seg_count = MAX(ts->s.seg_count, (uint32_t)(2 +
+	    ((queue_size + ts->seg_blk_count - 1) / ts->seg_blk_count)));
+	ts->blk_count = ((uint64_t)ts->seg_blk_count * ts->s.seg_count);
+	atomic_init(&ts->blk_written, 0);
+	atomic_init(&ts->written_size, 0);
+	atomic_init(&ts->dropped_size, 0);
+
+	ts->fd = malloc((sizeof(uintptr_t) * ts->s.seg_count));
+	ts->idx = calloc((size_t)ts->blk_count, sizeof(tshift_idx_t));
+	ts->blks = calloc(queue_size, sizeof(tshift_blk_t));
+	if (NULL == ts->fd || NULL == ts->idx || NULL == ts->blks) {
+		error = ENOMEM;
+		goto err_out;
+	}
+	for (i = 0; i < ts->s.seg_count; i ++) {
+		ts->fd[i] = (uintptr_t)-1;
+	}
+	for (i = 0; i < queue_size; i ++) {
+		ts->blks[i].data = malloc(ts->s.blk_size);
+		if (NULL == ts->blks[i].data) {
+			error = ENOMEM;
+			goto err_out;
+		}
+	}
+	for (i = 0; i < ts->s.seg_count; i ++) {
+		error = tshift_seg_open(tsw->s.dir, &ts->fd[i]);
+		if (0 != error)
+			goto err_out;
+		if (0 != ftruncate((int)ts->fd[i], (off_t)ts->s.seg_size)) {
+			error = errno;
+			SYSLOG_ERR(LOG_ERR, error, "ftruncate().");
+			goto err_out;
+		}
+	}
+	wr_thread_add(&tsw->wt, &ts->q);
+
+	(*ts_ret) = ts;
+	return (0);
+
+err_out:
+	tshift_free(ts);
+	return (error);
+}
+
+void
+tshift_destroy(tshift_p ts) {
+
+	if (NULL == ts)
+		return;
+	wr_queue_dead_set(&ts->q);
+}
+
+static void
+tshift_free_cb(wr_queue_p q, void *udata __unused) {
+
+	tshift_free((tshift_p)q);
+}
+
+static void
+tshift_free(tshift_p ts) {
+	size_t i;
+
+	if (NULL == ts)
+		return;
+	if (NULL != ts->fd) {
+		for (i = 0; i < ts->s.seg_count; i ++) {
+			if ((uintptr_t)-1 == ts->fd[i])
+				continue;
+			close((int)ts->fd[i]);
+		}
+		free(ts->fd);
+	}
+	if (NULL != ts->blks) {
+		for (i = 0; i < ts->s.queue_size; i ++) {
+			free(ts->blks[i].data);
+		}
+		free(ts->blks);
+	}
+	free(ts->idx);
+	free(ts);
+}
+
+/* Segment file: not visible in dir, space freed on close. */
+static int
+tshift_seg_open(const char *dir, uintptr_t *fd_ret) {
+	int error, fd;
+	char file_name[1100];
+
+#ifdef O_TMPFILE
+	fd = open(dir, (O_TMPFILE | O_RDWR | O_CLOEXEC), 0600);
+	if (-1 != fd) {
+		(*fd_ret) = (uintptr_t)fd;
+		return (0);
+	}
+#endif
+	snprintf(file_name, sizeof(file_name), "%s/msd_tshift.XXXXXX", dir);
+	fd = mkstemp(file_name);
+	if (-1 == fd) {
+		error = errno;
+		SYSLOG_ERR(LOG_ERR, error, "mkstemp(%s).", file_name);
+		return (error);
+	}
+	unlink(file_name);
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	(*fd_ret) = (uintptr_t)fd;
+
+	return (0);
+}
+
+
+void
+tshift_write(tshift_p ts, const uint8_t *buf, size_t buf_size,
+    uint64_t live_pos, uint64_t time_ms) {
+	tshift_blk_p blk;
+	tshift_idx_p idx;
+	size_t wpos, tm;
+	struct timespec tp;
+
+	if (NULL == ts || NULL == buf)
+		return;
+	while (0 != buf_size) {
+		if (0 != wr_queue_wpos(&ts->q, &wpos)) { /* Writer too slow. */
+			atomic_fetch_add_explicit(&ts->dropped_size, buf_size,
+			    memory_order_relaxed);
+			return;
+		}
+		blk = &ts->blks[(wpos & ts->q.mask)];
+		if (0 != blk->size &&
+		    (ts->s.blk_size < (blk->size + buf_size) ||
+		    (ts->blk_start + TSHIFT_BLK_TIME_MAX) <= time_ms)) {
+			tshift_blk_commit(ts, blk);
+			continue;
+		}
+		idx = &ts->idx[(ts->blk_next % ts->blk_count)];
+		if (0 == blk->size) { /* Start new block. */
+			blk->num = ts->blk_next;
+			ts->blk_start = time_ms;
+			clock_gettime(CLOCK_REALTIME, &tp);
+			idx->live_pos = live_pos;
+			idx->time = (((uint64_t)tp.tv_sec * 1000) +
+			    ((uint64_t)tp.tv_nsec / 1000000));
+			idx->pcr = TSHIFT_PCR_NONE;
+			idx->size = 0;
+		}
+		/* Only for buf bigger than block: keep TS packets whole. */
+		tm = MIN(buf_size, (ts->s.blk_size -
+		    (ts->s.blk_size % MPEG2_TS_PKT_SIZE_188)));
+		memcpy((blk->data + blk->size), buf, tm);
+		if (TSHIFT_PCR_NONE == idx->pcr) {
+			idx->pcr = tshift_pcr_find(buf, tm);
+		}
+		blk->size += tm;
+		buf += tm;
+		buf_size -= tm;
+		live_pos += tm;
+	}
+}
+
+static void
+tshift_blk_commit(tshift_p ts, tshift_blk_p blk) {
+
+	ts->idx[(blk->num % ts->blk_count)].size = blk->size;
+	ts->blk_next ++;
+	wr_queue_commit(&ts->q);
+}
+
+/* Blocks from segment that writer may reuse soon are not readable. */
+static uint64_t
+tshift_blk_oldest(tshift_p ts) {
+	uint64_t end = (ts->blk_next + ts->s.queue_size + ts->seg_blk_count);
+
+	if (ts->blk_count >= end)
+		return (0);
+	return ((end - ts->blk_count));
+}
+
+static inline void
+tshift_blk_loc(tshift_p ts, uint64_t num, uintptr_t *fd, off_t *off) {
+	uint64_t slot = (num % ts->blk_count);
+
+	(*fd) = ts->fd[(slot / ts->seg_blk_count)];
+	(*off) = (off_t)((slot % ts->seg_blk_count) * ts->s.blk_size);
+}
+
+static uint64_t
+tshift_pcr_find(const uint8_t *buf, size_t buf_size) {
+	const uint8_t *pkt;
+	size_t off;
+
+	for (off = 0; (off + MPEG2_TS_PKT_SIZE_188) <= buf_size;
+	    off += MPEG2_TS_PKT_SIZE_188) {
+		pkt = (buf + off);
+		if (0x47 != pkt[0] ||
+		    0 == (0x20 & pkt[3]) || /* No adaptation field. */
+		    7 > pkt[4] || 0 == (0x10 & pkt[5])) /* No PCR. */
+			continue;
+		/* 33 bit base * 300 + 9 bit extension. */
+		return (((((uint64_t)pkt[6] << 25) | ((uint64_t)pkt[7] << 17) |
+		    ((uint64_t)pkt[8] << 9) | ((uint64_t)pkt[9] << 1) |
+		    ((uint64_t)pkt[10] >> 7)) * 300) +
+		    ((((uint64_t)pkt[10] & 0x01) << 8) | pkt[11]));
+	}
+	return (TSHIFT_PCR_NONE);
+}
+
+
+int
+tshift_seek(tshift_p ts, uint64_t time_ms, uint64_t *blk_ret) {
+	uint64_t lo, hi, mid;
+
+	if (NULL == ts || NULL == blk_ret)
+		return (EINVAL);
+	lo = tshift_blk_oldest(ts);
+	hi = atomic_load_explicit(&ts->blk_written, memory_order_acquire);
+	if (lo >= hi)
+		return (ENOENT);
+	/* Wall clock may step back: result is approximate then. */
+	while (lo < hi) {
+		mid = (lo + ((hi - lo) / 2));
+		if (ts->idx[(mid % ts->blk_count)].time < time_ms) {
+			lo = (mid + 1);
+		} else {
+			hi = mid;
+		}
+	}
+	(*blk_ret) = lo;
+
+	return (0);
+}
+
+int
+tshift_blk_get(tshift_p ts, uint64_t blk, uintptr_t *fd, off_t *off,
+    size_t *size, uint64_t *live_pos) {
+	tshift_idx_p idx;
+
+	if (NULL == ts || NULL == fd || NULL == off || NULL == size)
+		return (EINVAL);
+	if (blk >= atomic_load_explicit(&ts->blk_written, memory_order_acquire))
+		return (EAGAIN);
+	if (blk < tshift_blk_oldest(ts))
+		return (ENOENT);
+	idx = &ts->idx[(blk % ts->blk_count)];
+	tshift_blk_loc(ts, blk, fd, off);
+	(*size) = idx->size;
+	if (NULL != live_pos) {
+		(*live_pos) = idx->live_pos;
+	}
+
+	return (0);
+}
+
+void
+tshift_blk_prefetch(tshift_p ts, uint64_t blk) {
+	uintptr_t fd;
+	off_t off;
+
+	if (NULL == ts ||
+	    blk >= atomic_load_explicit(&ts->blk_written, memory_order_acquire))
+		return;
+	tshift_blk_loc(ts, blk, &fd, &off);
+	posix_fadvise((int)fd, off, (off_t)ts->s.blk_size, POSIX_FADV_WILLNEED);
+}
+
+int
+tshift_stat_get(tshift_p ts, tshift_stat_p stat) {
+	uint64_t first, last;
+	tshift_idx_p idx;
+
+	if (NULL == ts || NULL == stat)
+		return (EINVAL);
+	memset(stat, 0x00, sizeof(tshift_stat_t));
+	stat->written_size = atomic_load_explicit(&ts->written_size,
+	    memory_order_relaxed);
+	stat->dropped_size = atomic_load_explicit(&ts->dropped_size,
+	    memory_order_relaxed);
+	first = tshift_blk_oldest(ts);
+	last = atomic_load_explicit(&ts->blk_written, memory_order_acquire);
+	if (first >= last)
+		return (0);
+	idx = &ts->idx[(first % ts->blk_count)];
+	stat->time_first = idx->time;
+	stat->pcr_first = ((TSHIFT_PCR_NONE == idx->pcr) ? 0 : idx->pcr);
+	idx = &ts->idx[((last - 1) % ts->blk_count)];
+	stat->time_last = idx->time;
+	stat->pcr_last = ((TSHIFT_PCR_NONE == idx->pcr) ? 0 : idx->pcr);
+
+	return (0);
+}
+
+
+static size_t
+tshift_drain(wr_queue_p q, int dead, void *udata) {
+	tshift_writer_p tsw = udata;
+	tshift_p ts = (tshift_p)q;
+	tshift_blk_p blk;
+	size_t rpos, wpos, count = 0;
+	uintptr_t fd;
+	off_t off;
+	ssize_t ios;
+	int error;
+
+	if (0 != dead) /* Hub gone: nobody read it. */
+		return (0);
+	rpos = wr_queue_rpos(q, &wpos);
+	for (; rpos != wpos; rpos ++, count ++) {
+		blk = &ts->blks[(rpos & q->mask)];
+		tshift_blk_loc(ts, blk->num, &fd, &off);
+		ios = pwrite((int)fd, blk->data, blk->size, off);
+		if ((ssize_t)blk->size == ios) {
+			atomic_fetch_add_explicit(&ts->written_size, blk->size,
+			    memory_order_relaxed);
+			tsw->last_error = 0;
+		} else {
+			error = ((-1 == ios) ? errno : EIO);
+			if (tsw->last_error != error) {
+				tsw->last_error = error;
+				SYSLOG_ERR(LOG_ERR, error, "pwrite().");
+			}
+			atomic_fetch_add_explicit(&ts->dropped_size, blk->size,
+			    memory_order_relaxed);
+		}
+		atomic_store_explicit(&ts->blk_written, (blk->num + 1),
+		    memory_order_release);
+		blk->size = 0;
+		wr_queue_release(q, (rpos + 1));
+	}
+
+	return (count);
+}
@@ -0,0 +1,115 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+
+
+#ifndef __MSD_TSHIFT_H__
+#define __MSD_TSHIFT_H__
+
+#include <sys/types.h>
+#include <inttypes.h>
+
+
+/*
+ * Time-shift store: hub thread copy stream to fixed size blocks, writer
+ * thread write them to ring of fixed size segment files on disk.
+ * Each block is one index entry: wall clock time, first PCR, live pos.
+ * Block dropped (and counted) if writer queue is full, hub never block.
+ * tshift_* calls except tshift_writer_* only from hub thread.
+ */
+
+typedef struct tshift_writer_s	*tshift_writer_p;
+typedef struct tshift_s		*tshift_p;
+
+typedef struct tshift_writer_settings_s {
+	uint32_t	flags;
+	uint32_t	write_interval;	/* Writer wakeup interval if idle, ms. */
+	char		dir[1024];	/* Segment files, created unlinked. */
+} tshift_writer_settings_t, *tshift_writer_settings_p;
+/* Flags. */
+#define TSHIFT_W_S_F_ENABLE		(((uint32_t)1) << 0)
+/* Default values. */
+#define TSHIFT_W_S_DEF_FLAGS		(0)
+#define TSHIFT_W_S_DEF_WRITE_INTERVAL	(20) /* ms */
+#define TSHIFT_W_S_DEF_DIR		"/var/tmp"
+
+typedef struct tshift_settings_s {
+	size_t		seg_size;	/* Segment file size, bytes. */
+	uint32_t	seg_count;	/* Segment files. */
+	size_t		blk_size;	/* Write batch and index step, bytes. */
+	uint32_t	queue_size;	/* Blocks waiting for writer. */
+} tshift_settings_t, *tshift_settings_p;
+/* Default values. */
+#define TSHIFT_S_DEF_SEG_SIZE		(65536)	/* kb */
+#define TSHIFT_S_DEF_SEG_COUNT		(16)
+#define TSHIFT_S_DEF_BLK_SIZE		(256)	/* kb */
+#define TSHIFT_S_DEF_QUEUE_SIZE		(32)
+#define TSHIFT_BLK_SIZE_MIN		(64)	/* kb, max UDP GRO batch. */
+#define TSHIFT_BLK_TIME_MAX		(1000)	/* ms, commit not full block. */
+
+typedef struct tshift_stat_s {
+	uint64_t	time_first;	/* Wall clock, ms, oldest readable block. */
+	uint64_t	time_last;	/* Wall clock, ms, newest written block. */
+	uint64_t	pcr_first;	/* 27 MHz, 0 = no PCR. */
+	uint64_t	pcr_last;
+	uint64_t	written_size;	/* Bytes on disk. */
+	uint64_t	dropped_size;	/* Bytes lost: queue full or write error. */
+} tshift_stat_t, *tshift_stat_p;
+
+
+void	tshift_writer_settings_def(tshift_writer_settings_p p_ret);
+int	tshift_writer_create(tshift_writer_settings_p s,
+	    tshift_writer_p *tsw_ret);
+/* Call after all stores destroyed. */
+void	tshift_writer_destroy(tshift_writer_p tsw);
+
+void	tshift_settings_def(tshift_settings_p p_ret);
+int	tshift_create(tshift_writer_p tsw, tshift_settings_p s,
+	    tshift_p *ts_ret);
+/* Writer thread close files and free it. */
+void	tshift_destroy(tshift_p ts);
+
+/* live_pos: hub stream byte pos of buf, time_ms: monotonic arrival time. */
+void	tshift_write(tshift_p ts, const uint8_t *buf, size_t buf_size,
+	    uint64_t live_pos, uint64_t time_ms);
+
+/* First readable block with wall clock time >= time_ms, else oldest. */
+int	tshift_seek(tshift_p ts, uint64_t time_ms, uint64_t *blk_ret);
+/*
+ * Block location in segment file.
+ * EAGAIN: not on disk yet, ENOENT: overwritten.
+ */
+int	tshift_blk_get(tshift_p ts, uint64_t blk, uintptr_t *fd, off_t *off,
+	    size_t *size, uint64_t *live_pos);
+/* Hint kernel to read block from disk. */
+void	tshift_blk_prefetch(tshift_p ts, uint64_t blk);
+int	tshift_stat_get(tshift_p ts, tshift_stat_p stat);
+
+
+#endif /* __MSD_TSHIFT_H__ */
@@ -0,0 +1,544 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/udp.h> /* UDP_SEGMENT */
+
+#include <stdlib.h> /* malloc, exit */
+#include <unistd.h> /* close, write, sysconf */
+#include <inttypes.h>
+#include <string.h> /* bcopy, bzero, memcpy, memmove, memset, strerror... */
+#include <time.h>
+#include <errno.h>
+#include <syslog.h>
+
+#include "utils/macro.h"
+#include "udp_push.h"
+
+
+#define UDP_PUSH_BATCH_MSGS	256	/* Messages per sendmmsg(). */
+#define UDP_PUSH_BATCH_IOV	4096	/* iovecs per batch. */
+#define UDP_PUSH_BATCH_PKTS	1024	/* Datagrams (RTP headers) per batch. */
+#define UDP_PUSH_GSO_PKTS	32	/* Datagrams per GSO message, < 64 kb. */
+#define UDP_PUSH_RTP_HDR_SIZE	12
+#define UDP_PUSH_RTP_PT_MP2T	33	/* RFC 3551. */
+
+typedef struct udp_push_s {
+	udp_push_params_t p;
+	uintptr_t	skt;		/* Own socket, -1 = sender socket. */
+	uint16_t	rtp_seq;
+	uint32_t	rtp_ssrc;
+	udp_push_stat_t	stat;
+} udp_push_t;
+
+/* Queued message: one datagram or GSO train of one output. */
+typedef struct udp_push_msg_s {
+	udp_push_p	push;
+	size_t		pkt_count;
+	size_t		size;		/* Payload, without RTP headers. */
+} udp_push_msg_t, *udp_push_msg_p;
+
+typedef struct udp_push_sender_s {
+	udp_push_settings_t s;
+	uintptr_t	skt[2];		/* AF_INET, AF_INET6, -1 = not opened. */
+	int		gso;		/* UDP_SEGMENT usable. */
+	uintptr_t	skt_cur;	/* Of queued messages. */
+	size_t		msg_cnt;
+	size_t		iov_cnt;
+	size_t		pkt_cnt;
+	struct mmsghdr	msgs[UDP_PUSH_BATCH_MSGS];
+	udp_push_msg_t	minfo[UDP_PUSH_BATCH_MSGS];
+	struct iovec	iov[UDP_PUSH_BATCH_IOV];
+	uint8_t		rtp_hdr[UDP_PUSH_BATCH_PKTS][UDP_PUSH_RTP_HDR_SIZE];
+#ifdef UDP_SEGMENT
+	union {
+		struct cmsghdr	align;
+		uint8_t		buf[CMSG_SPACE(sizeof(uint16_t))];
+	} cmsg[UDP_PUSH_BATCH_MSGS];
+#endif
+} udp_push_sender_t;
+
+
+static int	udp_push_sender_skt_get(udp_push_sender_p sender,
+		    sa_family_t family, uintptr_t *skt_ret);
+static void	udp_push_sender_msg_done(udp_push_sender_p sender,
+		    size_t idx, int error);
+static void	udp_push_skt_opts(uintptr_t skt, sa_family_t family,
+		    udp_push_settings_p s);
+static int	udp_push_skt_create(udp_push_settings_p s, udp_push_p push);
+
+
+void
+udp_push_settings_def(udp_push_settings_p p_ret) {
+
+	if (NULL == p_ret)
+		return;
+	memset(p_ret, 0x00, sizeof(udp_push_settings_t));
+	p_ret->flags = UDP_PUSH_S_DEF_FLAGS;
+	p_ret->skt_snd_buf = UDP_PUSH_S_DEF_SKT_SND_BUF;
+	p_ret->ttl = UDP_PUSH_S_DEF_TTL;
+	p_ret->tos = UDP_PUSH_S_DEF_TOS;
+	p_ret->burst = UDP_PUSH_S_DEF_BURST;
+}
+
+
+int
+udp_push_sender_create(udp_push_settings_p s, udp_push_sender_p *sender_ret) {
+	udp_push_sender_p sender;
+
+	if (NULL == s || NULL == sender_ret)
+		return (EINVAL);
+	sender = calloc(1, sizeof(udp_push_sender_t));
+	if (NULL == sender)
+		return (ENOMEM);
+	memcpy(&sender->s, s, sizeof(udp_push_settings_t));
+	sender->s.burst = MAX(1, sender->s.burst);
+	sender->skt[0] = (uintptr_t)-1;
+	sender->skt[1] = (uintptr_t)-1;
+#ifdef UDP_SEGMENT
+	sender->gso = (0 != (UDP_PUSH_S_F_GSO & s->flags));
+#endif
+	(*sender_ret) = sender;
+
+	return (0);
+}
+
+void
+udp_push_sender_destroy(udp_push_sender_p sender) {
+	size_t i;
+
+	if (NULL == sender)
+		return;
+	for (i = 0; i < 2; i ++) {
+		if ((uintptr_t)-1 != sender->skt[i]) {
+			close((int)sender->skt[i]);
+		}
+	}
+	free(sender);
+}
+
+static int
+udp_push_sender_skt_get(udp_push_sender_p sender, sa_family_t family,
+    uintptr_t *skt_ret) {
+	size_t idx = ((AF_INET6 == family) ? 1 : 0);
+	uintptr_t skt;
+
+	if ((uintptr_t)-1 != sender->skt[idx]) {
+		(*skt_ret) = sender->skt[idx];
+		return (0);
+	}
+	skt = (uintptr_t)socket(family, (SOCK_DGRAM | SOCK_CLOEXEC),
+	    IPPROTO_UDP);
+	if ((uintptr_t)-1 == skt)
+		return (errno);
+	udp_push_skt_opts(skt, family, &sender->s);
+	sender->skt[idx] = skt;
+	(*skt_ret) = skt;
+
+	return (0);
+}
+
+/* Send buf, unicast TTL and TOS from settings, errors not fatal. */
+static void
+udp_push_skt_opts(uintptr_t skt, sa_family_t family, udp_push_settings_p s) {
+	int error, ival;
+
+	ival = (int)(s->skt_snd_buf * 1024);
+	if (0 != ival &&
+	    0 != setsockopt((int)skt, SOL_SOCKET, SO_SNDBUF, &ival,
+	    sizeof(ival))) {
+		error = errno;
+		SYSLOG_ERR(LOG_NOTICE, error, "setsockopt(SO_SNDBUF), not set.");
+	}
+	ival = (int)s->ttl;
+	if (0 != ival &&
+	    0 != setsockopt((int)skt,
+	    ((AF_INET6 == family) ? IPPROTO_IPV6 : IPPROTO_IP),
+	    ((AF_INET6 == family) ? IPV6_UNICAST_HOPS : IP_TTL),
+	    &ival, sizeof(ival))) {
+		error = errno;
+		SYSLOG_ERR(LOG_NOTICE, error, "setsockopt(TTL), not set.");
+	}
+	ival = (int)s->tos;
+	if (0 != ival &&
+	    0 != setsockopt((int)skt,
+	    ((AF_INET6 == family) ? IPPROTO_IPV6 : IPPROTO_IP),
+	    ((AF_INET6 == family) ? IPV6_TCLASS : IP_TOS),
+	    &ival, sizeof(ival))) {
+		error = errno;
+		SYSLOG_ERR(LOG_NOTICE, error, "setsockopt(TOS), not set.");
+	}
+}
+
+
+void
+udp_push_sender_add(udp_push_sender_p sender, udp_push_p push,
+    const struct iovec *iov, size_t iov_cnt, size_t size) {
+	int error;
+	size_t i, j, off, pkt_cnt, gso_pkts, piece, need;
+	uintptr_t skt;
+	uint32_t rtp_ts;
+	uint8_t *hdr;
+	struct timespec tp;
+	struct mmsghdr *msg;
+	udp_push_msg_p minfo;
+	socklen_t addrlen;
+#ifdef UDP_SEGMENT
+	struct cmsghdr *cmsg;
+#endif
+
+	if (NULL == sender || NULL == push || NULL == iov)
+		return;
+	size -= (size % UDP_PUSH_PKT_SIZE);
+	if (0 == size)
+		return;
+	if ((uintptr_t)-1 != push->skt) {
+		skt = push->skt;
+	} else {
+		error = udp_push_sender_skt_get(sender,
+		    push->p.addr.ss_family, &skt);
+		if (0 != error) {
+			push->stat.dropped_size += size;
+			push->stat.err_count ++;
+			push->stat.last_error = error;
+			return;
+		}
+	}
+	if (0 != sender->msg_cnt && sender->skt_cur != skt) {
+		udp_push_sender_flush(sender);
+	}
+	sender->skt_cur = skt;
+	addrlen = ((AF_INET6 == push->p.addr.ss_family) ?
+	    sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in));
+	/* Paced: kernel pace skb, GSO train go as one burst. */
+	gso_pkts = ((0 != sender->gso && 0 == push->p.pacing_rate) ?
+	    UDP_PUSH_GSO_PKTS : 1);
+	if (0 != (UDP_PUSH_F_RTP & push->p.flags)) {
+		/* 90 kHz clock, same for all datagrams of one add. */
+		clock_gettime(CLOCK_MONOTONIC_FAST, &tp);
+		rtp_ts = (uint32_t)(((uint64_t)tp.tv_sec * 90000) +
+		    ((uint64_t)tp.tv_nsec / 11111));
+	} else {
+		rtp_ts = 0;
+	}
+
+	i = 0;
+	off = 0;
+	while (0 != size) {
+		/* Worst case for one message: each datagram split + header. */
+		pkt_cnt = MIN(gso_pkts, (size / UDP_PUSH_PKT_SIZE));
+		need = (pkt_cnt * (iov_cnt + 1));
+		if (UDP_PUSH_BATCH_MSGS == sender->msg_cnt ||
+		    UDP_PUSH_BATCH_IOV < (sender->iov_cnt + need) ||
+		    UDP_PUSH_BATCH_PKTS < (sender->pkt_cnt + pkt_cnt)) {
+			udp_push_sender_flush(sender);
+			sender->skt_cur = skt;
+		}
+		msg = &sender->msgs[sender->msg_cnt];
+		minfo = &sender->minfo[sender->msg_cnt];
+		memset(msg, 0x00, sizeof(struct mmsghdr));
+		msg->msg_hdr.msg_name = &push->p.addr;
+		msg->msg_hdr.msg_namelen = addrlen;
+		msg->msg_hdr.msg_iov = &sender->iov[sender->iov_cnt];
+		minfo->push = push;
+		minfo->pkt_count = pkt_cnt;
+		minfo->size = (pkt_cnt * UDP_PUSH_PKT_SIZE);
+		for (j = 0; j < pkt_cnt; j ++) {
+			if (0 != (UDP_PUSH_F_RTP & push->p.flags)) {
+				hdr = sender->rtp_hdr[sender->pkt_cnt];
+				hdr[0] = 0x80; /* V = 2. */
+				hdr[1] = UDP_PUSH_RTP_PT_MP2T;
+				hdr[2] = (uint8_t)(push->rtp_seq >> 8);
+				hdr[3] = (uint8_t)push->rtp_seq;
+				hdr[4] = (uint8_t)(rtp_ts >> 24);
+				hdr[5] = (uint8_t)(rtp_ts >> 16);
+				hdr[6] = (uint8_t)(rtp_ts >> 8);
+				hdr[7] = (uint8_t)rtp_ts;
+				hdr[8] = (uint8_t)(push->rtp_ssrc >> 24);
+				hdr[9] = (uint8_t)(push->rtp_ssrc >> 16);
+				hdr[10] = (uint8_t)(push->rtp_ssrc >> 8);
+				hdr[11] = (uint8_t)push->rtp_ssrc;
+				push->rtp_seq ++;
+				sender->iov[sender->iov_cnt].iov_base = hdr;
+				sender->iov[sender->iov_cnt].iov_len = UDP_PUSH_RTP_HDR_SIZE;
+				sender->iov_cnt ++;
+			}
+			sender->pkt_cnt ++;
+			/* Payload: may cross ring buf wrap. */
+			for (need = UDP_PUSH_PKT_SIZE; 0 != need;) {
+				piece = MIN(need, (iov[i].iov_len - off));
+				sender->iov[sender->iov_cnt].iov_base =
+				    (((uint8_t*)iov[i].iov_base) + off);
+				sender->iov[sender->iov_cnt].iov_len = piece;
+				sender->iov_cnt ++;
+				need -= piece;
+				off += piece;
+				if (off == iov[i].iov_len) {
+					i ++;
+					off = 0;
+				}
+			}
+		}
+		msg->msg_hdr.msg_iovlen = (size_t)(&sender->iov[sender->iov_cnt] -
+		    msg->msg_hdr.msg_iov);
+#ifdef UDP_SEGMENT
+		if (1 < pkt_cnt) { /* Kernel cut train to datagrams. */
+			msg->msg_hdr.msg_control = sender->cmsg[sender->msg_cnt].buf;
+			msg->msg_hdr.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+			cmsg = CMSG_FIRSTHDR(&msg->msg_hdr);
+			cmsg->cmsg_level = SOL_UDP;
+			cmsg->cmsg_type = UDP_SEGMENT;
+			cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+			*((uint16_t*)(void*)CMSG_DATA(cmsg)) = (uint16_t)
+			    (UDP_PUSH_PKT_SIZE +
+			    ((0 != (UDP_PUSH_F_RTP & push->p.flags)) ?
+			    UDP_PUSH_RTP_HDR_SIZE : 0));
+		}
+#endif
+		sender->msg_cnt ++;
+		size -= minfo->size;
+	}
+}
+
+void
+udp_push_sender_flush(udp_push_sender_p sender) {
+	int error;
+	ssize_t ios;
+	size_t i, off;
+
+	if (NULL == sender || 0 == sender->msg_cnt)
+		return;
+	for (off = 0; off < sender->msg_cnt;) {
+		ios = sendmmsg((int)sender->skt_cur, &sender->msgs[off],
+		    (unsigned int)(sender->msg_cnt - off), MSG_DONTWAIT);
+		if (-1 == ios) { /* First message failed. */
+			error = errno;
+			if (EINTR == error)
+				continue;
+#ifdef UDP_SEGMENT
+			if (EIO == error && 0 != sender->gso &&
+			    1 < sender->minfo[off].pkt_count) {
+				/* No checksum offload on route: no GSO. */
+				sender->gso = 0;
+				syslog(LOG_NOTICE, "UDP push: UDP_SEGMENT send failed, GSO disabled.");
+			}
+#endif
+			if (EAGAIN == error || EWOULDBLOCK == error ||
+			    ENOBUFS == error) { /* Send buf full: drop rest. */
+				for (; off < sender->msg_cnt; off ++) {
+					udp_push_sender_msg_done(sender, off,
+					    error);
+				}
+				break;
+			}
+			udp_push_sender_msg_done(sender, off, error);
+			off ++;
+			continue;
+		}
+		for (i = 0; i < (size_t)ios; i ++, off ++) {
+			udp_push_sender_msg_done(sender, off, 0);
+		}
+	}
+	sender->msg_cnt = 0;
+	sender->iov_cnt = 0;
+	sender->pkt_cnt = 0;
+}
+
+static void
+udp_push_sender_msg_done(udp_push_sender_p sender, size_t idx, int error) {
+	udp_push_msg_p minfo = &sender->minfo[idx];
+	udp_push_p push = minfo->push;
+
+	if (0 != error) {
+		push->stat.dropped_size += minfo->size;
+		push->stat.err_count ++;
+		push->stat.last_error = error;
+		return;
+	}
+	push->stat.pkt_count += minfo->pkt_count;
+	push->stat.sended_size += minfo->size;
+	push->stat.last_error = 0;
+}
+
+
+int
+udp_push_create(udp_push_settings_p s, udp_push_params_p params,
+    udp_push_p *push_ret) {
+	int error;
+	udp_push_p push;
+	struct timespec tp;
+
+	if (NULL == s || NULL == params || NULL == push_ret)
+		return (EINVAL);
+	if (AF_INET != params->addr.ss_family &&
+	    AF_INET6 != params->addr.ss_family)
+		return (EAFNOSUPPORT);
+	push = calloc(1, sizeof(udp_push_t));
+	if (NULL == push)
+		return (ENOMEM);
+	memcpy(&push->p, params, sizeof(udp_push_params_t));
+	push->skt = (uintptr_t)-1;
+	if ((AF_INET == params->addr.ss_family &&
+	    IN_MULTICAST(ntohl(((const struct sockaddr_in*)(const void*)
+	    &params->addr)->sin_addr.s_addr))) ||
+	    (AF_INET6 == params->addr.ss_family &&
+	    IN6_IS_ADDR_MULTICAST(&((const struct sockaddr_in6*)(const void*)
+	    &params->addr)->sin6_addr)) ||
+	    0 != params->pacing_rate) {
+		error = udp_push_skt_create(s, push);
+		if (0 != error) {
+			free(push);
+			return (error);
+		}
+	}
+	/* RFC 3550: random start values. */
+	clock_gettime(CLOCK_REALTIME, &tp);
+	push->rtp_ssrc = (uint32_t)(((uint64_t)tp.tv_nsec * 2654435761ULL) ^
+	    (uint64_t)tp.tv_sec ^ (uintptr_t)push);
+	push->rtp_seq = (uint16_t)(push->rtp_ssrc >> 7);
+	(*push_ret) = push;
+
+	return (0);
+}
+
+/* Own socket: multicast relay out interface, TTL, pacing. */
+static int
+udp_push_skt_create(udp_push_settings_p s, udp_push_p push) {
+	int error, ival;
+	uint8_t cval;
+	uintptr_t skt;
+	sa_family_t family = push->p.addr.ss_family;
+#ifdef SO_MAX_PACING_RATE
+	unsigned int pacing_rate;
+#endif
+	struct ip_mreqn mreqn;
+
+	skt = (uintptr_t)socket(family, (SOCK_DGRAM | SOCK_CLOEXEC),
+	    IPPROTO_UDP);
+	if ((uintptr_t)-1 == skt)
+		return (errno);
+	/* Same as shared sender sockets, multicast TTL set below. */
+	udp_push_skt_opts(skt, family, s);
+	if (AF_INET == family) {
+		if (0 != push->p.if_index) {
+			memset(&mreqn, 0x00, sizeof(mreqn));
+			mreqn.imr_ifindex = (int)push->p.if_index;
+			if (0 != setsockopt((int)skt, IPPROTO_IP,
+			    IP_MULTICAST_IF, &mreqn, sizeof(mreqn)))
+				goto err_out;
+		}
+		cval = (uint8_t)MAX(1, MIN(255, push->p.ttl));
+		if (0 != setsockopt((int)skt, IPPROTO_IP, IP_MULTICAST_TTL,
+		    &cval, sizeof(cval)))
+			goto err_out;
+		cval = 0;
+		if (0 != setsockopt((int)skt, IPPROTO_IP, IP_MULTICAST_LOOP,
+		    &cval, sizeof(cval)))
+			goto err_out;
+	} else {
+		if (0 != push->p.if_index) {
+			ival = (int)push->p.if_index;
+			if (0 != setsockopt((int)skt, IPPROTO_IPV6,
+			    IPV6_MULTICAST_IF, &ival, sizeof(ival)))
+				goto err_out;
+		}
+		ival = (int)MAX(1, MIN(255, push->p.ttl));
+		if (0 != setsockopt((int)skt, IPPROTO_IPV6,
+		    IPV6_MULTICAST_HOPS, &ival, sizeof(ival)))
+			goto err_out;
+		ival = 0;
+		if (0 != setsockopt((int)skt, IPPROTO_IPV6,
+		    IPV6_MULTICAST_LOOP, &ival, sizeof(ival)))
+			goto err_out;
+	}
+	if (0 != push->p.pacing_rate) {
+#ifdef SO_MAX_PACING_RATE
+		pacing_rate = (push->p.pacing_rate * 125); /* kbit/s -> bytes/s */
+		if (0 != setsockopt((int)skt, SOL_SOCKET, SO_MAX_PACING_RATE,
+		    &pacing_rate, sizeof(pacing_rate))) {
+			error = errno;
+			SYSLOG_ERR(LOG_NOTICE, error,
+			    "setsockopt(SO_MAX_PACING_RATE), not set.");
+		}
+#else
+		syslog(LOG_NOTICE, "UDP push: pacing not supported by OS.");
+#endif
+	}
+	push->skt = skt;
+
+	return (0);
+
+err_out:
+	error = errno;
+	close((int)skt);
+	return (error);
+}
+
+void
+udp_push_destroy(udp_push_p push) {
+
+	if (NULL == push)
+		return;
+	if ((uintptr_t)-1 != push->skt) {
+		close((int)push->skt);
+	}
+	free(push);
+}
+
+const udp_push_params_t *
+udp_push_params_get(udp_push_p push) {
+
+	if (NULL == push)
+		return (NULL);
+	return (&push->p);
+}
+
+void
+udp_push_drop(udp_push_p push, size_t size) {
+
+	if (NULL == push)
+		return;
+	push->stat.dropped_size += size;
+}
+
+int
+udp_push_stat_get(udp_push_p push, udp_push_stat_p stat) {
+
+	if (NULL == push || NULL == stat)
+		return (EINVAL);
+	memcpy(stat, &push->stat, sizeof(udp_push_stat_t));
+
+	return (0);
+}
@@ -0,0 +1,120 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+
+
+
+#ifndef __MSD_UDP_PUSH_H__
+#define __MSD_UDP_PUSH_H__
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <inttypes.h>
+
+
+/*
+ * UDP/RTP push: hub data cut to UDP_PUSH_PKT_SIZE datagrams,
+ * optional RTP header generated per datagram.
+ * Unicast outputs share per thread sender socket (one per address
+ * family), multicast relay and paced outputs own socket: out interface,
+ * TTL and SO_MAX_PACING_RATE are per socket.
+ * Sender batch messages of many outputs to few sendmmsg() calls, with
+ * UDP GSO one message carry many datagrams of one output.
+ * Data is not copied: iovecs point to hub ring buf until flush.
+ * All calls only from one (hub) thread.
+ */
+
+typedef struct udp_push_sender_s	*udp_push_sender_p;
+typedef struct udp_push_s		*udp_push_p;
+
+typedef struct udp_push_settings_s {
+	uint32_t	flags;
+	uint32_t	skt_snd_buf;	/* Sender sockets send buf size, kb. */
+	uint32_t	ttl;		/* IP_TTL / IPV6_UNICAST_HOPS, 0 = OS default. */
+	uint32_t	tos;		/* IP_TOS / IPV6_TCLASS, 0 = OS default. */
+	uint32_t	burst;		/* Max datagrams per output per flush. */
+} udp_push_settings_t, *udp_push_settings_p;
+/* Flags. */
+#define UDP_PUSH_S_F_ENABLE		(((uint32_t)1) << 0)
+#define UDP_PUSH_S_F_GSO		(((uint32_t)1) << 1) /* Linux: UDP_SEGMENT. */
+/* Default values. */
+#define UDP_PUSH_S_DEF_FLAGS		(UDP_PUSH_S_F_GSO)
+#define UDP_PUSH_S_DEF_SKT_SND_BUF	(1024)	/* kb */
+#define UDP_PUSH_S_DEF_TTL		(0)
+#define UDP_PUSH_S_DEF_TOS		(0)
+#define UDP_PUSH_S_DEF_BURST		(256)
+
+#define UDP_PUSH_PKT_SIZE		(7 * 188) /* Datagram payload. */
+
+typedef struct udp_push_params_s {
+	struct sockaddr_storage	addr;	/* Destination: unicast or multicast. */
+	uint32_t	flags;
+	uint32_t	if_index;	/* Multicast out interface, 0 = OS default. */
+	uint32_t	ttl;		/* Multicast TTL / hops, 0 = 1. */
+	uint32_t	pacing_rate;	/* kbit/s, Linux: need fq qdisc, 0 = off. */
+} udp_push_params_t, *udp_push_params_p;
+/* Flags. */
+#define UDP_PUSH_F_RTP			(((uint32_t)1) << 0) /* Add RTP header. */
+
+typedef struct udp_push_stat_s {
+	uint64_t	pkt_count;	/* Datagrams sended. */
+	uint64_t	sended_size;	/* Payload bytes sended. */
+	uint64_t	dropped_size;	/* Payload bytes lost: overrun or send error. */
+	uint64_t	err_count;	/* Send errors. */
+	int		last_error;
+} udp_push_stat_t, *udp_push_stat_p;
+
+
+void	udp_push_settings_def(udp_push_settings_p p_ret);
+
+int	udp_push_sender_create(udp_push_settings_p s,
+	    udp_push_sender_p *sender_ret);
+void	udp_push_sender_destroy(udp_push_sender_p sender);
+/*
+ * Queue iov data for output, size multiple of UDP_PUSH_PKT_SIZE.
+ * Flush by self if batch is full, so data must stay valid until
+ * udp_push_sender_flush().
+ */
+void	udp_push_sender_add(udp_push_sender_p sender, udp_push_p push,
+	    const struct iovec *iov, size_t iov_cnt, size_t size);
+/* Send all queued, errors counted per output. */
+void	udp_push_sender_flush(udp_push_sender_p sender);
+
+/* s: sender settings, applied to output own socket. */
+int	udp_push_create(udp_push_settings_p s, udp_push_params_p params,
+	    udp_push_p *push_ret);
+/* Sender must be flushed before. */
+void	udp_push_destroy(udp_push_p push);
+const udp_push_params_t *udp_push_params_get(udp_push_p push);
+void	udp_push_drop(udp_push_p push, size_t size);
+int	udp_push_stat_get(udp_push_p push, udp_push_stat_p stat);
+
+
+#endif /* __MSD_UDP_PUSH_H__ */
@@ -0,0 +1,174 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+
+#include <sys/param.h>
+#include <sys/types.h>
+
+#include <stdlib.h> /* malloc, exit */
+#include <pthread.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <string.h> /* bcopy, bzero, memcpy, memmove, memset, strerror... */
+#include <time.h>
+#include <errno.h>
+#include <syslog.h>
+
+#include "utils/macro.h"
+#include "wr_queue.h"
+
+
+static void	*wr_thread_proc(void *arg);
+static size_t	wr_thread_drain(wr_thread_p wt);
+
+
+
+size_t
+wr_queue_init(wr_queue_p q, size_t size, size_t size_min) {
+	size_t qsize;
+
+	for (qsize = size_min; qsize < size; qsize <<= 1)
+		;
+	memset(q, 0x00, sizeof(wr_queue_t));
+	atomic_init(&q->wpos, 0);
+	atomic_init(&q->rpos, 0);
+	atomic_init(&q->dead, 0);
+	q->size = qsize;
+	q->mask = (qsize - 1);
+
+	return (qsize);
+}
+
+
+int
+wr_thread_start(wr_thread_p wt, uint32_t interval, uint32_t flags,
+    wr_thread_drain_cb drain_cb, wr_thread_free_cb free_cb,
+    wr_thread_pass_cb pass_cb, void *udata) {
+	int error;
+
+	if (NULL == wt || NULL == drain_cb)
+		return (EINVAL);
+	wt->interval.tv_sec = (interval / 1000);
+	wt->interval.tv_nsec = ((interval % 1000) * 1000000);
+	wt->flags = flags;
+	wt->drain_cb = drain_cb;
+	wt->free_cb = free_cb;
+	wt->pass_cb = pass_cb;
+	wt->udata = udata;
+	wt->head = NULL;
+	atomic_init(&wt->add_head, NULL);
+	atomic_init(&wt->running, 1);
+	error = pthread_create(&wt->pt_id, NULL, wr_thread_proc, wt);
+	if (0 != error) {
+		SYSLOG_ERR(LOG_ERR, error, "pthread_create().");
+		return (error);
+	}
+
+	return (0);
+}
+
+void
+wr_thread_stop(wr_thread_p wt) {
+	wr_queue_p q;
+
+	if (NULL == wt)
+		return;
+	atomic_store_explicit(&wt->running, 0, memory_order_release);
+	pthread_join(wt->pt_id, NULL);
+	/* Writer take all new queues on last drain. */
+	while (NULL != wt->head) {
+		q = wt->head;
+		wt->head = q->next;
+		if (NULL != wt->free_cb) {
+			wt->free_cb(q, wt->udata);
+		}
+	}
+}
+
+void
+wr_thread_add(wr_thread_p wt, wr_queue_p q) {
+
+	q->next = atomic_load_explicit(&wt->add_head, memory_order_relaxed);
+	while (0 == atomic_compare_exchange_weak_explicit(&wt->add_head,
+	    &q->next, q, memory_order_release, memory_order_relaxed))
+		;
+}
+
+
+static void *
+wr_thread_proc(void *arg) {
+	wr_thread_p wt = arg;
+
+	while (0 != atomic_load_explicit(&wt->running, memory_order_acquire)) {
+		if (0 != wr_thread_drain(wt) &&
+		    0 != (WR_THREAD_F_SPIN & wt->flags))
+			continue;
+		nanosleep(&wt->interval, NULL);
+	}
+	/* Last data. */
+	wr_thread_drain(wt);
+
+	return (NULL);
+}
+
+static size_t
+wr_thread_drain(wr_thread_p wt) {
+	wr_queue_p q, q_next, *pq;
+	size_t count = 0;
+	int dead;
+
+	/* Take new queues. */
+	q = atomic_exchange_explicit(&wt->add_head, NULL,
+	    memory_order_acquire);
+	while (NULL != q) {
+		q_next = q->next;
+		q->next = wt->head;
+		wt->head = q;
+		q = q_next;
+	}
+	pq = &wt->head;
+	while (NULL != (q = (*pq))) {
+		/* Before drain: see last slot committed before dead set. */
+		dead = atomic_load_explicit(&q->dead, memory_order_acquire);
+		count += wt->drain_cb(q, dead, wt->udata);
+		if (0 != dead) {
+			(*pq) = q->next;
+			if (NULL != wt->free_cb) {
+				wt->free_cb(q, wt->udata);
+			}
+			continue;
+		}
+		pq = &q->next;
+	}
+	if (NULL != wt->pass_cb) {
+		wt->pass_cb(wt->udata);
+	}
+
+	return (count);
+}
@@ -0,0 +1,152 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+
+#ifndef __MSD_WR_QUEUE_H__
+#define __MSD_WR_QUEUE_H__
+
+#include <sys/types.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <errno.h>
+
+
+/*
+ * Single producer / single consumer queue and writer thread, shared by
+ * access log, time-shift and recording.
+ * Producer (hub thread) fill slot at wpos and commit it, consumer
+ * (writer thread) process slots up to wpos and release them.
+ * Slots storage is owned by user, wr_queue_t must be first member of
+ * user struct: callbacks cast queue to it.
+ */
+
+#define WR_QUEUE_CACHE_LINE	64
+
+typedef struct wr_queue_s {
+	atomic_size_t	wpos;		/* Producer: committed slots. */
+	uint8_t		pad0[(WR_QUEUE_CACHE_LINE - sizeof(atomic_size_t))];
+	atomic_size_t	rpos;		/* Consumer: released slots. */
+	uint8_t		pad1[(WR_QUEUE_CACHE_LINE - sizeof(atomic_size_t))];
+	atomic_int	dead;		/* Producer gone, writer free it. */
+	struct wr_queue_s *next;	/* Writer list. */
+	size_t		size;		/* Slots count, power of 2. */
+	size_t		mask;		/* size - 1. */
+} wr_queue_t, *wr_queue_p;
+
+/* Writer thread: return processed slots count. */
+typedef size_t (*wr_thread_drain_cb)(wr_queue_p q, int dead, void *udata);
+/* Dead queue removed from writer list. */
+typedef void (*wr_thread_free_cb)(wr_queue_p q, void *udata);
+/* After all queues drained. */
+typedef void (*wr_thread_pass_cb)(void *udata);
+
+typedef struct wr_thread_s {
+	pthread_t	pt_id;
+	atomic_int	running;
+	_Atomic(wr_queue_p) add_head;	/* New queues, lock free push. */
+	wr_queue_p	head;		/* Writer thread owned list. */
+	struct timespec	interval;	/* Sleep if idle. */
+	uint32_t	flags;		/* WR_THREAD_F_*. */
+	wr_thread_drain_cb drain_cb;
+	wr_thread_free_cb free_cb;	/* May be NULL. */
+	wr_thread_pass_cb pass_cb;	/* May be NULL. */
+	void		*udata;
+} wr_thread_t, *wr_thread_p;
+/* Flags. */
+#define WR_THREAD_F_SPIN	(((uint32_t)1) << 0) /* No sleep while got data. */
+
+
+/* Return size rounded up to power of 2, at least size_min. */
+size_t	wr_queue_init(wr_queue_p q, size_t size, size_t size_min);
+
+/* Producer: slot to fill, ENOBUFS if queue full. */
+static inline int
+wr_queue_wpos(wr_queue_p q, size_t *wpos) {
+	size_t rpos;
+
+	(*wpos) = atomic_load_explicit(&q->wpos, memory_order_relaxed);
+	rpos = atomic_load_explicit(&q->rpos, memory_order_acquire);
+	if (q->size <= ((*wpos) - rpos))
+		return (ENOBUFS);
+	return (0);
+}
+
+/* Producer: pass filled slot to writer. */
+static inline void
+wr_queue_commit(wr_queue_p q) {
+
+	atomic_store_explicit(&q->wpos,
+	    (atomic_load_explicit(&q->wpos, memory_order_relaxed) + 1),
+	    memory_order_release);
+}
+
+/* Producer: writer free queue after last drain. */
+static inline void
+wr_queue_dead_set(wr_queue_p q) {
+
+	atomic_store_explicit(&q->dead, 1, memory_order_release);
+}
+
+/* Committed, not released slots count. */
+static inline size_t
+wr_queue_used(wr_queue_p q) {
+	size_t wpos;
+
+	wpos = atomic_load_explicit(&q->wpos, memory_order_relaxed);
+	return ((wpos - atomic_load_explicit(&q->rpos, memory_order_acquire)));
+}
+
+/* Consumer: return first slot to process, wpos: end. */
+static inline size_t
+wr_queue_rpos(wr_queue_p q, size_t *wpos) {
+
+	(*wpos) = atomic_load_explicit(&q->wpos, memory_order_acquire);
+	return (atomic_load_explicit(&q->rpos, memory_order_relaxed));
+}
+
+/* Consumer: slots before rpos can be reused. */
+static inline void
+wr_queue_release(wr_queue_p q, size_t rpos) {
+
+	atomic_store_explicit(&q->rpos, rpos, memory_order_release);
+}
+
+
+int	wr_thread_start(wr_thread_p wt, uint32_t interval, uint32_t flags,
+	    wr_thread_drain_cb drain_cb, wr_thread_free_cb free_cb,
+	    wr_thread_pass_cb pass_cb, void *udata);
+/* Last drain done, not dead queues passed to free_cb. */
+void	wr_thread_stop(wr_thread_p wt);
+/* Any thread: pass queue to writer. */
+void	wr_thread_add(wr_thread_p wt, wr_queue_p q);
+
+
+#endif /* __MSD_WR_QUEUE_H__ */
@@ -0,0 +1,270 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+
+
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <stdlib.h> /* malloc, exit */
+#include <stdio.h> /* snprintf, fprintf */
+#include <inttypes.h>
+#include <string.h> /* bcopy, bzero, memcpy, memmove, memset, strerror... */
+#include <errno.h>
+
+#include "utils/macro.h"
+#include "replay.h"
+#include "test_common.h"
+
+
+#define TEST_PORT		1234
+#define TEST_PAYLOAD		"\x47payload"
+#define TEST_PAYLOAD_SIZE	(sizeof(TEST_PAYLOAD) - 1)
+
+
+/* IPv4 + UDP to 239.1.2.3:TEST_PORT + payload, return size. */
+static size_t
+test_ip4_make(uint8_t *buf, uint16_t frag) {
+
+	memset(buf, 0x00, 28);
+	buf[0] = 0x45;
+	buf[6] = (uint8_t)(frag >> 8);
+	buf[7] = (uint8_t)frag;
+	buf[8] = 64;
+	buf[9] = 17; /* UDP. */
+	buf[16] = 239;
+	buf[17] = 1;
+	buf[18] = 2;
+	buf[19] = 3;
+	buf[22] = (TEST_PORT >> 8);
+	buf[23] = (TEST_PORT & 0xff);
+	memcpy((buf + 28), TEST_PAYLOAD, TEST_PAYLOAD_SIZE);
+
+	return (28 + TEST_PAYLOAD_SIZE);
+}
+
+/* IPv6 + UDP to ff3e::1:TEST_PORT + payload, return size. */
+static size_t
+test_ip6_make(uint8_t *buf, uint8_t next_hdr) {
+
+	memset(buf, 0x00, 48);
+	buf[0] = 0x60;
+	buf[6] = next_hdr;
+	buf[7] = 64;
+	buf[24] = 0xff;
+	buf[25] = 0x3e;
+	buf[39] = 1;
+	buf[42] = (TEST_PORT >> 8);
+	buf[43] = (TEST_PORT & 0xff);
+	memcpy((buf + 48), TEST_PAYLOAD, TEST_PAYLOAD_SIZE);
+
+	return (48 + TEST_PAYLOAD_SIZE);
+}
+
+static int
+test_dst4_check(const struct sockaddr_storage *dst) {
+	const struct sockaddr_in *dst4 = (const struct sockaddr_in*)(const void*)dst;
+
+	return (AF_INET == dst->ss_family &&
+	    htonl(0xef010203) == dst4->sin_addr.s_addr &&
+	    htons(TEST_PORT) == dst4->sin_port);
+}
+
+static int
+test_dst6_check(const struct sockaddr_storage *dst) {
+	const struct sockaddr_in6 *dst6 = (const struct sockaddr_in6*)(const void*)dst;
+
+	return (AF_INET6 == dst->ss_family &&
+	    0xff == dst6->sin6_addr.s6_addr[0] &&
+	    0x3e == dst6->sin6_addr.s6_addr[1] &&
+	    1 == dst6->sin6_addr.s6_addr[15] &&
+	    htons(TEST_PORT) == dst6->sin6_port);
+}
+
+/* Parse, check payload position. */
+static int
+test_parse(uint32_t linktype, const uint8_t *pkt, size_t pkt_size,
+    size_t l2_size, struct sockaddr_storage *dst) {
+	size_t off = 0;
+	int error;
+
+	error = replay_pcap_udp_get(linktype, pkt, pkt_size, dst, &off);
+	if (0 != error)
+		return (error);
+	if ((pkt_size - TEST_PAYLOAD_SIZE) != off ||
+	    0 != memcmp((pkt + off), TEST_PAYLOAD, TEST_PAYLOAD_SIZE) ||
+	    (l2_size + ((AF_INET == dst->ss_family) ? 28 : 48)) != off)
+		return (EBADMSG);
+	return (0);
+}
+
+
+static int
+test_raw(void) {
+	uint8_t pkt[128];
+	size_t size;
+	struct sockaddr_storage dst;
+
+	size = test_ip4_make(pkt, 0);
+	TEST_CHECK(0 == test_parse(REPLAY_DLT_RAW, pkt, size, 0, &dst));
+	TEST_CHECK(test_dst4_check(&dst));
+	TEST_CHECK(0 == test_parse(REPLAY_DLT_RAW_BSD, pkt, size, 0, &dst));
+	TEST_CHECK(test_dst4_check(&dst));
+	size = test_ip6_make(pkt, 17);
+	TEST_CHECK(0 == test_parse(REPLAY_DLT_RAW, pkt, size, 0, &dst));
+	TEST_CHECK(test_dst6_check(&dst));
+	TEST_CHECK(EPROTONOSUPPORT == test_parse(105, pkt, size, 0, &dst));
+
+	return (0);
+}
+
+static int
+test_null(void) {
+	uint8_t pkt[128];
+	size_t size;
+	struct sockaddr_storage dst;
+
+	memset(pkt, 0x00, 4);
+	pkt[0] = 2; /* AF_INET, host byte order. */
+	size = (4 + test_ip4_make((pkt + 4), 0));
+	TEST_CHECK(0 == test_parse(REPLAY_DLT_NULL, pkt, size, 4, &dst));
+	TEST_CHECK(test_dst4_check(&dst));
+	size = (4 + test_ip6_make((pkt + 4), 17));
+	TEST_CHECK(0 == test_parse(REPLAY_DLT_NULL, pkt, size, 4, &dst));
+	TEST_CHECK(test_dst6_check(&dst));
+	/* Link header only. */
+	TEST_CHECK(EINVAL == test_parse(REPLAY_DLT_NULL, pkt, 4, 4, &dst));
+
+	return (0);
+}
+
+static int
+test_ether(void) {
+	uint8_t pkt[128];
+	size_t size;
+	struct sockaddr_storage dst;
+
+	memset(pkt, 0x00, 22);
+	pkt[12] = 0x08; /* IPv4. */
+	size = (14 + test_ip4_make((pkt + 14), 0));
+	TEST_CHECK(0 == test_parse(REPLAY_DLT_EN10MB, pkt, size, 14, &dst));
+	TEST_CHECK(test_dst4_check(&dst));
+	/* QinQ: 802.1ad + 802.1Q + IPv6. */
+	pkt[12] = 0x88;
+	pkt[13] = 0xa8;
+	pkt[16] = 0x81;
+	pkt[17] = 0x00;
+	pkt[20] = 0x86;
+	pkt[21] = 0xdd;
+	size = (22 + test_ip6_make((pkt + 22), 17));
+	TEST_CHECK(0 == test_parse(REPLAY_DLT_EN10MB, pkt, size, 22, &dst));
+	TEST_CHECK(test_dst6_check(&dst));
+	/* ARP. */
+	pkt[12] = 0x08;
+	pkt[13] = 0x06;
+	TEST_CHECK(EINVAL == test_parse(REPLAY_DLT_EN10MB, pkt, size, 14, &dst));
+	/* Short. */
+	TEST_CHECK(EINVAL == test_parse(REPLAY_DLT_EN10MB, pkt, 10, 14, &dst));
+
+	return (0);
+}
+
+static int
+test_sll(void) {
+	uint8_t pkt[128];
+	size_t size;
+	struct sockaddr_storage dst;
+
+	memset(pkt, 0x00, 20);
+	pkt[14] = 0x08; /* SLL protocol: IPv4. */
+	size = (16 + test_ip4_make((pkt + 16), 0));
+	TEST_CHECK(0 == test_parse(REPLAY_DLT_LINUX_SLL, pkt, size, 16, &dst));
+	TEST_CHECK(test_dst4_check(&dst));
+	memset(pkt, 0x00, 20);
+	pkt[0] = 0x86; /* SLL2 protocol: IPv6. */
+	pkt[1] = 0xdd;
+	size = (20 + test_ip6_make((pkt + 20), 17));
+	TEST_CHECK(0 == test_parse(REPLAY_DLT_LINUX_SLL2, pkt, size, 20, &dst));
+	TEST_CHECK(test_dst6_check(&dst));
+
+	return (0);
+}
+
+static int
+test_skip(void) {
+	uint8_t pkt[128];
+	size_t size, off;
+	struct sockaddr_storage dst;
+
+	/* Fragments: MF, offset. */
+	size = test_ip4_make(pkt, 0x2000);
+	TEST_CHECK(EINVAL == test_parse(REPLAY_DLT_RAW, pkt, size, 0, &dst));
+	size = test_ip4_make(pkt, 0x0010);
+	TEST_CHECK(EINVAL == test_parse(REPLAY_DLT_RAW, pkt, size, 0, &dst));
+	/* DF only is fine. */
+	size = test_ip4_make(pkt, 0x4000);
+	TEST_CHECK(0 == test_parse(REPLAY_DLT_RAW, pkt, size, 0, &dst));
+	/* TCP. */
+	pkt[9] = 6;
+	TEST_CHECK(EINVAL == test_parse(REPLAY_DLT_RAW, pkt, size, 0, &dst));
+	/* Bad IHL. */
+	size = test_ip4_make(pkt, 0);
+	pkt[0] = 0x44;
+	TEST_CHECK(EINVAL == test_parse(REPLAY_DLT_RAW, pkt, size, 0, &dst));
+	/* Truncated UDP header. */
+	size = test_ip4_make(pkt, 0);
+	TEST_CHECK(EINVAL == test_parse(REPLAY_DLT_RAW, pkt, 27, 0, &dst));
+	/* Empty payload: parsed, caller skip. */
+	TEST_CHECK(0 == replay_pcap_udp_get(REPLAY_DLT_RAW, pkt, 28, &dst, &off));
+	TEST_CHECK(28 == off);
+	/* IPv6 extension header. */
+	size = test_ip6_make(pkt, 0);
+	TEST_CHECK(EINVAL == test_parse(REPLAY_DLT_RAW, pkt, size, 0, &dst));
+	TEST_CHECK(EINVAL == test_parse(REPLAY_DLT_RAW, pkt, 0, 0, &dst));
+
+	return (0);
+}
+
+
+int
+main(int argc __unused, char *argv[] __unused) {
+	int error = 0;
+
+	error |= test_raw();
+	error |= test_null();
+	error |= test_ether();
+	error |= test_sll();
+	error |= test_skip();
+
+	return (error);
+}
@@ -0,0 +1,299 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+
+
+
+#include <sys/param.h>
+#include <sys/types.h>
+
+#include <stdlib.h> /* malloc, exit */
+#include <stdio.h> /* snprintf, fprintf */
+#include <inttypes.h>
+#include <string.h> /* bcopy, bzero, memcpy, memmove, memset, strerror... */
+#include <errno.h>
+
+#include "utils/macro.h"
+#include "rtp_arq.h"
+#include "test_common.h"
+
+
+#define TEST_RTCP_PT_RTPFB	205
+#define TEST_SSRC		0x11223344
+
+
+static void
+test_rtp_make(uint8_t *buf, uint16_t seq) {
+
+	memset(buf, 0x00, 16);
+	buf[0] = 0x80; /* V = 2. */
+	buf[1] = 33; /* MP2T. */
+	buf[2] = (uint8_t)(seq >> 8);
+	buf[3] = (uint8_t)seq;
+	buf[8] = (uint8_t)(TEST_SSRC >> 24);
+	buf[9] = (uint8_t)(TEST_SSRC >> 16);
+	buf[10] = (uint8_t)(TEST_SSRC >> 8);
+	buf[11] = (uint8_t)TEST_SSRC;
+	buf[12] = 0x47;
+}
+
+static int
+test_put(rtp_arq_p arq, uint16_t seq, uint64_t time) {
+	uint8_t buf[16];
+
+	test_rtp_make(buf, seq);
+	return (rtp_arq_put(arq, buf, sizeof(buf), time));
+}
+
+/* Sequence of next released packet, -1 = none. */
+static int
+test_get(rtp_arq_p arq, uint64_t time) {
+	const uint8_t *buf;
+
+	if (0 == rtp_arq_get(arq, time, &buf))
+		return (-1);
+	return ((buf[2] << 8) | buf[3]);
+}
+
+/* Find generic NACK in compound RTCP, return FCI count, fci: first. */
+static size_t
+test_nack_fci(const uint8_t *buf, size_t buf_size, const uint8_t **fci) {
+	size_t off, len;
+
+	for (off = 0; (off + 4) <= buf_size; off += len) {
+		len = ((((size_t)buf[(off + 2)] << 8) | buf[(off + 3)]) + 1) * 4;
+		if ((off + len) > buf_size || 2 != (buf[off] >> 6))
+			return (0);
+		if (TEST_RTCP_PT_RTPFB != buf[(off + 1)] ||
+		    1 != (buf[off] & 0x1f))
+			continue;
+		/* Media SSRC. */
+		if (0x11 != buf[(off + 8)] || 0x44 != buf[(off + 11)])
+			return (0);
+		(*fci) = (buf + off + 12);
+		return ((len - 12) / 4);
+	}
+	return (0);
+}
+
+static uint16_t
+test_be16(const uint8_t *buf) {
+
+	return ((uint16_t)((buf[0] << 8) | buf[1]));
+}
+
+static int
+test_arq_create(rtp_arq_p *arq_ret) {
+	rtp_arq_settings_t s;
+
+	rtp_arq_settings_def(&s);
+	s.window = 64;
+	return (rtp_arq_create(&s, arq_ret));
+}
+
+
+static int
+test_in_order(void) {
+	rtp_arq_p arq;
+	uint8_t buf[RTP_ARQ_RTCP_SIZE_MAX];
+
+	TEST_CHECK(0 == test_arq_create(&arq));
+	TEST_CHECK(0 == test_put(arq, 100, 1000));
+	TEST_CHECK(0 == test_put(arq, 101, 1000));
+	TEST_CHECK(100 == test_get(arq, 1000));
+	TEST_CHECK(101 == test_get(arq, 1000));
+	TEST_CHECK(-1 == test_get(arq, 1000));
+	TEST_CHECK(0 == rtp_arq_nack_make(arq, 5000, buf, sizeof(buf)));
+	/* Duplicate of released. */
+	TEST_CHECK(0 == test_put(arq, 100, 1000));
+	TEST_CHECK(-1 == test_get(arq, 1000));
+	rtp_arq_destroy(arq);
+
+	return (0);
+}
+
+static int
+test_not_rtp(void) {
+	rtp_arq_p arq;
+	uint8_t buf[188];
+
+	TEST_CHECK(0 == test_arq_create(&arq));
+	memset(buf, 0x00, sizeof(buf));
+	buf[0] = 0x47; /* TS sync byte: V = 1. */
+	TEST_CHECK(EINVAL == rtp_arq_put(arq, buf, sizeof(buf), 0));
+	test_rtp_make(buf, 1);
+	TEST_CHECK(EINVAL == rtp_arq_put(arq, buf, 8, 0));
+	rtp_arq_destroy(arq);
+
+	return (0);
+}
+
+/* Gap 101, 102: one FCI with PID 101, BLP bit 0 for 102, then recovery. */
+static int
+test_gap_recover(void) {
+	rtp_arq_p arq;
+	rtp_arq_stat_t stat;
+	uint8_t buf[RTP_ARQ_RTCP_SIZE_MAX];
+	const uint8_t *fci = NULL;
+	size_t size;
+
+	TEST_CHECK(0 == test_arq_create(&arq));
+	TEST_CHECK(0 == test_put(arq, 100, 1000));
+	TEST_CHECK(0 == test_put(arq, 103, 1000));
+	TEST_CHECK(100 == test_get(arq, 1000));
+	TEST_CHECK(-1 == test_get(arq, 1000));
+	/* Reorder wait. */
+	TEST_CHECK(0 == rtp_arq_nack_make(arq, 1000, buf, sizeof(buf)));
+	size = rtp_arq_nack_make(arq, (1000 + RTP_ARQ_S_DEF_REORDER),
+	    buf, sizeof(buf));
+	TEST_CHECK(0 != size && 0 == (size % 4));
+	TEST_CHECK(1 == test_nack_fci(buf, size, &fci));
+	TEST_CHECK(101 == test_be16(fci));
+	TEST_CHECK(0x0001 == test_be16(fci + 2));
+	/* Repeat only after NACK interval. */
+	TEST_CHECK(0 == rtp_arq_nack_make(arq, (1000 + RTP_ARQ_S_DEF_REORDER + 1),
+	    buf, sizeof(buf)));
+	TEST_CHECK(0 == test_put(arq, 102, 1020));
+	TEST_CHECK(-1 == test_get(arq, 1020));
+	TEST_CHECK(0 == test_put(arq, 101, 1030));
+	TEST_CHECK(101 == test_get(arq, 1030));
+	TEST_CHECK(102 == test_get(arq, 1030));
+	TEST_CHECK(103 == test_get(arq, 1030));
+	TEST_CHECK(-1 == test_get(arq, 1030));
+	TEST_CHECK(0 == rtp_arq_stat_get(arq, &stat));
+	TEST_CHECK(2 == stat.requested);
+	TEST_CHECK(2 == stat.recovered);
+	TEST_CHECK(1 == stat.nack_count);
+	TEST_CHECK(0 == stat.lost);
+	rtp_arq_destroy(arq);
+
+	return (0);
+}
+
+/* 18 missing: PID + 16 in BLP, next FCI for rest. */
+static int
+test_blp_split(void) {
+	rtp_arq_p arq;
+	uint8_t buf[RTP_ARQ_RTCP_SIZE_MAX];
+	const uint8_t *fci = NULL;
+	size_t size;
+
+	TEST_CHECK(0 == test_arq_create(&arq));
+	TEST_CHECK(0 == test_put(arq, 100, 0));
+	TEST_CHECK(0 == test_put(arq, 119, 0));
+	size = rtp_arq_nack_make(arq, 100, buf, sizeof(buf));
+	TEST_CHECK(2 == test_nack_fci(buf, size, &fci));
+	TEST_CHECK(101 == test_be16(fci));
+	TEST_CHECK(0xffff == test_be16(fci + 2));
+	TEST_CHECK(118 == test_be16(fci + 4));
+	TEST_CHECK(0x0000 == test_be16(fci + 6));
+	/* Too small buffer: nothing. */
+	TEST_CHECK(0 == rtp_arq_nack_make(arq, 1000, buf, 16));
+	rtp_arq_destroy(arq);
+
+	return (0);
+}
+
+/* Gap over sequence wrap, skipped after hold time. */
+static int
+test_wrap_lost(void) {
+	rtp_arq_p arq;
+	rtp_arq_stat_t stat;
+	uint8_t buf[RTP_ARQ_RTCP_SIZE_MAX];
+	const uint8_t *fci = NULL;
+	size_t size, i;
+
+	TEST_CHECK(0 == test_arq_create(&arq));
+	TEST_CHECK(0 == test_put(arq, 65534, 0));
+	TEST_CHECK(0 == test_put(arq, 1, 0));
+	size = rtp_arq_nack_make(arq, 100, buf, sizeof(buf));
+	TEST_CHECK(1 == test_nack_fci(buf, size, &fci));
+	TEST_CHECK(65535 == test_be16(fci));
+	TEST_CHECK(0x0001 == test_be16(fci + 2)); /* 0. */
+	/* Retries limit. */
+	for (i = 1; i < RTP_ARQ_S_DEF_RETRIES; i ++) {
+		TEST_CHECK(0 != rtp_arq_nack_make(arq,
+		    (100 + (i * RTP_ARQ_S_DEF_NACK_INTERVAL)), buf, sizeof(buf)));
+	}
+	TEST_CHECK(0 == rtp_arq_nack_make(arq, 450, buf, sizeof(buf)));
+	TEST_CHECK(65534 == test_get(arq, 100));
+	TEST_CHECK(-1 == test_get(arq, (RTP_ARQ_S_DEF_DELAY - 1)));
+	TEST_CHECK(1 == test_get(arq, RTP_ARQ_S_DEF_DELAY));
+	TEST_CHECK(0 == rtp_arq_stat_get(arq, &stat));
+	TEST_CHECK(2 == stat.lost);
+	TEST_CHECK((2 * RTP_ARQ_S_DEF_RETRIES) == stat.requested);
+	/* Late: skipped packet. */
+	TEST_CHECK(0 == test_put(arq, 0, 600));
+	TEST_CHECK(-1 == test_get(arq, 600));
+	TEST_CHECK(0 == rtp_arq_stat_get(arq, &stat));
+	TEST_CHECK(1 == stat.late);
+	rtp_arq_destroy(arq);
+
+	return (0);
+}
+
+/* Jump out of window: release held, then restart from new sequence. */
+static int
+test_resync(void) {
+	rtp_arq_p arq;
+	rtp_arq_stat_t stat;
+
+	TEST_CHECK(0 == test_arq_create(&arq));
+	TEST_CHECK(0 == test_put(arq, 10, 0));
+	TEST_CHECK(0 == test_put(arq, 12, 0));
+	TEST_CHECK(10 == test_get(arq, 0));
+	TEST_CHECK(EAGAIN == test_put(arq, 40000, 1));
+	/* Flush: gap skipped without wait. */
+	TEST_CHECK(EAGAIN == test_put(arq, 40000, 1));
+	TEST_CHECK(12 == test_get(arq, 1));
+	TEST_CHECK(-1 == test_get(arq, 1));
+	TEST_CHECK(0 == test_put(arq, 40000, 1));
+	TEST_CHECK(40000 == test_get(arq, 1));
+	TEST_CHECK(0 == rtp_arq_stat_get(arq, &stat));
+	TEST_CHECK(1 == stat.resync_count);
+	TEST_CHECK(1 == stat.lost);
+	rtp_arq_destroy(arq);
+
+	return (0);
+}
+
+
+int
+main(int argc __unused, char *argv[] __unused) {
+	int error = 0;
+
+	error |= test_in_order();
+	error |= test_not_rtp();
+	error |= test_gap_recover();
+	error |= test_blp_split();
+	error |= test_wrap_lost();
+	error |= test_resync();
+
+	return (error);
+}
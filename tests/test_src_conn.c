@@ -0,0 +1,182 @@
+/*-
+ * Copyright (c) 2012 - 2021 Rozhuk Ivan <rozhuk.im@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ */
+
+
+
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <stdlib.h> /* malloc, exit */
+#include <stdio.h> /* snprintf, fprintf */
+#include <inttypes.h>
+#include <string.h> /* bcopy, bzero, memcpy, memmove, memset, strerror... */
+#include <errno.h>
+
+#include "utils/macro.h"
+#include "net/socket_address.h"
+#include "stream_sys.h"
+#include "test_common.h"
+
+
+static int
+test_addr(str_src_conn_params_p src_conn_params, const char *str) {
+
+	str_src_conn_def(src_conn_params);
+	return (str_src_conn_addr_from_str(src_conn_params, str, strlen(str)));
+}
+
+/* Compare address and port with string form. */
+static int
+test_sa_eq(const struct sockaddr_storage *addr, const char *str) {
+	struct sockaddr_storage tmp;
+
+	memset(&tmp, 0x00, sizeof(tmp));
+	if (0 != sa_addr_port_from_str(&tmp, str, strlen(str)))
+		return (0);
+	return (sa_addr_port_is_eq(addr, &tmp));
+}
+
+static int
+test_sa_addr_eq(const struct sockaddr_storage *addr, const char *str) {
+	struct sockaddr_storage tmp;
+
+	memset(&tmp, 0x00, sizeof(tmp));
+	if (0 != sa_addr_from_str(&tmp, str, strlen(str)))
+		return (0);
+	sa_port_set(&tmp, sa_port_get(addr));
+	return (sa_addr_port_is_eq(addr, &tmp));
+}
+
+
+static int
+test_any_source(void) {
+	str_src_conn_params_t scp;
+
+	TEST_CHECK(0 == test_addr(&scp, "239.1.2.3:5000"));
+	TEST_CHECK(STR_SRC_CONN_T_MC == scp.udp.type);
+	TEST_CHECK(test_sa_eq(&scp.udp.addr, "239.1.2.3:5000"));
+	TEST_CHECK(AF_UNSPEC == scp.mc.src.ss_family);
+	TEST_CHECK(STR_SRC_CONN_DEF_IFINDEX == scp.mc.if_index);
+	/* Default port. */
+	TEST_CHECK(0 == test_addr(&scp, "239.1.2.3"));
+	TEST_CHECK(STR_SRC_CONN_DEF_PORT == sa_port_get(&scp.udp.addr));
+	TEST_CHECK(0 == test_addr(&scp, "[ff3e::1]:5000"));
+	TEST_CHECK(test_sa_eq(&scp.udp.addr, "[ff3e::1]:5000"));
+	TEST_CHECK(AF_UNSPEC == scp.mc.src.ss_family);
+
+	return (0);
+}
+
+static int
+test_ssm(void) {
+	str_src_conn_params_t scp;
+
+	TEST_CHECK(0 == test_addr(&scp, "10.0.0.1@232.1.2.3:5000"));
+	TEST_CHECK(test_sa_eq(&scp.udp.addr, "232.1.2.3:5000"));
+	TEST_CHECK(test_sa_addr_eq(&scp.mc.src, "10.0.0.1"));
+	TEST_CHECK(0 == test_addr(&scp, "2001:db8::1@[ff3e::1]:5000"));
+	TEST_CHECK(test_sa_eq(&scp.udp.addr, "[ff3e::1]:5000"));
+	TEST_CHECK(test_sa_addr_eq(&scp.mc.src, "2001:db8::1"));
+	/* Source reset by next parse without it. */
+	TEST_CHECK(0 == str_src_conn_addr_from_str(&scp, "232.1.2.3:5000",
+	    14));
+	TEST_CHECK(AF_UNSPEC == scp.mc.src.ss_family);
+
+	return (0);
+}
+
+static int
+test_bad(void) {
+	str_src_conn_params_t scp;
+
+	TEST_CHECK(EINVAL == test_addr(&scp, "10.0.0.1@[ff3e::1]:5000"));
+	TEST_CHECK(EINVAL == test_addr(&scp, "2001:db8::1@232.1.2.3:5000"));
+	TEST_CHECK(EINVAL == test_addr(&scp, "@232.1.2.3:5000"));
+	TEST_CHECK(EINVAL == test_addr(&scp, "10.0.0.1@"));
+	TEST_CHECK(EINVAL == test_addr(&scp, "source@232.1.2.3:5000"));
+	TEST_CHECK(EINVAL == test_addr(&scp, "group"));
+	TEST_CHECK(EINVAL == str_src_conn_addr_from_str(&scp, "", 0));
+	TEST_CHECK(EINVAL == str_src_conn_addr_from_str(NULL, "1.1.1.1", 7));
+
+	return (0);
+}
+
+static int
+test_http(void) {
+	str_src_conn_params_t scp;
+	const char *str = "10.0.0.1:8080,10.0.0.2/udp/239.1.2.3:5000";
+
+	str_src_conn_def(&scp);
+	TEST_CHECK(0 == str_src_conn_http_from_str(&scp, str, strlen(str)));
+	TEST_CHECK(STR_SRC_CONN_T_HTTP == scp.udp.type);
+	TEST_CHECK(2 == scp.http.origin_count);
+	TEST_CHECK(test_sa_eq(&scp.http.origin[0], "10.0.0.1:8080"));
+	TEST_CHECK(STR_SRC_CONN_DEF_HTTP_PORT == sa_port_get(&scp.http.origin[1]));
+	TEST_CHECK(test_sa_eq(&scp.udp.addr, "10.0.0.1:8080"));
+	TEST_CHECK(0 == strcmp(scp.http.path, "/udp/239.1.2.3:5000"));
+	str = "10.0.0.1/a b";
+	TEST_CHECK(EINVAL == str_src_conn_http_from_str(&scp, str, strlen(str)));
+
+	return (0);
+}
+
+static int
+test_file(void) {
+	str_src_conn_params_t scp;
+	const char *str = "/tmp/a.pcap?loop&dst=239.1.2.3:5000";
+
+	str_src_conn_def(&scp);
+	TEST_CHECK(0 == str_src_conn_file_from_str(&scp, str, strlen(str)));
+	TEST_CHECK(STR_SRC_CONN_T_FILE == scp.udp.type);
+	TEST_CHECK(0 == strcmp(scp.file.path, "/tmp/a.pcap"));
+	TEST_CHECK(REPLAY_F_LOOP == scp.file.flags);
+	TEST_CHECK(test_sa_eq(&scp.udp.addr, "239.1.2.3:5000"));
+	str = "/tmp/a.ts?speed=2";
+	TEST_CHECK(EINVAL == str_src_conn_file_from_str(&scp, str, strlen(str)));
+
+	return (0);
+}
+
+
+int
+main(int argc __unused, char *argv[] __unused) {
+	int error = 0;
+
+	error |= test_any_source();
+	error |= test_ssm();
+	error |= test_bad();
+	error |= test_http();
+	error |= test_file();
+
+	return (error);
+}